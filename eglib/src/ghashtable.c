@@ -29,32 +29,45 @@
 #include <math.h>
 #include <glib.h>
 
+/*
+ * The table uses open addressing with linear probing: the slots are
+ * stored inline in a power of two sized array and the key hash is cached
+ * in each slot, so most probes don't need to call the equal function.
+ * Removed slots are marked, so that slots never move while iterating:
+ * the marks are dropped when the table is resized.
+ */
 typedef struct _Slot Slot;
 
 struct _Slot {
 	gpointer key;
 	gpointer value;
-	Slot    *next;
+	guint    hash;
 };
 
-static gpointer KEYMARKER_REMOVED = &KEYMARKER_REMOVED;
+/* values of Slot.hash reserved for unused slots */
+#define HASH_EMPTY     0
+#define HASH_REMOVED   1
+#define HASH_FIRST_KEY 2
+
+#define SLOT_USED(s) ((s)->hash >= HASH_FIRST_KEY)
+
+#define MIN_TABLE_SIZE 8
 
 struct _GHashTable {
 	GHashFunc      hash_func;
 	GEqualFunc     key_equal_func;
 
-	Slot **table;
+	Slot *table;
 	int   table_size;
+	int   table_shift;
 	int   in_use;
-	int   threshold;
-	int   last_rehash;
+	int   removed;
 	GDestroyNotify value_destroy_func, key_destroy_func;
 };
 
 typedef struct {
 	GHashTable *ht;
 	int slot_index;
-	Slot *slot;
 } Iter;
 
 static const guint prime_tbl[] = {
@@ -104,6 +117,49 @@ g_spaced_primes_closest (guint x)
 	return calc_prime (x);
 }
 
+static void
+alloc_table (GHashTable *hash, int size)
+{
+	int shift = 32;
+
+	while ((1 << (32 - shift)) < size)
+		shift--;
+	hash->table_size = size;
+	hash->table_shift = shift;
+	hash->table = g_new0 (Slot, size);
+}
+
+static inline guint
+key_hash (GHashTable *hash, gconstpointer key)
+{
+	guint hashcode = (*hash->hash_func) (key);
+
+	if (hashcode < HASH_FIRST_KEY)
+		hashcode += HASH_FIRST_KEY;
+	return hashcode;
+}
+
+/*
+ * Fibonacci hashing: this spreads the bits of weak hash codes, like
+ * aligned pointers from g_direct_hash, over the whole table.
+ */
+#define FIRST_SLOT(hash,hashcode) (((hashcode) * 2654435769U) >> (hash)->table_shift)
+#define NEXT_SLOT(hash,i) (((i) + 1) & ((hash)->table_size - 1))
+
+static int
+find_slot (GHashTable *hash, gconstpointer key, guint hashcode)
+{
+	GEqualFunc equal = hash->key_equal_func;
+	Slot *table = hash->table;
+	int i;
+
+	for (i = FIRST_SLOT (hash, hashcode); table [i].hash != HASH_EMPTY; i = NEXT_SLOT (hash, i)) {
+		if (table [i].hash == hashcode && (*equal) (table [i].key, key))
+			return i;
+	}
+	return -1;
+}
+
 GHashTable *
 g_hash_table_new (GHashFunc hash_func, GEqualFunc key_equal_func)
 {
@@ -118,9 +174,7 @@ g_hash_table_new (GHashFunc hash_func, GEqualFunc key_equal_func)
 	hash->hash_func = hash_func;
 	hash->key_equal_func = key_equal_func;
 
-	hash->table_size = g_spaced_primes_closest (1);
-	hash->table = g_new0 (Slot *, hash->table_size);
-	hash->last_rehash = hash->table_size;
+	alloc_table (hash, MIN_TABLE_SIZE);
 	
 	return hash;
 }
@@ -139,44 +193,28 @@ g_hash_table_new_full (GHashFunc hash_func, GEqualFunc key_equal_func,
 	return hash;
 }
 
-#if 0
-static void
-dump_hash_table (GHashTable *hash)
-{
-	int i;
-
-	for (i = 0; i < hash->table_size; i++) {
-		Slot *s;
-
-		for (s = hash->table [i]; s != NULL; s = s->next){
-			guint hashcode = (*hash->hash_func) (s->key);
-			guint slot = (hashcode) % hash->table_size;
-			printf ("key %p hash %x on slot %d correct slot %d tb size %d\n", s->key, hashcode, i, slot, hash->table_size);
-		}
-	}
-}
-#endif
-
 #ifdef SANITY_CHECK
 static void
 sanity_check (GHashTable *hash)
 {
-	int i;
+	int i, j, in_use = 0;
 
 	for (i = 0; i < hash->table_size; i++) {
-		Slot *s;
-
-		for (s = hash->table [i]; s != NULL; s = s->next){
-			guint hashcode = (*hash->hash_func) (s->key);
-			guint slot = (hashcode) % hash->table_size;
-			if (slot != i) {
-				dump_hashcode_func = 1;
-				hashcode = (*hash->hash_func) (s->key);
-				dump_hashcode_func = 0;
-				g_error ("Key %p (bucket %d) on invalid bucket %d (hashcode %x) (tb size %d)", s->key, slot, i, hashcode, hash->table_size);
-			}
+		Slot *s = &hash->table [i];
+
+		if (!SLOT_USED (s))
+			continue;
+		in_use++;
+		if (s->hash != key_hash (hash, s->key))
+			g_error ("Key %p in slot %d has a wrong cached hash", s->key, i);
+		/* all the slots from the first one for the hash must be in use */
+		for (j = FIRST_SLOT (hash, s->hash); j != i; j = NEXT_SLOT (hash, j)) {
+			if (hash->table [j].hash == HASH_EMPTY)
+				g_error ("Key %p in slot %d is unreachable (tb size %d)", s->key, i, hash->table_size);
 		}
 	}
+	if (in_use != hash->in_use)
+		g_error ("Found %d keys, expected %d", in_use, hash->in_use);
 }
 #else
 
@@ -185,44 +223,45 @@ sanity_check (GHashTable *hash)
 #endif
 
 static void
-do_rehash (GHashTable *hash)
+do_rehash (GHashTable *hash, int new_size)
 {
 	int current_size, i;
-	Slot **table;
+	Slot *table;
 
-	/* printf ("Resizing diff=%d slots=%d\n", hash->in_use - hash->last_rehash, hash->table_size); */
-	hash->last_rehash = hash->table_size;
+	/* printf ("Resizing used=%d removed=%d slots=%d\n", hash->in_use, hash->removed, hash->table_size); */
 	current_size = hash->table_size;
-	hash->table_size = g_spaced_primes_closest (hash->in_use);
-	/* printf ("New size: %d\n", hash->table_size); */
 	table = hash->table;
-	hash->table = g_new0 (Slot *, hash->table_size);
+	alloc_table (hash, new_size);
+	hash->removed = 0;
 	
 	for (i = 0; i < current_size; i++){
-		Slot *s, *next;
-
-		for (s = table [i]; s != NULL; s = next){
-			guint hashcode = ((*hash->hash_func) (s->key)) % hash->table_size;
-			next = s->next;
-
-			s->next = hash->table [hashcode];
-			hash->table [hashcode] = s;
-		}
+		Slot *s = &table [i];
+		int j;
+
+		if (!SLOT_USED (s))
+			continue;
+		for (j = FIRST_SLOT (hash, s->hash); hash->table [j].hash != HASH_EMPTY; j = NEXT_SLOT (hash, j))
+			;
+		hash->table [j] = *s;
 	}
 	g_free (table);
 }
 
+/*
+ * Resize the table if adding EXTRA keys would make it more than 3/4 full
+ * (counting the removed slots) or if it is mostly empty after removals.
+ */
 static void
-rehash (GHashTable *hash)
+rehash (GHashTable *hash, int extra)
 {
-	int diff = ABS (hash->last_rehash - hash->in_use);
+	int new_size;
 
-	/* These are the factors to play with to change the rehashing strategy */
-	/* I played with them with a large range, and could not really get */
-	/* something that was too good, maybe the tests are not that great */
-	if (!(diff * 0.75 > hash->table_size * 2))
+	if ((hash->in_use + hash->removed + extra) * 4 <= hash->table_size * 3 &&
+	    (hash->in_use * 8 >= hash->table_size || hash->table_size == MIN_TABLE_SIZE))
 		return;
-	do_rehash (hash);
+	for (new_size = MIN_TABLE_SIZE; new_size < (hash->in_use + extra) * 2; new_size *= 2)
+		;
+	do_rehash (hash, new_size);
 	sanity_check (hash);
 }
 
@@ -232,17 +271,23 @@ g_hash_table_insert_replace (GHashTable *hash, gpointer key, gpointer value, gbo
 	guint hashcode;
 	Slot *s;
 	GEqualFunc equal;
+	int i, free_slot = -1;
 	
 	g_return_if_fail (hash != NULL);
 	sanity_check (hash);
 
 	equal = hash->key_equal_func;
-	if (hash->in_use >= hash->threshold)
-		rehash (hash);
-
-	hashcode = ((*hash->hash_func) (key)) % hash->table_size;
-	for (s = hash->table [hashcode]; s != NULL; s = s->next){
-		if ((*equal) (s->key, key)){
+	rehash (hash, 1);
+
+	hashcode = key_hash (hash, key);
+	for (i = FIRST_SLOT (hash, hashcode); hash->table [i].hash != HASH_EMPTY; i = NEXT_SLOT (hash, i)){
+		s = &hash->table [i];
+		if (s->hash == HASH_REMOVED) {
+			if (free_slot == -1)
+				free_slot = i;
+			continue;
+		}
+		if (s->hash == hashcode && (*equal) (s->key, key)){
 			if (replace){
 				if (hash->key_destroy_func != NULL)
 					(*hash->key_destroy_func)(s->key);
@@ -255,11 +300,14 @@ g_hash_table_insert_replace (GHashTable *hash, gpointer key, gpointer value, gbo
 			return;
 		}
 	}
-	s = g_new (Slot, 1);
+	if (free_slot == -1)
+		free_slot = i;
+	else
+		hash->removed--;
+	s = &hash->table [free_slot];
 	s->key = key;
 	s->value = value;
-	s->next = hash->table [hashcode];
-	hash->table [hashcode] = s;
+	s->hash = hashcode;
 	hash->in_use++;
 	sanity_check (hash);
 }
@@ -275,35 +323,29 @@ g_hash_table_size (GHashTable *hash)
 gpointer
 g_hash_table_lookup (GHashTable *hash, gconstpointer key)
 {
-	gpointer orig_key, value;
-	
-	if (g_hash_table_lookup_extended (hash, key, &orig_key, &value))
-		return value;
-	else
-		return NULL;
+	int i;
+
+	g_return_val_if_fail (hash != NULL, NULL);
+	sanity_check (hash);
+
+	i = find_slot (hash, key, key_hash (hash, key));
+	return i == -1 ? NULL : hash->table [i].value;
 }
 
 gboolean
 g_hash_table_lookup_extended (GHashTable *hash, gconstpointer key, gpointer *orig_key, gpointer *value)
 {
-	GEqualFunc equal;
-	Slot *s;
-	guint hashcode;
+	int i;
 	
 	g_return_val_if_fail (hash != NULL, FALSE);
 	sanity_check (hash);
-	equal = hash->key_equal_func;
 
-	hashcode = ((*hash->hash_func) (key)) % hash->table_size;
-	
-	for (s = hash->table [hashcode]; s != NULL; s = s->next){
-		if ((*equal)(s->key, key)){
-			*orig_key = s->key;
-			*value = s->value;
-			return TRUE;
-		}
-	}
-	return FALSE;
+	i = find_slot (hash, key, key_hash (hash, key));
+	if (i == -1)
+		return FALSE;
+	*orig_key = hash->table [i].key;
+	*value = hash->table [i].value;
+	return TRUE;
 }
 
 void
@@ -315,9 +357,9 @@ g_hash_table_foreach (GHashTable *hash, GHFunc func, gpointer user_data)
 	g_return_if_fail (func != NULL);
 
 	for (i = 0; i < hash->table_size; i++){
-		Slot *s;
+		Slot *s = &hash->table [i];
 
-		for (s = hash->table [i]; s != NULL; s = s->next)
+		if (SLOT_USED (s))
 			(*func)(s->key, s->value, user_data);
 	}
 }
@@ -331,15 +373,34 @@ g_hash_table_find (GHashTable *hash, GHRFunc predicate, gpointer user_data)
 	g_return_val_if_fail (predicate != NULL, NULL);
 
 	for (i = 0; i < hash->table_size; i++){
-		Slot *s;
+		Slot *s = &hash->table [i];
 
-		for (s = hash->table [i]; s != NULL; s = s->next)
-			if ((*predicate)(s->key, s->value, user_data))
-				return s->value;
+		if (SLOT_USED (s) && (*predicate)(s->key, s->value, user_data))
+			return s->value;
 	}
 	return NULL;
 }
 
+/*
+ * Mark the slot I as unused: it needs to stay in the probe sequence
+ * unless the next slot is empty.
+ */
+static void
+clear_slot (GHashTable *hash, int i)
+{
+	Slot *s = &hash->table [i];
+
+	s->key = NULL;
+	s->value = NULL;
+	if (hash->table [NEXT_SLOT (hash, i)].hash == HASH_EMPTY) {
+		s->hash = HASH_EMPTY;
+	} else {
+		s->hash = HASH_REMOVED;
+		hash->removed++;
+	}
+	hash->in_use--;
+}
+
 void
 g_hash_table_remove_all (GHashTable *hash)
 {
@@ -348,47 +409,40 @@ g_hash_table_remove_all (GHashTable *hash)
 	g_return_if_fail (hash != NULL);
 
 	for (i = 0; i < hash->table_size; i++){
-		Slot *s;
-
-		while (hash->table [i]) {
-			s = hash->table [i];
-			g_hash_table_remove (hash, s->key);
-		}
+		Slot *s = &hash->table [i];
+
+		if (!SLOT_USED (s))
+			continue;
+		if (hash->key_destroy_func != NULL)
+			(*hash->key_destroy_func)(s->key);
+		if (hash->value_destroy_func != NULL)
+			(*hash->value_destroy_func)(s->value);
 	}
+	memset (hash->table, 0, hash->table_size * sizeof (Slot));
+	hash->in_use = 0;
+	hash->removed = 0;
 }
 
 gboolean
 g_hash_table_remove (GHashTable *hash, gconstpointer key)
 {
-	GEqualFunc equal;
-	Slot *s, *last;
-	guint hashcode;
+	Slot *s;
+	int i;
 	
 	g_return_val_if_fail (hash != NULL, FALSE);
 	sanity_check (hash);
-	equal = hash->key_equal_func;
 
-	hashcode = ((*hash->hash_func)(key)) % hash->table_size;
-	last = NULL;
-	for (s = hash->table [hashcode]; s != NULL; s = s->next){
-		if ((*equal)(s->key, key)){
-			if (hash->key_destroy_func != NULL)
-				(*hash->key_destroy_func)(s->key);
-			if (hash->value_destroy_func != NULL)
-				(*hash->value_destroy_func)(s->value);
-			if (last == NULL)
-				hash->table [hashcode] = s->next;
-			else
-				last->next = s->next;
-			g_free (s);
-			hash->in_use--;
-			sanity_check (hash);
-			return TRUE;
-		}
-		last = s;
-	}
+	i = find_slot (hash, key, key_hash (hash, key));
+	if (i == -1)
+		return FALSE;
+	s = &hash->table [i];
+	if (hash->key_destroy_func != NULL)
+		(*hash->key_destroy_func)(s->key);
+	if (hash->value_destroy_func != NULL)
+		(*hash->value_destroy_func)(s->value);
+	clear_slot (hash, i);
 	sanity_check (hash);
-	return FALSE;
+	return TRUE;
 }
 
 guint
@@ -402,37 +456,25 @@ g_hash_table_foreach_remove (GHashTable *hash, GHRFunc func, gpointer user_data)
 
 	sanity_check (hash);
 	for (i = 0; i < hash->table_size; i++){
-		Slot *s, *last;
-
-		last = NULL;
-		for (s = hash->table [i]; s != NULL; ){
-			if ((*func)(s->key, s->value, user_data)){
-				Slot *n;
+		Slot *s = &hash->table [i];
 
-				if (hash->key_destroy_func != NULL)
-					(*hash->key_destroy_func)(s->key);
-				if (hash->value_destroy_func != NULL)
-					(*hash->value_destroy_func)(s->value);
-				if (last == NULL){
-					hash->table [i] = s->next;
-					n = s->next;
-				} else  {
-					last->next = s->next;
-					n = last->next;
-				}
-				g_free (s);
-				hash->in_use--;
-				count++;
-				s = n;
-			} else {
-				last = s;
-				s = s->next;
-			}
+		if (SLOT_USED (s) && (*func)(s->key, s->value, user_data)){
+			if (hash->key_destroy_func != NULL)
+				(*hash->key_destroy_func)(s->key);
+			if (hash->value_destroy_func != NULL)
+				(*hash->value_destroy_func)(s->value);
+			/* don't drop the slot from the probe sequences we are still iterating */
+			s->key = NULL;
+			s->value = NULL;
+			s->hash = HASH_REMOVED;
+			hash->removed++;
+			hash->in_use--;
+			count++;
 		}
 	}
 	sanity_check (hash);
 	if (count > 0)
-		rehash (hash);
+		rehash (hash, 0);
 	return count;
 }
 
@@ -447,33 +489,20 @@ g_hash_table_foreach_steal (GHashTable *hash, GHRFunc func, gpointer user_data)
 
 	sanity_check (hash);
 	for (i = 0; i < hash->table_size; i++){
-		Slot *s, *last;
-
-		last = NULL;
-		for (s = hash->table [i]; s != NULL; ){
-			if ((*func)(s->key, s->value, user_data)){
-				Slot *n;
-
-				if (last == NULL){
-					hash->table [i] = s->next;
-					n = s->next;
-				} else  {
-					last->next = s->next;
-					n = last->next;
-				}
-				g_free (s);
-				hash->in_use--;
-				count++;
-				s = n;
-			} else {
-				last = s;
-				s = s->next;
-			}
+		Slot *s = &hash->table [i];
+
+		if (SLOT_USED (s) && (*func)(s->key, s->value, user_data)){
+			s->key = NULL;
+			s->value = NULL;
+			s->hash = HASH_REMOVED;
+			hash->removed++;
+			hash->in_use--;
+			count++;
 		}
 	}
 	sanity_check (hash);
 	if (count > 0)
-		rehash (hash);
+		rehash (hash, 0);
 	return count;
 }
 
@@ -485,17 +514,14 @@ g_hash_table_destroy (GHashTable *hash)
 	g_return_if_fail (hash != NULL);
 
 	for (i = 0; i < hash->table_size; i++){
-		Slot *s, *next;
-
-		for (s = hash->table [i]; s != NULL; s = next){
-			next = s->next;
-			
-			if (hash->key_destroy_func != NULL)
-				(*hash->key_destroy_func)(s->key);
-			if (hash->value_destroy_func != NULL)
-				(*hash->value_destroy_func)(s->value);
-			g_free (s);
-		}
+		Slot *s = &hash->table [i];
+
+		if (!SLOT_USED (s))
+			continue;
+		if (hash->key_destroy_func != NULL)
+			(*hash->key_destroy_func)(s->key);
+		if (hash->value_destroy_func != NULL)
+			(*hash->value_destroy_func)(s->value);
 	}
 	g_free (hash->table);
 	
@@ -505,22 +531,23 @@ g_hash_table_destroy (GHashTable *hash)
 void
 g_hash_table_print_stats (GHashTable *table)
 {
-	int i, max_chain_index, chain_size, max_chain_size;
-	Slot *node;
+	int i, max_probe_index, probe_size, max_probe_size;
+	Slot *s;
 
-	max_chain_size = 0;
-	max_chain_index = -1;
+	max_probe_size = 0;
+	max_probe_index = -1;
 	for (i = 0; i < table->table_size; i++) {
-		chain_size = 0;
-		for (node = table->table [i]; node; node = node->next)
-			chain_size ++;
-		if (chain_size > max_chain_size) {
-			max_chain_size = chain_size;
-			max_chain_index = i;
+		s = &table->table [i];
+		if (!SLOT_USED (s))
+			continue;
+		probe_size = (i - (int)FIRST_SLOT (table, s->hash)) & (table->table_size - 1);
+		if (probe_size > max_probe_size) {
+			max_probe_size = probe_size;
+			max_probe_index = i;
 		}
 	}
 
-	printf ("Size: %d Table Size: %d Max Chain Length: %d at %d\n", table->in_use, table->table_size, max_chain_size, max_chain_index);
+	printf ("Size: %d Table Size: %d Removed: %d Max Probe Length: %d at %d\n", table->in_use, table->table_size, table->removed, max_probe_size, max_probe_index);
 }
 
 void
@@ -542,24 +569,20 @@ gboolean g_hash_table_iter_next (GHashTableIter *it, gpointer *key, gpointer *va
 	g_assert (iter->slot_index != -2);
 	g_assert (sizeof (Iter) <= sizeof (GHashTableIter));
 
-	if (!iter->slot) {
-		while (TRUE) {
-			iter->slot_index ++;
-			if (iter->slot_index >= hash->table_size) {
-				iter->slot_index = -2;
-				return FALSE;
-			}
-			if (hash->table [iter->slot_index])
-				break;
+	while (TRUE) {
+		iter->slot_index ++;
+		if (iter->slot_index >= hash->table_size) {
+			iter->slot_index = -2;
+			return FALSE;
 		}
-		iter->slot = hash->table [iter->slot_index];
+		if (SLOT_USED (&hash->table [iter->slot_index]))
+			break;
 	}
 
 	if (key)
-		*key = iter->slot->key;
+		*key = hash->table [iter->slot_index].key;
 	if (value)
-		*value = iter->slot->value;
-	iter->slot = iter->slot->next;
+		*value = hash->table [iter->slot_index].value;
 
 	return TRUE;
 }
@@ -594,14 +617,20 @@ g_str_equal (gconstpointer v1, gconstpointer v2)
 	return strcmp (v1, v2) == 0;
 }
 
+/*
+ * FNV-1a: unlike the old shift based hash it mixes every byte into all
+ * the bits of the result.
+ */
 guint
 g_str_hash (gconstpointer v1)
 {
-	guint hash = 0;
-	char *p = (char *) v1;
+	guint hash = 2166136261U;
+	const unsigned char *p = v1;
 
-	while (*p++)
-		hash = (hash << 5) - (hash + *p);
+	while (*p) {
+		hash ^= *p++;
+		hash *= 16777619U;
+	}
 
 	return hash;
 }
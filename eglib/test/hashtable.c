@@ -163,6 +163,95 @@ RESULT hash_iter (void)
 #endif
 }
 
+static gboolean
+remove_odd (gpointer key, gpointer value, gpointer user_data)
+{
+	return GPOINTER_TO_UINT (key) & 1;
+}
+
+RESULT hash_remove (void)
+{
+	GHashTable *hash = g_hash_table_new (NULL, NULL);
+	int i;
+
+	/* interleave inserts and removes, so removed slots get reused */
+	for (i = 0; i < 10000; i++) {
+		g_hash_table_insert (hash, GUINT_TO_POINTER (i), GUINT_TO_POINTER (i + 1));
+		if (i >= 100 && !g_hash_table_remove (hash, GUINT_TO_POINTER (i - 100)))
+			return FAILED ("Did not remove %d", i - 100);
+	}
+	if (g_hash_table_size (hash) != 100)
+		return FAILED ("Expected 100 elements, found %d", g_hash_table_size (hash));
+	for (i = 0; i < 10000; i++) {
+		gpointer value = g_hash_table_lookup (hash, GUINT_TO_POINTER (i));
+		if (i < 9900 && value != NULL)
+			return FAILED ("Found removed key %d", i);
+		if (i >= 9900 && value != GUINT_TO_POINTER (i + 1))
+			return FAILED ("Did not find key %d", i);
+	}
+
+	if (g_hash_table_foreach_remove (hash, remove_odd, NULL) != 50)
+		return FAILED ("foreach_remove did not remove 50 elements");
+	for (i = 9900; i < 10000; i++) {
+		gpointer value = g_hash_table_lookup (hash, GUINT_TO_POINTER (i));
+		if ((i & 1) && value != NULL)
+			return FAILED ("Found removed key %d", i);
+		if (!(i & 1) && value != GUINT_TO_POINTER (i + 1))
+			return FAILED ("Did not find key %d after foreach_remove", i);
+	}
+
+	g_hash_table_remove_all (hash);
+	if (g_hash_table_size (hash) != 0 || g_hash_table_lookup (hash, GUINT_TO_POINTER (9900)))
+		return FAILED ("remove_all left elements in the hash");
+	g_hash_table_destroy (hash);
+	return OK;
+}
+
+/*
+ * Not really a test: a workload similar to the runtime caches, to compare
+ * hash implementations with test-both --speed-compare.
+ */
+#define BENCH_KEYS 20000
+
+RESULT hash_bench (void)
+{
+	GHashTable *names = g_hash_table_new (g_str_hash, g_str_equal);
+	GHashTable *ptrs = g_hash_table_new (NULL, NULL);
+	char **keys = g_new (char*, BENCH_KEYS);
+	gpointer *objs = g_new (gpointer, BENCH_KEYS);
+	int i, round;
+
+	for (i = 0; i < BENCH_KEYS; i++) {
+		keys [i] = g_strdup_printf ("System.Collections.Generic.Class%d", i);
+		objs [i] = g_malloc (16);
+		g_hash_table_insert (names, keys [i], objs [i]);
+		g_hash_table_insert (ptrs, objs [i], keys [i]);
+	}
+	for (round = 0; round < 10; round++) {
+		for (i = 0; i < BENCH_KEYS; i++) {
+			if (g_hash_table_lookup (names, keys [i]) != objs [i])
+				return FAILED ("Did not find %s", keys [i]);
+			if (g_hash_table_lookup (ptrs, objs [i]) != keys [i])
+				return FAILED ("Did not find object %d", i);
+			if (g_hash_table_lookup (ptrs, keys [i]))
+				return FAILED ("Found a missing key");
+		}
+		for (i = round; i < BENCH_KEYS; i += 10) {
+			g_hash_table_remove (ptrs, objs [i]);
+			g_hash_table_insert (ptrs, objs [i], keys [i]);
+		}
+	}
+	g_hash_table_destroy (names);
+	g_hash_table_destroy (ptrs);
+	for (i = 0; i < BENCH_KEYS; i++) {
+		g_free (keys [i]);
+		g_free (objs [i]);
+	}
+	g_free (keys);
+	g_free (objs);
+	return OK;
+}
+
 static Test hashtable_tests [] = {
 	{"t1", hash_t1},
 	{"t2", hash_t2},
@@ -170,6 +259,8 @@ static Test hashtable_tests [] = {
 	{"default", hash_default},
 	{"null_lookup", hash_null_lookup},
 	{"iter", hash_iter},
+	{"remove", hash_remove},
+	{"bench", hash_bench},
 	{NULL, NULL}
 };
 
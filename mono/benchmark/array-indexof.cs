@@ -0,0 +1,30 @@
+using System;
+
+public class Tests {
+
+	public static int Main (string[] args) {
+		int res = 0, repeat = 1;
+		int[] ia = new int [256];
+		char[] ca = new char [256];
+		byte[] ba = new byte [256];
+
+		if (args.Length == 1)
+			repeat = Convert.ToInt32 (args [0]);
+		
+		Console.WriteLine ("Repeat = " + repeat);
+
+		ia [255] = 1;
+		ca [255] = 'a';
+		ba [255] = 1;
+
+		for (int i = 0; i < (repeat * 10); i++) {
+			for (int j = 0; j < 100000; j++) {
+				res += Array.IndexOf (ia, 1);
+				res += Array.IndexOf (ca, 'a');
+				res += Array.IndexOf (ba, (byte)1);
+			}
+		}
+		
+		return res == repeat * 10 * 100000 * 255 * 3 ? 0 : 1;
+	}
+}
@@ -0,0 +1,41 @@
+using System;
+
+struct Block {
+	public long a, b, c, d, e, f, g, h;
+}
+
+public class Tests {
+
+	static Block copy (Block b) {
+		return b;
+	}
+
+	public static int Main (string[] args) {
+		int repeat = 1;
+		byte[] src = new byte [64 * 1024];
+		byte[] dst = new byte [64 * 1024];
+		int[] isrc = new int [16 * 1024];
+		int[] idst = new int [16 * 1024];
+		Block blk = new Block ();
+
+		if (args.Length == 1)
+			repeat = Convert.ToInt32 (args [0]);
+		
+		Console.WriteLine ("Repeat = " + repeat);
+
+		src [src.Length - 1] = 1;
+		isrc [isrc.Length - 1] = 1;
+		blk.h = 1;
+
+		for (int i = 0; i < (repeat * 10); i++) {
+			for (int j = 0; j < 1000; j++) {
+				Buffer.BlockCopy (src, 0, dst, 0, src.Length);
+				Array.Copy (isrc, idst, isrc.Length);
+			}
+			for (int j = 0; j < 1000000; j++)
+				blk = copy (blk);
+		}
+		
+		return dst [dst.Length - 1] == 1 && idst [idst.Length - 1] == 1 && blk.h == 1 ? 0 : 1;
+	}
+}
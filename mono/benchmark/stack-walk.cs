@@ -0,0 +1,60 @@
+using System;
+using System.Diagnostics;
+using System.Threading;
+
+/*
+ * Measures how fast the runtime maps return addresses to methods: every
+ * thread walks a deep stack over and over, like a sampling profiler or
+ * an exception unwind would.
+ */
+public class Tests {
+
+	static int iterations;
+	static int frames;
+
+	static int walk (int depth) {
+		if (depth == 0) {
+			int n = 0;
+			for (int i = 0; i < iterations; i++)
+				n += new StackTrace ().FrameCount;
+			return n;
+		}
+		return depth % 2 == 0 ? walk_even (depth - 1) : walk_odd (depth - 1);
+	}
+
+	static int walk_even (int depth) {
+		return walk (depth);
+	}
+
+	static int walk_odd (int depth) {
+		return walk (depth);
+	}
+
+	static void run () {
+		Interlocked.Add (ref frames, walk (32));
+	}
+
+	public static int Main (string[] args) {
+		int repeat = 1;
+		int nthreads = 1;
+
+		if (args.Length > 0)
+			repeat = Convert.ToInt32 (args [0]);
+		if (args.Length > 1)
+			nthreads = Convert.ToInt32 (args [1]);
+
+		Console.WriteLine ("Repeat = " + repeat + ", threads = " + nthreads);
+
+		iterations = repeat * 10000;
+
+		Thread[] threads = new Thread [nthreads];
+		for (int i = 0; i < nthreads; i++) {
+			threads [i] = new Thread (run);
+			threads [i].Start ();
+		}
+		for (int i = 0; i < nthreads; i++)
+			threads [i].Join ();
+
+		return frames >= iterations * nthreads * 64 ? 0 : 1;
+	}
+}
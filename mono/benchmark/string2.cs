@@ -0,0 +1,29 @@
+using System;
+
+public class Tests {
+
+	public static int Main (string[] args) {
+		int res = 0, repeat = 1;
+		string ts1 = "The quick brown fox jumps over the lazy dog, then naps in the afternoon sun!";
+		string ts2 = String.Concat ("The quick brown fox jumps over the lazy dog, ", "then naps in the afternoon sun!");
+		string ts3 = "The quick brown fox jumps over the lazy dog, then naps in the afternoon sun?";
+		
+		if (args.Length == 1)
+			repeat = Convert.ToInt32 (args [0]);
+		
+		Console.WriteLine ("Repeat = " + repeat);
+
+		for (int i = 0; i < (repeat * 50); i++) {
+			for (int j = 0; j < 100000; j++) {
+				res += ts1.IndexOf ('!');
+				if (ts1 == ts2)
+					res++;
+				if (String.Equals (ts1, ts3))
+					res++;
+				res += String.CompareOrdinal (ts1, ts3);
+			}
+		}
+		
+		return res == repeat * 50 * 100000 * (75 + 1 + 0 + ('!' - '?')) ? 0 : 1;
+	}
+}
@@ -718,6 +718,7 @@ typedef struct {
 	gulong jit_info_table_insert_count;
 	gulong jit_info_table_remove_count;
 	gulong jit_info_table_lookup_count;
+	gulong jit_info_table_lookup_cache_hits;
 	gulong hazardous_pointer_count;
 	gulong generics_sharable_methods;
 	gulong generics_unsharable_methods;
@@ -74,8 +74,6 @@ struct _MonoJitInfoTable
 
 #define MONO_SIZEOF_JIT_INFO_TABLE (sizeof (struct _MonoJitInfoTable) - MONO_ZERO_LEN_ARRAY * SIZEOF_VOID_P)
 
-typedef GArray MonoAotModuleInfoTable;
-
 typedef struct {
 	guint32  flags;
 	gint32   exvar_offset;
@@ -167,12 +165,11 @@ struct _MonoJitInfo {
 	gboolean    has_try_block_holes:1;
 	gboolean    from_aot:1;
 	gboolean    from_llvm:1;
+	gboolean    has_gc_info:1;
 
-	/* FIXME: Embed this after the structure later*/
-	gpointer    gc_info; /* Currently only used by SGen */
-	
 	MonoJitExceptionInfo clauses [MONO_ZERO_LEN_ARRAY];
-	/* There is an optional MonoGenericJitInfo after the clauses */
+	/* There is an optional gc map pointer after the clauses, currently only used by SGen */
+	/* There is an optional MonoGenericJitInfo after the gc map pointer */
 	/* There is an optional MonoTryBlockHoleTableJitInfo after MonoGenericJitInfo clauses*/
 };
 
@@ -418,6 +415,9 @@ mono_domain_code_reserve (MonoDomain *domain, int size) MONO_LLVM_INTERNAL;
 void*
 mono_domain_code_reserve_align (MonoDomain *domain, int size, int alignment) MONO_INTERNAL;
 
+void*
+mono_domain_code_reserve_cold (MonoDomain *domain, int size, int alignment) MONO_INTERNAL;
+
 void
 mono_domain_code_commit (MonoDomain *domain, void *data, int size, int newsize) MONO_INTERNAL;
 
@@ -439,6 +439,12 @@ mono_domain_set_internal_with_options (MonoDomain *domain, gboolean migrate_exce
 MonoTryBlockHoleTableJitInfo*
 mono_jit_info_get_try_block_hole_table_info (MonoJitInfo *ji) MONO_INTERNAL;
 
+gpointer
+mono_jit_info_get_gc_info (MonoJitInfo *ji) MONO_INTERNAL;
+
+void
+mono_jit_info_set_gc_info (MonoJitInfo *ji, gpointer gc_info) MONO_INTERNAL;
+
 /* 
  * Installs a new function which is used to return a MonoJitInfo for a method inside
  * an AOT module.
@@ -20,6 +20,7 @@
 #include <mono/utils/mono-logger-internal.h>
 #include <mono/utils/mono-membar.h>
 #include <mono/utils/mono-counters.h>
+#include <mono/utils/mono-metrics.h>
 #include <mono/metadata/object.h>
 #include <mono/metadata/object-internals.h>
 #include <mono/metadata/domain-internals.h>
@@ -121,9 +122,16 @@ static const MonoRuntimeInfo *current_runtime = NULL;
 static MonoJitInfoFindInAot jit_info_find_in_aot_func = NULL;
 
 /*
- * Contains information about AOT loaded code.
+ * Contains information about AOT loaded code, sorted by start address.
+ * It is replaced as a whole under the appdomains lock when a module is
+ * added, and read under a hazard pointer, so lookups don't take a lock.
  */
-static MonoAotModuleInfoTable *aot_modules = NULL;
+typedef struct {
+	int len;
+	AotModuleInfo *modules [MONO_ZERO_LEN_ARRAY];
+} AotModuleInfoTable;
+
+static AotModuleInfoTable * volatile aot_modules = NULL;
 
 /* This is the list of runtime versions supported by this JIT.
  */
@@ -185,6 +193,37 @@ mono_domain_get_tls_offset (void)
 #define JIT_INFO_TABLE_HAZARD_INDEX		0
 #define JIT_INFO_HAZARD_INDEX			1
 
+/*
+ * Stack walks and sampling profilers look up the same handful of
+ * methods over and over, so every thread remembers the code ranges of
+ * its last few hits.  The range is copied into the entry, so a stale
+ * MonoJitInfo is never dereferenced.  Any removal from a jit info
+ * table bumps jit_info_table_gen, which flushes the caches of all
+ * threads on their next lookup.  The cache can be entered from a
+ * signal handler while the interrupted thread is updating it, so
+ * nested lookups bypass it.
+ */
+#define JIT_INFO_LOOKUP_CACHE_SIZE		8
+
+typedef struct {
+	MonoDomain *domain;
+	gint8 *code_start, *code_end;
+	MonoJitInfo *ji;
+} JitInfoLookupCacheEntry;
+
+typedef struct {
+	gint32 gen;
+	gint32 busy;
+	int next;
+	JitInfoLookupCacheEntry entries [JIT_INFO_LOOKUP_CACHE_SIZE];
+} JitInfoLookupCache;
+
+static volatile gint32 jit_info_table_gen;
+
+#ifdef HAVE_KW_THREAD
+static __thread JitInfoLookupCache jit_info_lookup_cache MONO_TLS_FAST;
+#endif
+
 static int
 jit_info_table_num_elements (MonoJitInfoTable *table)
 {
@@ -367,8 +406,86 @@ jit_info_table_chunk_index (MonoJitInfoTableChunk *chunk, MonoThreadHazardPointe
 	return left;
 }
 
-MonoJitInfo*
-mono_jit_info_table_find (MonoDomain *domain, char *addr)
+static void
+jit_info_lookup_cache_invalidate (void)
+{
+	InterlockedIncrement (&jit_info_table_gen);
+}
+
+#ifdef HAVE_KW_THREAD
+
+/*
+ * Returns the cache of the current thread, or NULL if it can't be used
+ * because we interrupted a lookup on this thread.  On success the cache
+ * must be released with jit_info_lookup_cache_release ().
+ */
+static JitInfoLookupCache*
+jit_info_lookup_cache_acquire (void)
+{
+	JitInfoLookupCache *cache = &jit_info_lookup_cache;
+	gint32 gen;
+
+	if (cache->busy)
+		return NULL;
+	cache->busy = 1;
+	mono_memory_write_barrier ();
+
+	gen = jit_info_table_gen;
+	if (cache->gen != gen) {
+		memset (cache->entries, 0, sizeof (cache->entries));
+		cache->gen = gen;
+	}
+
+	return cache;
+}
+
+static void
+jit_info_lookup_cache_release (JitInfoLookupCache *cache)
+{
+	mono_memory_write_barrier ();
+	cache->busy = 0;
+}
+
+static MonoJitInfo*
+jit_info_lookup_cache_find (JitInfoLookupCache *cache, MonoDomain *domain, gint8 *addr)
+{
+	int i;
+
+	for (i = 0; i < JIT_INFO_LOOKUP_CACHE_SIZE; ++i) {
+		JitInfoLookupCacheEntry *entry = &cache->entries [i];
+
+		if (entry->domain == domain && addr >= entry->code_start && addr < entry->code_end)
+			return entry->ji;
+	}
+
+	return NULL;
+}
+
+/*
+ * The table entry we found is only guaranteed to be alive if nothing
+ * was removed since the cache was validated.
+ */
+static void
+jit_info_lookup_cache_add (JitInfoLookupCache *cache, MonoDomain *domain, MonoJitInfo *ji)
+{
+	JitInfoLookupCacheEntry *entry;
+
+	if (cache->gen != jit_info_table_gen)
+		return;
+
+	entry = &cache->entries [cache->next];
+	cache->next = (cache->next + 1) % JIT_INFO_LOOKUP_CACHE_SIZE;
+
+	entry->domain = domain;
+	entry->code_start = (gint8*)ji->code_start;
+	entry->code_end = (gint8*)ji->code_start + ji->code_size;
+	entry->ji = ji;
+}
+
+#endif
+
+static MonoJitInfo*
+jit_info_table_find (MonoDomain *domain, char *addr)
 {
 	MonoJitInfoTable *table;
 	MonoJitInfo *ji;
@@ -376,8 +493,6 @@ mono_jit_info_table_find (MonoDomain *domain, char *addr)
 	MonoThreadHazardPointers *hp = mono_hazard_pointer_get ();
 	MonoImage *image;
 
-	++mono_stats.jit_info_table_lookup_count;
-
 	/* First we have to get the domain's jit_info_table.  This is
 	   complicated by the fact that a writer might substitute a
 	   new table and free the old one.  What the writer guarantees
@@ -445,6 +560,37 @@ mono_jit_info_table_find (MonoDomain *domain, char *addr)
 	return ji;
 }
 
+MonoJitInfo*
+mono_jit_info_table_find (MonoDomain *domain, char *addr)
+{
+	MonoJitInfo *ji;
+#ifdef HAVE_KW_THREAD
+	JitInfoLookupCache *cache;
+#endif
+
+	++mono_stats.jit_info_table_lookup_count;
+
+#ifdef HAVE_KW_THREAD
+	cache = jit_info_lookup_cache_acquire ();
+	if (cache) {
+		ji = jit_info_lookup_cache_find (cache, domain, (gint8*)addr);
+		if (ji) {
+			++mono_stats.jit_info_table_lookup_cache_hits;
+		} else {
+			ji = jit_info_table_find (domain, addr);
+			if (ji)
+				jit_info_lookup_cache_add (cache, domain, ji);
+		}
+		jit_info_lookup_cache_release (cache);
+		return ji;
+	}
+#endif
+
+	ji = jit_info_table_find (domain, addr);
+
+	return ji;
+}
+
 static G_GNUC_UNUSED void
 jit_info_table_check (MonoJitInfoTable *table)
 {
@@ -838,6 +984,9 @@ mono_jit_info_table_remove (MonoDomain *domain, MonoJitInfo *ji)
 
 	chunk->data [pos] = mono_jit_info_make_tombstone (ji);
 
+	/* Has to happen before ji can be freed */
+	jit_info_lookup_cache_invalidate ();
+
 	/* Debugging code, should be removed. */
 	//jit_info_table_check (table);
 
@@ -846,20 +995,14 @@ mono_jit_info_table_remove (MonoDomain *domain, MonoJitInfo *ji)
 	mono_domain_unlock (domain);
 }
 
-static MonoAotModuleInfoTable*
-mono_aot_module_info_table_new (void)
-{
-	return g_array_new (FALSE, FALSE, sizeof (gpointer));
-}
-
 static int
-aot_info_table_index (MonoAotModuleInfoTable *table, char *addr)
+aot_info_table_index (AotModuleInfoTable *table, char *addr)
 {
 	int left = 0, right = table->len;
 
 	while (left < right) {
 		int pos = (left + right) / 2;
-		AotModuleInfo *ainfo = g_array_index (table, gpointer, pos);
+		AotModuleInfo *ainfo = table->modules [pos];
 		char *start = ainfo->start;
 		char *end = ainfo->end;
 
@@ -878,7 +1021,8 @@ void
 mono_jit_info_add_aot_module (MonoImage *image, gpointer start, gpointer end)
 {
 	AotModuleInfo *ainfo = g_new0 (AotModuleInfo, 1);
-	int pos;
+	AotModuleInfoTable *old_table, *new_table;
+	int pos, len;
 
 	ainfo->image = image;
 	ainfo->start = start;
@@ -886,44 +1030,61 @@ mono_jit_info_add_aot_module (MonoImage *image, gpointer start, gpointer end)
 
 	mono_appdomains_lock ();
 
-	if (!aot_modules)
-		aot_modules = mono_aot_module_info_table_new ();
+	old_table = aot_modules;
+	len = old_table ? old_table->len : 0;
+	pos = old_table ? aot_info_table_index (old_table, start) : 0;
 
-	pos = aot_info_table_index (aot_modules, start);
+	new_table = g_malloc (sizeof (AotModuleInfoTable) + (len + 1) * sizeof (AotModuleInfo*));
+	new_table->len = len + 1;
+	if (old_table) {
+		memcpy (new_table->modules, old_table->modules, pos * sizeof (AotModuleInfo*));
+		memcpy (new_table->modules + pos + 1, old_table->modules + pos, (len - pos) * sizeof (AotModuleInfo*));
+	}
+	new_table->modules [pos] = ainfo;
 
-	g_array_insert_val (aot_modules, pos, ainfo);
+	mono_memory_write_barrier ();
+	aot_modules = new_table;
+
+	if (old_table)
+		mono_thread_hazardous_free_or_queue (old_table, g_free);
 
 	mono_appdomains_unlock ();
 }
 
+/*
+ * LOCKING: Lock free, uses the JIT_INFO_TABLE_HAZARD_INDEX hazard pointer.
+ */
 static MonoImage*
 mono_jit_info_find_aot_module (guint8* addr)
 {
-	guint left = 0, right;
+	MonoThreadHazardPointers *hp = mono_hazard_pointer_get ();
+	AotModuleInfoTable *table;
+	MonoImage *image = NULL;
+	int left = 0, right;
 
 	if (!aot_modules)
 		return NULL;
 
-	mono_appdomains_lock ();
+	table = get_hazardous_pointer ((gpointer volatile*)&aot_modules, hp, JIT_INFO_TABLE_HAZARD_INDEX);
 
-	right = aot_modules->len;
+	right = table->len;
 	while (left < right) {
-		guint pos = (left + right) / 2;
-		AotModuleInfo *ai = g_array_index (aot_modules, gpointer, pos);
+		int pos = (left + right) / 2;
+		AotModuleInfo *ai = table->modules [pos];
 
 		if (addr < (guint8*)ai->start)
 			right = pos;
 		else if (addr >= (guint8*)ai->end)
 			left = pos + 1;
 		else {
-			mono_appdomains_unlock ();
-			return ai->image;
+			image = ai->image;
+			break;
 		}
 	}
 
-	mono_appdomains_unlock ();
+	mono_hazard_pointer_clear (hp, JIT_INFO_TABLE_HAZARD_INDEX);
 
-	return NULL;
+	return image;
 }
 
 void
@@ -975,13 +1136,42 @@ mono_jit_code_hash_init (MonoInternalHashTable *jit_code_hash)
 				       jit_info_next_value);
 }
 
+/*
+ * mono_jit_info_get_gc_info:
+ *
+ *   Return the GC map of JI, or NULL. Most methods don't have one, so the
+ * pointer is only allocated after the clauses if JI->has_gc_info is set.
+ */
+gpointer
+mono_jit_info_get_gc_info (MonoJitInfo *ji)
+{
+	if (ji->has_gc_info)
+		return *(gpointer*)&ji->clauses [ji->num_clauses];
+	else
+		return NULL;
+}
+
+void
+mono_jit_info_set_gc_info (MonoJitInfo *ji, gpointer gc_info)
+{
+	g_assert (ji->has_gc_info);
+
+	*(gpointer*)&ji->clauses [ji->num_clauses] = gc_info;
+}
+
 MonoGenericJitInfo*
 mono_jit_info_get_generic_jit_info (MonoJitInfo *ji)
 {
-	if (ji->has_generic_jit_info)
-		return (MonoGenericJitInfo*)&ji->clauses [ji->num_clauses];
-	else
+	char *ptr;
+
+	if (ji->has_generic_jit_info) {
+		ptr = (char*)&ji->clauses [ji->num_clauses];
+		if (ji->has_gc_info)
+			ptr += sizeof (gpointer);
+		return (MonoGenericJitInfo*)ptr;
+	} else {
 		return NULL;
+	}
 }
 
 /*
@@ -1025,6 +1215,8 @@ mono_jit_info_get_try_block_hole_table_info (MonoJitInfo *ji)
 {
 	if (ji->has_try_block_holes) {
 		char *ptr = (char*)&ji->clauses [ji->num_clauses];
+		if (ji->has_gc_info)
+			ptr += sizeof (gpointer);
 		if (ji->has_generic_jit_info)
 			ptr += sizeof (MonoGenericJitInfo);
 		return (MonoTryBlockHoleTableJitInfo*)ptr;
@@ -1212,7 +1404,7 @@ mono_domain_create (void)
 	domain->proxy_vtable_hash = g_hash_table_new ((GHashFunc)mono_ptrarray_hash, (GCompareFunc)mono_ptrarray_equal);
 	domain->static_data_array = NULL;
 	mono_jit_code_hash_init (&domain->jit_code_hash);
-	domain->ldstr_table = mono_g_hash_table_new_type ((GHashFunc)mono_string_hash, (GCompareFunc)mono_string_equal, MONO_HASH_KEY_VALUE_GC);
+	domain->ldstr_table = mono_g_hash_table_new_type_concurrent ((GHashFunc)mono_string_hash, (GCompareFunc)mono_string_equal, MONO_HASH_KEY_VALUE_GC);
 	domain->num_jit_info_tables = 1;
 	domain->jit_info_table = jit_info_table_new (domain);
 	domain->jit_info_free_queue = NULL;
@@ -1278,12 +1470,17 @@ mono_init_internal (const char *filename, const char *exe_filename, const char *
 
 	mono_perfcounters_init ();
 
+	mono_metrics_init ();
+
 	mono_counters_register ("Max native code in a domain", MONO_COUNTER_INT|MONO_COUNTER_JIT, &max_domain_code_size);
 	mono_counters_register ("Max code space allocated in a domain", MONO_COUNTER_INT|MONO_COUNTER_JIT, &max_domain_code_alloc);
 	mono_counters_register ("Total code space allocated", MONO_COUNTER_INT|MONO_COUNTER_JIT, &total_domain_code_alloc);
+	mono_code_manager_init ();
 
 	mono_gc_base_init ();
 
+	mono_mempool_init ();
+
 	appdomain_thread_id = TlsAlloc ();
 
 	InitializeCriticalSection (&appdomains_mutex);
@@ -2031,6 +2228,7 @@ mono_domain_free (MonoDomain *domain, gboolean force)
 	 */
 	mono_thread_hazardous_try_free_all ();
 	g_assert (domain->num_jit_info_tables == 1);
+	jit_info_lookup_cache_invalidate ();
 	jit_info_table_free (domain->jit_info_table);
 	domain->jit_info_table = NULL;
 	g_assert (!domain->jit_info_free_queue);
@@ -2184,6 +2382,24 @@ mono_domain_code_reserve_align (MonoDomain *domain, int size, int alignment)
 	return res;
 }
 
+/*
+ * mono_domain_code_reserve_cold:
+ *
+ *   Allocate code which is rarely executed, away from the methods of DOMAIN.
+ * LOCKING: Acquires the domain lock.
+ */
+void*
+mono_domain_code_reserve_cold (MonoDomain *domain, int size, int alignment)
+{
+	gpointer res;
+
+	mono_domain_lock (domain);
+	res = mono_code_manager_reserve_cold (domain->code_mp, size, alignment);
+	mono_domain_unlock (domain);
+
+	return res;
+}
+
 /*
  * mono_domain_code_commit:
  *
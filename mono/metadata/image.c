@@ -30,6 +30,7 @@
 #include <mono/utils/mono-logger-internal.h>
 #include <mono/utils/mono-path.h>
 #include <mono/utils/mono-mmap.h>
+#include <mono/utils/mono-counters.h>
 #include <mono/utils/mono-io-portability.h>
 #include <mono/metadata/class-internals.h>
 #include <mono/metadata/assembly.h>
@@ -53,6 +54,10 @@ static GHashTable *loaded_images_refonly_hash;
 
 static gboolean debug_assembly_unload = FALSE;
 
+/* Statistics */
+static gint32 images_mapped, images_copied;
+static gint64 image_bytes_mapped, image_bytes_copied;
+
 #define mono_images_lock() if (mutex_inited) EnterCriticalSection (&images_mutex)
 #define mono_images_unlock() if (mutex_inited) LeaveCriticalSection (&images_mutex)
 static gboolean mutex_inited;
@@ -170,6 +175,43 @@ mono_image_rva_map (MonoImage *image, guint32 addr)
 	return NULL;
 }
 
+static void
+add_resident_bytes (gpointer key, gpointer value, gpointer user_data)
+{
+	MonoImage *image = value;
+	gint64 *total = user_data;
+	int pages;
+
+	/* Images are also registered under their assembly name, count them once */
+	if (key != image->name)
+		return;
+	/* Only file mappings can be partially paged in */
+	if (!image->raw_buffer_used || !image->raw_data)
+		return;
+	pages = mono_mresident (image->raw_data, image->raw_data_len);
+	if (pages > 0)
+		*total += (gint64)pages * mono_pagesize ();
+}
+
+/*
+ * image_bytes_resident:
+ *
+ *   Counter callback returning how many bytes of the mmapped images are
+ * actually in memory, i.e. how much of the assemblies was touched.
+ */
+static gint64
+image_bytes_resident (void)
+{
+	gint64 total = 0;
+
+	if (!mutex_inited)
+		return 0;
+	mono_images_lock ();
+	g_hash_table_foreach (loaded_images_hash, add_resident_bytes, &total);
+	mono_images_unlock ();
+	return total;
+}
+
 /**
  * mono_images_init:
  *
@@ -185,6 +227,12 @@ mono_images_init (void)
 
 	debug_assembly_unload = g_getenv ("MONO_DEBUG_ASSEMBLY_UNLOAD") != NULL;
 
+	mono_counters_register ("Images mapped", MONO_COUNTER_METADATA | MONO_COUNTER_INT, &images_mapped);
+	mono_counters_register ("Image bytes mapped", MONO_COUNTER_METADATA | MONO_COUNTER_LONG, &image_bytes_mapped);
+	mono_counters_register ("Image bytes resident", MONO_COUNTER_METADATA | MONO_COUNTER_LONG | MONO_COUNTER_CALLBACK, image_bytes_resident);
+	mono_counters_register ("Images copied", MONO_COUNTER_METADATA | MONO_COUNTER_INT, &images_copied);
+	mono_counters_register ("Image bytes copied", MONO_COUNTER_METADATA | MONO_COUNTER_LONG, &image_bytes_copied);
+
 	mutex_inited = TRUE;
 }
 
@@ -1027,6 +1075,8 @@ do_mono_image_open (const char *fname, MonoImageOpenStatus *status,
 			*status = MONO_IMAGE_IMAGE_INVALID;
 		return NULL;
 	}
+	images_mapped++;
+	image_bytes_mapped += image->raw_data_len;
 	iinfo = g_new0 (MonoCLIImageInfo, 1);
 	image->image_info = iinfo;
 	image->name = mono_path_resolve_symlinks (fname);
@@ -1148,6 +1198,8 @@ mono_image_open_from_data_with_name (char *data, guint32 data_len, gboolean need
 			return NULL;
 		}
 		memcpy (datac, data, data_len);
+		images_copied++;
+		image_bytes_copied += data_len;
 	}
 
 	image = g_new0 (MonoImage, 1);
@@ -1602,6 +1654,7 @@ mono_image_close_except_pools (MonoImage *image)
 		g_hash_table_destroy (image->name_cache);
 	}
 
+	mono_marshal_clear_wrapper_lookup_cache ();
 	free_hash (image->native_wrapper_cache);
 	free_hash (image->managed_wrapper_cache);
 	free_hash (image->delegate_begin_invoke_cache);
@@ -1611,6 +1664,7 @@ mono_image_close_except_pools (MonoImage *image)
 	free_hash (image->delegate_bound_static_invoke_cache);
 	free_hash (image->remoting_invoke_cache);
 	free_hash (image->runtime_invoke_cache);
+	free_hash (image->runtime_invoke_array_cache);
 	free_hash (image->runtime_invoke_direct_cache);
 	free_hash (image->runtime_invoke_vcall_cache);
 	free_hash (image->synchronized_cache);
@@ -35,6 +35,7 @@
 #include "mono/metadata/gc-internal.h"
 #include "mono/metadata/cominterop.h"
 #include "mono/utils/mono-counters.h"
+#include "mono/utils/mono-conc-cache.h"
 #include <string.h>
 #include <errno.h>
 
@@ -76,6 +77,13 @@ typedef struct _MonoRemotingMethods MonoRemotingMethods;
 static CRITICAL_SECTION marshal_mutex;
 static gboolean marshal_mutex_initialized;
 
+/*
+ * Lock-free front end of the wrapper caches in MonoImage, so looking up an already
+ * created wrapper doesn't need to take the marshal lock. Updated while holding the
+ * marshal lock.
+ */
+static MonoConcCache *wrapper_lookup_cache;
+
 static guint32 last_error_tls_id;
 
 static guint32 load_type_info_tls_id;
@@ -201,6 +209,7 @@ mono_marshal_init (void)
 		module_initialized = TRUE;
 		InitializeCriticalSection (&marshal_mutex);
 		marshal_mutex_initialized = TRUE;
+		wrapper_lookup_cache = mono_conc_cache_new (2048);
 		last_error_tls_id = TlsAlloc ();
 		load_type_info_tls_id = TlsAlloc ();
 
@@ -267,6 +276,8 @@ mono_marshal_cleanup (void)
 	TlsFree (last_error_tls_id);
 	DeleteCriticalSection (&marshal_mutex);
 	marshal_mutex_initialized = FALSE;
+	mono_conc_cache_free (wrapper_lookup_cache);
+	wrapper_lookup_cache = NULL;
 }
 
 MonoClass *byte_array_class;
@@ -2375,12 +2386,36 @@ mono_marshal_find_in_cache (GHashTable *cache, gpointer key)
 {
 	MonoMethod *res;
 
+	res = mono_conc_cache_lookup (wrapper_lookup_cache, cache, key);
+	if (res)
+		return res;
+
 	mono_marshal_lock ();
 	res = g_hash_table_lookup (cache, key);
+	if (res)
+		mono_conc_cache_insert (wrapper_lookup_cache, cache, key, res);
 	mono_marshal_unlock ();
 	return res;
 }
 
+/*
+ * mono_marshal_clear_wrapper_lookup_cache:
+ *
+ *   Flush the lock-free wrapper lookup cache. This needs to be called before the
+ * wrapper caches of an image are freed.
+ */
+void
+mono_marshal_clear_wrapper_lookup_cache (void)
+{
+	/* This could be called during shutdown */
+	if (!marshal_mutex_initialized)
+		return;
+
+	mono_marshal_lock ();
+	mono_conc_cache_clear (wrapper_lookup_cache);
+	mono_marshal_unlock ();
+}
+
 /* Create the method from the builder and place it in the cache */
 MonoMethod*
 mono_mb_create_and_cache (GHashTable *cache, gpointer key,
@@ -2389,9 +2424,7 @@ mono_mb_create_and_cache (GHashTable *cache, gpointer key,
 {
 	MonoMethod *res;
 
-	mono_marshal_lock ();
-	res = g_hash_table_lookup (cache, key);
-	mono_marshal_unlock ();
+	res = mono_marshal_find_in_cache (cache, key);
 	if (!res) {
 		MonoMethod *newm;
 		newm = mono_mb_create_method (mb, sig, max_stack);
@@ -2401,6 +2434,7 @@ mono_mb_create_and_cache (GHashTable *cache, gpointer key,
 			res = newm;
 			g_hash_table_insert (cache, key, res);
 			mono_marshal_set_wrapper_info (res, key);
+			mono_conc_cache_insert (wrapper_lookup_cache, cache, key, res);
 			mono_marshal_unlock ();
 		} else {
 			mono_marshal_unlock ();
@@ -4204,12 +4238,14 @@ runtime_invoke_signature_equal (MonoMethodSignature *sig1, MonoMethodSignature *
  * emit_invoke_call:
  *
  *   Emit the call to the wrapper method from a runtime invoke wrapper.
+ * If FROM_ARRAY is TRUE, the arguments are read directly from the object[] passed
+ * as the second argument, instead of from an array of pointers to the values.
  */
 static void
 emit_invoke_call (MonoMethodBuilder *mb, MonoMethod *method,
 				  MonoMethodSignature *sig, MonoMethodSignature *callsig,
 				  int loc_res,
-				  gboolean virtual, gboolean need_direct_wrapper)
+				  gboolean virtual, gboolean need_direct_wrapper, gboolean from_array)
 {
 	static MonoString *string_dummy = NULL;
 	int i;
@@ -4242,12 +4278,16 @@ emit_invoke_call (MonoMethodBuilder *mb, MonoMethod *method,
 		int type;
 
 		mono_mb_emit_ldarg (mb, 1);
-		if (i) {
+		if (from_array) {
+			mono_mb_emit_icon (mb, G_STRUCT_OFFSET (MonoArray, vector) + sizeof (gpointer) * i);
+			mono_mb_emit_byte (mb, CEE_ADD);
+		} else if (i) {
 			mono_mb_emit_icon (mb, sizeof (gpointer) * i);
 			mono_mb_emit_byte (mb, CEE_ADD);
 		}
 
 		if (t->byref) {
+			g_assert (!from_array);
 			mono_mb_emit_byte (mb, CEE_LDIND_I);
 			/* A Nullable<T> type don't have a boxed form, it's either null or a boxed T.
 			 * So to make this work we unbox it to a local variablee and push a reference to that.
@@ -4281,6 +4321,11 @@ handle_enum:
 		case MONO_TYPE_I8:
 		case MONO_TYPE_U8:
 			mono_mb_emit_byte (mb, CEE_LDIND_I);
+			if (from_array) {
+				/* Load the value directly from the boxed object */
+				mono_mb_emit_icon (mb, sizeof (MonoObject));
+				mono_mb_emit_byte (mb, CEE_ADD);
+			}
 			mono_mb_emit_byte (mb, mono_type_to_ldind (sig->params [i]));
 			break;
 		case MONO_TYPE_STRING:
@@ -4304,7 +4349,12 @@ handle_enum:
 				goto handle_enum;
 			}
 			mono_mb_emit_byte (mb, CEE_LDIND_I);
+			if (from_array) {
+				mono_mb_emit_icon (mb, sizeof (MonoObject));
+				mono_mb_emit_byte (mb, CEE_ADD);
+			}
 			if (mono_class_is_nullable (mono_class_from_mono_type (sig->params [i]))) {
+				g_assert (!from_array);
 				/* Need to convert a boxed vtype to an mp to a Nullable struct */
 				mono_mb_emit_op (mb, CEE_UNBOX, mono_class_from_mono_type (sig->params [i]));
 				mono_mb_emit_op (mb, CEE_LDOBJ, mono_class_from_mono_type (sig->params [i]));
@@ -4400,7 +4450,7 @@ handle_enum:
 static void
 emit_runtime_invoke_body (MonoMethodBuilder *mb, MonoClass *target_klass, MonoMethod *method,
 						  MonoMethodSignature *sig, MonoMethodSignature *callsig,
-						  gboolean virtual, gboolean need_direct_wrapper)
+						  gboolean virtual, gboolean need_direct_wrapper, gboolean from_array)
 {
 	gint32 labels [16];
 	MonoExceptionClause *clause;
@@ -4435,7 +4485,7 @@ emit_runtime_invoke_body (MonoMethodBuilder *mb, MonoClass *target_klass, MonoMe
 	 */
 	labels [1] = mono_mb_get_label (mb);
 	emit_thread_force_interrupt_checkpoint (mb);
-	emit_invoke_call (mb, method, sig, callsig, loc_res, virtual, need_direct_wrapper);
+	emit_invoke_call (mb, method, sig, callsig, loc_res, virtual, need_direct_wrapper, from_array);
 
 	labels [2] = mono_mb_emit_branch (mb, CEE_LEAVE);
 
@@ -4469,7 +4519,7 @@ emit_runtime_invoke_body (MonoMethodBuilder *mb, MonoClass *target_klass, MonoMe
 	 */
 	mono_mb_patch_branch (mb, labels [0]);
 	emit_thread_force_interrupt_checkpoint (mb);
-	emit_invoke_call (mb, method, sig, callsig, loc_res, virtual, need_direct_wrapper);
+	emit_invoke_call (mb, method, sig, callsig, loc_res, virtual, need_direct_wrapper, from_array);
 
 	mono_mb_emit_ldloc (mb, 0);
 	mono_mb_emit_byte (mb, CEE_RET);
@@ -4617,7 +4667,7 @@ mono_marshal_get_runtime_invoke (MonoMethod *method, gboolean virtual)
 	mb = mono_mb_new (target_klass, name,  MONO_WRAPPER_RUNTIME_INVOKE);
 	g_free (name);
 
-	emit_runtime_invoke_body (mb, target_klass, method, sig, callsig, virtual, need_direct_wrapper);
+	emit_runtime_invoke_body (mb, target_klass, method, sig, callsig, virtual, need_direct_wrapper, FALSE);
 
 	if (need_direct_wrapper) {
 		mb->skip_visibility = 1;
@@ -4654,6 +4704,123 @@ mono_marshal_get_runtime_invoke (MonoMethod *method, gboolean virtual)
 	return res;	
 }
 
+/*
+ * mono_marshal_get_runtime_invoke_array:
+ *
+ *   Return a runtime invoke wrapper which reads the arguments of METHOD directly
+ * from an object[] holding the boxed values, as passed in by reflection:
+ * MonoObject *runtime_invoke (MonoObject *this, MonoArray *params, MonoObject **exc, void* method)
+ * Primitive and valuetype arguments are loaded straight out of their boxes, so
+ * the caller doesn't have to build an array of pointers to the unboxed values.
+ * The wrappers are shared between all methods with the same signature shape.
+ * The caller has to make sure none of the valuetype arguments are null.
+ * Returns NULL if METHOD has arguments which need more elaborate marshalling,
+ * like byref, Nullable<T> or pointer arguments.
+ */
+MonoMethod*
+mono_marshal_get_runtime_invoke_array (MonoMethod *method)
+{
+	MonoMethodSignature *sig, *csig, *callsig, *tmp_sig;
+	MonoMethodBuilder *mb;
+	GHashTable *cache;
+	MonoClass *target_klass;
+	MonoMethod *res, *newm;
+	char *name;
+	int i;
+
+	g_assert (method);
+
+	sig = mono_method_signature (method);
+
+	if (method->string_ctor || method->wrapper_type != MONO_WRAPPER_NONE || method->klass->contextbound)
+		return NULL;
+	/* These receive a managed pointer as this */
+	if (method->klass->valuetype && sig->hasthis)
+		return NULL;
+	/* Array Get/Set/Address methods need a direct wrapper */
+	if (method->klass->rank && (method->iflags & METHOD_IMPL_ATTRIBUTE_INTERNAL_CALL) &&
+		(method->iflags & METHOD_IMPL_ATTRIBUTE_NATIVE))
+		return NULL;
+	if (sig->ret->byref || sig->ret->type == MONO_TYPE_PTR || sig->ret->type == MONO_TYPE_TYPEDBYREF)
+		return NULL;
+	for (i = 0; i < sig->param_count; ++i) {
+		MonoType *t = sig->params [i];
+
+		if (t->byref)
+			return NULL;
+		switch (t->type) {
+		case MONO_TYPE_PTR:
+		case MONO_TYPE_FNPTR:
+		case MONO_TYPE_TYPEDBYREF:
+			return NULL;
+		case MONO_TYPE_VALUETYPE:
+		case MONO_TYPE_GENERICINST:
+			if (mono_class_is_nullable (mono_class_from_mono_type (t)))
+				return NULL;
+			break;
+		default:
+			break;
+		}
+	}
+
+	target_klass = get_wrapper_target_class (method->klass->image);
+
+	callsig = mono_marshal_get_runtime_invoke_sig (sig);
+
+	cache = get_cache (&target_klass->image->runtime_invoke_array_cache,
+					   (GHashFunc)mono_signature_hash,
+					   (GCompareFunc)runtime_invoke_signature_equal);
+
+	mono_marshal_lock ();
+	res = g_hash_table_lookup (cache, callsig);
+	mono_marshal_unlock ();
+
+	if (res) {
+		g_free (callsig);
+		return res;
+	}
+
+	/* Make a copy of the signature from the image mempool */
+	tmp_sig = callsig;
+	callsig = mono_metadata_signature_dup_full (target_klass->image, callsig);
+	g_free (tmp_sig);
+
+	csig = mono_metadata_signature_alloc (target_klass->image, 4);
+
+	csig->ret = &mono_defaults.object_class->byval_arg;
+	csig->params [0] = &mono_defaults.object_class->byval_arg;
+	csig->params [1] = &mono_defaults.int_class->byval_arg;
+	csig->params [2] = &mono_defaults.int_class->byval_arg;
+	csig->params [3] = &mono_defaults.int_class->byval_arg;
+	csig->pinvoke = 1;
+#if TARGET_WIN32
+	/* This is called from runtime code so it has to be cdecl */
+	csig->call_convention = MONO_CALL_C;
+#endif
+
+	name = mono_signature_to_name (callsig, "runtime_invoke_array");
+	mb = mono_mb_new (target_klass, name,  MONO_WRAPPER_RUNTIME_INVOKE);
+	g_free (name);
+
+	emit_runtime_invoke_body (mb, target_klass, method, sig, callsig, FALSE, FALSE, TRUE);
+
+	newm = mono_mb_create_method (mb, csig, sig->param_count + 16);
+
+	mono_marshal_lock ();
+	res = g_hash_table_lookup (cache, callsig);
+	if (!res) {
+		res = newm;
+		g_hash_table_insert (cache, callsig, res);
+	} else {
+		mono_free_method (newm);
+	}
+	mono_marshal_unlock ();
+
+	mono_mb_free (mb);
+
+	return res;
+}
+
 /*
  * mono_marshal_get_runtime_invoke_dynamic:
  *
@@ -11946,6 +12113,8 @@ mono_marshal_free_dynamic_wrappers (MonoMethod *method)
 		g_hash_table_foreach_remove (image->delegate_bound_static_invoke_cache, signature_method_pair_matches_method, method);
 	if (image->delegate_abstract_invoke_cache)
 		g_hash_table_foreach_remove (image->delegate_abstract_invoke_cache, signature_method_pair_matches_method, method);
+	if (wrapper_lookup_cache)
+		mono_conc_cache_clear (wrapper_lookup_cache);
 
 	if (marshal_mutex_initialized)
 		mono_marshal_unlock ();
@@ -11995,6 +12164,8 @@ mono_marshal_free_inflated_wrappers (MonoMethod *method)
                g_hash_table_remove (method->klass->image->delegate_invoke_cache, sig);
        if (sig && method->klass->image->runtime_invoke_cache)
                g_hash_table_remove (method->klass->image->runtime_invoke_cache, sig);
+       if (sig && method->klass->image->runtime_invoke_array_cache)
+               g_hash_table_remove (method->klass->image->runtime_invoke_array_cache, sig);
 
         /*
          * indexed by SignatureMethodPair
@@ -12029,5 +12200,8 @@ mono_marshal_free_inflated_wrappers (MonoMethod *method)
        if (method->klass->image->thunk_invoke_cache)
                g_hash_table_remove (method->klass->image->thunk_invoke_cache, method);
 
+       /* Some of the caches above are keyed by signature equality */
+       mono_conc_cache_clear (wrapper_lookup_cache);
+
        mono_marshal_unlock ();
 }
@@ -85,6 +85,9 @@ G_BEGIN_DECLS
 /*type of the function pointer of methods returned by mono_marshal_get_runtime_invoke*/
 typedef MonoObject *(*RuntimeInvokeFunction) (MonoObject *this, void **params, MonoObject **exc, void* compiled_method);
 
+/*type of the function pointer of methods returned by mono_marshal_get_runtime_invoke_array*/
+typedef MonoObject *(*RuntimeInvokeArrayFunction) (MonoObject *this, MonoArray *params, MonoObject **exc, void* compiled_method);
+
 typedef void (*RuntimeInvokeDynamicFunction) (void *args, MonoObject **exc, void* compiled_method);
 
 /* marshaling helper functions */
@@ -199,6 +202,9 @@ mono_marshal_get_delegate_invoke (MonoMethod *method, MonoDelegate *del) MONO_IN
 MonoMethod *
 mono_marshal_get_runtime_invoke (MonoMethod *method, gboolean virtual) MONO_INTERNAL;
 
+MonoMethod*
+mono_marshal_get_runtime_invoke_array (MonoMethod *method) MONO_INTERNAL;
+
 MonoMethod*
 mono_marshal_get_runtime_invoke_dynamic (void) MONO_INTERNAL;
 
@@ -284,6 +290,9 @@ mono_marshal_free_dynamic_wrappers (MonoMethod *method) MONO_INTERNAL;
 void
 mono_marshal_free_inflated_wrappers (MonoMethod *method) MONO_INTERNAL;
 
+void
+mono_marshal_clear_wrapper_lookup_cache (void) MONO_INTERNAL;
+
 /* marshaling internal calls */
 
 void * 
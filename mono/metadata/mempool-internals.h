@@ -60,4 +60,13 @@ g_slist_append_mempool (MonoMemPool *mp, GSList *list, gpointer data)
 long
 mono_mempool_get_bytes_allocated (void) MONO_INTERNAL;
 
+void
+mono_mempool_init (void) MONO_INTERNAL;
+
+void
+mono_mempool_thread_cleanup (void) MONO_INTERNAL;
+
+MonoMemPool*
+mono_mempool_new_from_buffer (gpointer buf, int size) MONO_INTERNAL;
+
 #endif
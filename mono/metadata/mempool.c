@@ -3,6 +3,9 @@
  *
  * MonoMemPool is for fast allocation of memory. We free
  * all memory when the pool is destroyed.
+ * The chunks of standard sizes are kept in a per-thread cache when
+ * a pool is destroyed, so short lived pools like the ones used by the
+ * JIT don't need to go through malloc every time.
  *
  * Author:
  *   Dietmar Maurer (dietmar@ximian.com)
@@ -17,6 +20,8 @@
 
 #include "mempool.h"
 #include "mempool-internals.h"
+#include "mono/io-layer/io-layer.h"
+#include "mono/utils/mono-counters.h"
 
 #if USE_MALLOC_FOR_MEMPOOLS
 #define MALLOC_ALLOCATION
@@ -58,14 +63,162 @@ struct _MonoMemPool {
 	gint rest;
 	guint8 *pos, *end;
 	guint32 size;
+	/* whenever the first chunk is owned by the caller */
+	gboolean inline_chunk;
 	union {
 		double pad; /* to assure proper alignment */
 		guint32 allocated;
 	} d;
 };
+
+/*
+ * The chunks which can be cached have a power of two size between
+ * MONO_MEMPOOL_MINSIZE and MONO_MEMPOOL_PAGESIZE: this covers the
+ * pools created with mono_mempool_new (), the chunks they grow with
+ * and the small pools used by the runtime.
+ */
+#define CHUNK_CLASSES 5
+/*
+ * The cache of a thread holds at most this many bytes: this is enough for
+ * the pools of a JIT compilation, while threads which are never attached
+ * to the runtime, and so never free their cache, don't keep much around.
+ */
+#define MAX_CACHED_BYTES (32 * 1024)
+
+typedef struct {
+	MonoMemPool *chunks [CHUNK_CLASSES];
+	guint32 bytes;
+} ChunkCache;
+
+static guint32 chunk_cache_tls_id;
+static gboolean chunk_cache_inited;
 #endif
 
 static long total_bytes_allocated = 0;
+static int chunks_allocated, chunks_recycled;
+
+static gssize
+get_bytes_allocated (void)
+{
+	return total_bytes_allocated;
+}
+
+/**
+ * mono_mempool_init:
+ *
+ * Initialize the per-thread chunk caches. Pools created before this
+ * is called work normally, their chunks are just not recycled.
+ */
+void
+mono_mempool_init (void)
+{
+#ifndef MALLOC_ALLOCATION
+	chunk_cache_tls_id = TlsAlloc ();
+	chunk_cache_inited = TRUE;
+#endif
+
+	mono_counters_register ("Mempool bytes allocated", MONO_COUNTER_METADATA | MONO_COUNTER_WORD | MONO_COUNTER_CALLBACK, get_bytes_allocated);
+	mono_counters_register ("Mempool chunks allocated", MONO_COUNTER_METADATA | MONO_COUNTER_INT, &chunks_allocated);
+	mono_counters_register ("Mempool chunks recycled", MONO_COUNTER_METADATA | MONO_COUNTER_INT, &chunks_recycled);
+}
+
+/**
+ * mono_mempool_thread_cleanup:
+ *
+ * Free the chunks cached by the current thread. Called when a thread exits.
+ */
+void
+mono_mempool_thread_cleanup (void)
+{
+#ifndef MALLOC_ALLOCATION
+	ChunkCache *cache;
+	MonoMemPool *p, *n;
+	int i;
+
+	if (!chunk_cache_inited)
+		return;
+	cache = TlsGetValue (chunk_cache_tls_id);
+	if (!cache)
+		return;
+	TlsSetValue (chunk_cache_tls_id, NULL);
+
+	for (i = 0; i < CHUNK_CLASSES; ++i) {
+		for (p = cache->chunks [i]; p; p = n) {
+			n = p->next;
+			g_free (p);
+		}
+	}
+	g_free (cache);
+#endif
+}
+
+#ifndef MALLOC_ALLOCATION
+static int
+chunk_class (guint32 size)
+{
+	int class = 0;
+	guint32 class_size = MONO_MEMPOOL_MINSIZE;
+
+	if (size & (size - 1))
+		return -1;
+	while (class_size < size) {
+		class_size <<= 1;
+		class++;
+	}
+	if (class_size != size || class >= CHUNK_CLASSES)
+		return -1;
+	return class;
+}
+
+/*
+ * Return a chunk of SIZE bytes, taking it from the cache of the current
+ * thread if possible.
+ */
+static MonoMemPool*
+chunk_alloc (guint32 size)
+{
+	int class = chunk_class (size);
+
+	if (class >= 0 && chunk_cache_inited) {
+		ChunkCache *cache = TlsGetValue (chunk_cache_tls_id);
+
+		if (cache && cache->chunks [class]) {
+			MonoMemPool *chunk = cache->chunks [class];
+
+			cache->chunks [class] = chunk->next;
+			cache->bytes -= size;
+			chunks_recycled++;
+			return chunk;
+		}
+	}
+
+	chunks_allocated++;
+	return g_malloc (size);
+}
+
+static void
+chunk_free (MonoMemPool *chunk)
+{
+	int class = chunk_class (chunk->size);
+
+	if (class >= 0 && chunk_cache_inited) {
+		ChunkCache *cache = TlsGetValue (chunk_cache_tls_id);
+
+		if (!cache) {
+			cache = g_new0 (ChunkCache, 1);
+			TlsSetValue (chunk_cache_tls_id, cache);
+		}
+		if (cache->bytes + chunk->size <= MAX_CACHED_BYTES) {
+			chunk->next = cache->chunks [class];
+			cache->chunks [class] = chunk;
+			cache->bytes += chunk->size;
+			return;
+		}
+	}
+
+	g_free (chunk);
+}
+#endif
 
 /**
  * mono_mempool_new:
@@ -87,17 +240,51 @@ mono_mempool_new_size (int initial_size)
 	MonoMemPool *pool;
 	if (initial_size < MONO_MEMPOOL_MINSIZE)
 		initial_size = MONO_MEMPOOL_MINSIZE;
-	pool = g_malloc (initial_size);
+	pool = chunk_alloc (initial_size);
 
 	pool->next = NULL;
 	pool->pos = (guint8*)pool + sizeof (MonoMemPool);
 	pool->end = pool->pos + initial_size - sizeof (MonoMemPool);
 	pool->d.allocated = pool->size = initial_size;
+	pool->inline_chunk = FALSE;
 	total_bytes_allocated += initial_size;
 	return pool;
 #endif
 }
 
+/**
+ * mono_mempool_new_from_buffer:
+ * @buf: memory to use for the first chunk of the pool
+ * @size: the size of @buf
+ *
+ * Create a pool whose first chunk is @buf, which needs to be aligned to 8
+ * bytes and which is owned by the caller: it must stay valid until the
+ * pool is destroyed, but it is not freed. This avoids any malloc traffic
+ * for short lived pools which are small enough to fit into a stack buffer.
+ *
+ * Returns: a new memory pool.
+ */
+MonoMemPool *
+mono_mempool_new_from_buffer (gpointer buf, int size)
+{
+#ifdef MALLOC_ALLOCATION
+	return mono_mempool_new ();
+#else
+	MonoMemPool *pool = buf;
+
+	g_assert (((gsize)buf & (MEM_ALIGN - 1)) == 0);
+	g_assert (size > sizeof (MonoMemPool));
+
+	pool->next = NULL;
+	pool->pos = (guint8*)pool + sizeof (MonoMemPool);
+	pool->end = pool->pos + size - sizeof (MonoMemPool);
+	pool->d.allocated = pool->size = size;
+	pool->inline_chunk = TRUE;
+	total_bytes_allocated += size;
+	return pool;
+#endif
+}
+
 /**
  * mono_mempool_destroy:
  * @pool: the memory pool to destroy
@@ -116,10 +303,10 @@ mono_mempool_destroy (MonoMemPool *pool)
 
 	total_bytes_allocated -= pool->d.allocated;
 
-	p = pool;
+	p = pool->inline_chunk ? pool->next : pool;
 	while (p) {
 		n = p->next;
-		g_free (p);
+		chunk_free (p);
 		p = n;
 	}
 #endif
@@ -290,7 +477,7 @@ mono_mempool_alloc (MonoMemPool *pool, guint size)
 	if (G_UNLIKELY (pool->pos >= pool->end)) {
 		pool->pos -= size;
 		if (size >= 4096) {
-			MonoMemPool *np = g_malloc (sizeof (MonoMemPool) + size);
+			MonoMemPool *np = chunk_alloc (sizeof (MonoMemPool) + size);
 			np->next = pool->next;
 			pool->next = np;
 			np->pos = (guint8*)np + sizeof (MonoMemPool);
@@ -301,7 +488,7 @@ mono_mempool_alloc (MonoMemPool *pool, guint size)
 			return (guint8*)np + sizeof (MonoMemPool);
 		} else {
 			int new_size = get_next_size (pool, size);
-			MonoMemPool *np = g_malloc (new_size);
+			MonoMemPool *np = chunk_alloc (new_size);
 			np->next = pool->next;
 			pool->next = np;
 			pool->pos = (guint8*)np + sizeof (MonoMemPool);
@@ -254,6 +254,7 @@ struct _MonoImage {
 	GHashTable *delegate_end_invoke_cache;
 	GHashTable *delegate_invoke_cache;
 	GHashTable *runtime_invoke_cache;
+	GHashTable *runtime_invoke_array_cache;
 
 	/*
 	 * indexed by SignatureMethodPair
@@ -26,6 +26,7 @@
 #include <mono/metadata/marshal.h>
 #include <mono/metadata/profiler-private.h>
 #include <mono/utils/mono-time.h>
+#include <mono/utils/mono-metrics.h>
 
 /*
  * Pull the list of opcodes
@@ -100,6 +101,9 @@ static MonoThreadsSync *monitor_freelist;
 static MonitorArray *monitor_allocated;
 static int array_size = 16;
 
+static MonoMetric *metric_contentions;
+static MonoMetric *metric_waiting_threads;
+
 #ifdef HAVE_KW_THREAD
 static __thread gsize tls_pthread_self MONO_TLS_FAST;
 #endif
@@ -120,6 +124,9 @@ void
 mono_monitor_init (void)
 {
 	InitializeCriticalSection (&monitor_mutex);
+
+	metric_contentions = mono_metric_new ("Contended monitor enters", MONO_METRIC_COUNTER, MONO_COUNTER_RUNTIME);
+	metric_waiting_threads = mono_metric_new ("Threads waiting on a monitor", MONO_METRIC_GAUGE, MONO_COUNTER_RUNTIME);
 }
  
 void
@@ -537,6 +544,7 @@ retry:
 
 	/* The object must be locked by someone else... */
 	mono_perfcounters->thread_contentions++;
+	mono_metric_add (metric_contentions, 1);
 
 	/* If ms is 0 we don't block, but just fail straight away */
 	if (ms == 0) {
@@ -614,6 +622,7 @@ retry_contended:
 
 	mono_perfcounters->thread_queue_len++;
 	mono_perfcounters->thread_queue_max++;
+	mono_metric_add (metric_waiting_threads, 1);
 	thread = mono_thread_internal_current ();
 
 	mono_thread_set_state (thread, ThreadState_WaitSleepJoin);
@@ -628,6 +637,7 @@ retry_contended:
 	
 	InterlockedDecrement (&mon->entry_count);
 	mono_perfcounters->thread_queue_len--;
+	mono_metric_add (metric_waiting_threads, -1);
 
 	if (ms != INFINITE) {
 		now = mono_msec_ticks ();
@@ -31,6 +31,9 @@
 #include <glib.h>
 #include "mono-hash.h"
 #include "metadata/gc-internal.h"
+#include "metadata/object-internals.h"
+#include "metadata/threads-types.h"
+#include "utils/mono-membar.h"
 
 #ifdef HAVE_BOEHM_GC
 #define mg_new0(type,n)  ((type *) GC_MALLOC(sizeof(type) * (n)))
@@ -52,6 +55,31 @@ struct _Slot {
 
 static gpointer KEYMARKER_REMOVED = &KEYMARKER_REMOVED;
 
+/*
+ * The slots of concurrent tables are stored inline with open addressing,
+ * so lookups don't follow pointers to nodes which could be freed while
+ * they run: they only need to protect the slot array with a hazard pointer.
+ * A slot goes from empty to used and from used to removed, but it is only
+ * reused after a rehash, which copies the live slots to a new array: this
+ * way a reader which found a key always reads the value stored with it.
+ */
+typedef struct {
+	gpointer volatile key;
+	gpointer volatile value;
+} ConcSlot;
+
+typedef struct {
+	MonoGHashGCType gc_type;
+	int size;
+	int shift;
+	ConcSlot slots [MONO_ZERO_LEN_ARRAY];
+} ConcTable;
+
+#define CONC_MIN_SIZE 16
+#define CONC_TABLE_HAZARD_INDEX 0
+#define CONC_FIRST_SLOT(table,hashcode) (((guint)(hashcode) * 2654435769U) >> (table)->shift)
+#define CONC_NEXT_SLOT(table,i) (((i) + 1) & ((table)->size - 1))
+
 struct _MonoGHashTable {
 	GHashFunc      hash_func;
 	GEqualFunc     key_equal_func;
@@ -63,6 +91,10 @@ struct _MonoGHashTable {
 	int   last_rehash;
 	GDestroyNotify value_destroy_func, key_destroy_func;
 	MonoGHashGCType gc_type;
+	/* only used by concurrent tables */
+	ConcTable * volatile conc_table;
+	int removed;
+	CRITICAL_SECTION conc_lock;
 };
 
 static const int prime_tbl[] = {
@@ -75,6 +107,7 @@ static const int prime_tbl[] = {
 
 #ifdef HAVE_SGEN_GC
 static void *table_hash_descr = NULL;
+static void *conc_table_descr = NULL;
 
 static void mono_g_hash_mark (void *addr, MonoGCMarkFunc mark_func);
 
@@ -152,6 +185,303 @@ mono_g_hash_table_new_type (GHashFunc hash_func, GEqualFunc key_equal_func, Mono
 	return hash;
 }
 
+#ifdef HAVE_SGEN_GC
+/* GC marker function for the slots of concurrent tables */
+static void
+conc_table_mark (void *addr, MonoGCMarkFunc mark_func)
+{
+	ConcTable *table = addr;
+	int i;
+
+	for (i = 0; i < table->size; i++) {
+		ConcSlot *s = &table->slots [i];
+
+		if ((table->gc_type & MONO_HASH_KEY_GC) && s->key && s->key != KEYMARKER_REMOVED)
+			mark_func ((void**)&s->key);
+		/* the values of removed keys can still be returned by readers until the next rehash */
+		if ((table->gc_type & MONO_HASH_VALUE_GC) && s->value)
+			mark_func ((void**)&s->value);
+	}
+}
+#endif
+
+/*
+ * Each slot array of a concurrent table is a GC root of its own, so that
+ * the arrays being replaced, which readers can still access, are updated
+ * by moving collections too.
+ */
+static ConcTable*
+conc_table_new (MonoGHashGCType gc_type, int size)
+{
+	ConcTable *table;
+	size_t bytes = sizeof (ConcTable) + size * sizeof (ConcSlot);
+	int shift = 32;
+
+#ifdef HAVE_SGEN_GC
+	if (gc_type == MONO_HASH_CONSERVATIVE_GC)
+		table = mono_gc_alloc_fixed (bytes, NULL);
+	else
+		table = g_malloc0 (bytes);
+#else
+	table = (ConcTable*)mg_new0 (char, bytes);
+#endif
+	while ((1 << (32 - shift)) < size)
+		shift--;
+	table->gc_type = gc_type;
+	table->size = size;
+	table->shift = shift;
+#ifdef HAVE_SGEN_GC
+	if (gc_type != MONO_HASH_CONSERVATIVE_GC) {
+		if (!conc_table_descr)
+			conc_table_descr = mono_gc_make_root_descr_user (conc_table_mark);
+		mono_gc_register_root_wbarrier ((char*)table, bytes, conc_table_descr);
+	}
+#endif
+	return table;
+}
+
+static void
+conc_table_free (gpointer p)
+{
+#ifdef HAVE_SGEN_GC
+	ConcTable *table = p;
+
+	if (table->gc_type == MONO_HASH_CONSERVATIVE_GC) {
+		mono_gc_free_fixed (table);
+	} else {
+		mono_gc_deregister_root ((char*)table);
+		g_free (table);
+	}
+#else
+	mg_free (p);
+#endif
+}
+
+/**
+ * mono_g_hash_table_new_type_concurrent:
+ *
+ *   Create a table which can be used by multiple threads without external
+ * locking: lookups don't take any lock and inserts and removals take a lock
+ * private to the table. Keys can't be NULL and the table doesn't support
+ * destroy functions.
+ * Callers which need to atomically check for a key and insert it still
+ * need their own lock around the check and the insert.
+ */
+MonoGHashTable *
+mono_g_hash_table_new_type_concurrent (GHashFunc hash_func, GEqualFunc key_equal_func, MonoGHashGCType type)
+{
+	MonoGHashTable *hash = mono_g_hash_table_new (hash_func, key_equal_func);
+
+	if (type < 0 || type > MONO_HASH_KEY_VALUE_GC)
+		g_error ("wrong type for gc hashtable");
+	hash->gc_type = type;
+	InitializeCriticalSection (&hash->conc_lock);
+	hash->conc_table = conc_table_new (type, CONC_MIN_SIZE);
+
+	return hash;
+}
+
+static gboolean
+conc_table_find (MonoGHashTable *hash, ConcTable *table, gconstpointer key, gpointer *orig_key, gpointer *value)
+{
+	guint i;
+	gpointer k;
+
+	for (i = CONC_FIRST_SLOT (table, (*hash->hash_func) (key)); (k = table->slots [i].key); i = CONC_NEXT_SLOT (table, i)) {
+		if (k != KEYMARKER_REMOVED && (*hash->key_equal_func) (k, key)) {
+			/* pairs with the write barrier in conc_insert_replace () */
+			mono_memory_read_barrier ();
+			*orig_key = k;
+			*value = table->slots [i].value;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static gpointer
+get_hazardous_pointer (gpointer volatile *pp, MonoThreadHazardPointers *hp, int hazard_index)
+{
+	gpointer p;
+
+	for (;;) {
+		/* Get the pointer */
+		p = *pp;
+		/* Make it hazardous */
+		mono_hazard_pointer_set (hp, hazard_index, p);
+		/* Check that it's still the same.  If not, try
+		   again. */
+		if (*pp != p) {
+			mono_hazard_pointer_clear (hp, hazard_index);
+			continue;
+		}
+		break;
+	}
+
+	return p;
+}
+
+static gboolean
+conc_lookup (MonoGHashTable *hash, gconstpointer key, gpointer *orig_key, gpointer *value)
+{
+	MonoInternalThread *thread = mono_thread_internal_current ();
+	MonoThreadHazardPointers *hp;
+	ConcTable *table;
+	gboolean res;
+
+	/* threads not attached to the runtime don't have hazard pointers */
+	if (!thread || thread->small_id < 0) {
+		EnterCriticalSection (&hash->conc_lock);
+		res = conc_table_find (hash, hash->conc_table, key, orig_key, value);
+		LeaveCriticalSection (&hash->conc_lock);
+		return res;
+	}
+
+	hp = mono_hazard_pointer_get ();
+	table = get_hazardous_pointer ((gpointer volatile*)&hash->conc_table, hp, CONC_TABLE_HAZARD_INDEX);
+	res = conc_table_find (hash, table, key, orig_key, value);
+	mono_hazard_pointer_clear (hp, CONC_TABLE_HAZARD_INDEX);
+	return res;
+}
+
+/*
+ * Replace the slot array if adding EXTRA keys would make it more than 3/4
+ * full, counting the removed slots. Called with the table lock held.
+ */
+static void
+conc_rehash (MonoGHashTable *hash, int extra)
+{
+	ConcTable *old_table = hash->conc_table;
+	ConcTable *table;
+	int i, size;
+
+	if ((hash->in_use + hash->removed + extra) * 4 <= old_table->size * 3)
+		return;
+	for (size = CONC_MIN_SIZE; size < (hash->in_use + extra) * 2; size *= 2)
+		;
+	table = conc_table_new (old_table->gc_type, size);
+	for (i = 0; i < old_table->size; i++) {
+		ConcSlot *s = &old_table->slots [i];
+		gpointer key = s->key;
+		guint j;
+
+		if (!key || key == KEYMARKER_REMOVED)
+			continue;
+		for (j = CONC_FIRST_SLOT (table, (*hash->hash_func) (key)); table->slots [j].key; j = CONC_NEXT_SLOT (table, j))
+			;
+		table->slots [j].value = s->value;
+		table->slots [j].key = key;
+	}
+	hash->removed = 0;
+
+	mono_memory_barrier ();
+	hash->conc_table = table;
+	mono_memory_barrier ();
+
+	mono_thread_hazardous_free_or_queue (old_table, conc_table_free);
+}
+
+static void
+conc_insert_replace (MonoGHashTable *hash, gpointer key, gpointer value, gboolean replace)
+{
+	ConcTable *table;
+	gpointer k;
+	guint i;
+
+	/* NULL marks the empty slots */
+	g_assert (key);
+
+	EnterCriticalSection (&hash->conc_lock);
+	conc_rehash (hash, 1);
+	table = hash->conc_table;
+	for (i = CONC_FIRST_SLOT (table, (*hash->hash_func) (key)); (k = table->slots [i].key); i = CONC_NEXT_SLOT (table, i)) {
+		if (k != KEYMARKER_REMOVED && (*hash->key_equal_func) (k, key)) {
+			if (replace)
+				table->slots [i].key = key;
+			table->slots [i].value = value;
+			LeaveCriticalSection (&hash->conc_lock);
+			return;
+		}
+	}
+	/* readers which see the key need to see the value too */
+	table->slots [i].value = value;
+	mono_memory_write_barrier ();
+	table->slots [i].key = key;
+	hash->in_use++;
+	LeaveCriticalSection (&hash->conc_lock);
+}
+
+static gboolean
+conc_remove (MonoGHashTable *hash, gconstpointer key)
+{
+	ConcTable *table;
+	gpointer k;
+	guint i;
+
+	EnterCriticalSection (&hash->conc_lock);
+	table = hash->conc_table;
+	for (i = CONC_FIRST_SLOT (table, (*hash->hash_func) (key)); (k = table->slots [i].key); i = CONC_NEXT_SLOT (table, i)) {
+		if (k != KEYMARKER_REMOVED && (*hash->key_equal_func) (k, key)) {
+			/* the value is kept for the readers which already found the key */
+			table->slots [i].key = KEYMARKER_REMOVED;
+			hash->in_use--;
+			hash->removed++;
+			LeaveCriticalSection (&hash->conc_lock);
+			return TRUE;
+		}
+	}
+	LeaveCriticalSection (&hash->conc_lock);
+	return FALSE;
+}
+
+/*
+ * Calls FUNC for the live slots of a concurrent table with the table lock
+ * held, removing the ones for which it returns TRUE if REMOVE is set.
+ * Stops at the first slot for which it returns TRUE if REMOVE is not set.
+ */
+static ConcSlot*
+conc_foreach (MonoGHashTable *hash, GHRFunc func, gpointer user_data, gboolean remove, int *count)
+{
+	ConcTable *table;
+	ConcSlot *res = NULL;
+	int i;
+
+	EnterCriticalSection (&hash->conc_lock);
+	table = hash->conc_table;
+	for (i = 0; i < table->size; i++) {
+		ConcSlot *s = &table->slots [i];
+
+		if (!s->key || s->key == KEYMARKER_REMOVED)
+			continue;
+		if ((*func) (s->key, s->value, user_data)) {
+			if (!remove) {
+				res = s;
+				break;
+			}
+			s->key = KEYMARKER_REMOVED;
+			hash->in_use--;
+			hash->removed++;
+			(*count)++;
+		}
+	}
+	LeaveCriticalSection (&hash->conc_lock);
+	return res;
+}
+
+typedef struct {
+	GHFunc func;
+	gpointer user_data;
+} ConcForeachData;
+
+static gboolean
+conc_foreach_func (gpointer key, gpointer value, gpointer user_data)
+{
+	ConcForeachData *data = user_data;
+
+	(*data->func) (key, value, data->user_data);
+	return FALSE;
+}
+
 MonoGHashTable *
 mono_g_hash_table_new (GHashFunc hash_func, GEqualFunc key_equal_func)
 {
@@ -271,6 +601,8 @@ mono_g_hash_table_lookup_extended (MonoGHashTable *hash, gconstpointer key, gpoi
 	guint hashcode;
 	
 	g_return_val_if_fail (hash != NULL, FALSE);
+	if (hash->conc_table)
+		return conc_lookup (hash, key, orig_key, value);
 	equal = hash->key_equal_func;
 
 	hashcode = ((*hash->hash_func) (key)) % hash->table_size;
@@ -293,6 +625,16 @@ mono_g_hash_table_foreach (MonoGHashTable *hash, GHFunc func, gpointer user_data
 	g_return_if_fail (hash != NULL);
 	g_return_if_fail (func != NULL);
 
+	if (hash->conc_table) {
+		ConcForeachData data;
+		int count = 0;
+
+		data.func = func;
+		data.user_data = user_data;
+		conc_foreach (hash, conc_foreach_func, &data, FALSE, &count);
+		return;
+	}
+
 	for (i = 0; i < hash->table_size; i++){
 		Slot *s;
 
@@ -309,6 +651,11 @@ mono_g_hash_table_find (MonoGHashTable *hash, GHRFunc predicate, gpointer user_d
 	g_return_val_if_fail (hash != NULL, NULL);
 	g_return_val_if_fail (predicate != NULL, NULL);
 
+	if (hash->conc_table) {
+		ConcSlot *s = conc_foreach (hash, predicate, user_data, FALSE, &i);
+		return s ? s->value : NULL;
+	}
+
 	for (i = 0; i < hash->table_size; i++){
 		Slot *s;
 
@@ -327,6 +674,8 @@ mono_g_hash_table_remove (MonoGHashTable *hash, gconstpointer key)
 	guint hashcode;
 	
 	g_return_val_if_fail (hash != NULL, FALSE);
+	if (hash->conc_table)
+		return conc_remove (hash, key);
 	equal = hash->key_equal_func;
 
 	hashcode = ((*hash->hash_func)(key)) % hash->table_size;
@@ -359,6 +708,11 @@ mono_g_hash_table_foreach_remove (MonoGHashTable *hash, GHRFunc func, gpointer u
 	g_return_val_if_fail (hash != NULL, 0);
 	g_return_val_if_fail (func != NULL, 0);
 
+	if (hash->conc_table) {
+		conc_foreach (hash, func, user_data, TRUE, &count);
+		return count;
+	}
+
 	for (i = 0; i < hash->table_size; i++){
 		Slot *s, *last;
 
@@ -400,6 +754,14 @@ mono_g_hash_table_destroy (MonoGHashTable *hash)
 	
 	g_return_if_fail (hash != NULL);
 
+	if (hash->conc_table) {
+		mono_thread_hazardous_free_or_queue (hash->conc_table, conc_table_free);
+		DeleteCriticalSection (&hash->conc_lock);
+		mg_free (hash->table);
+		mg_free (hash);
+		return;
+	}
+
 #ifdef HAVE_SGEN_GC
 	mono_gc_deregister_root ((char*)hash);
 #endif
@@ -429,6 +791,10 @@ mono_g_hash_table_insert_replace (MonoGHashTable *hash, gpointer key, gpointer v
 	GEqualFunc equal;
 	
 	g_return_if_fail (hash != NULL);
+	if (hash->conc_table) {
+		conc_insert_replace (hash, key, value, replace);
+		return;
+	}
 
 	equal = hash->key_equal_func;
 	if (hash->in_use >= hash->threshold)
@@ -474,6 +840,11 @@ mono_g_hash_table_print_stats (MonoGHashTable *table)
 	int i, chain_size, max_chain_size;
 	Slot *node;
 
+	if (table->conc_table) {
+		printf ("Size: %d Table Size: %d Removed: %d\n", table->in_use, table->conc_table->size, table->removed);
+		return;
+	}
+
 	max_chain_size = 0;
 	for (i = 0; i < table->table_size; i++) {
 		chain_size = 0;
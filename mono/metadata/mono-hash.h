@@ -57,6 +57,9 @@ MonoGHashTable* mono_g_hash_table_new		   (GHashFunc	    hash_func,
 MonoGHashTable* mono_g_hash_table_new_type		   (GHashFunc	    hash_func,
 					    GEqualFunc	    key_equal_func,
 					    MonoGHashGCType type);
+MonoGHashTable* mono_g_hash_table_new_type_concurrent (GHashFunc	    hash_func,
+					    GEqualFunc	    key_equal_func,
+					    MonoGHashGCType type);
 MonoGHashTable* mono_g_hash_table_new_full      	   (GHashFunc	    hash_func,
 					    GEqualFunc	    key_equal_func,
 					    GDestroyNotify  key_destroy_func,
@@ -569,6 +569,8 @@ typedef struct {
 	gpointer (*get_vtable_trampoline) (int slot_index);
 	gpointer (*get_imt_trampoline) (int imt_slot_index);
 	void (*set_cast_details) (MonoClass *from, MonoClass *to);
+	/* Returns FALSE if METHOD can't be invoked this way, without invoking it */
+	gboolean (*runtime_invoke_array) (MonoMethod *method, void *obj, MonoArray *params, MonoObject **exc, MonoObject **res);
 } MonoRuntimeCallbacks;
 
 /* used to free a dynamic method */
@@ -3989,6 +3989,19 @@ mono_runtime_invoke_array (MonoMethod *method, void *obj, MonoArray *params,
 	int i;
 	gboolean has_byref_nullables = FALSE;
 
+	/*
+	 * Let the runtime unbox the arguments straight from PARAMS if it can.  This
+	 * doesn't cover constructors and pointer return values, which need extra work
+	 * below, and would bypass the invoke events of mono_runtime_invoke ().
+	 */
+	if (params && callbacks.runtime_invoke_array && !mono_runtime_get_no_exec () &&
+		!(mono_profiler_get_events () & MONO_PROFILE_METHOD_EVENTS) &&
+		sig->ret->type != MONO_TYPE_PTR && !mono_class_is_nullable (method->klass) &&
+		strcmp (method->name, ".ctor")) {
+		if (callbacks.runtime_invoke_array (method, obj, params, exc, &res))
+			return res;
+	}
+
 	if (NULL != params) {
 		pa = alloca (sizeof (gpointer) * mono_array_length (params));
 		for (i = 0; i < mono_array_length (params); i++) {
@@ -5223,6 +5236,9 @@ mono_string_is_interned_lookup (MonoString *str, int insert)
 	
 	domain = ((MonoObject *)str)->vtable->domain;
 	ldstr_table = domain->ldstr_table;
+	/* ldstr_table is a concurrent table, the lock is only needed to insert */
+	if ((res = mono_g_hash_table_lookup (ldstr_table, str)))
+		return res;
 	ldstr_lock ();
 	if ((res = mono_g_hash_table_lookup (ldstr_table, str))) {
 		ldstr_unlock ();
@@ -5332,6 +5348,8 @@ mono_ldstr_metadata_sig (MonoDomain *domain, const char* sig)
 		}
 	}
 #endif
+	if ((interned = mono_g_hash_table_lookup (domain->ldstr_table, o)))
+		return interned;
 	ldstr_lock ();
 	if ((interned = mono_g_hash_table_lookup (domain->ldstr_table, o))) {
 		ldstr_unlock ();
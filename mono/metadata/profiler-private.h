@@ -29,12 +29,15 @@ void mono_profiler_method_enter    (MonoMethod *method) MONO_INTERNAL;
 void mono_profiler_method_leave    (MonoMethod *method) MONO_INTERNAL;
 void mono_profiler_method_jit      (MonoMethod *method) MONO_INTERNAL;
 void mono_profiler_method_end_jit  (MonoMethod *method, MonoJitInfo* jinfo, int result) MONO_INTERNAL;
+void mono_profiler_method_jit_phases (MonoMethod *method, int il_size, const guint64 *phase_times) MONO_INTERNAL;
 void mono_profiler_method_free     (MonoMethod *method) MONO_INTERNAL;
 void mono_profiler_method_start_invoke (MonoMethod *method) MONO_INTERNAL;
 void mono_profiler_method_end_invoke   (MonoMethod *method) MONO_INTERNAL;
 
 void mono_profiler_code_transition (MonoMethod *method, int result) MONO_INTERNAL;
 void mono_profiler_allocation      (MonoObject *obj, MonoClass *klass) MONO_INTERNAL;
+void mono_profiler_allocation_sample (MonoObject *obj, MonoClass *klass) MONO_INTERNAL;
+guint32 mono_profiler_get_allocation_sample_bytes (void) MONO_INTERNAL;
 void mono_profiler_monitor_event   (MonoObject *obj, MonoProfilerMonitorEvent event) MONO_INTERNAL;
 void mono_profiler_stat_hit        (guchar *ip, void *context) MONO_INTERNAL;
 void mono_profiler_stat_call_chain (int call_chain_depth, guchar **ips, void *context) MONO_INTERNAL;
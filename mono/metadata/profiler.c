@@ -59,11 +59,14 @@ struct _ProfilerDesc {
 	MonoProfileMethodFunc   jit_start;
 	MonoProfileMethodResult jit_end;
 	MonoProfileJitResult    jit_end2;
+	MonoProfileJitPhasesFunc jit_phases;
 	MonoProfileMethodFunc   method_free;
 	MonoProfileMethodFunc   method_start_invoke;
 	MonoProfileMethodFunc   method_end_invoke;
 	MonoProfileMethodResult man_unman_transition;
 	MonoProfileAllocFunc    allocation_cb;
+	MonoProfileAllocFunc    allocation_sample_cb;
+	guint32                 allocation_sample_bytes;
 	MonoProfileMonitorFunc  monitor_event_cb;
 	MonoProfileStatFunc     statistical_cb;
 	MonoProfileStatCallChainFunc statistical_call_chain_cb;
@@ -213,6 +216,14 @@ mono_profiler_install_jit_end (MonoProfileJitResult end)
 	prof_list->jit_end2 = end;
 }
 
+void 
+mono_profiler_install_jit_phases (MonoProfileJitPhasesFunc callback)
+{
+	if (!prof_list)
+		return;
+	prof_list->jit_phases = callback;
+}
+
 void 
 mono_profiler_install_method_free (MonoProfileMethodFunc callback)
 {
@@ -263,6 +274,27 @@ mono_profiler_install_allocation (MonoProfileAllocFunc callback)
 	prof_list->allocation_cb = callback;
 }
 
+/**
+ * mono_profiler_install_allocation_sample:
+ * @callback: the routine to be called for the sampled allocations
+ * @sample_bytes: how many bytes a thread allocates between two samples
+ *
+ * Unlike mono_profiler_install_allocation () this doesn't disable the fast
+ * allocation paths: the GC reports an object when it refills the thread local
+ * allocation buffer of a thread which allocated @sample_bytes since the last
+ * sample, so the interval is only as precise as the TLAB size.
+ * The callback is invoked only when MONO_PROFILE_ALLOCATION_SAMPLES is set
+ * and only the SGen collector reports allocation samples.
+ */
+void
+mono_profiler_install_allocation_sample (MonoProfileAllocFunc callback, uint32_t sample_bytes)
+{
+	if (!prof_list)
+		return;
+	prof_list->allocation_sample_cb = callback;
+	prof_list->allocation_sample_bytes = sample_bytes;
+}
+
 void
 mono_profiler_install_monitor  (MonoProfileMonitorFunc callback)
 {
@@ -422,6 +454,16 @@ mono_profiler_method_end_jit (MonoMethod *method, MonoJitInfo* jinfo, int result
 	}
 }
 
+void 
+mono_profiler_method_jit_phases (MonoMethod *method, int il_size, const guint64 *phase_times)
+{
+	ProfilerDesc *prof;
+	for (prof = prof_list; prof; prof = prof->next) {
+		if ((prof->events & MONO_PROFILE_JIT_COMPILATION) && prof->jit_phases)
+			prof->jit_phases (prof->profiler, method, il_size, phase_times);
+	}
+}
+
 void 
 mono_profiler_method_free (MonoMethod *method)
 {
@@ -472,6 +514,34 @@ mono_profiler_allocation (MonoObject *obj, MonoClass *klass)
 	}
 }
 
+void
+mono_profiler_allocation_sample (MonoObject *obj, MonoClass *klass)
+{
+	ProfilerDesc *prof;
+	for (prof = prof_list; prof; prof = prof->next) {
+		if ((prof->events & MONO_PROFILE_ALLOCATION_SAMPLES) && prof->allocation_sample_cb)
+			prof->allocation_sample_cb (prof->profiler, obj, klass);
+	}
+}
+
+/*
+ * The smallest sampling interval requested by the installed profilers, 0 if
+ * allocation sampling is disabled.
+ */
+guint32
+mono_profiler_get_allocation_sample_bytes (void)
+{
+	ProfilerDesc *prof;
+	guint32 res = 0;
+	for (prof = prof_list; prof; prof = prof->next) {
+		if ((prof->events & MONO_PROFILE_ALLOCATION_SAMPLES) && prof->allocation_sample_cb && prof->allocation_sample_bytes) {
+			if (!res || prof->allocation_sample_bytes < res)
+				res = prof->allocation_sample_bytes;
+		}
+	}
+	return res;
+}
+
 void
 mono_profiler_monitor_event      (MonoObject *obj, MonoProfilerMonitorEvent event) {
 	ProfilerDesc *prof;
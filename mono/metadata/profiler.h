@@ -30,7 +30,8 @@ typedef enum {
 	MONO_PROFILE_MONITOR_EVENTS   = 1 << 17,
 	MONO_PROFILE_IOMAP_EVENTS     = 1 << 18, /* this should likely be removed, too */
 	MONO_PROFILE_GC_MOVES         = 1 << 19,
-	MONO_PROFILE_GC_ROOTS         = 1 << 20
+	MONO_PROFILE_GC_ROOTS         = 1 << 20,
+	MONO_PROFILE_ALLOCATION_SAMPLES = 1 << 21
 } MonoProfileFlags;
 
 typedef enum {
@@ -84,6 +85,22 @@ typedef enum {
 	MONO_PROFILER_CALL_CHAIN_INVALID = 4
 } MonoProfilerCallChainStrategy;
 
+/* JIT compilation phases, reported by the jit_phases callback */
+typedef enum {
+	MONO_PROFILER_JIT_PHASE_METHOD_TO_IR, /* IL to IR conversion, excluding inlining */
+	MONO_PROFILER_JIT_PHASE_INLINE,
+	MONO_PROFILER_JIT_PHASE_DECOMPOSE,
+	MONO_PROFILER_JIT_PHASE_LOCAL_OPTS,
+	MONO_PROFILER_JIT_PHASE_BRANCH_OPTS,
+	MONO_PROFILER_JIT_PHASE_LOOP_OPTS,
+	MONO_PROFILER_JIT_PHASE_SSA,
+	MONO_PROFILER_JIT_PHASE_LIVENESS,
+	MONO_PROFILER_JIT_PHASE_REGALLOC,
+	MONO_PROFILER_JIT_PHASE_CODEGEN,
+	MONO_PROFILER_JIT_PHASE_JIT_INFO,
+	MONO_PROFILER_JIT_PHASE_LAST
+} MonoProfilerJitPhase;
+
 typedef enum {
 	MONO_PROFILER_GC_HANDLE_CREATED,
 	MONO_PROFILER_GC_HANDLE_DESTROYED
@@ -121,6 +138,8 @@ typedef void (*MonoProfileExceptionClauseFunc) (MonoProfiler *prof, MonoMethod *
 typedef void (*MonoProfileAppDomainResult)(MonoProfiler *prof, MonoDomain   *domain,   int result);
 typedef void (*MonoProfileMethodResult)   (MonoProfiler *prof, MonoMethod   *method,   int result);
 typedef void (*MonoProfileJitResult)      (MonoProfiler *prof, MonoMethod   *method,   MonoJitInfo* jinfo,   int result);
+/* phase_times has MONO_PROFILER_JIT_PHASE_LAST entries, in nanoseconds */
+typedef void (*MonoProfileJitPhasesFunc)  (MonoProfiler *prof, MonoMethod   *method,   int il_size, const uint64_t *phase_times);
 typedef void (*MonoProfileClassResult)    (MonoProfiler *prof, MonoClass    *klass,    int result);
 typedef void (*MonoProfileModuleResult)   (MonoProfiler *prof, MonoImage    *module,   int result);
 typedef void (*MonoProfileAssemblyResult) (MonoProfiler *prof, MonoAssembly *assembly, int result);
@@ -167,6 +186,7 @@ void mono_profiler_install_class       (MonoProfileClassFunc start_load, MonoPro
 
 void mono_profiler_install_jit_compile (MonoProfileMethodFunc start, MonoProfileMethodResult end);
 void mono_profiler_install_jit_end (MonoProfileJitResult end);
+void mono_profiler_install_jit_phases (MonoProfileJitPhasesFunc callback);
 void mono_profiler_install_method_free (MonoProfileMethodFunc callback);
 void mono_profiler_install_method_invoke (MonoProfileMethodFunc start, MonoProfileMethodFunc end);
 void mono_profiler_install_enter_leave (MonoProfileMethodFunc enter, MonoProfileMethodFunc fleave);
@@ -174,6 +194,7 @@ void mono_profiler_install_thread      (MonoProfileThreadFunc start, MonoProfile
 void mono_profiler_install_thread_name (MonoProfileThreadNameFunc thread_name_cb);
 void mono_profiler_install_transition  (MonoProfileMethodResult callback);
 void mono_profiler_install_allocation  (MonoProfileAllocFunc callback);
+void mono_profiler_install_allocation_sample (MonoProfileAllocFunc callback, uint32_t sample_bytes);
 void mono_profiler_install_monitor     (MonoProfileMonitorFunc callback);
 void mono_profiler_install_statistical (MonoProfileStatFunc callback);
 void mono_profiler_install_statistical_call_chain (MonoProfileStatCallChainFunc callback, int call_chain_depth, MonoProfilerCallChainStrategy call_chain_strategy);
@@ -6035,22 +6035,6 @@ reflected_hash (gconstpointer a) {
 	return mono_aligned_addr_hash (ea->item);
 }
 
-#define CHECK_OBJECT(t,p,k)	\
-	do {	\
-		t _obj;	\
-		ReflectedEntry e; 	\
-		e.item = (p);	\
-		e.refclass = (k);	\
-		mono_domain_lock (domain);	\
-		if (!domain->refobject_hash)	\
-			domain->refobject_hash = mono_g_hash_table_new_type (reflected_hash, reflected_equal, MONO_HASH_VALUE_GC);	\
-		if ((_obj = mono_g_hash_table_lookup (domain->refobject_hash, &e))) {	\
-			mono_domain_unlock (domain);	\
-			return _obj;	\
-		}	\
-        mono_domain_unlock (domain); \
-	} while (0)
-
 #ifdef HAVE_BOEHM_GC
 /* ReflectedEntry doesn't need to be GC tracked */
 #define ALLOC_REFENTRY g_new0 (ReflectedEntry, 1)
@@ -6062,6 +6046,33 @@ reflected_hash (gconstpointer a) {
 #define FREE_REFENTRY(entry)
 #endif
 
+/*
+ * refobject_hash is a concurrent table, so it can be searched without
+ * taking the domain lock, unless the entries are freed when they are
+ * removed, since a lookup could still be comparing them.
+ */
+#ifdef REFENTRY_REQUIRES_CLEANUP
+#define refobject_lookup_lock(domain) mono_domain_lock (domain)
+#define refobject_lookup_unlock(domain) mono_domain_unlock (domain)
+#else
+#define refobject_lookup_lock(domain)
+#define refobject_lookup_unlock(domain)
+#endif
+
+#define CHECK_OBJECT(t,p,k)	\
+	do {	\
+		t _obj;	\
+		ReflectedEntry e; 	\
+		e.item = (p);	\
+		e.refclass = (k);	\
+		refobject_lookup_lock (domain);	\
+		if (domain->refobject_hash && (_obj = mono_g_hash_table_lookup (domain->refobject_hash, &e))) {	\
+			refobject_lookup_unlock (domain);	\
+			return _obj;	\
+		}	\
+		refobject_lookup_unlock (domain);	\
+	} while (0)
+
 #define CACHE_OBJECT(t,p,o,k)	\
 	do {	\
 		t _obj;	\
@@ -6069,8 +6080,11 @@ reflected_hash (gconstpointer a) {
         pe.item = (p); \
         pe.refclass = (k); \
         mono_domain_lock (domain); \
-		if (!domain->refobject_hash)	\
-			domain->refobject_hash = mono_g_hash_table_new_type (reflected_hash, reflected_equal, MONO_HASH_VALUE_GC);	\
+		if (!domain->refobject_hash) {	\
+			MonoGHashTable *_hash = mono_g_hash_table_new_type_concurrent (reflected_hash, reflected_equal, MONO_HASH_VALUE_GC);	\
+			mono_memory_barrier ();	\
+			domain->refobject_hash = _hash;	\
+		}	\
         _obj = mono_g_hash_table_lookup (domain->refobject_hash, &pe); \
         if (!_obj) { \
 		    ReflectedEntry *e = ALLOC_REFENTRY; 	\
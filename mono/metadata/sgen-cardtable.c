@@ -152,6 +152,9 @@ void
 sgen_card_table_mark_range (mword address, mword size)
 {
 	mword end = address + size;
+
+	/* Mark the last card too if ADDRESS is not card aligned */
+	address &= ~(mword)(CARD_SIZE_IN_BYTES - 1);
 	do {
 		sgen_card_table_mark_address (address);
 		address += CARD_SIZE_IN_BYTES;
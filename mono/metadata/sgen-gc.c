@@ -211,9 +211,11 @@
 #include "metadata/mempool-internals.h"
 #include "metadata/marshal.h"
 #include "utils/mono-mmap.h"
+#include "utils/mono-codeman.h"
 #include "utils/mono-time.h"
 #include "utils/mono-semaphore.h"
 #include "utils/mono-counters.h"
+#include "utils/mono-metrics.h"
 #include "utils/mono-proclib.h"
 
 #include <mono/utils/memcheck.h>
@@ -301,6 +303,10 @@ static int stat_wbarrier_object_copy = 0;
 
 static long long stat_pinned_objects = 0;
 
+/* Always enabled, unlike the counters above */
+static MonoMetric *metric_minor_pause;
+static MonoMetric *metric_major_pause;
+
 static long long time_minor_pre_collection_fragment_clear = 0;
 static long long time_minor_pinning = 0;
 static long long time_minor_scan_remsets = 0;
@@ -325,6 +331,9 @@ static long long time_major_los_sweep = 0;
 static long long time_major_sweep = 0;
 static long long time_major_fragment_creation = 0;
 
+static long long time_domain_clear = 0;
+static long long stat_domain_clear_objects = 0;
+
 #define DEBUG(level,a) do {if (G_UNLIKELY ((level) <= SGEN_MAX_DEBUG_LEVEL && (level) <= gc_debug_level)) a;} while (0)
 
 int gc_debug_level = 0;
@@ -364,6 +373,19 @@ typedef enum {
 
 static NurseryClearPolicy nursery_clear_policy = CLEAR_AT_TLAB_CREATION;
 
+/* Whenever to ask the OS to back the nursery and the major heap with huge pages */
+static gboolean heap_hugepages = FALSE;
+/*
+ * The NUMA placement of the heap. With MONO_NUMA_LOCAL the nursery pages are
+ * placed on the node of the thread which touches them first, which, when clearing
+ * at TLAB creation, is the thread which allocates in them. This only affects the
+ * initial placement: the pages stay on that node when the nursery is reused after
+ * a collection and other threads get TLABs in them. MONO_NUMA_INTERLEAVE spreads
+ * the nursery and the major heap over all the nodes.
+ */
+static int heap_numa_policy = MONO_NUMA_DEFAULT;
+static mword stat_hugepage_heap_bytes = 0;
+
 /*
  * The young generation is divided into fragments. This is because
  * we can hand one fragments to a thread for lock-less fast alloc and
@@ -674,6 +696,8 @@ static char *nursery_start = NULL;
 #define STORE_REMSET_BUFFER	store_remset_buffer
 #define STORE_REMSET_BUFFER_INDEX	store_remset_buffer_index
 #define IN_CRITICAL_REGION thread_info->in_critical_region
+#define ALLOC_SAMPLE_COUNTDOWN thread_info->alloc_sample_countdown
+#define ALLOC_SAMPLE_PENDING thread_info->alloc_sample_pending
 #else
 static pthread_key_t thread_info_key;
 #define TLAB_ACCESS_INIT	SgenThreadInfo *__thread_info__ = pthread_getspecific (thread_info_key)
@@ -685,6 +709,8 @@ static pthread_key_t thread_info_key;
 #define STORE_REMSET_BUFFER	(__thread_info__->store_remset_buffer)
 #define STORE_REMSET_BUFFER_INDEX	(__thread_info__->store_remset_buffer_index)
 #define IN_CRITICAL_REGION (__thread_info__->in_critical_region)
+#define ALLOC_SAMPLE_COUNTDOWN (__thread_info__->alloc_sample_countdown)
+#define ALLOC_SAMPLE_PENDING (__thread_info__->alloc_sample_pending)
 #endif
 
 /* we use the memory barrier only to prevent compiler reordering (a memory constraint may be enough) */
@@ -1499,24 +1525,75 @@ clear_domain_process_minor_object_callback (char *obj, size_t size, MonoDomain *
 		memset (obj, 0, size);
 }
 
+/*
+ * Major heap objects of the domain being cleared are collected here while
+ * walking the heap once, and only freed after the walk.
+ */
+typedef struct {
+	char *obj;
+	size_t size;
+	gboolean pinned;
+} DomainClearObject;
+
+static DomainClearObject *domain_clear_objects = NULL;
+static int domain_clear_objects_size = 0;
+static int domain_clear_objects_capacity = 0;
+
 static void
-clear_domain_process_major_object_callback (char *obj, size_t size, MonoDomain *domain)
+domain_clear_objects_add (char *obj, size_t size, gboolean pinned)
 {
-	clear_domain_process_object (obj, domain);
+	DomainClearObject *entry;
+
+	if (domain_clear_objects_size >= domain_clear_objects_capacity) {
+		int new_capacity = domain_clear_objects_capacity ? domain_clear_objects_capacity * 2 : 1024;
+		DomainClearObject *new_objects = mono_sgen_alloc_internal_dynamic (sizeof (DomainClearObject) * new_capacity, INTERNAL_MEM_DOMAIN_CLEAR);
+		if (domain_clear_objects) {
+			memcpy (new_objects, domain_clear_objects, sizeof (DomainClearObject) * domain_clear_objects_size);
+			mono_sgen_free_internal_dynamic (domain_clear_objects, sizeof (DomainClearObject) * domain_clear_objects_capacity, INTERNAL_MEM_DOMAIN_CLEAR);
+		}
+		domain_clear_objects = new_objects;
+		domain_clear_objects_capacity = new_capacity;
+	}
+
+	entry = &domain_clear_objects [domain_clear_objects_size++];
+	entry->obj = obj;
+	entry->size = size;
+	entry->pinned = pinned;
 }
 
 static void
-clear_domain_free_major_non_pinned_object_callback (char *obj, size_t size, MonoDomain *domain)
+clear_domain_process_major_non_pinned_object_callback (char *obj, size_t size, MonoDomain *domain)
 {
-	if (need_remove_object_for_domain (obj, domain))
-		major_collector.free_non_pinned_object (obj, size);
+	if (clear_domain_process_object (obj, domain))
+		domain_clear_objects_add (obj, size, FALSE);
 }
 
 static void
-clear_domain_free_major_pinned_object_callback (char *obj, size_t size, MonoDomain *domain)
+clear_domain_process_major_pinned_object_callback (char *obj, size_t size, MonoDomain *domain)
 {
-	if (need_remove_object_for_domain (obj, domain))
-		major_collector.free_pinned_object (obj, size);
+	if (clear_domain_process_object (obj, domain))
+		domain_clear_objects_add (obj, size, TRUE);
+}
+
+static void
+clear_domain_free_major_objects (void)
+{
+	int i;
+
+	for (i = 0; i < domain_clear_objects_size; ++i) {
+		DomainClearObject *entry = &domain_clear_objects [i];
+
+		if (entry->pinned)
+			major_collector.free_pinned_object (entry->obj, entry->size);
+		else
+			major_collector.free_non_pinned_object (entry->obj, entry->size);
+	}
+	stat_domain_clear_objects += domain_clear_objects_size;
+
+	if (domain_clear_objects)
+		mono_sgen_free_internal_dynamic (domain_clear_objects, sizeof (DomainClearObject) * domain_clear_objects_capacity, INTERNAL_MEM_DOMAIN_CLEAR);
+	domain_clear_objects = NULL;
+	domain_clear_objects_size = domain_clear_objects_capacity = 0;
 }
 
 /*
@@ -1531,11 +1608,15 @@ clear_domain_free_major_pinned_object_callback (char *obj, size_t size, MonoDoma
 void
 mono_gc_clear_domain (MonoDomain * domain)
 {
-	LOSObject *bigobj, *prev;
+	LOSObject *bigobj, *prev, *los_to_free = NULL;
 	int i;
+	TV_DECLARE (atv);
+	TV_DECLARE (btv);
 
 	LOCK_GC;
 
+	TV_GETTIME (atv);
+
 	clear_nursery_fragments (nursery_next);
 
 	if (xdomain_checks && domain != mono_get_root_domain ()) {
@@ -1554,36 +1635,47 @@ mono_gc_clear_domain (MonoDomain * domain)
 	for (i = GENERATION_NURSERY; i < GENERATION_MAX; ++i)
 		null_links_for_domain (domain, i);
 
-	/* We need two passes over major and large objects because
-	   freeing such objects might give their memory back to the OS
-	   (in the case of large objects) or obliterate its vtable
-	   (pinned objects with major-copying or pinned and non-pinned
-	   objects with major-mark&sweep), but we might need to
-	   dereference a pointer from an object to another object if
-	   the first object is a proxy. */
-	major_collector.iterate_objects (TRUE, TRUE, (IterateObjectCallbackFunc)clear_domain_process_major_object_callback, domain);
-	for (bigobj = los_object_list; bigobj; bigobj = bigobj->next)
-		clear_domain_process_object (bigobj->data, domain);
+	/* Freeing major and large objects might give their memory back
+	   to the OS (in the case of large objects) or obliterate its
+	   vtable (pinned objects with major-copying or pinned and
+	   non-pinned objects with major-mark&sweep), but we might need
+	   to dereference a pointer from an object to another object if
+	   the first object is a proxy.  So we walk the major heap and
+	   the large objects once, remembering the objects to remove,
+	   and free them only after all objects have been processed. */
+	major_collector.iterate_objects (TRUE, FALSE, (IterateObjectCallbackFunc)clear_domain_process_major_non_pinned_object_callback, domain);
+	major_collector.iterate_objects (FALSE, TRUE, (IterateObjectCallbackFunc)clear_domain_process_major_pinned_object_callback, domain);
 
 	prev = NULL;
 	for (bigobj = los_object_list; bigobj;) {
-		if (need_remove_object_for_domain (bigobj->data, domain)) {
+		if (clear_domain_process_object (bigobj->data, domain)) {
 			LOSObject *to_free = bigobj;
 			if (prev)
 				prev->next = bigobj->next;
 			else
 				los_object_list = bigobj->next;
 			bigobj = bigobj->next;
-			DEBUG (4, fprintf (gc_debug_file, "Freeing large object %p\n",
-					bigobj->data));
-			mono_sgen_los_free_object (to_free);
+			to_free->next = los_to_free;
+			los_to_free = to_free;
 			continue;
 		}
 		prev = bigobj;
 		bigobj = bigobj->next;
 	}
-	major_collector.iterate_objects (TRUE, FALSE, (IterateObjectCallbackFunc)clear_domain_free_major_non_pinned_object_callback, domain);
-	major_collector.iterate_objects (FALSE, TRUE, (IterateObjectCallbackFunc)clear_domain_free_major_pinned_object_callback, domain);
+
+	clear_domain_free_major_objects ();
+
+	while (los_to_free) {
+		bigobj = los_to_free;
+		los_to_free = bigobj->next;
+		DEBUG (4, fprintf (gc_debug_file, "Freeing large object %p\n",
+				bigobj->data));
+		mono_sgen_los_free_object (bigobj);
+		++stat_domain_clear_objects;
+	}
+
+	TV_GETTIME (btv);
+	time_domain_clear += TV_ELAPSED_MS (atv, btv);
 
 	UNLOCK_GC;
 }
@@ -2202,6 +2294,20 @@ mono_sgen_alloc_os_memory_aligned (mword size, mword alignment, gboolean activat
 	return aligned;
 }
 
+/*
+ * Apply the page size and NUMA placement requested in MONO_GC_PARAMS to a
+ * newly allocated area of the heap. NURSERY is whenever it is part of the
+ * nursery.
+ */
+void
+mono_sgen_setup_heap_memory (void *addr, size_t size, gboolean nursery)
+{
+	if (heap_hugepages && !mono_mprotect (addr, size, MONO_MMAP_READ | MONO_MMAP_WRITE | MONO_MMAP_HUGEPAGES))
+		stat_hugepage_heap_bytes += size;
+	if (heap_numa_policy == MONO_NUMA_INTERLEAVE || (nursery && heap_numa_policy == MONO_NUMA_LOCAL))
+		mono_mbind (addr, size, heap_numa_policy);
+}
+
 /*
  * Allocate and setup the data structures needed to be able to allocate objects
  * in the nursery. The nursery is stored in nursery_section.
@@ -2234,6 +2340,7 @@ alloc_nursery (void)
 #endif
 	nursery_start = data;
 	nursery_real_end = nursery_start + nursery_size;
+	mono_sgen_setup_heap_memory (nursery_start, alloc_size, TRUE);
 	mono_sgen_update_heap_boundaries ((mword)nursery_start, (mword)nursery_real_end);
 	nursery_next = nursery_start;
 	DEBUG (4, fprintf (gc_debug_file, "Expanding nursery size (%p-%p): %lu, total: %lu\n", data, data + alloc_size, (unsigned long)nursery_size, (unsigned long)total_alloc));
@@ -2823,6 +2930,9 @@ init_stats (void)
 	if (inited)
 		return;
 
+	metric_minor_pause = mono_metric_new ("Minor GC pause (usec)", MONO_METRIC_HISTOGRAM, MONO_COUNTER_GC);
+	metric_major_pause = mono_metric_new ("Major GC pause (usec)", MONO_METRIC_HISTOGRAM, MONO_COUNTER_GC);
+
 	mono_counters_register ("Minor fragment clear", MONO_COUNTER_GC | MONO_COUNTER_LONG, &time_minor_pre_collection_fragment_clear);
 	mono_counters_register ("Minor pinning", MONO_COUNTER_GC | MONO_COUNTER_LONG, &time_minor_pinning);
 	mono_counters_register ("Minor scan remsets", MONO_COUNTER_GC | MONO_COUNTER_LONG, &time_minor_scan_remsets);
@@ -2847,8 +2957,15 @@ init_stats (void)
 	mono_counters_register ("Major sweep", MONO_COUNTER_GC | MONO_COUNTER_LONG, &time_major_sweep);
 	mono_counters_register ("Major fragment creation", MONO_COUNTER_GC | MONO_COUNTER_LONG, &time_major_fragment_creation);
 
+	mono_counters_register ("Domain clear", MONO_COUNTER_GC | MONO_COUNTER_LONG, &time_domain_clear);
+	mono_counters_register ("Domain clear objects freed", MONO_COUNTER_GC | MONO_COUNTER_LONG, &stat_domain_clear_objects);
+
 	mono_counters_register ("Number of pinned objects", MONO_COUNTER_GC | MONO_COUNTER_LONG, &stat_pinned_objects);
 
+	mono_counters_register ("OS page size", MONO_COUNTER_GC | MONO_COUNTER_INT | MONO_COUNTER_CALLBACK, mono_pagesize);
+	mono_counters_register ("OS huge page size", MONO_COUNTER_GC | MONO_COUNTER_INT | MONO_COUNTER_CALLBACK, mono_hugepage_size);
+	mono_counters_register ("Heap space advised for huge pages", MONO_COUNTER_GC | MONO_COUNTER_WORD, &stat_hugepage_heap_bytes);
+
 #ifdef HEAVY_STATISTICS
 	mono_counters_register ("WBarrier set field", MONO_COUNTER_GC | MONO_COUNTER_INT, &stat_wbarrier_set_field);
 	mono_counters_register ("WBarrier set arrayref", MONO_COUNTER_GC | MONO_COUNTER_INT, &stat_wbarrier_set_arrayref);
@@ -3618,9 +3735,39 @@ search_fragment_for_size_range (size_t desired_size, size_t minimum_size)
 	return 0;
 }
 
+/*
+ * The JIT omits the write barriers of stores into objects which were just allocated
+ * by the same thread, with no calls in between (see mono_elide_fresh_object_barriers ()).
+ * Such objects are normally in the nursery, but large objects and objects allocated in
+ * degraded mode are not, so their cards are marked on allocation instead. Since a
+ * collection can still happen before the stores, the cards of the last such object of
+ * each thread are marked again when the world is restarted. This is only done after
+ * the first collection following the allocation: the thread does the stores as soon as
+ * it runs again, and rescanning the object at every later collection would cost more
+ * than the barriers.
+ */
+static void
+mark_fresh_old_object (void *obj, size_t size)
+{
+	SgenThreadInfo *info;
+
+	if (!use_cardtable || !obj)
+		return;
+
+	sgen_card_table_mark_range ((mword)obj, size);
+
+	info = mono_sgen_thread_info_lookup (ARCH_GET_THREAD ());
+	if (info) {
+		info->fresh_old_obj = obj;
+		info->fresh_old_obj_size = size;
+	}
+}
+
 static void*
 alloc_degraded (MonoVTable *vtable, size_t size)
 {
+	void *p;
+
 	if (need_major_collection (0)) {
 		mono_profiler_gc_event (MONO_GC_EVENT_START, 1);
 		stop_world (1);
@@ -3629,7 +3776,9 @@ alloc_degraded (MonoVTable *vtable, size_t size)
 		mono_profiler_gc_event (MONO_GC_EVENT_END, 1);
 	}
 
-	return major_collector.alloc_degraded (vtable, size);
+	p = major_collector.alloc_degraded (vtable, size);
+	mark_fresh_old_object (p, size);
+	return p;
 }
 
 /*
@@ -3640,6 +3789,42 @@ alloc_degraded (MonoVTable *vtable, size_t size)
  * so when we scan the thread stacks for pinned objects, we can start
  * a search for the pinned object in SCAN_START_SIZE chunks.
  */
+/*
+ * Allocation sampling for the profiler (MONO_PROFILE_ALLOCATION_SAMPLES).
+ * Threads are charged for the TLABs they retire and for their large objects,
+ * so the fast paths, including the managed allocators, are left alone. The
+ * object allocated when the countdown expires is reported by the public
+ * allocation functions once the GC lock has been released.
+ */
+static void
+charge_alloc_sample (void *obj, mword size)
+{
+	guint32 sample_bytes;
+	TLAB_ACCESS_INIT;
+
+	if (!obj)
+		return;
+	ALLOC_SAMPLE_COUNTDOWN -= size;
+	if (ALLOC_SAMPLE_COUNTDOWN > 0)
+		return;
+	sample_bytes = mono_profiler_get_allocation_sample_bytes ();
+	if (!sample_bytes)
+		return;
+	ALLOC_SAMPLE_COUNTDOWN = sample_bytes;
+	ALLOC_SAMPLE_PENDING = obj;
+}
+
+static void
+report_alloc_sample (void *obj)
+{
+	TLAB_ACCESS_INIT;
+
+	if (!obj || ALLOC_SAMPLE_PENDING != obj)
+		return;
+	ALLOC_SAMPLE_PENDING = NULL;
+	mono_profiler_allocation_sample (obj, ((MonoVTable*)LOAD_VTABLE (obj))->klass);
+}
+
 static void*
 mono_gc_alloc_obj_nolock (MonoVTable *vtable, size_t size)
 {
@@ -3688,6 +3873,9 @@ mono_gc_alloc_obj_nolock (MonoVTable *vtable, size_t size)
 
 	if (size > MAX_SMALL_OBJ_SIZE) {
 		p = mono_sgen_los_alloc_large_inner (vtable, size);
+		mark_fresh_old_object (p, size);
+		if (G_UNLIKELY (mono_profiler_events & MONO_PROFILE_ALLOCATION_SAMPLES))
+			charge_alloc_sample (p, size);
 	} else {
 		/* tlab_next and tlab_temp_end are TLS vars so accessing them might be expensive */
 
@@ -3771,6 +3959,7 @@ mono_gc_alloc_obj_nolock (MonoVTable *vtable, size_t size)
 			} else {
 				int alloc_size = tlab_size;
 				int available_in_nursery = nursery_frag_real_end - nursery_next;
+				mword retired_size = TLAB_NEXT - TLAB_START;
 				if (TLAB_START)
 					DEBUG (3, fprintf (gc_debug_file, "Retire TLAB: %p-%p [%ld]\n", TLAB_START, TLAB_REAL_END, (long)(TLAB_REAL_END - TLAB_NEXT - size)));
 
@@ -3808,6 +3997,9 @@ mono_gc_alloc_obj_nolock (MonoVTable *vtable, size_t size)
 				g_assert (TLAB_NEXT <= TLAB_REAL_END);
 
 				nursery_section->scan_starts [((char*)p - (char*)nursery_section->data)/SCAN_START_SIZE] = (char*)p;
+
+				if (G_UNLIKELY (mono_profiler_events & MONO_PROFILE_ALLOCATION_SAMPLES))
+					charge_alloc_sample (p, retired_size);
 			}
 		} else {
 			/* Reached tlab_temp_end */
@@ -3890,6 +4082,8 @@ mono_gc_alloc_obj (MonoVTable *vtable, size_t size)
 	UNLOCK_GC;
 	if (G_UNLIKELY (!res))
 		return mono_gc_out_of_memory (size);
+	if (G_UNLIKELY (mono_profiler_events & MONO_PROFILE_ALLOCATION_SAMPLES))
+		report_alloc_sample (res);
 	return res;
 }
 
@@ -3921,6 +4115,9 @@ mono_gc_alloc_vector (MonoVTable *vtable, size_t size, uintptr_t max_length)
 
 	UNLOCK_GC;
 
+	if (G_UNLIKELY (mono_profiler_events & MONO_PROFILE_ALLOCATION_SAMPLES))
+		report_alloc_sample (arr);
+
 	return arr;
 }
 
@@ -3945,6 +4142,9 @@ mono_gc_alloc_array (MonoVTable *vtable, size_t size, uintptr_t max_length, uint
 
 	UNLOCK_GC;
 
+	if (G_UNLIKELY (mono_profiler_events & MONO_PROFILE_ALLOCATION_SAMPLES))
+		report_alloc_sample (arr);
+
 	return arr;
 }
 
@@ -3976,6 +4176,9 @@ mono_gc_alloc_string (MonoVTable *vtable, size_t size, gint32 len)
 
 	UNLOCK_GC;
 
+	if (G_UNLIKELY (mono_profiler_events & MONO_PROFILE_ALLOCATION_SAMPLES))
+		report_alloc_sample (str);
+
 	return str;
 }
 
@@ -3997,6 +4200,7 @@ mono_gc_alloc_pinned_obj (MonoVTable *vtable, size_t size)
 		DEBUG (9, g_assert (vtable->klass->inited));
 		p = major_collector.alloc_small_pinned_obj (size, SGEN_VTABLE_HAS_REFERENCES (vtable));
 	}
+	mark_fresh_old_object (p, size);
 	if (G_LIKELY (p)) {
 		DEBUG (6, fprintf (gc_debug_file, "Allocated pinned object %p, vtable: %p (%s), size: %zd\n", p, vtable, vtable->klass->name, size));
 		binary_protocol_alloc_pinned (p, vtable, size);
@@ -5222,6 +5426,11 @@ restart_world (int generation)
 		for (info = thread_table [i]; info; info = info->next) {
 			info->stack_start = NULL;
 			info->stopped_regs = NULL;
+			/* The collection cleared the cards, see mark_fresh_old_object () */
+			if (info->fresh_old_obj && use_cardtable)
+				sgen_card_table_mark_range ((mword)info->fresh_old_obj, info->fresh_old_obj_size);
+			info->fresh_old_obj = NULL;
+			info->fresh_old_obj_size = 0;
 		}
 	}
 
@@ -5231,6 +5440,8 @@ restart_world (int generation)
 	TV_GETTIME (end_sw);
 	usec = TV_ELAPSED (stop_world_time, end_sw);
 	max_pause_usec = MAX (usec, max_pause_usec);
+	/* The other threads are running again, so this can't deadlock on the metrics lock */
+	mono_metric_record (generation == GENERATION_NURSERY ? metric_minor_pause : metric_major_pause, usec);
 	DEBUG (2, fprintf (gc_debug_file, "restarted %d thread(s) (pause time: %d usec, max: %d)\n", count, (int)usec, (int)max_pause_usec));
 	mono_profiler_gc_event (MONO_GC_EVENT_POST_START_WORLD, generation);
 	return count;
@@ -5731,6 +5942,10 @@ gc_register_current_thread (void *addr)
 	info->stopped_ip = NULL;
 	info->stopped_domain = NULL;
 	info->stopped_regs = NULL;
+	info->fresh_old_obj = NULL;
+	info->fresh_old_obj_size = 0;
+	info->alloc_sample_countdown = 0;
+	info->alloc_sample_pending = NULL;
 
 	binary_protocol_thread_register ((gpointer)info->id);
 
@@ -7109,6 +7324,40 @@ mono_gc_base_init (void)
 				}
 				continue;
 			}
+			if (g_str_has_prefix (opt, "hugepages=")) {
+				opt = strchr (opt, '=') + 1;
+				if (!strcmp (opt, "none")) {
+					heap_hugepages = FALSE;
+					mono_code_manager_set_hugepages (FALSE);
+				} else if (!strcmp (opt, "heap")) {
+					heap_hugepages = TRUE;
+				} else if (!strcmp (opt, "code")) {
+					mono_code_manager_set_hugepages (TRUE);
+				} else if (!strcmp (opt, "all")) {
+					heap_hugepages = TRUE;
+					mono_code_manager_set_hugepages (TRUE);
+				} else {
+					fprintf (stderr, "Invalid value '%s' for hugepages= option, possible values are: 'none', 'heap', 'code', 'all'.\n", opt);
+					exit (1);
+				}
+				if (!mono_hugepage_size ())
+					fprintf (stderr, "Warning: Huge pages are not supported on this system.\n");
+				continue;
+			}
+			if (g_str_has_prefix (opt, "numa=")) {
+				opt = strchr (opt, '=') + 1;
+				if (!strcmp (opt, "default")) {
+					heap_numa_policy = MONO_NUMA_DEFAULT;
+				} else if (!strcmp (opt, "local")) {
+					heap_numa_policy = MONO_NUMA_LOCAL;
+				} else if (!strcmp (opt, "interleave")) {
+					heap_numa_policy = MONO_NUMA_INTERLEAVE;
+				} else {
+					fprintf (stderr, "Invalid value '%s' for numa= option, possible values are: 'default', 'local', 'interleave'.\n", opt);
+					exit (1);
+				}
+				continue;
+			}
 #ifdef USER_CONFIG
 			if (g_str_has_prefix (opt, "nursery-size=")) {
 				long val;
@@ -7139,6 +7388,8 @@ mono_gc_base_init (void)
 				fprintf (stderr, "  major=COLLECTOR (where COLLECTOR is `marksweep', `marksweep-par' or `copying')\n");
 				fprintf (stderr, "  wbarrier=WBARRIER (where WBARRIER is `remset' or `cardtable')\n");
 				fprintf (stderr, "  stack-mark=MARK-METHOD (where MARK-METHOD is 'precise' or 'conservative')\n");
+				fprintf (stderr, "  hugepages=MODE (where MODE is 'none', 'heap', 'code' or 'all')\n");
+				fprintf (stderr, "  numa=POLICY (where POLICY is 'default', 'local' or 'interleave')\n");
 				if (major_collector.print_gc_param_usage)
 					major_collector.print_gc_param_usage ();
 				exit (1);
@@ -7322,8 +7573,10 @@ create_allocator (int atype)
 #endif
 
 	if (!registered) {
-		mono_register_jit_icall (mono_gc_alloc_obj, "mono_gc_alloc_obj", mono_create_icall_signature ("object ptr int"), FALSE);
-		mono_register_jit_icall (mono_gc_alloc_vector, "mono_gc_alloc_vector", mono_create_icall_signature ("object ptr int int"), FALSE);
+		/* the slow paths may report allocation samples, which need an LMF to walk the managed stack */
+		gboolean save = (mono_profiler_get_events () & MONO_PROFILE_ALLOCATION_SAMPLES) != 0;
+		mono_register_jit_icall (mono_gc_alloc_obj, "mono_gc_alloc_obj", mono_create_icall_signature ("object ptr int"), save);
+		mono_register_jit_icall (mono_gc_alloc_vector, "mono_gc_alloc_vector", mono_create_icall_signature ("object ptr int int"), save);
 		registered = TRUE;
 	}
 
@@ -106,6 +106,13 @@ struct _SgenThreadInfo {
 	gpointer stopped_ip;	/* only valid if the thread is stopped */
 	MonoDomain *stopped_domain; /* ditto */
 	gpointer *stopped_regs;	    /* ditto */
+	/* The last object allocated by this thread outside the nursery */
+	char *fresh_old_obj;
+	mword fresh_old_obj_size;
+	/* bytes left to allocate before the next profiler allocation sample */
+	gssize alloc_sample_countdown;
+	/* the sampled object, reported once the GC lock is released */
+	void *alloc_sample_pending;
 #ifndef HAVE_KW_THREAD
 	char *tlab_start;
 	char *tlab_next;
@@ -577,6 +584,7 @@ typedef void (*IterateObjectCallbackFunc) (char*, size_t, void*);
 void* mono_sgen_alloc_os_memory (size_t size, int activate) MONO_INTERNAL;
 void* mono_sgen_alloc_os_memory_aligned (mword size, mword alignment, gboolean activate) MONO_INTERNAL;
 void mono_sgen_free_os_memory (void *addr, size_t size) MONO_INTERNAL;
+void mono_sgen_setup_heap_memory (void *addr, size_t size, gboolean nursery) MONO_INTERNAL;
 
 int mono_sgen_thread_handshake (int signum) MONO_INTERNAL;
 SgenThreadInfo* mono_sgen_thread_info_lookup (ARCH_THREAD_TYPE id) MONO_INTERNAL;
@@ -615,6 +623,7 @@ enum {
 	INTERNAL_MEM_EPHEMERON_LINK,
 	INTERNAL_MEM_WORKER_DATA,
 	INTERNAL_MEM_BRIDGE_DATA,
+	INTERNAL_MEM_DOMAIN_CLEAR,
 	INTERNAL_MEM_MAX
 };
 
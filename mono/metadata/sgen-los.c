@@ -243,6 +243,7 @@ get_los_section_memory (size_t size)
 		return NULL;
 
 	section = mono_sgen_alloc_os_memory_aligned (LOS_SECTION_SIZE, LOS_SECTION_SIZE, TRUE);
+	mono_sgen_setup_heap_memory (section, LOS_SECTION_SIZE, FALSE);
 
 	free_chunks = (LOSFreeChunks*)((char*)section + LOS_CHUNK_SIZE);
 	free_chunks->size = LOS_SECTION_SIZE - LOS_CHUNK_SIZE;
@@ -371,6 +372,7 @@ mono_sgen_los_alloc_large_inner (MonoVTable *vtable, size_t size)
 		alloc_size &= ~(pagesize - 1);
 		if (mono_sgen_try_alloc_space (alloc_size, SPACE_LOS)) {
 			obj = mono_sgen_alloc_os_memory (alloc_size, TRUE);
+			mono_sgen_setup_heap_memory (obj, alloc_size, FALSE);
 			obj->huge_object = TRUE;
 		}
 	} else {
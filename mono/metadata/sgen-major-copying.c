@@ -126,6 +126,7 @@ alloc_major_section (void)
 	int scan_starts;
 
 	section = mono_sgen_alloc_os_memory_aligned (MAJOR_SECTION_SIZE, MAJOR_SECTION_SIZE, TRUE);
+	mono_sgen_setup_heap_memory (section, MAJOR_SECTION_SIZE, FALSE);
 	section->next_data = section->data = (char*)section + SGEN_SIZEOF_GC_MEM_SECTION;
 	g_assert (!((mword)section->data & 7));
 	section->size = MAJOR_SECTION_SIZE - SGEN_SIZEOF_GC_MEM_SECTION;
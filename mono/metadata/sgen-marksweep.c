@@ -308,6 +308,7 @@ major_alloc_heap (mword nursery_size, mword nursery_align, int the_nursery_bits)
 	nursery_bits = the_nursery_bits;
 
 	ms_heap_end = heap_start + major_heap_size;
+	mono_sgen_setup_heap_memory (heap_start, major_heap_size, FALSE);
 
 	block_infos = mono_sgen_alloc_internal_dynamic (sizeof (MSBlockInfo) * ms_heap_num_blocks, INTERNAL_MEM_MS_BLOCK_INFO);
 
@@ -385,6 +386,7 @@ ms_get_empty_block (void)
  retry:
 	if (!empty_blocks) {
 		p = mono_sgen_alloc_os_memory_aligned (MS_BLOCK_SIZE * MS_BLOCK_ALLOC_NUM, MS_BLOCK_SIZE, TRUE);
+		mono_sgen_setup_heap_memory (p, MS_BLOCK_SIZE * MS_BLOCK_ALLOC_NUM, FALSE);
 
 		for (i = 0; i < MS_BLOCK_ALLOC_NUM; ++i) {
 			block = p;
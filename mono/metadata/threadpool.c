@@ -31,6 +31,7 @@
 #include <mono/metadata/gc-internal.h>
 #include <mono/utils/mono-time.h>
 #include <mono/utils/mono-proclib.h>
+#include <mono/utils/mono-metrics.h>
 #include <mono/utils/mono-semaphore.h>
 #include <errno.h>
 #ifdef HAVE_SYS_TIME_H
@@ -158,6 +159,11 @@ typedef struct {
 static ThreadPool async_tp;
 static ThreadPool async_io_tp;
 
+static MonoMetric *metric_pending_items;
+static MonoMetric *metric_item_time;
+static MonoMetric *metric_io_operations;
+static MonoMetric *metric_io_bytes;
+
 static void async_invoke_thread (gpointer data);
 static MonoObject *mono_async_invoke (ThreadPool *tp, MonoAsyncResult *ares);
 static void threadpool_free_queue (ThreadPool *tp);
@@ -425,8 +431,10 @@ get_events_from_list (MonoMList *list)
 static void
 threadpool_jobs_inc (MonoObject *obj)
 {
-	if (obj)
+	if (obj) {
 		InterlockedIncrement (&obj->vtable->domain->threadpool_jobs);
+		mono_metric_add (metric_pending_items, 1);
+	}
 }
 
 static gboolean
@@ -434,6 +442,7 @@ threadpool_jobs_dec (MonoObject *obj)
 {
 	MonoDomain *domain = obj->vtable->domain;
 	int remaining_jobs = InterlockedDecrement (&domain->threadpool_jobs);
+	mono_metric_add (metric_pending_items, -1);
 	if (remaining_jobs == 0 && domain->cleanup_semaphore) {
 		ReleaseSemaphore (domain->cleanup_semaphore, 1, NULL);
 		return TRUE;
@@ -1186,6 +1195,18 @@ init_perf_counter (const char *category, const char *counter)
 	return mono_perfcounter_get_impl (category_str, counter_str, NULL, machine, &type, &custom);
 }
 
+static gint64
+get_busy_threads (void)
+{
+	return async_tp.busy_threads;
+}
+
+static gint64
+get_io_busy_threads (void)
+{
+	return async_io_tp.busy_threads;
+}
+
 #ifdef DEBUG
 static void
 print_pool_info (ThreadPool *tp)
@@ -1328,6 +1349,13 @@ mono_thread_pool_init ()
 
 	async_io_tp.pc_nthreads = init_perf_counter ("Mono Threadpool", "# of IO Threads");
 	g_assert (async_io_tp.pc_nthreads);
+
+	metric_pending_items = mono_metric_new ("Threadpool pending work items", MONO_METRIC_GAUGE, MONO_COUNTER_RUNTIME);
+	metric_item_time = mono_metric_new ("Threadpool work item time (usec)", MONO_METRIC_HISTOGRAM, MONO_COUNTER_RUNTIME);
+	mono_metric_new_callback ("Threadpool busy threads", MONO_COUNTER_RUNTIME, get_busy_threads);
+	mono_metric_new_callback ("Threadpool busy IO threads", MONO_COUNTER_RUNTIME, get_io_busy_threads);
+	metric_io_operations = mono_metric_new ("Async socket operations", MONO_METRIC_COUNTER, MONO_COUNTER_RUNTIME);
+	metric_io_bytes = mono_metric_new ("Async socket bytes transferred", MONO_METRIC_COUNTER, MONO_COUNTER_RUNTIME);
 	tp_inited = 2;
 #ifdef DEBUG
 	signal (SIGALRM, signal_handler);
@@ -1849,6 +1877,9 @@ async_invoke_thread (gpointer data)
 					state->total = ICALL_SEND (state);
 					break;
 				}
+				mono_metric_add (metric_io_operations, 1);
+				if (state->total > 0)
+					mono_metric_add (metric_io_bytes, state->total);
 			}
 #endif
 			/* worker threads invokes methods in different domains,
@@ -1872,13 +1903,16 @@ async_invoke_thread (gpointer data)
 
 				if (mono_domain_set (domain, FALSE)) {
 					MonoObject *exc;
+					gint64 start;
 
 					if (tp_item_begin_func)
 						tp_item_begin_func (tp_item_user_data);
 
 					if (!is_io_task && ar->add_time > 0)
 						process_idle_times (tp, ar->add_time);
+					start = mono_100ns_ticks ();
 					exc = mono_async_invoke (tp, ar);
+					mono_metric_record (metric_item_time, (mono_100ns_ticks () - start) / 10);
 					if (tp_item_end_func)
 						tp_item_end_func (tp_item_user_data);
 					if (exc && mono_runtime_unhandled_exception_policy_get () == MONO_UNHANDLED_POLICY_CURRENT) {
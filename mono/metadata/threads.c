@@ -42,6 +42,7 @@
 #include <mono/utils/mono-mmap.h>
 #include <mono/utils/mono-membar.h>
 #include <mono/utils/mono-time.h>
+#include <mono/utils/mono-metrics.h>
 
 #include <mono/metadata/gc-internal.h>
 
@@ -488,6 +489,13 @@ mono_thread_hazardous_free_or_queue (gpointer p, MonoHazardousFreeFunc free_func
 {
 	int i;
 
+	/* Before mono_thread_init () and after mono_thread_cleanup ()
+	   no other thread can hold hazard pointers. */
+	if (!delayed_free_table) {
+		free_func (p);
+		return;
+	}
+
 	/* First try to free a few entries in the delayed free
 	   table. */
 	for (i = 2; i >= 0; --i)
@@ -550,6 +558,11 @@ static void thread_cleanup (MonoInternalThread *thread)
 {
 	g_assert (thread != NULL);
 
+	if (thread == mono_thread_internal_current ()) {
+		mono_mempool_thread_cleanup ();
+		mono_metrics_thread_cleanup ();
+	}
+
 	if (thread->abort_state_handle) {
 		mono_gchandle_free (thread->abort_state_handle);
 		thread->abort_state_handle = 0;
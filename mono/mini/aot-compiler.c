@@ -99,6 +99,8 @@ typedef struct MonoAotOptions {
 	gboolean metadata_only;
 	gboolean bind_to_runtime_version;
 	gboolean full_aot;
+	gboolean profile_only;
+	char *profile_file;
 	gboolean no_dlsym;
 	gboolean static_link;
 	gboolean asm_only;
@@ -122,6 +124,7 @@ typedef struct MonoAotStats {
 	int code_size, info_size, ex_info_size, unwind_info_size, got_size, class_info_size, got_info_size;
 	int methods_without_got_slots, direct_calls, all_calls, llvm_count;
 	int got_slots, offsets_size;
+	int profile_skip_count;
 	int got_slot_types [MONO_PATCH_INFO_NONE];
 	int jit_time, gen_time, link_time;
 } MonoAotStats;
@@ -145,6 +148,10 @@ typedef struct MonoAotCompile {
 	GPtrArray *image_table;
 	GPtrArray *globals;
 	GPtrArray *method_order;
+	/* Methods found in the profile data files */
+	GHashTable *profile_methods;
+	/* Generic instances and wrappers found in the profile data files */
+	GPtrArray *profile_extra_methods;
 	guint32 *plt_got_info_offsets;
 	guint32 got_offset, plt_offset, plt_got_offset_base;
 	guint32 final_got_size;
@@ -4619,6 +4626,10 @@ mono_aot_parse_options (const char *aot_options, MonoAotOptions *opts)
 			opts->bind_to_runtime_version = TRUE;
 		} else if (str_begins_with (arg, "full")) {
 			opts->full_aot = TRUE;
+		} else if (str_begins_with (arg, "profile-only")) {
+			opts->profile_only = TRUE;
+		} else if (str_begins_with (arg, "profile=")) {
+			opts->profile_file = g_strdup (arg + strlen ("profile="));
 		} else if (str_begins_with (arg, "threads=")) {
 			opts->nthreads = atoi (arg + strlen ("threads="));
 		} else if (str_begins_with (arg, "static")) {
@@ -4662,6 +4673,8 @@ mono_aot_parse_options (const char *aot_options, MonoAotOptions *opts)
 			printf ("    metadata-only\n");
 			printf ("    bind-to-runtime-version\n");
 			printf ("    full\n");
+			printf ("    profile-only\n");
+			printf ("    profile=\n");
 			printf ("    threads=\n");
 			printf ("    static\n");
 			printf ("    asmonly\n");
@@ -4827,6 +4840,14 @@ compile_method (MonoAotCompile *acfg, MonoMethod *method)
 		// FIXME: The wrapper should be generic too, but it is not
 		return;
 
+	/* Methods added by collect_methods () have an index equal to their token index */
+	if (acfg->aot_opts.profile_only && index < acfg->image->tables [MONO_TABLE_METHOD].rows && !g_hash_table_lookup (acfg->profile_methods, method)) {
+		if (acfg->aot_opts.print_skipped_methods)
+			printf ("Skip (not in profile): %s\n", mono_method_full_name (method, TRUE));
+		InterlockedIncrement (&acfg->stats.profile_skip_count);
+		return;
+	}
+
 	InterlockedIncrement (&acfg->stats.mcount);
 
 #if 0
@@ -5096,93 +5117,511 @@ compile_thread_main (gpointer *user_data)
 		compile_method (acfg, g_ptr_array_index (methods, i));
 }
 
-static void
-load_profile_files (MonoAotCompile *acfg)
+/* Profile record kinds, keep in sync with profiler/mono-profiler-aot.c */
+enum {
+	PROFILE_RECORD_METHOD = 1,
+	PROFILE_RECORD_GINST = 2,
+	PROFILE_RECORD_WRAPPER = 3
+};
+
+typedef struct {
+	MonoAotCompile *acfg;
+	guint8 *p, *end;
+	int version;
+	/* Maps image names to images */
+	GHashTable *images;
+	/* Set if the data is truncated or invalid, the rest of the file is ignored */
+	gboolean error;
+	/* Set if the current record refers to something which can't be loaded */
+	gboolean unresolved;
+} ProfileReader;
+
+static int
+profile_decode_byte (ProfileReader *reader)
 {
-	FILE *infile;
-	char *tmp;
-	int file_index, res, method_index, i;
-	char ver [256];
+	if (reader->p >= reader->end) {
+		reader->error = TRUE;
+		return 0;
+	}
+	return *reader->p++;
+}
+
+static guint32
+profile_decode_int32 (ProfileReader *reader)
+{
+	guint8 *p = reader->p;
+
+	if (reader->end - p < 4) {
+		reader->error = TRUE;
+		reader->p = reader->end;
+		return 0;
+	}
+	reader->p += 4;
+	return p [0] | (p [1] << 8) | (p [2] << 16) | ((guint32)p [3] << 24);
+}
+
+static MonoImage*
+profile_decode_image (ProfileReader *reader)
+{
+	MonoAssembly *assembly;
+	MonoImageOpenStatus status;
+	MonoImage *image;
+	guint32 len;
+	char *name;
+	gpointer orig_name;
+
+	len = profile_decode_int32 (reader);
+	if (reader->error || len > reader->end - reader->p) {
+		reader->error = TRUE;
+		return NULL;
+	}
+	name = g_strndup ((char*)reader->p, len);
+	reader->p += len;
+
+	if (g_hash_table_lookup_extended (reader->images, name, &orig_name, (gpointer*)&image)) {
+		g_free (name);
+	} else {
+		if (!strcmp (name, reader->acfg->image->assembly_name))
+			image = reader->acfg->image;
+		else
+			image = mono_image_loaded (name);
+		if (!image) {
+			assembly = mono_assembly_load_with_partial_name (name, &status);
+			image = assembly ? assembly->image : NULL;
+		}
+		g_hash_table_insert (reader->images, name, image);
+	}
+
+	if (!image)
+		reader->unresolved = TRUE;
+	return image;
+}
+
+static MonoGenericInst* profile_decode_inst (ProfileReader *reader);
+
+static MonoClass*
+profile_decode_class (ProfileReader *reader)
+{
+	MonoClass *klass, *eklass;
+	MonoImage *image;
+	MonoGenericContext ctx;
 	guint32 token;
-	GList *unordered, *l;
-	gboolean found;
+	int type, rank;
+
+	type = profile_decode_byte (reader);
+	switch (type) {
+	case MONO_TYPE_BOOLEAN:
+		return mono_defaults.boolean_class;
+	case MONO_TYPE_CHAR:
+		return mono_defaults.char_class;
+	case MONO_TYPE_I1:
+		return mono_defaults.sbyte_class;
+	case MONO_TYPE_U1:
+		return mono_defaults.byte_class;
+	case MONO_TYPE_I2:
+		return mono_defaults.int16_class;
+	case MONO_TYPE_U2:
+		return mono_defaults.uint16_class;
+	case MONO_TYPE_I4:
+		return mono_defaults.int32_class;
+	case MONO_TYPE_U4:
+		return mono_defaults.uint32_class;
+	case MONO_TYPE_I8:
+		return mono_defaults.int64_class;
+	case MONO_TYPE_U8:
+		return mono_defaults.uint64_class;
+	case MONO_TYPE_R4:
+		return mono_defaults.single_class;
+	case MONO_TYPE_R8:
+		return mono_defaults.double_class;
+	case MONO_TYPE_I:
+		return mono_defaults.int_class;
+	case MONO_TYPE_U:
+		return mono_defaults.uint_class;
+	case MONO_TYPE_STRING:
+		return mono_defaults.string_class;
+	case MONO_TYPE_OBJECT:
+		return mono_defaults.object_class;
+	case MONO_TYPE_CLASS:
+	case MONO_TYPE_VALUETYPE:
+	case MONO_TYPE_GENERICINST:
+		image = profile_decode_image (reader);
+		token = profile_decode_int32 (reader);
+		klass = NULL;
+		if (image && mono_metadata_token_table (token) == MONO_TABLE_TYPEDEF) {
+			klass = mono_class_get (image, token);
+			if (!klass)
+				mono_loader_clear_error ();
+		}
+		if (type == MONO_TYPE_GENERICINST) {
+			memset (&ctx, 0, sizeof (ctx));
+			ctx.class_inst = profile_decode_inst (reader);
+			if (klass && ctx.class_inst && klass->generic_container && klass->generic_container->type_argc == ctx.class_inst->type_argc)
+				klass = mono_class_inflate_generic_class (klass, &ctx);
+			else
+				klass = NULL;
+		} else if (klass && klass->generic_container) {
+			klass = NULL;
+		}
+		if (!klass)
+			reader->unresolved = TRUE;
+		return klass;
+	case MONO_TYPE_SZARRAY:
+	case MONO_TYPE_ARRAY:
+		rank = type == MONO_TYPE_ARRAY ? profile_decode_byte (reader) : 1;
+		eklass = profile_decode_class (reader);
+		if (!eklass)
+			return NULL;
+		if (type == MONO_TYPE_SZARRAY)
+			return mono_array_class_get (eklass, 1);
+		return mono_bounded_array_class_get (eklass, rank, TRUE);
+	case MONO_TYPE_PTR:
+		eklass = profile_decode_class (reader);
+		if (!eklass)
+			return NULL;
+		return mono_ptr_class_get (&eklass->byval_arg);
+	default:
+		/* The remaining encoding can't be decoded */
+		reader->error = TRUE;
+		return NULL;
+	}
+}
+
+static MonoGenericInst*
+profile_decode_inst (ProfileReader *reader)
+{
+	MonoType **type_argv;
+	MonoClass *klass;
+	MonoGenericInst *inst;
+	int i, type_argc;
+
+	type_argc = profile_decode_byte (reader);
+	if (type_argc == 0)
+		return NULL;
+
+	type_argv = g_new0 (MonoType*, type_argc);
+	for (i = 0; i < type_argc; ++i) {
+		klass = profile_decode_class (reader);
+		if (klass)
+			type_argv [i] = &klass->byval_arg;
+	}
+
+	if (reader->error || reader->unresolved)
+		inst = NULL;
+	else
+		inst = mono_metadata_get_generic_inst (type_argc, type_argv);
+	g_free (type_argv);
+	return inst;
+}
+
+static MonoMethod*
+profile_decode_methoddef (ProfileReader *reader, MonoImage *image)
+{
+	MonoMethod *method;
+	guint32 token;
+
+	token = profile_decode_int32 (reader);
+	if (reader->error || !image)
+		return NULL;
+	if (mono_metadata_token_table (token) != MONO_TABLE_METHOD || mono_metadata_token_index (token) > image->tables [MONO_TABLE_METHOD].rows) {
+		reader->error = TRUE;
+		return NULL;
+	}
+	method = mono_get_method (image, token, NULL);
+	if (!method) {
+		mono_loader_clear_error ();
+		reader->unresolved = TRUE;
+	}
+	return method;
+}
+
+/*
+ * profile_decode_ginst:
+ *
+ *   Decode a PROFILE_RECORD_GINST record, returning the inflated method or NULL
+ * if the instantiation doesn't match the method. Since version 4 the declaring
+ * method can be in another image, like for List<T> over a type of this image.
+ */
+static MonoMethod*
+profile_decode_ginst (ProfileReader *reader)
+{
+	MonoImage *image;
+	MonoMethod *declaring;
+	MonoGenericContainer *container;
+	MonoGenericContext ctx;
+
+	image = reader->version >= 4 ? profile_decode_image (reader) : reader->acfg->image;
+	declaring = profile_decode_methoddef (reader, image);
+	memset (&ctx, 0, sizeof (ctx));
+	ctx.class_inst = profile_decode_inst (reader);
+	ctx.method_inst = profile_decode_inst (reader);
+	if (!declaring || reader->error || reader->unresolved)
+		return NULL;
+
+	container = declaring->klass->generic_container;
+	if ((container ? container->type_argc : 0) != (ctx.class_inst ? ctx.class_inst->type_argc : 0))
+		return NULL;
+	container = declaring->is_generic ? mono_method_get_generic_container (declaring) : NULL;
+	if ((container ? container->type_argc : 0) != (ctx.method_inst ? ctx.method_inst->type_argc : 0))
+		return NULL;
+	if (!ctx.class_inst && !ctx.method_inst)
+		return NULL;
+
+	return mono_class_inflate_generic_method (declaring, &ctx);
+}
+
+/*
+ * profile_decode_wrapper:
+ *
+ *   Decode a PROFILE_RECORD_WRAPPER record, recreating the wrapper from the
+ * method it wraps. Only the wrapper types which have a 1:1 mapping to a methoddef
+ * are saved by the profiler.
+ */
+static MonoMethod*
+profile_decode_wrapper (ProfileReader *reader)
+{
+	MonoMethod *method;
+	int wrapper_type;
+
+	wrapper_type = profile_decode_byte (reader);
+	method = profile_decode_methoddef (reader, reader->acfg->image);
+	if (!method || reader->error || reader->unresolved)
+		return NULL;
+	if (method->is_generic || method->klass->generic_container)
+		return NULL;
+
+	switch (wrapper_type) {
+	case MONO_WRAPPER_SYNCHRONIZED:
+		if (!(method->iflags & METHOD_IMPL_ATTRIBUTE_SYNCHRONIZED))
+			return NULL;
+		return mono_marshal_get_synchronized_wrapper (method);
+	case MONO_WRAPPER_MANAGED_TO_NATIVE:
+		if (!(method->flags & METHOD_ATTRIBUTE_PINVOKE_IMPL) && !(method->iflags & METHOD_IMPL_ATTRIBUTE_INTERNAL_CALL))
+			return NULL;
+		return mono_marshal_get_native_wrapper (method, check_for_pending_exc, reader->acfg->aot_opts.full_aot);
+	case MONO_WRAPPER_DELEGATE_INVOKE:
+		if (!method->klass->delegate || strcmp (method->name, "Invoke"))
+			return NULL;
+		return mono_marshal_get_delegate_invoke (method, NULL);
+	case MONO_WRAPPER_DELEGATE_BEGIN_INVOKE:
+		if (!method->klass->delegate || strcmp (method->name, "BeginInvoke"))
+			return NULL;
+		return mono_marshal_get_delegate_begin_invoke (method);
+	case MONO_WRAPPER_DELEGATE_END_INVOKE:
+		if (!method->klass->delegate || strcmp (method->name, "EndInvoke"))
+			return NULL;
+		return mono_marshal_get_delegate_end_invoke (method);
+	default:
+		return NULL;
+	}
+}
 
-	file_index = 0;
+/*
+ * add_profiled_method:
+ *
+ *   Record that METHOD was found in the profile data. ORDERED is indexed by
+ * methoddef index and is used to compute the method order in linear time.
+ */
+static void
+add_profiled_method (MonoAotCompile *acfg, MonoMethod *method, gboolean *ordered)
+{
+	int method_index;
+
+	if (g_hash_table_lookup (acfg->profile_methods, method))
+		return;
+	g_hash_table_insert (acfg->profile_methods, method, method);
+
+	if (method->wrapper_type || method->is_inflated) {
+		g_ptr_array_add (acfg->profile_extra_methods, method);
+		return;
+	}
+
+	method_index = mono_metadata_token_index (mono_method_get_token (method)) - 1;
+	if (!ordered [method_index]) {
+		ordered [method_index] = TRUE;
+		g_ptr_array_add (acfg->method_order, GUINT_TO_POINTER (method_index));
+	}
+}
+
+static void
+load_profile_data_v2 (MonoAotCompile *acfg, FILE *infile, gboolean *ordered)
+{
 	while (TRUE) {
-		tmp = g_strdup_printf ("%s/.mono/aot-profile-data/%s-%d", g_get_home_dir (), acfg->image->assembly_name, file_index);
+		char name [1024];
+		MonoMethodDesc *desc;
+		MonoMethod *method;
 
-		if (!g_file_test (tmp, G_FILE_TEST_IS_REGULAR)) {
-			g_free (tmp);
+		if (fgets (name, 1023, infile) == NULL)
 			break;
+
+		/* Kill the newline */
+		if (strlen (name) > 0)
+			name [strlen (name) - 1] = '\0';
+
+		desc = mono_method_desc_new (name, TRUE);
+
+		method = mono_method_desc_search_in_image (desc, acfg->image);
+
+		mono_method_desc_free (desc);
+
+		if (method && mono_method_get_token (method)) {
+			add_profiled_method (acfg, method, ordered);
+		} else {
+			//printf ("No method found matching '%s'.\n", name);
 		}
+	}
+}
 
-		infile = fopen (tmp, "r");
-		g_assert (infile);
+static void
+load_profile_data_v3 (MonoAotCompile *acfg, FILE *infile, int version, gboolean *ordered)
+{
+	ProfileReader reader;
+	MonoMethod *method;
+	guint8 *buf;
+	long start, size;
+	int kind;
+
+	start = ftell (infile);
+	fseek (infile, 0, SEEK_END);
+	size = ftell (infile) - start;
+	fseek (infile, start, SEEK_SET);
+	if (size <= 0)
+		return;
 
-		printf ("Using profile data file '%s'\n", tmp);
-		g_free (tmp);
+	buf = g_malloc (size);
+	if (fread (buf, 1, size, infile) != size) {
+		g_free (buf);
+		printf ("Unable to read profile data.\n");
+		return;
+	}
 
-		file_index ++;
+	memset (&reader, 0, sizeof (reader));
+	reader.acfg = acfg;
+	reader.version = version;
+	reader.p = buf;
+	reader.end = buf + size;
+	reader.images = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
-		res = fscanf (infile, "%32s\n", ver);
-		if ((res != 1) || strcmp (ver, "#VER:2") != 0) {
-			printf ("Profile file has wrong version or invalid.\n");
-			fclose (infile);
-			continue;
+	while (reader.p < reader.end && !reader.error) {
+		reader.unresolved = FALSE;
+
+		kind = profile_decode_byte (&reader);
+		switch (kind) {
+		case PROFILE_RECORD_METHOD:
+			method = profile_decode_methoddef (&reader, acfg->image);
+			break;
+		case PROFILE_RECORD_GINST:
+			method = profile_decode_ginst (&reader);
+			break;
+		case PROFILE_RECORD_WRAPPER:
+			method = profile_decode_wrapper (&reader);
+			break;
+		default:
+			reader.error = TRUE;
+			method = NULL;
+			break;
 		}
 
-		while (TRUE) {
-			char name [1024];
-			MonoMethodDesc *desc;
-			MonoMethod *method;
+		if (method && !reader.error && !reader.unresolved)
+			add_profiled_method (acfg, method, ordered);
+	}
 
-			if (fgets (name, 1023, infile) == NULL)
-				break;
+	if (reader.error)
+		printf ("Profile data is truncated or invalid, ignoring the rest of the file.\n");
 
-			/* Kill the newline */
-			if (strlen (name) > 0)
-				name [strlen (name) - 1] = '\0';
+	g_hash_table_destroy (reader.images);
+	g_free (buf);
+}
 
-			desc = mono_method_desc_new (name, TRUE);
+/*
+ * load_profile_file:
+ *
+ *   Load the profile data file at PATH. Returns FALSE if it doesn't exist or it is
+ * invalid.
+ */
+static gboolean
+load_profile_file (MonoAotCompile *acfg, const char *path, gboolean *ordered)
+{
+	FILE *infile;
+	char ver [256];
 
-			method = mono_method_desc_search_in_image (desc, acfg->image);
+	infile = fopen (path, "rb");
+	if (!infile)
+		return FALSE;
 
-			if (method && mono_method_get_token (method)) {
-				token = mono_method_get_token (method);
-				method_index = mono_metadata_token_index (token) - 1;
+	printf ("Using profile data file '%s'\n", path);
 
-				found = FALSE;
-				for (i = 0; i < acfg->method_order->len; ++i) {
-					if (g_ptr_array_index (acfg->method_order, i) == GUINT_TO_POINTER (method_index)) {
-						found = TRUE;
-						break;
-					}
-				}
-				if (!found)
-					g_ptr_array_add (acfg->method_order, GUINT_TO_POINTER (method_index));
-			} else {
-				//printf ("No method found matching '%s'.\n", name);
-			}
-		}
+	if (fgets (ver, sizeof (ver), infile) == NULL) {
+		printf ("Profile file has wrong version or invalid.\n");
 		fclose (infile);
+		return FALSE;
 	}
 
-	/* Add missing methods */
-	unordered = NULL;
-	for (method_index = 0; method_index < acfg->image->tables [MONO_TABLE_METHOD].rows; ++method_index) {
-		found = FALSE;
-		for (i = 0; i < acfg->method_order->len; ++i) {
-			if (g_ptr_array_index (acfg->method_order, i) == GUINT_TO_POINTER (method_index)) {
-				found = TRUE;
+	if (strcmp (ver, "#VER:2\n") == 0) {
+		load_profile_data_v2 (acfg, infile, ordered);
+	} else if (strcmp (ver, "#VER:3\n") == 0) {
+		load_profile_data_v3 (acfg, infile, 3, ordered);
+	} else if (strcmp (ver, "#VER:4\n") == 0) {
+		load_profile_data_v3 (acfg, infile, 4, ordered);
+	} else {
+		printf ("Profile file has wrong version or invalid.\n");
+		fclose (infile);
+		return FALSE;
+	}
+	fclose (infile);
+	return TRUE;
+}
+
+/*
+ * load_profile_files:
+ *
+ *   Load the profile data written by the AOT profiler (mono-profiler-aot.c), or the
+ * file given by the 'profile=' option. It is used to order the methods, and in
+ * profile-only mode, to determine the set of methods to compile.
+ */
+static void
+load_profile_files (MonoAotCompile *acfg)
+{
+	char *tmp;
+	int file_index, method_index, nmethods;
+	gboolean *ordered;
+	gboolean found = FALSE;
+
+	nmethods = acfg->image->tables [MONO_TABLE_METHOD].rows;
+	ordered = g_new0 (gboolean, nmethods);
+
+	if (acfg->aot_opts.profile_file) {
+		found = load_profile_file (acfg, acfg->aot_opts.profile_file, ordered);
+	} else {
+		file_index = 0;
+		while (TRUE) {
+			tmp = g_strdup_printf ("%s/.mono/aot-profile-data/%s-%d", g_get_home_dir (), acfg->image->assembly_name, file_index);
+
+			if (!g_file_test (tmp, G_FILE_TEST_IS_REGULAR)) {
+				g_free (tmp);
 				break;
 			}
+
+			if (load_profile_file (acfg, tmp, ordered))
+				found = TRUE;
+			g_free (tmp);
+
+			file_index ++;
 		}
-		if (!found)
-			unordered = g_list_prepend (unordered, GUINT_TO_POINTER (method_index));
 	}
-	unordered = g_list_reverse (unordered);
-	for (l = unordered; l; l = l->next)
-		g_ptr_array_add (acfg->method_order, l->data);
+
+	if (acfg->aot_opts.profile_only && !found) {
+		fprintf (stderr, "Warning: no AOT profile data found for '%s', compiling all methods.\n", acfg->image->assembly_name);
+		acfg->aot_opts.profile_only = FALSE;
+	}
+
+	/* Add missing methods */
+	for (method_index = 0; method_index < nmethods; ++method_index) {
+		if (!ordered [method_index])
+			g_ptr_array_add (acfg->method_order, GUINT_TO_POINTER (method_index));
+	}
+
+	g_free (ordered);
 }
  
 /* Used by the LLVM backend */
@@ -5471,6 +5910,39 @@ emit_code (MonoAotCompile *acfg)
 		}
 	}
 	emit_line (acfg);
+
+	/*
+	 * Emit a table of <code offset, method index> pairs sorted by code offset, so
+	 * mono_aot_find_jit_info () doesn't have to sort code_offsets at runtime. The
+	 * JIT compiled methods are emitted in method_order, so the table is sorted by
+	 * construction. LLVM decides the order of its methods itself, so the table is
+	 * left empty in that case and the runtime sorts the offsets.
+	 */
+	sprintf (symbol, "sorted_code_offsets");
+	emit_section_change (acfg, RODATA_SECT, 1);
+	emit_alignment (acfg, 8);
+	emit_label (acfg, symbol);
+
+	if (acfg->llvm) {
+		emit_int32 (acfg, 0);
+	} else {
+		int noffsets = 0;
+
+		for (i = 0; i < acfg->nmethods; ++i)
+			if (acfg->cfgs [i])
+				noffsets ++;
+		emit_int32 (acfg, noffsets);
+		for (oindex = 0; oindex < acfg->method_order->len; ++oindex) {
+			i = GPOINTER_TO_UINT (g_ptr_array_index (acfg->method_order, oindex));
+
+			if (!acfg->cfgs [i])
+				continue;
+			emit_symbol_diff (acfg, acfg->cfgs [i]->asm_symbol, end_symbol, 0);
+			emit_int32 (acfg, i);
+		}
+		acfg->stats.offsets_size += 4 + noffsets * 8;
+	}
+	emit_line (acfg);
 }
 
 static void
@@ -6387,6 +6859,7 @@ emit_file_info (MonoAotCompile *acfg)
 	emit_pointer (acfg, "method_info_offsets");
 	emit_pointer (acfg, "ex_info_offsets");
 	emit_pointer (acfg, "code_offsets");
+	emit_pointer (acfg, "sorted_code_offsets");
 	emit_pointer (acfg, "extra_method_info_offsets");
 	emit_pointer (acfg, "extra_method_table");
 	emit_pointer (acfg, "got_info_offsets");
@@ -6568,7 +7041,16 @@ collect_methods (MonoAotCompile *acfg)
 		acfg->method_index ++;
 	}
 
-	add_generic_instances (acfg);
+	/* Generic instances and wrappers which were observed by the profiler */
+	for (i = 0; i < acfg->profile_extra_methods->len; ++i)
+		add_extra_method (acfg, g_ptr_array_index (acfg->profile_extra_methods, i));
+
+	/*
+	 * In profile-only mode, only the instances observed by the profiler and the ones
+	 * needed by the compiled methods are added.
+	 */
+	if (!acfg->aot_opts.profile_only)
+		add_generic_instances (acfg);
 
 	if (acfg->aot_opts.full_aot)
 		add_wrappers (acfg);
@@ -6798,6 +7280,8 @@ acfg_create (MonoAssembly *ass, guint32 opts)
 	acfg->unwind_ops = g_ptr_array_new ();
 	acfg->method_label_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 	acfg->method_order = g_ptr_array_new ();
+	acfg->profile_methods = g_hash_table_new (NULL, NULL);
+	acfg->profile_extra_methods = g_ptr_array_new ();
 	InitializeCriticalSection (&acfg->mutex);
 
 	return acfg;
@@ -6823,6 +7307,8 @@ acfg_free (MonoAotCompile *acfg)
 	g_ptr_array_free (acfg->unwind_ops, TRUE);
 	g_hash_table_destroy (acfg->method_indexes);
 	g_hash_table_destroy (acfg->method_depth);
+	g_hash_table_destroy (acfg->profile_methods);
+	g_ptr_array_free (acfg->profile_extra_methods, TRUE);
 	g_hash_table_destroy (acfg->plt_offset_to_entry);
 	g_hash_table_destroy (acfg->patch_to_plt_entry);
 	g_hash_table_destroy (acfg->patch_to_got_offset);
@@ -6903,6 +7389,11 @@ mono_compile_assembly (MonoAssembly *ass, guint32 opts, const char *aot_options)
 	if (acfg->aot_opts.full_aot)
 		acfg->flags |= MONO_AOT_FILE_FLAG_FULL_AOT;
 
+	if (acfg->aot_opts.profile_only && acfg->aot_opts.full_aot) {
+		fprintf (stderr, "The 'profile-only' option can't be used together with 'full', since full AOT code can't fall back to the JIT.\n");
+		exit (1);
+	}
+
 	load_profile_files (acfg);
 
 	acfg->num_trampolines [MONO_AOT_TRAMP_SPECIFIC] = acfg->aot_opts.full_aot ? acfg->aot_opts.ntrampolines : 0;
@@ -7151,6 +7642,8 @@ mono_compile_assembly (MonoAssembly *ass, guint32 opts, const char *aot_options)
 	acfg->stats.link_time = TV_ELAPSED (atv, btv);
 
 	printf ("Compiled %d out of %d methods (%d%%)\n", acfg->stats.ccount, acfg->stats.mcount, acfg->stats.mcount ? (acfg->stats.ccount * 100) / acfg->stats.mcount : 100);
+	if (acfg->stats.profile_skip_count)
+		printf ("%d methods are not in the profile and are left to the JIT\n", acfg->stats.profile_skip_count);
 	if (acfg->stats.genericcount)
 		printf ("%d methods are generic (%d%%)\n", acfg->stats.genericcount, acfg->stats.mcount ? (acfg->stats.genericcount * 100) / acfg->stats.mcount : 100);
 	if (acfg->stats.abscount)
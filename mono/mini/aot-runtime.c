@@ -34,6 +34,9 @@
 #ifdef HAVE_SYS_WAIT_H
 #include <sys/wait.h>  /* for WIFEXITED, WEXITSTATUS */
 #endif
+#ifdef HAVE_SETPRIORITY
+#include <sys/resource.h>
+#endif
 
 #ifdef HAVE_DL_ITERATE_PHDR
 #include <link.h>
@@ -90,7 +93,15 @@ typedef struct MonoAotModule {
 	MonoAssembly *assembly;
 	MonoImage **image_table;
 	guint32 image_table_len;
+	/* The encoded image table, decoded by decode_image_table () on first use */
+	guint8 *image_table_data;
 	gboolean out_of_date;
+	/* Whenever the module was loaded from the AOT cache */
+	gboolean from_cache;
+	/* Whenever all the images in image_table have been loaded and checked */
+	gboolean dependencies_loaded;
+	/* Whenever a thread is loading the images in image_table */
+	gboolean dependencies_loading;
 	gboolean plt_inited;
 	guint8 *mem_begin;
 	guint8 *mem_end;
@@ -101,7 +112,7 @@ typedef struct MonoAotModule {
 	guint8 *blob;
 	gint32 *code_offsets;
 	/* This contains <offset, index> pairs sorted by offset */
-	/* This is needed because LLVM emitted methods can be in any order */
+	/* This is emitted by the AOT compiler, except with LLVM, where it is computed on demand */
 	gint32 *sorted_code_offsets;
 	gint32 sorted_code_offsets_len;
 	guint32 *method_info_offsets;
@@ -147,16 +158,30 @@ static GHashTable *static_aot_modules;
 static GHashTable *ji_to_amodule;
 
 /*
- * Whenever to AOT compile loaded assemblies on demand and store them in
- * a cache under $HOME/.mono/aot-cache.
+ * Whenever to AOT compile the JIT compiled methods of loaded assemblies in the
+ * background and store them in a cache under $HOME/.mono/aot-cache.
  */
 static gboolean use_aot_cache = FALSE;
 
 /*
- * Whenever to spawn a new process to AOT a file or do it in-process. Only relevant if
- * use_aot_cache is TRUE.
+ * An assembly whose methods were JIT compiled while running with the AOT cache
+ * enabled.
  */
-static gboolean spawn_compiler = TRUE;
+typedef struct {
+	/* The file name of the assembly */
+	char *assembly_file;
+	/* The cache file name without extension, see get_aot_cache_name () */
+	char *cache_name;
+	/* The methoddef tokens of the JIT compiled methods in the order they were compiled */
+	GPtrArray *methods;
+	GHashTable *method_hash;
+} AotCacheEntry;
+
+/* Maps MonoImage* to AotCacheEntry* */
+static GHashTable *aot_cache_entries;
+
+/* A lock file older than this is assumed to belong to a compilation which failed */
+#define AOT_CACHE_LOCK_TIMEOUT (60 * 60)
 
 /* For debugging */
 static gint32 mono_last_aot_method = -1;
@@ -174,10 +199,70 @@ static GHashTable *aot_jit_icall_hash;
 static void
 init_plt (MonoAotModule *info);
 
+static void
+invalidate_cached_module (MonoAotModule *amodule);
+
 /*****************************************************/
 /*                 AOT RUNTIME                       */
 /*****************************************************/
 
+/*
+ * decode_image_table:
+ *
+ *   Decode the names and GUIDs of the images referenced by AMODULE. This is done
+ * the first time one of the images is needed instead of at load time, since a lot
+ * of the AOT modules loaded at startup are never used. The strings point into the
+ * AOT image.
+ */
+static void
+decode_image_table (MonoAotModule *amodule)
+{
+	MonoAssemblyName *image_names;
+	char **image_guids;
+	char *table;
+	guint32 i;
+
+	mono_aot_lock ();
+	if (amodule->image_names) {
+		mono_aot_unlock ();
+		return;
+	}
+
+	table = (char*)amodule->image_table_data;
+	image_names = g_new0 (MonoAssemblyName, amodule->image_table_len);
+	image_guids = g_new0 (char*, amodule->image_table_len);
+	for (i = 0; i < amodule->image_table_len; ++i) {
+		MonoAssemblyName *aname = &(image_names [i]);
+
+		aname->name = table;
+		table += strlen (table) + 1;
+		image_guids [i] = table;
+		table += strlen (table) + 1;
+		if (table [0] != 0)
+			aname->culture = table;
+		table += strlen (table) + 1;
+		memcpy (aname->public_key_token, table, strlen (table) + 1);
+		table += strlen (table) + 1;			
+
+		table = ALIGN_PTR_TO (table, 8);
+		aname->flags = *(guint32*)table;
+		table += 4;
+		aname->major = *(guint32*)table;
+		table += 4;
+		aname->minor = *(guint32*)table;
+		table += 4;
+		aname->build = *(guint32*)table;
+		table += 4;
+		aname->revision = *(guint32*)table;
+		table += 4;
+	}
+
+	amodule->image_guids = image_guids;
+	mono_memory_barrier ();
+	amodule->image_names = image_names;
+	mono_aot_unlock ();
+}
+
 /*
  * load_image:
  *
@@ -197,6 +282,9 @@ load_image (MonoAotModule *amodule, int index, gboolean set_error)
 	if (amodule->out_of_date)
 		return NULL;
 
+	if (!amodule->image_names)
+		decode_image_table (amodule);
+
 	assembly = mono_assembly_load (&amodule->image_names [index], amodule->assembly->basedir, &status);
 	if (!assembly) {
 		mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT module %s is unusable because dependency %s is not found.\n", amodule->aot_name, amodule->image_names [index].name);
@@ -220,6 +308,60 @@ load_image (MonoAotModule *amodule, int index, gboolean set_error)
 	return assembly->image;
 }
 
+/*
+ * load_dependencies:
+ *
+ *   Load all the images referenced by AMODULE, checking that they are the exact
+ * versions the module was compiled against.
+ * Since we store methoddef and classdef tokens when referring to methods/classes in
+ * referenced assemblies, we depend on the exact versions of the referenced assemblies.
+ * MS calls this 'hard binding'. The generated code and the cached class info also
+ * depend on the layout of types in those assemblies, so this has to be done before
+ * any of them are used, since we can't handle out-of-date errors later.
+ * It is done on first use instead of in load_aot_module (), so modules which are
+ * never used don't cause their dependencies to be loaded.
+ * Returns: FALSE if the module is out-of-date.
+ */
+static gboolean
+load_dependencies (MonoAotModule *amodule)
+{
+	int i;
+	gboolean loading;
+
+	if (amodule->dependencies_loaded)
+		return !amodule->out_of_date;
+
+	/*
+	 * Loading an image can run the managed assembly resolve handlers, which can
+	 * end up here again for the same module, and other threads can get here at
+	 * the same time. Only the first caller loads the images, the others don't use
+	 * the module until it is done, so their methods are JITted.
+	 */
+	mono_aot_lock ();
+	loading = amodule->dependencies_loading;
+	amodule->dependencies_loading = TRUE;
+	mono_aot_unlock ();
+	if (loading)
+		return FALSE;
+
+	for (i = 0; i < amodule->image_table_len; ++i)
+		load_image (amodule, i, FALSE);
+
+	if (amodule->out_of_date) {
+		mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT Module %s is unusable because a dependency is out-of-date.\n", amodule->assembly->image->name);
+		invalidate_cached_module (amodule);
+		if (mono_aot_only) {
+			fprintf (stderr, "Failed to load AOT module '%s' while running in aot-only mode because a dependency cannot be found or it is out of date.\n", amodule->aot_name);
+			exit (1);
+		}
+	}
+
+	mono_memory_barrier ();
+	amodule->dependencies_loaded = TRUE;
+
+	return !amodule->out_of_date;
+}
+
 static inline gint32
 decode_value (guint8 *ptr, guint8 **rptr)
 {
@@ -795,130 +937,423 @@ decode_resolve_method_ref (MonoAotModule *module, guint8 *buf, guint8 **endbuf)
 	return decode_resolve_method_ref_with_target (module, NULL, buf, endbuf);
 }
 
-static void
-create_cache_structure (void)
+static gboolean
+create_cache_dir (const char *dir)
 {
-	const char *home;
-	char *tmp;
 	int err;
 
-	home = g_get_home_dir ();
-	if (!home)
-		return;
+	if (g_file_test (dir, G_FILE_TEST_IS_DIR))
+		return TRUE;
 
-	tmp = g_build_filename (home, ".mono", NULL);
-	if (!g_file_test (tmp, G_FILE_TEST_IS_DIR)) {
-		mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT creating directory %s", tmp);
+	mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT creating directory %s", dir);
 #ifdef HOST_WIN32
-		err = mkdir (tmp);
+	err = mkdir (dir);
 #else
-		err = mkdir (tmp, 0777);
+	err = mkdir (dir, 0777);
 #endif
-		if (err) {
-			mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT failed: %s", g_strerror (errno));
-			g_free (tmp);
-			return;
-		}
+	if (err && errno != EEXIST) {
+		mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT failed: %s", g_strerror (errno));
+		return FALSE;
 	}
-	g_free (tmp);
-	tmp = g_build_filename (home, ".mono", "aot-cache", NULL);
-	if (!g_file_test (tmp, G_FILE_TEST_IS_DIR)) {
-		mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT creating directory %s", tmp);
-#ifdef HOST_WIN32
-		err = mkdir (tmp);
-#else
-		err = mkdir (tmp, 0777);
-#endif
-		if (err) {
-			mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT failed: %s", g_strerror (errno));
-			g_free (tmp);
-			return;
-		}
+	return TRUE;
+}
+
+/*
+ * get_aot_cache_dir:
+ *
+ *   Return the directory holding the cached AOT images of this runtime. The
+ * images depend on the runtime version, the GC and the AOT file format, so the
+ * cache is versioned by them, and images from other runtimes are never seen.
+ */
+static char*
+get_aot_cache_dir (void)
+{
+	const char *home;
+	char *build_info, *key, *p;
+	char *res;
+
+	home = g_get_home_dir ();
+	if (!home)
+		return NULL;
+
+	build_info = mono_get_runtime_build_info ();
+	key = g_strdup_printf ("%s-%s-%d", build_info, mono_gc_get_gc_name (), MONO_AOT_FILE_VERSION);
+	g_free (build_info);
+	for (p = key; *p; ++p) {
+		if (!g_ascii_isalpha (*p) && !(*p >= '0' && *p <= '9') && *p != '.' && *p != '-')
+			*p = '_';
 	}
-	g_free (tmp);
+
+	res = g_build_filename (home, ".mono", "aot-cache", key, NULL);
+	g_free (key);
+	return res;
+}
+
+/*
+ * create_cache_structure:
+ *
+ *   Create CACHE_DIR, which is $HOME/.mono/aot-cache/<key>, and its parents.
+ */
+static gboolean
+create_cache_structure (const char *cache_dir)
+{
+	char *cache_root, *mono_dir;
+	gboolean res;
+
+	cache_root = g_path_get_dirname (cache_dir);
+	mono_dir = g_path_get_dirname (cache_root);
+	res = create_cache_dir (mono_dir) && create_cache_dir (cache_root) && create_cache_dir (cache_dir);
+	g_free (mono_dir);
+	g_free (cache_root);
+	return res;
+}
+
+/*
+ * get_aot_cache_name:
+ *
+ *   Return the name of the cache entries for IMAGE without the extension. It
+ * contains the GUID of the assembly, so a modified assembly never matches an old
+ * entry.
+ */
+static char*
+get_aot_cache_name (MonoImage *image)
+{
+	char *dir, *fname, *res;
+
+	dir = get_aot_cache_dir ();
+	if (!dir)
+		return NULL;
+	fname = g_strdup_printf ("%s-%s", image->assembly_name, image->guid);
+	res = g_build_filename (dir, fname, NULL);
+	g_free (fname);
+	g_free (dir);
+	return res;
 }
 
 /*
  * load_aot_module_from_cache:
  *
- *  Experimental code to AOT compile loaded assemblies on demand. 
+ *   Load the AOT image of ASSEMBLY from the AOT cache. The cache is populated in
+ * the background by aot_cache_compile_pending () from the methods JIT compiled by
+ * previous runs, so this never compiles anything itself.
  *
  * FIXME: 
- * - Add environment variable MONO_AOT_CACHE_OPTIONS
  * - Add options for controlling the cache size
  * - Handle full cache by deleting old assemblies lru style
  * - Add options for excluding assemblies during development
- * - Maybe add a threshold after an assembly is AOT compiled
  * - invoking a new mono process is a security risk
- * - recompile the AOT module if one of its dependencies changes
  */
 static MonoDl*
 load_aot_module_from_cache (MonoAssembly *assembly, char **aot_name)
 {
-	char *fname, *cmd, *tmp2, *aot_options;
-	const char *home;
+	char *cache_name;
 	MonoDl *module;
-	gboolean res;
-	gchar *out, *err;
-	gint exit_status;
 
 	*aot_name = NULL;
 
 	if (assembly->image->dynamic)
 		return NULL;
 
-	create_cache_structure ();
+	cache_name = get_aot_cache_name (assembly->image);
+	if (!cache_name)
+		return NULL;
+	*aot_name = g_strdup_printf ("%s%s", cache_name, SHARED_EXT);
+	g_free (cache_name);
 
-	home = g_get_home_dir ();
+	mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT trying to load from cache: '%s'.", *aot_name);
+	module = mono_dl_open (*aot_name, MONO_DL_LAZY, NULL);
+	if (!module)
+		mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT not found.");
 
-	tmp2 = g_strdup_printf ("%s-%s%s", assembly->image->assembly_name, assembly->image->guid, SHARED_EXT);
-	fname = g_build_filename (home, ".mono", "aot-cache", tmp2, NULL);
-	*aot_name = fname;
-	g_free (tmp2);
+	return module;
+}
 
-	mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT trying to load from cache: '%s'.", fname);
-	module = mono_dl_open (fname, MONO_DL_LAZY, NULL);
+/*
+ * invalidate_cached_module:
+ *
+ *   Remove the cached image of AMODULE since it can't be used, i.e. because one of
+ * its dependencies changed. It will be recreated by the next run which JIT compiles
+ * some of its methods.
+ */
+static void
+invalidate_cached_module (MonoAotModule *amodule)
+{
+	if (!amodule->from_cache)
+		return;
 
-	if (!module) {
-		mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT not found.");
+	mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT removing stale cache entry '%s'.", amodule->aot_name);
+	/* This is safe even if the image is mapped */
+	unlink (amodule->aot_name);
+}
 
-		mono_trace (G_LOG_LEVEL_MESSAGE, MONO_TRACE_AOT, "AOT precompiling assembly '%s'... ", assembly->image->name);
+/*
+ * aot_cache_record_method:
+ *
+ *   Record that METHOD is being JIT compiled because it was not found in the AOT
+ * cache, so it can be added to the cached image of its assembly.
+ */
+static void
+aot_cache_record_method (MonoMethod *method)
+{
+	MonoImage *image = method->klass->image;
+	AotCacheEntry *entry;
+	guint32 token = method->token;
+
+	if (mono_compile_aot || image->dynamic || !image->assembly)
+		return;
+	if (method->wrapper_type || method->is_inflated || method->is_generic || method->klass->generic_container)
+		return;
+	if (mono_metadata_token_table (token) != MONO_TABLE_METHOD)
+		return;
+	/* These are never AOT compiled */
+	if ((method->iflags & METHOD_IMPL_ATTRIBUTE_INTERNAL_CALL) ||
+		(method->flags & METHOD_ATTRIBUTE_PINVOKE_IMPL) ||
+		(method->iflags & METHOD_IMPL_ATTRIBUTE_RUNTIME) ||
+		(method->flags & METHOD_ATTRIBUTE_ABSTRACT))
+		return;
 
-		aot_options = g_strdup_printf ("outfile=%s", fname);
+	mono_aot_lock ();
+	if (!aot_cache_entries)
+		aot_cache_entries = g_hash_table_new (NULL, NULL);
+	entry = g_hash_table_lookup (aot_cache_entries, image);
+	if (!entry) {
+		entry = g_new0 (AotCacheEntry, 1);
+		entry->assembly_file = g_strdup (image->name);
+		entry->cache_name = get_aot_cache_name (image);
+		entry->methods = g_ptr_array_new ();
+		entry->method_hash = g_hash_table_new (NULL, NULL);
+		g_hash_table_insert (aot_cache_entries, image, entry);
+	}
+	if (!g_hash_table_lookup (entry->method_hash, GUINT_TO_POINTER (token))) {
+		g_hash_table_insert (entry->method_hash, GUINT_TO_POINTER (token), GUINT_TO_POINTER (token));
+		g_ptr_array_add (entry->methods, GUINT_TO_POINTER (token));
+	}
+	mono_aot_unlock ();
+}
 
-		if (spawn_compiler) {
-			/* FIXME: security */
-			/* FIXME: Has to pass the assembly loading path to the child process */
-			cmd = g_strdup_printf ("mono -O=all --aot=%s %s", aot_options, assembly->image->name);
+#ifndef HOST_WIN32
+static void
+aot_cache_compiler_setup (gpointer user_data)
+{
+	int i;
 
-			res = g_spawn_command_line_sync (cmd, &out, &err, &exit_status, NULL);
+	/*
+	 * The compiler can outlive the app, so it shouldn't keep its files and sockets
+	 * open. They are closed on exec instead of here, since g_spawn () reports exec
+	 * failures through one of them.
+	 */
+	for (i = getdtablesize () - 1; i > 2; i--)
+		fcntl (i, F_SETFD, FD_CLOEXEC);
 
-#if !defined(HOST_WIN32) && !defined(__ppc__) && !defined(__ppc64__) && !defined(__powerpc__)
-			if (res) {
-				if (!WIFEXITED (exit_status) && (WEXITSTATUS (exit_status) == 0))
-					mono_trace (G_LOG_LEVEL_MESSAGE, MONO_TRACE_AOT, "AOT failed: %s.", err);
-				else
-					mono_trace (G_LOG_LEVEL_MESSAGE, MONO_TRACE_AOT, "AOT succeeded.");
-				g_free (out);
-				g_free (err);
-			}
+#ifdef HAVE_SETPRIORITY
+	/* Run the compiler at idle priority so it doesn't compete with the app */
+	setpriority (PRIO_PROCESS, 0, 19);
 #endif
-			g_free (cmd);
-		} else {
-			res = mono_compile_assembly (assembly, mono_parse_default_optimizations (NULL), aot_options);
-			if (!res) {
-				mono_trace (G_LOG_LEVEL_MESSAGE, MONO_TRACE_AOT, "AOT failed.");
-			} else {
-				mono_trace (G_LOG_LEVEL_MESSAGE, MONO_TRACE_AOT, "AOT succeeded.");
+}
+
+/*
+ * aot_cache_lock:
+ *
+ *   Create the lock file for ENTRY, so only one process compiles an assembly at a
+ * time. The compiler doesn't remove the lock, so it is considered stale once the
+ * image is newer than it, or after AOT_CACHE_LOCK_TIMEOUT if the compilation failed.
+ */
+static gboolean
+aot_cache_lock (AotCacheEntry *entry, const char *image_name)
+{
+	char *lock_name;
+	struct stat lock_stat, image_stat;
+	int fd;
+
+	lock_name = g_strdup_printf ("%s.lock", entry->cache_name);
+	if (stat (lock_name, &lock_stat) == 0) {
+		gboolean image_done = stat (image_name, &image_stat) == 0 && image_stat.st_mtime >= lock_stat.st_mtime;
+
+		if (image_done || time (NULL) - lock_stat.st_mtime > AOT_CACHE_LOCK_TIMEOUT)
+			unlink (lock_name);
+	}
+
+	fd = open (lock_name, O_WRONLY | O_CREAT | O_EXCL, 0644);
+	g_free (lock_name);
+	if (fd == -1)
+		return FALSE;
+	close (fd);
+	return TRUE;
+}
+
+/*
+ * aot_cache_write_profile:
+ *
+ *   Append the methods of ENTRY to its profile file, which uses the format read by
+ * the AOT compiler (see mono-profiler-aot.c). The file accumulates the methods
+ * JIT compiled by all runs, so the recompiled image contains all of them.
+ * Returns: the number of methods which were not in the file already. Methods which
+ * the AOT compiler can't compile are JIT compiled by every run, so this avoids
+ * recompiling the image over and over.
+ */
+static int
+aot_cache_write_profile (AotCacheEntry *entry, const char *profile_name)
+{
+	FILE *file;
+	GHashTable *known;
+	char ver [256];
+	guint8 record [5];
+	guint32 token;
+	int i, nnew;
+
+	known = g_hash_table_new (NULL, NULL);
+	file = fopen (profile_name, "rb");
+	if (file) {
+		if (fgets (ver, sizeof (ver), file) && !strcmp (ver, "#VER:3\n")) {
+			while (fread (record, 1, 5, file) == 5 && record [0] == 1) {
+				token = record [1] | (record [2] << 8) | (record [3] << 16) | ((guint32)record [4] << 24);
+				g_hash_table_insert (known, GUINT_TO_POINTER (token), GUINT_TO_POINTER (token));
 			}
 		}
+		fclose (file);
+		file = fopen (profile_name, "ab");
+	} else {
+		file = fopen (profile_name, "wb");
+		if (file)
+			fprintf (file, "#VER:%d\n", 3);
+	}
+	if (!file) {
+		g_hash_table_destroy (known);
+		return 0;
+	}
 
-		module = mono_dl_open (fname, MONO_DL_LAZY, NULL);
+	nnew = 0;
+	for (i = 0; i < entry->methods->len; ++i) {
+		token = GPOINTER_TO_UINT (g_ptr_array_index (entry->methods, i));
+		if (g_hash_table_lookup (known, GUINT_TO_POINTER (token)))
+			continue;
+		/* A methoddef record */
+		record [0] = 1;
+		record [1] = token & 0xff;
+		record [2] = (token >> 8) & 0xff;
+		record [3] = (token >> 16) & 0xff;
+		record [4] = (token >> 24) & 0xff;
+		fwrite (record, 1, 5, file);
+		nnew ++;
+	}
+	fclose (file);
+	g_hash_table_destroy (known);
+	return nnew;
+}
 
+/*
+ * aot_cache_needs_compile:
+ *
+ *   Return whenever the cached image of ENTRY needs to be (re)compiled, i.e. there
+ * are methods in the profile which were added after the image was created.
+ */
+static gboolean
+aot_cache_needs_compile (AotCacheEntry *entry, const char *image_name, const char *profile_name)
+{
+	struct stat image_stat, profile_stat;
+
+	if (aot_cache_write_profile (entry, profile_name) > 0)
+		return TRUE;
+	if (stat (profile_name, &profile_stat) != 0)
+		return FALSE;
+	/* Methods added by a run which couldn't start the compiler */
+	return stat (image_name, &image_stat) != 0 || profile_stat.st_mtime > image_stat.st_mtime;
+}
+
+/*
+ * get_aot_cache_compiler:
+ *
+ *   Return the mono executable used to populate the cache. Prefer the running
+ * executable if it is mono, so the images match this runtime.
+ */
+static char*
+get_aot_cache_compiler (void)
+{
+#ifdef __linux__
+	char buf [4096];
+	char *base;
+	int len;
+
+	len = readlink ("/proc/self/exe", buf, sizeof (buf) - 1);
+	if (len > 0) {
+		buf [len] = '\0';
+		base = g_path_get_basename (buf);
+		if (!strncmp (base, "mono", 4)) {
+			g_free (base);
+			return g_strdup (buf);
+		}
+		g_free (base);
+	}
+#endif
+	return g_strdup ("mono");
+}
+
+static void
+aot_cache_compile_entry (gpointer key, gpointer value, gpointer user_data)
+{
+	AotCacheEntry *entry = value;
+	char *image_name, *profile_name, *aot_options, *compiler;
+	const char *argv [5];
+	GError *error = NULL;
+
+	if (!entry->cache_name || !entry->methods->len)
+		return;
+
+	image_name = g_strdup_printf ("%s%s", entry->cache_name, SHARED_EXT);
+	profile_name = g_strdup_printf ("%s.prof", entry->cache_name);
+
+	if (aot_cache_needs_compile (entry, image_name, profile_name) && aot_cache_lock (entry, image_name)) {
+		mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT compiling '%s' into the cache in the background.", entry->assembly_file);
+
+		/*
+		 * Bind the image to the runtime version, so an image created by another mono in
+		 * PATH is rejected by check_usable () and invalidated.
+		 */
+		aot_options = g_strdup_printf ("--aot=bind-to-runtime-version,profile-only,profile=%s,outfile=%s", profile_name, image_name);
+		compiler = get_aot_cache_compiler ();
+		/* FIXME: Has to pass the assembly loading path to the child process */
+		argv [0] = compiler;
+		argv [1] = "-O=all";
+		argv [2] = aot_options;
+		argv [3] = entry->assembly_file;
+		argv [4] = NULL;
+
+		/* The child is reaped by eglib, and it outlives this process */
+		if (!g_spawn_async_with_pipes (NULL, (char**)argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL, aot_cache_compiler_setup, NULL, NULL, NULL, NULL, NULL, &error)) {
+			mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT failed to spawn the compiler: %s", error ? error->message : "");
+			if (error)
+				g_error_free (error);
+		}
 		g_free (aot_options);
+		g_free (compiler);
 	}
 
-	return module;
+	g_free (image_name);
+	g_free (profile_name);
+}
+#endif
+
+/*
+ * aot_cache_compile_pending:
+ *
+ *   Start a background AOT compilation for each assembly which had methods JIT
+ * compiled during this run.
+ */
+static void
+aot_cache_compile_pending (void)
+{
+	char *dir;
+
+	if (!aot_cache_entries)
+		return;
+
+	dir = get_aot_cache_dir ();
+	if (dir && create_cache_structure (dir)) {
+#ifndef HOST_WIN32
+		g_hash_table_foreach (aot_cache_entries, aot_cache_compile_entry, NULL);
+#endif
+	}
+	g_free (dir);
 }
 
 static void
@@ -1047,9 +1482,10 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 	char *msg = NULL;
 	gpointer *globals = NULL;
 	MonoAotFileInfo *info = NULL;
-	int i, version;
+	int version;
 	guint8 *blob;
 	gboolean do_load_image = TRUE;
+	gboolean from_cache = FALSE;
 
 	if (mono_compile_aot)
 		return;
@@ -1081,9 +1517,10 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 		mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "Found statically linked AOT module '%s'.\n", aot_name);
 		globals = info->globals;
 	} else {
-		if (use_aot_cache)
+		if (use_aot_cache) {
 			sofile = load_aot_module_from_cache (assembly, &aot_name);
-		else {
+			from_cache = TRUE;
+		} else {
 			char *err;
 			aot_name = g_strdup_printf ("%s%s", assembly->image->name, SHARED_EXT);
 
@@ -1149,6 +1586,7 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 	amodule = g_new0 (MonoAotModule, 1);
 	amodule->aot_name = aot_name;
 	amodule->assembly = assembly;
+	amodule->from_cache = from_cache;
 
 	memcpy (&amodule->info, info, sizeof (*info));
 
@@ -1159,48 +1597,17 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 	amodule->method_to_code = g_hash_table_new (mono_aligned_addr_hash, NULL);
 	amodule->blob = blob;
 
-	/* Read image table */
-	{
-		guint32 table_len, i;
-		char *table = NULL;
-
-		table = info->image_table;
-		g_assert (table);
-
-		table_len = *(guint32*)table;
-		table += sizeof (guint32);
-		amodule->image_table = g_new0 (MonoImage*, table_len);
-		amodule->image_names = g_new0 (MonoAssemblyName, table_len);
-		amodule->image_guids = g_new0 (char*, table_len);
-		amodule->image_table_len = table_len;
-		for (i = 0; i < table_len; ++i) {
-			MonoAssemblyName *aname = &(amodule->image_names [i]);
-
-			aname->name = g_strdup (table);
-			table += strlen (table) + 1;
-			amodule->image_guids [i] = g_strdup (table);
-			table += strlen (table) + 1;
-			if (table [0] != 0)
-				aname->culture = g_strdup (table);
-			table += strlen (table) + 1;
-			memcpy (aname->public_key_token, table, strlen (table) + 1);
-			table += strlen (table) + 1;			
-
-			table = ALIGN_PTR_TO (table, 8);
-			aname->flags = *(guint32*)table;
-			table += 4;
-			aname->major = *(guint32*)table;
-			table += 4;
-			aname->minor = *(guint32*)table;
-			table += 4;
-			aname->build = *(guint32*)table;
-			table += 4;
-			aname->revision = *(guint32*)table;
-			table += 4;
-		}
-	}
+	/* The image table is only decoded when one of the images is needed */
+	g_assert (info->image_table);
+	amodule->image_table_len = *(guint32*)info->image_table;
+	amodule->image_table_data = (guint8*)info->image_table + sizeof (guint32);
+	amodule->image_table = g_new0 (MonoImage*, amodule->image_table_len);
 
 	amodule->code_offsets = info->code_offsets;
+	if (*(gint32*)info->sorted_code_offsets > 0) {
+		amodule->sorted_code_offsets_len = *(gint32*)info->sorted_code_offsets;
+		amodule->sorted_code_offsets = (gint32*)info->sorted_code_offsets + 1;
+	}
 	amodule->code = info->methods;
 #ifdef TARGET_ARM
 	/* Mask out thumb interop bit */
@@ -1277,11 +1684,9 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 	}
 
 	/*
-	 * Since we store methoddef and classdef tokens when referring to methods/classes in
-	 * referenced assemblies, we depend on the exact versions of the referenced assemblies.
-	 * MS calls this 'hard binding'. This means we have to load all referenced assemblies
-	 * non-lazily, since we can't handle out-of-date errors later.
-	 * The cached class info also depends on the exact assemblies.
+	 * The referenced assemblies are loaded and checked by load_dependencies () when the
+	 * module is first used. In aot-only mode, there is no fallback if they are
+	 * out-of-date, so check them immediately to fail early.
 	 */
 #if defined(__native_client__)
 	/* TODO: Don't 'load_image' on mscorlib due to a */
@@ -1293,20 +1698,12 @@ load_aot_module (MonoAssembly *assembly, gpointer user_data)
 		do_load_image = FALSE;
 	}
 #endif
-	if (do_load_image) {
-		for (i = 0; i < amodule->image_table_len; ++i)
-			load_image (amodule, i, FALSE);
-	}
+	if (!do_load_image)
+		amodule->dependencies_loaded = TRUE;
+	else if (mono_aot_only)
+		load_dependencies (amodule);
 
-	if (amodule->out_of_date) {
-		mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT Module %s is unusable because a dependency is out-of-date.\n", assembly->image->name);
-		if (mono_aot_only) {
-			fprintf (stderr, "Failed to load AOT module '%s' while running in aot-only mode because a dependency cannot be found or it is out of date.\n", aot_name);
-			exit (1);
-		}
-	}
-	else
-		mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT loaded AOT Module for %s.\n", assembly->image->name);
+	mono_trace (G_LOG_LEVEL_INFO, MONO_TRACE_AOT, "AOT loaded AOT Module for %s.\n", assembly->image->name);
 }
 
 /*
@@ -1372,6 +1769,8 @@ mono_aot_init (void)
 void
 mono_aot_cleanup (void)
 {
+	if (use_aot_cache)
+		aot_cache_compile_pending ();
 	if (aot_jit_icall_hash)
 		g_hash_table_destroy (aot_jit_icall_hash);
 	if (aot_modules)
@@ -1439,6 +1838,9 @@ mono_aot_get_method_from_vt_slot (MonoDomain *domain, MonoVTable *vtable, int sl
 	if (MONO_CLASS_IS_INTERFACE (klass) || klass->rank || !amodule)
 		return NULL;
 
+	if (!load_dependencies (amodule))
+		return NULL;
+
 	info = &amodule->blob [mono_aot_get_offset (amodule->class_info_offsets, mono_metadata_token_index (klass->type_token) - 1)];
 	p = info;
 
@@ -1471,6 +1873,10 @@ mono_aot_get_cached_class_info (MonoClass *klass, MonoCachedClassInfo *res)
 	if (klass->rank || !amodule)
 		return FALSE;
 
+	/* The cached info depends on the layout of types in the referenced assemblies */
+	if (!load_dependencies (amodule))
+		return FALSE;
+
 	p = (guint8*)&amodule->blob [mono_aot_get_offset (amodule->class_info_offsets, mono_metadata_token_index (klass->type_token) - 1)];
 
 	err = decode_cached_class_info (amodule, res, p, &p);
@@ -1775,7 +2181,7 @@ decode_exception_debug_info (MonoAotModule *amodule, MonoDomain *domain,
 	gboolean has_generic_jit_info, has_dwarf_unwind_info, has_clauses, has_seq_points, has_try_block_holes;
 	gboolean from_llvm, has_gc_map;
 	guint8 *p;
-	int generic_info_size, try_holes_info_size, num_holes, this_reg = 0, this_offset = 0;
+	int generic_info_size, try_holes_info_size, gc_info_size, num_holes, this_reg = 0, this_offset = 0;
 
 	/* Load the method info from the AOT file */
 
@@ -1809,6 +2215,7 @@ decode_exception_debug_info (MonoAotModule *amodule, MonoDomain *domain,
 	} else {
 		num_holes = try_holes_info_size = 0;
 	}
+	gc_info_size = has_gc_map ? sizeof (gpointer) : 0;
 	/* Exception table */
 	if (has_clauses)
 		num_clauses = decode_value (p, &p);
@@ -1843,7 +2250,7 @@ decode_exception_debug_info (MonoAotModule *amodule, MonoDomain *domain,
 			}
 		}
 
- 		jinfo = decode_llvm_mono_eh_frame (amodule, domain, method, code, clauses, num_clauses, generic_info_size + try_holes_info_size, nesting, &this_reg, &this_offset);
+ 		jinfo = decode_llvm_mono_eh_frame (amodule, domain, method, code, clauses, num_clauses, gc_info_size + generic_info_size + try_holes_info_size, nesting, &this_reg, &this_offset);
 		jinfo->from_llvm = 1;
 
 		g_free (clauses);
@@ -1852,7 +2259,7 @@ decode_exception_debug_info (MonoAotModule *amodule, MonoDomain *domain,
 		g_free (nesting);
 	} else {
 		jinfo = 
-			mono_domain_alloc0 (domain, MONO_SIZEOF_JIT_INFO + (sizeof (MonoJitExceptionInfo) * num_clauses) + generic_info_size + try_holes_info_size);
+			mono_domain_alloc0 (domain, MONO_SIZEOF_JIT_INFO + (sizeof (MonoJitExceptionInfo) * num_clauses) + gc_info_size + generic_info_size + try_holes_info_size);
 		jinfo->num_clauses = num_clauses;
 
 		for (i = 0; i < jinfo->num_clauses; ++i) {
@@ -1882,6 +2289,8 @@ decode_exception_debug_info (MonoAotModule *amodule, MonoDomain *domain,
 		jinfo->from_aot = 1;
 	}
 
+	jinfo->has_gc_info = has_gc_map;
+
 	if (has_generic_jit_info) {
 		MonoGenericJitInfo *gi;
 
@@ -1964,7 +2373,7 @@ decode_exception_debug_info (MonoAotModule *amodule, MonoDomain *domain,
 		/* The GC map requires 4 bytes of alignment */
 		while ((guint64)(gsize)p % 4)
 			p ++;		
-		jinfo->gc_info = p;
+		mono_jit_info_set_gc_info (jinfo, p);
 		p += map_size;
 	}
 
@@ -2496,7 +2905,7 @@ load_method (MonoDomain *domain, MonoAotModule *amodule, MonoImage *image, MonoM
 		/* Non shared AOT code can't be used in other appdomains */
 		return NULL;
 
-	if (amodule->out_of_date)
+	if (!load_dependencies (amodule))
 		return NULL;
 
 	if (amodule->code_offsets [method_index] == 0xffffffff) {
@@ -2828,11 +3237,11 @@ mono_aot_get_method (MonoDomain *domain, MonoMethod *method)
 	MonoAotModule *amodule = klass->image->aot_module;
 	guint8 *code;
 
-	if (!amodule)
-		return NULL;
-
-	if (amodule->out_of_date)
+	if (!amodule || !load_dependencies (amodule)) {
+		if (use_aot_cache)
+			aot_cache_record_method (method);
 		return NULL;
+	}
 
 	if ((method->iflags & METHOD_IMPL_ATTRIBUTE_INTERNAL_CALL) ||
 		(method->flags & METHOD_ATTRIBUTE_PINVOKE_IMPL) ||
@@ -2979,6 +3388,10 @@ mono_aot_get_method (MonoDomain *domain, MonoMethod *method)
 	} else {
 		/* Common case */
 		method_index = mono_metadata_token_index (method->token) - 1;
+
+		if (use_aot_cache && amodule->code_offsets [method_index] == 0xffffffff)
+			/* Not in the cached image yet */
+			aot_cache_record_method (method);
 	}
 
 	return load_method (domain, amodule, klass->image, method, method->token, method_index);
@@ -3100,6 +3513,8 @@ mono_aot_plt_resolve (gpointer aot_module, guint32 plt_info_offset, guint8 *code
 	MonoAotModule *module = (MonoAotModule*)aot_module;
 	gboolean res, no_ftnptr = FALSE;
 	MonoMemPool *mp;
+	/* decoding a single patch fits into this, so resolving doesn't need to malloc */
+	double mp_buf [512 / sizeof (double)];
 
 	//printf ("DYN: %p %d\n", aot_module, plt_info_offset);
 
@@ -3107,7 +3522,7 @@ mono_aot_plt_resolve (gpointer aot_module, guint32 plt_info_offset, guint8 *code
 
 	ji.type = decode_value (p, &p);
 
-	mp = mono_mempool_new_size (512);
+	mp = mono_mempool_new_from_buffer (mp_buf, sizeof (mp_buf));
 	res = decode_patch (module, mp, &ji, p, &p);
 
 	if (!res) {
@@ -727,6 +727,129 @@ class Tests {
 		return 0;
 	}
 
+	public static int test_45_loop_invariant_ldlen () {
+		int[] arr = new int [10];
+		for (int i = 0; i < arr.Length; ++i)
+			arr [i] = i;
+		int sum = 0;
+		for (int i = 0; i < arr.Length; ++i)
+			sum += arr [i];
+		return sum;
+	}
+
+	public static int test_0_loop_invariant_ldlen_null () {
+		int[] arr = null;
+		int count = 0;
+		try {
+			for (int i = 0; i < arr.Length; ++i)
+				count ++;
+		} catch (NullReferenceException) {
+			return count;
+		}
+		return 1;
+	}
+
+	public static int test_5_loop_invariant_strlen () {
+		string s = "abcde";
+		int count = 0;
+		for (int i = 0; i < s.Length; ++i)
+			if (s [i] >= 'a')
+				count ++;
+		return count;
+	}
+
+	public static int test_0_vectorize_int_add () {
+		int[] a = new int [11];
+		int[] b = new int [11];
+		int[] c = new int [11];
+		for (int i = 0; i < a.Length; ++i) {
+			a [i] = i;
+			b [i] = i * 10;
+		}
+		for (int i = 0; i < a.Length; ++i)
+			c [i] = a [i] + b [i];
+		for (int i = 0; i < c.Length; ++i)
+			if (c [i] != i * 11)
+				return i + 1;
+		return 0;
+	}
+
+	public static int test_0_vectorize_int_ops () {
+		int[] a = new int [] { 1, 2, 3, 4, 5, 6, 7 };
+		int[] b = new int [] { 7, 6, 5, 4, 3, 2, 1 };
+		int[] c = new int [7];
+		for (int i = 0; i < c.Length; ++i)
+			c [i] = (a [i] ^ b [i]) - (a [i] & b [i]);
+		for (int i = 0; i < c.Length; ++i)
+			if (c [i] != (a [i] ^ b [i]) - (a [i] & b [i]))
+				return i + 1;
+		return 0;
+	}
+
+	public static int test_0_vectorize_float_mul () {
+		float[] a = new float [9];
+		float[] b = new float [9];
+		for (int i = 0; i < a.Length; ++i)
+			a [i] = i + 0.5f;
+		for (int i = 0; i < a.Length; ++i)
+			b [i] = a [i] * a [i];
+		for (int i = 0; i < b.Length; ++i)
+			if (b [i] != (i + 0.5f) * (i + 0.5f))
+				return i + 1;
+		return 0;
+	}
+
+	static void vectorize_add_one (int[] a, int[] b) {
+		for (int i = 0; i < a.Length; ++i)
+			b [i] = a [i] + 1;
+	}
+
+	public static int test_0_vectorize_copy_shorter_dest () {
+		int[] a = new int [10];
+		int[] b = new int [6];
+		try {
+			vectorize_add_one (a, b);
+		} catch (IndexOutOfRangeException) {
+			for (int i = 0; i < b.Length; ++i)
+				if (b [i] != 1)
+					return 2;
+			return 0;
+		}
+		return 1;
+	}
+
+	public static int test_0_vectorize_null () {
+		int[] a = new int [10];
+		try {
+			vectorize_add_one (a, null);
+		} catch (NullReferenceException) {
+			return 0;
+		}
+		return 1;
+	}
+
+	static int vectorize_double_from (int[] a, int start) {
+		int i;
+		for (i = start; i < a.Length; ++i)
+			a [i] = a [i] + a [i];
+		return i;
+	}
+
+	public static int test_0_vectorize_negative_start () {
+		int[] a = new int [10];
+		try {
+			vectorize_double_from (a, -2);
+		} catch (IndexOutOfRangeException) {
+			return 0;
+		}
+		return 1;
+	}
+
+	public static int test_13_vectorize_counter () {
+		int[] a = new int [13];
+		return vectorize_double_from (a, 1);
+	}
+
 	public static int long_indices () {
 		int[] arr = new int [10];
 		int[,] arr2 = new int [10, 10];
@@ -739,6 +862,39 @@ class Tests {
 			return 2;
 		return 0;
 	}
+
+	public static int test_0_array_index_of_primitive () {
+		byte[] b = new byte [37];
+		short[] s = new short [37];
+		char[] c = new char [37];
+		int[] i = new int [37];
+		uint[] u = new uint [37];
+
+		b [33] = 200;
+		s [20] = -1;
+		c [36] = 'x';
+		i [5] = -7;
+		u [17] = 0xffffffff;
+
+		if (Array.IndexOf (b, (byte)200) != 33 || Array.IndexOf (b, (byte)1) != -1)
+			return 1;
+		if (Array.IndexOf (s, (short)-1) != 20 || Array.IndexOf (s, (short)0xff) != -1)
+			return 2;
+		if (Array.IndexOf (c, 'x') != 36 || Array.IndexOf (c, 'y') != -1)
+			return 3;
+		if (Array.IndexOf (i, -7) != 5 || Array.IndexOf (i, 0) != 0)
+			return 4;
+		if (Array.IndexOf (u, 0xffffffff) != 17)
+			return 5;
+		if (Array.IndexOf (new int [0], 0) != -1)
+			return 6;
+		try {
+			Array.IndexOf ((int[])null, 0);
+			return 7;
+		} catch (ArgumentNullException) {
+		}
+		return 0;
+	}
 }
 
 
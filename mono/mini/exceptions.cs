@@ -2628,6 +2628,41 @@ class Tests {
 		return 1;
 	}
 
+	static void throw_from_here (int i) {
+		if (i % 2 == 0)
+			throw new ArgumentException ();
+		else
+			throw new InvalidOperationException ();
+	}
+
+	static int catch_repeatedly (int i) {
+		try {
+			try {
+				throw_from_here (i);
+			} catch (ArgumentException) {
+				return 1;
+			}
+		} catch (InvalidOperationException e) {
+			if (e.StackTrace.IndexOf ("throw_from_here") == -1)
+				return 100;
+			return 2;
+		}
+		return 0;
+	}
+
+	/* The same throw sites and handlers are reached with different exception types */
+	public static int test_0_repeated_throw_same_ip () {
+		int res = 0;
+
+		for (int i = 0; i < 100; ++i) {
+			int r = catch_repeatedly (i);
+			if (r != (i % 2 == 0 ? 1 : 2))
+				return r;
+			res += r;
+		}
+		return res == 150 ? 0 : 1;
+	}
+
 	unsafe struct Foo
 	{
 		public int i;
@@ -564,4 +564,35 @@ class Tests {
 		liveness_13_inner (ref arr);
 		return 0;
 	}
-}
\ No newline at end of file
+
+	class Pair {
+		public object o1, o2;
+
+		public Pair (object o1, object o2) {
+			this.o1 = o1;
+			this.o2 = o2;
+		}
+	}
+
+	// Stores into freshly allocated objects have no write barriers
+	public static int test_0_fresh_object_stores () {
+		Pair p = new Pair (new object (), "A");
+
+		GC.Collect (0);
+
+		// p is no longer fresh, this store needs a barrier
+		p.o1 = new Pair ("B", "C");
+		Pair p2 = new Pair (p, new Pair ("D", "E"));
+
+		GC.Collect (0);
+		GC.Collect (0);
+
+		if ((string)p.o2 != "A")
+			return 1;
+		if ((string)((Pair)p.o1).o1 != "B" || (string)((Pair)p.o1).o2 != "C")
+			return 2;
+		if (p2.o1 != p || (string)((Pair)p2.o2).o2 != "E")
+			return 3;
+		return 0;
+	}
+}
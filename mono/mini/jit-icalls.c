@@ -10,12 +10,18 @@
 #include <config.h>
 #include <math.h>
 #include <limits.h>
+#include <string.h>
 #ifdef HAVE_ALLOCA_H
 #include <alloca.h>
 #endif
 
 #include "jit-icalls.h"
 
+#if defined(__GNUC__) && defined(__SSE2__)
+#define HAVE_SSE2_STRING_INTRINSICS 1
+#include <emmintrin.h>
+#endif
+
 void*
 mono_ldftn (MonoMethod *method)
 {
@@ -1120,3 +1126,222 @@ mono_get_native_calli_wrapper (MonoImage *image, MonoMethodSignature *sig, gpoin
 
 	return mono_compile_method (m);
 }
+
+/*
+ * Vectorized kernels behind the String/Array intrinsics emitted by
+ * mini_emit_inst_for_method (). The implementation is selected once at
+ * startup by mono_string_intrinsics_init () based on the cpu features, so
+ * AOT code calling these icalls stays correct on any host.
+ */
+
+typedef int (*FindCharFunc) (const gunichar2 *s, int len, gunichar2 c);
+typedef int (*FindInt32Func) (const guint32 *s, int len, guint32 v);
+typedef int (*MismatchFunc) (const gunichar2 *a, const gunichar2 *b, int len);
+
+static int
+find_char_generic (const gunichar2 *s, int len, gunichar2 c)
+{
+	int i;
+
+	for (i = 0; i < len; ++i)
+		if (s [i] == c)
+			return i;
+	return -1;
+}
+
+static int
+find_int32_generic (const guint32 *s, int len, guint32 v)
+{
+	int i;
+
+	for (i = 0; i < len; ++i)
+		if (s [i] == v)
+			return i;
+	return -1;
+}
+
+/* Return the index of the first differing char, or LEN if there is none */
+static int
+mismatch_generic (const gunichar2 *a, const gunichar2 *b, int len)
+{
+	int i;
+
+	for (i = 0; i < len; ++i)
+		if (a [i] != b [i])
+			return i;
+	return len;
+}
+
+#ifdef HAVE_SSE2_STRING_INTRINSICS
+static int
+find_char_sse2 (const gunichar2 *s, int len, gunichar2 c)
+{
+	__m128i needle = _mm_set1_epi16 ((short)c);
+	int i, mask;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		mask = _mm_movemask_epi8 (_mm_cmpeq_epi16 (_mm_loadu_si128 ((const __m128i*)(s + i)), needle));
+		if (mask)
+			return i + (__builtin_ctz (mask) >> 1);
+	}
+	for (; i < len; ++i)
+		if (s [i] == c)
+			return i;
+	return -1;
+}
+
+static int
+find_int32_sse2 (const guint32 *s, int len, guint32 v)
+{
+	__m128i needle = _mm_set1_epi32 ((int)v);
+	int i, mask;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		mask = _mm_movemask_epi8 (_mm_cmpeq_epi32 (_mm_loadu_si128 ((const __m128i*)(s + i)), needle));
+		if (mask)
+			return i + (__builtin_ctz (mask) >> 2);
+	}
+	for (; i < len; ++i)
+		if (s [i] == v)
+			return i;
+	return -1;
+}
+
+static int
+mismatch_sse2 (const gunichar2 *a, const gunichar2 *b, int len)
+{
+	int i, mask;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		__m128i va = _mm_loadu_si128 ((const __m128i*)(a + i));
+		__m128i vb = _mm_loadu_si128 ((const __m128i*)(b + i));
+
+		mask = _mm_movemask_epi8 (_mm_cmpeq_epi16 (va, vb));
+		if (mask != 0xffff)
+			return i + (__builtin_ctz (~mask) >> 1);
+	}
+	for (; i < len; ++i)
+		if (a [i] != b [i])
+			return i;
+	return len;
+}
+#endif
+
+static FindCharFunc find_char = find_char_generic;
+static FindInt32Func find_int32 = find_int32_generic;
+static MismatchFunc mismatch = mismatch_generic;
+static gboolean string_intrinsics_vectorized;
+
+void
+mono_string_intrinsics_init (void)
+{
+#if defined(HAVE_SSE2_STRING_INTRINSICS) && defined(MONO_ARCH_SIMD_INTRINSICS)
+	if (mono_arch_cpu_enumerate_simd_versions () & SIMD_VERSION_SSE2) {
+		find_char = find_char_sse2;
+		find_int32 = find_int32_sse2;
+		mismatch = mismatch_sse2;
+		string_intrinsics_vectorized = TRUE;
+	}
+#endif
+}
+
+/*
+ * mono_string_intrinsics_enabled:
+ *
+ *   Return whenever the helpers below are faster than the managed code they
+ * replace, i.e. whenever a vectorized implementation was selected.
+ */
+gboolean
+mono_string_intrinsics_enabled (void)
+{
+	return string_intrinsics_vectorized;
+}
+
+/* Replacement for String.IndexOfUnchecked (char, int, int) */
+gint32
+mono_string_index_of_char (MonoString *str, gint32 c, gint32 start, gint32 count)
+{
+	int res;
+
+	res = find_char (mono_string_chars (str) + start, count, (gunichar2)c);
+	return res == -1 ? -1 : start + res;
+}
+
+/* Replacement for the static String.Equals (string, string) */
+gint32
+mono_string_equal_ordinal (MonoString *a, MonoString *b)
+{
+	int len;
+
+	if (a == b)
+		return TRUE;
+	if (!a || !b)
+		return FALSE;
+	len = mono_string_length (a);
+	if (len != mono_string_length (b))
+		return FALSE;
+	return mismatch (mono_string_chars (a), mono_string_chars (b), len) == len;
+}
+
+/* Replacement for String.CompareOrdinalUnchecked () */
+gint32
+mono_string_compare_ordinal (MonoString *a, gint32 index_a, gint32 len_a, MonoString *b, gint32 index_b, gint32 len_b)
+{
+	const gunichar2 *ap, *bp;
+	int len, i;
+
+	if (!a)
+		return b ? -1 : 0;
+	if (!b)
+		return 1;
+	len_a = MIN (len_a, mono_string_length (a) - index_a);
+	len_b = MIN (len_b, mono_string_length (b) - index_b);
+	if (len_a == len_b && a == b)
+		return 0;
+
+	ap = mono_string_chars (a) + index_a;
+	bp = mono_string_chars (b) + index_b;
+	len = MIN (len_a, len_b);
+	i = mismatch (ap, bp, len);
+	if (i < len)
+		return (int)ap [i] - (int)bp [i];
+	return len_a - len_b;
+}
+
+/*
+ * Replacements for Array.IndexOf<T> (T[], T) when T is an integral type of
+ * the given size.
+ */
+gint32
+mono_array_index_of_1 (MonoArray *arr, gint32 value)
+{
+	guint8 *start, *p;
+
+	MONO_ARCH_SAVE_REGS;
+
+	if (!arr)
+		mono_raise_exception (mono_get_exception_argument_null ("array"));
+	start = (guint8*)mono_array_addr (arr, guint8, 0);
+	p = memchr (start, (guint8)value, mono_array_length (arr));
+	return p ? (int)(p - start) : -1;
+}
+
+gint32
+mono_array_index_of_2 (MonoArray *arr, gint32 value)
+{
+	MONO_ARCH_SAVE_REGS;
+
+	if (!arr)
+		mono_raise_exception (mono_get_exception_argument_null ("array"));
+	return find_char ((gunichar2*)mono_array_addr (arr, gunichar2, 0), mono_array_length (arr), (gunichar2)value);
+}
+
+gint32
+mono_array_index_of_4 (MonoArray *arr, gint32 value)
+{
+	MONO_ARCH_SAVE_REGS;
+
+	if (!arr)
+		mono_raise_exception (mono_get_exception_argument_null ("array"));
+	return find_int32 ((guint32*)mono_array_addr (arr, guint32, 0), mono_array_length (arr), (guint32)value);
+}
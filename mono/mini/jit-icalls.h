@@ -173,5 +173,21 @@ mono_object_isinst_with_cache (MonoObject *obj, MonoClass *klass, gpointer *cach
 MonoObject*
 mono_object_castclass_with_cache (MonoObject *obj, MonoClass *klass, gpointer *cache);
 
+void mono_string_intrinsics_init (void) MONO_INTERNAL;
+
+gboolean mono_string_intrinsics_enabled (void) MONO_INTERNAL;
+
+gint32 mono_string_index_of_char (MonoString *str, gint32 c, gint32 start, gint32 count) MONO_INTERNAL;
+
+gint32 mono_string_equal_ordinal (MonoString *a, MonoString *b) MONO_INTERNAL;
+
+gint32 mono_string_compare_ordinal (MonoString *a, gint32 index_a, gint32 len_a, MonoString *b, gint32 index_b, gint32 len_b) MONO_INTERNAL;
+
+gint32 mono_array_index_of_1 (MonoArray *arr, gint32 value) MONO_INTERNAL;
+
+gint32 mono_array_index_of_2 (MonoArray *arr, gint32 value) MONO_INTERNAL;
+
+gint32 mono_array_index_of_4 (MonoArray *arr, gint32 value) MONO_INTERNAL;
+
 #endif /* __MONO_JIT_ICALLS_H__ */
 
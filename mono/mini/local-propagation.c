@@ -21,6 +21,7 @@
 #include <mono/metadata/debug-helpers.h>
 #include <mono/metadata/mempool.h>
 #include <mono/metadata/opcodes.h>
+#include <mono/metadata/gc-internal.h>
 #include "mini.h"
 #include "ir-emit.h"
 
@@ -586,3 +587,115 @@ mono_local_deadce (MonoCompile *cfg)
 
 	//mono_print_code (cfg, "AFTER LOCAL-DEADCE");
 }
+
+#define MAX_FRESH_VREGS 16
+
+static inline int
+fresh_vreg_index (int *fresh, int nfresh, int vreg)
+{
+	int i;
+
+	for (i = 0; i < nfresh; ++i)
+		if (fresh [i] == vreg)
+			return i;
+	return -1;
+}
+
+/*
+ * Whenever INS might call into the runtime, which could allocate objects outside
+ * the nursery, or run arbitrary code.
+ */
+static inline gboolean
+ins_might_call (MonoInst *ins)
+{
+	if (MONO_IS_CALL (ins))
+		return TRUE;
+	switch (ins->opcode) {
+	case OP_NEWARR:
+	case OP_LDELEMA2D:
+	case OP_THROW:
+	case OP_RETHROW:
+	case OP_CALL_HANDLER:
+	case OP_SEQ_POINT:
+	case OP_BREAK:
+		return TRUE;
+	default:
+		return mono_find_jit_opcode_emulation (ins->opcode) != NULL;
+	}
+}
+
+/*
+ * mono_elide_fresh_object_barriers:
+ *
+ *   Remove the card table write barriers of stores into objects which were allocated
+ * earlier in the same bblock, with no calls in between. These objects are in the
+ * nursery, or the GC has already marked their cards (see mark_fresh_old_object () in
+ * sgen-gc.c), so the stores don't need to be recorded.
+ */
+void
+mono_elide_fresh_object_barriers (MonoCompile *cfg)
+{
+	MonoBasicBlock *bb;
+	MonoInst *ins, *var;
+	int fresh [MAX_FRESH_VREGS];
+	int nfresh, idx, nelided = 0;
+
+	if (!cfg->gen_write_barriers)
+		return;
+	/* With precise stack marking, objects referenced only from registers might be moved out of the nursery */
+	if (mono_gc_precise_stack_mark_enabled ())
+		return;
+
+	for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
+		nfresh = 0;
+
+		MONO_BB_FOR_EACH_INS (bb, ins) {
+			const char *spec = INS_INFO (ins->opcode);
+
+			if (ins->opcode == OP_CARD_TABLE_WBARRIER) {
+				if (fresh_vreg_index (fresh, nfresh, ins->sreg1) != -1) {
+					if (cfg->verbose_level > 2) {
+						printf ("WBARRIER: eliding barrier for store into fresh object: ");
+						mono_print_ins (ins);
+					}
+					NULLIFY_INS (ins);
+					nelided ++;
+				}
+				continue;
+			}
+
+			if (ins_might_call (ins)) {
+				nfresh = 0;
+				if (MONO_IS_CALL (ins) && ((MonoCallInst*)ins)->alloc_obj && ins->dreg != -1)
+					fresh [nfresh ++] = ins->dreg;
+				continue;
+			}
+
+			if (spec [MONO_INST_DEST] == ' ' || MONO_IS_STORE_MEMBASE (ins))
+				continue;
+
+			/* The dreg is redefined */
+			idx = fresh_vreg_index (fresh, nfresh, ins->dreg);
+			if (idx != -1)
+				fresh [idx] = fresh [-- nfresh];
+
+			switch (ins->opcode) {
+			case OP_MOVE:
+			case OP_PADD_IMM:
+			case OP_ADD_IMM:
+				/* Copies of the object and pointers into it */
+				if (fresh_vreg_index (fresh, nfresh, ins->sreg1) == -1 || nfresh == MAX_FRESH_VREGS)
+					break;
+				var = get_vreg_to_inst (cfg, ins->dreg);
+				if (var && (var->flags & (MONO_INST_VOLATILE|MONO_INST_INDIRECT)))
+					break;
+				fresh [nfresh ++] = ins->dreg;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	mono_jit_stats.write_barriers_elided += nelided;
+}
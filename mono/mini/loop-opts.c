@@ -0,0 +1,845 @@
+/*
+ * loop-opts.c: Loop optimizations for the JIT
+ */
+
+#include "mini.h"
+#include "ir-emit.h"
+
+#ifndef DISABLE_JIT
+
+/*
+ * Instructions whose result only depends on their source registers, so they can be
+ * moved out of a loop if their sources are not modified inside the loop.
+ * They can still fault, so they are only moved if they are executed each time the
+ * loop is entered, and nothing observable happens before them.
+ */
+static inline gboolean
+is_hoistable_opcode (MonoInst *ins)
+{
+	switch (ins->opcode) {
+	case OP_LDLEN:
+	case OP_STRLEN:
+	case OP_BOUNDS_CHECK:
+	case OP_CHECK_THIS:
+		return TRUE;
+	default:
+		return MONO_IS_LOAD_MEMBASE (ins) && (ins->flags & MONO_INST_CONSTANT_LOAD);
+	}
+}
+
+/*
+ * get_loop_preheader:
+ *
+ *   Return the bblock through which all entries into the loop headed by H pass, and
+ * which branches only to H, or NULL if there is no such bblock.
+ */
+static MonoBasicBlock*
+get_loop_preheader (MonoBasicBlock *h)
+{
+	MonoBasicBlock *idom = h->idom;
+
+	if (!idom || idom == h)
+		return NULL;
+	if (idom->out_count != 1 || idom->out_bb [0] != h)
+		return NULL;
+	if (g_list_find (h->loop_blocks, idom))
+		return NULL;
+	if (idom->region != h->region || idom->extended)
+		return NULL;
+	if (idom->last_ins && MONO_IS_BRANCH_OP (idom->last_ins) && idom->last_ins->opcode != OP_BR)
+		return NULL;
+	return idom;
+}
+
+/*
+ * get_next_loop_bblock:
+ *
+ *   Return the bblock of the loop headed by H which is always executed right after BB,
+ * and can only be entered from BB, or NULL if there is no such bblock.
+ */
+static MonoBasicBlock*
+get_next_loop_bblock (MonoBasicBlock *h, MonoBasicBlock *bb)
+{
+	MonoBasicBlock *next;
+
+	if (bb->out_count != 1)
+		return NULL;
+	if (bb->last_ins && MONO_IS_BRANCH_OP (bb->last_ins) && bb->last_ins->opcode != OP_BR)
+		return NULL;
+	next = bb->out_bb [0];
+	if (next == h || next->in_count != 1 || !g_list_find (h->loop_blocks, next))
+		return NULL;
+	if (next->region != h->region || next->extended || (next->flags & BB_EXCEPTION_HANDLER))
+		return NULL;
+	return next;
+}
+
+static gboolean
+is_loop_invariant_sreg (MonoCompile *cfg, int sreg, MonoBitSet *defined, MonoBitSet *hoisted)
+{
+	MonoInst *var;
+
+	if (sreg == -1)
+		return TRUE;
+
+	var = get_vreg_to_inst (cfg, sreg);
+	if (!var)
+		/* Local vregs are only live inside their bblock, so their def must have been moved too */
+		return mono_bitset_test_fast (hoisted, sreg);
+
+	if (var->flags & (MONO_INST_VOLATILE|MONO_INST_INDIRECT))
+		return FALSE;
+	return !mono_bitset_test_fast (defined, sreg);
+}
+
+/*
+ * hoist_loop_invariants:
+ *
+ *   Move loop invariant instructions into PREHEADER from the beginning of the header H,
+ * and from the bblocks which are executed on every iteration before anything with side
+ * effects, i.e. the chain of bblocks starting at H where each one falls through or
+ * branches unconditionally to the next one. The scan stops at the first instruction
+ * with side effects, so moving faulting instructions doesn't change which exception is
+ * thrown, or whether one is thrown at all.
+ * Return the number of instructions moved.
+ */
+static int
+hoist_loop_invariants (MonoCompile *cfg, MonoBasicBlock *h, MonoBasicBlock *preheader)
+{
+	MonoBitSet *defined, *multi_defined, *hoisted;
+	MonoBasicBlock *bb;
+	MonoInst *ins, *n, *branch;
+	GList *l;
+	gboolean stop = FALSE;
+	int size, i, nhoisted = 0;
+
+	size = mono_bitset_alloc_size (cfg->next_vreg, 0);
+	defined = mono_bitset_mem_new (mono_mempool_alloc0 (cfg->mempool, size), cfg->next_vreg, 0);
+	multi_defined = mono_bitset_mem_new (mono_mempool_alloc0 (cfg->mempool, size), cfg->next_vreg, 0);
+	hoisted = mono_bitset_mem_new (mono_mempool_alloc0 (cfg->mempool, size), cfg->next_vreg, 0);
+
+	/* Collect the vregs written inside the loop */
+	for (l = h->loop_blocks; l; l = l->next) {
+		bb = l->data;
+
+		MONO_BB_FOR_EACH_INS (bb, ins) {
+			const char *spec = INS_INFO (ins->opcode);
+
+			if (spec [MONO_INST_DEST] == ' ' || MONO_IS_STORE_MEMBASE (ins) || ins->dreg == -1)
+				continue;
+			if (mono_bitset_test_fast (defined, ins->dreg))
+				mono_bitset_set_fast (multi_defined, ins->dreg);
+			mono_bitset_set_fast (defined, ins->dreg);
+		}
+	}
+
+	branch = preheader->last_ins && preheader->last_ins->opcode == OP_BR ? preheader->last_ins : NULL;
+
+	for (bb = h; bb && !stop; bb = get_next_loop_bblock (h, bb)) {
+		MONO_BB_FOR_EACH_INS_SAFE (bb, n, ins) {
+			const char *spec = INS_INFO (ins->opcode);
+			int num_sregs, sregs [MONO_MAX_SRC_REGS];
+			gboolean invariant = FALSE;
+
+			if (is_hoistable_opcode (ins)) {
+				invariant = TRUE;
+				/* Only local vregs with a single def, vars might be read before this def */
+				if (spec [MONO_INST_DEST] != ' ' && (get_vreg_to_inst (cfg, ins->dreg) || mono_bitset_test_fast (multi_defined, ins->dreg)))
+					invariant = FALSE;
+				num_sregs = mono_inst_get_src_registers (ins, sregs);
+				for (i = 0; i < num_sregs && invariant; ++i)
+					if (!is_loop_invariant_sreg (cfg, sregs [i], defined, hoisted))
+						invariant = FALSE;
+			}
+
+			if (!invariant) {
+				/* The branch to the next bblock is checked by get_next_loop_bblock () */
+				if (ins == bb->last_ins && ins->opcode == OP_BR)
+					continue;
+				/* Can't move faulting instructions across instructions with side effects */
+				if (!MONO_INS_HAS_NO_SIDE_EFFECT (ins) && ins->opcode != OP_NOP) {
+					stop = TRUE;
+					break;
+				}
+				continue;
+			}
+
+			if (cfg->verbose_level > 2) {
+				printf ("LICM: moving from BB%d to BB%d: ", bb->block_num, preheader->block_num);
+				mono_print_ins (ins);
+			}
+
+			MONO_REMOVE_INS (bb, ins);
+			ins->prev = ins->next = NULL;
+			if (branch)
+				mono_bblock_insert_before_ins (preheader, branch, ins);
+			else
+				mono_bblock_insert_after_ins (preheader, preheader->last_ins, ins);
+
+			if (spec [MONO_INST_DEST] != ' ')
+				mono_bitset_set_fast (hoisted, ins->dreg);
+			if (ins->opcode == OP_LDLEN || ins->opcode == OP_STRLEN || ins->opcode == OP_BOUNDS_CHECK)
+				preheader->has_array_access = TRUE;
+			nhoisted ++;
+		}
+	}
+
+	return nhoisted;
+}
+
+/*
+ * mono_loop_invariant_code_motion:
+ *
+ *   Move loop invariant array length, string length, bounds check and constant loads
+ * out of loop headers, and the loop bblocks which are always executed after them, into
+ * the loop preheaders, so they are executed once per loop entry instead of once per
+ * iteration.
+ * Requires the loop information computed by mono_compute_natural_loops ().
+ */
+void
+mono_loop_invariant_code_motion (MonoCompile *cfg)
+{
+	MonoBasicBlock *h, *preheader;
+	int i, nhoisted = 0;
+
+	g_assert (cfg->comp_done & MONO_COMP_LOOPS);
+
+	/* Moving code would confuse the debugger */
+	if (cfg->gen_seq_points)
+		return;
+
+	for (i = 0; i < cfg->num_bblocks; ++i) {
+		h = cfg->bblocks [i];
+
+		if (!h->loop_blocks || h->extended || (h->flags & BB_EXCEPTION_HANDLER))
+			continue;
+
+		preheader = get_loop_preheader (h);
+		if (!preheader)
+			continue;
+
+		nhoisted += hoist_loop_invariants (cfg, h, preheader);
+	}
+
+	if (nhoisted) {
+		mono_jit_stats.loop_invariants_hoisted += nhoisted;
+		/* The dregs of the moved instructions are now used in more than one bblock */
+		mono_handle_global_vregs (cfg);
+	}
+}
+
+#ifdef MONO_ARCH_SIMD_INTRINSICS
+
+/*
+ * Loop vectorization.
+ *
+ * We handle counted loops of the form:
+ *
+ *   for (; i < limit; ++i)
+ *       c [i] = a [i] OP b [i];
+ *
+ * over int[]/uint[]/float[] arrays, where every array is indexed by the loop counter,
+ * so there are no dependencies between iterations. The loop is preceeded by a vector
+ * loop which processes 4 elements per iteration, and is only entered if none of the
+ * arrays is null and all of them are long enough for the whole iteration space. The
+ * original scalar loop handles the remaining elements, and runs the whole iteration
+ * space if the checks fail, so exceptions are thrown at the same place as before.
+ */
+
+#define VECTORIZE_MAX_ARRAYS 4
+
+enum {
+	VEC_NONE,
+	/* The loop counter, possibly sign extended */
+	VEC_INDEX,
+	/* The loop counter plus one */
+	VEC_INC,
+	/* An array object read from a loop invariant variable */
+	VEC_ARRAY,
+	/* The address of the array element at the loop counter */
+	VEC_ADDR,
+	/* An int32 value computed from array elements */
+	VEC_INT,
+	/* A float32 array element, widened to double */
+	VEC_FLOAT,
+	/* The result of one arithmetic operation on two VEC_FLOAT values */
+	VEC_FLOAT_OP
+};
+
+typedef struct {
+	MonoCompile *cfg;
+	MonoBasicBlock *preheader, *header, *body, *exit;
+	MonoInst *ivar, *limit_var;
+	int limit_imm;
+	int nvregs;
+	/* Indexed by vreg */
+	guint8 *kinds;
+	guint8 *etypes;
+	int *srcs;
+	int narrays;
+	int arrays [VECTORIZE_MAX_ARRAYS];
+} VectorizeCtx;
+
+static int
+vec_get_kind (VectorizeCtx *ctx, int vreg)
+{
+	MonoInst *var;
+
+	if (vreg < 0 || vreg >= ctx->nvregs)
+		return VEC_NONE;
+
+	var = get_vreg_to_inst (ctx->cfg, vreg);
+	if (!var)
+		return ctx->kinds [vreg];
+	if (var->flags & (MONO_INST_VOLATILE|MONO_INST_INDIRECT))
+		return VEC_NONE;
+	if (var == ctx->ivar)
+		return VEC_INDEX;
+	if (var->type == STACK_OBJ)
+		return VEC_ARRAY;
+	return VEC_NONE;
+}
+
+/* Return the array variable VREG refers to */
+static int
+vec_get_array (VectorizeCtx *ctx, int vreg)
+{
+	return get_vreg_to_inst (ctx->cfg, vreg) ? vreg : ctx->srcs [vreg];
+}
+
+static gboolean
+vec_set_kind (VectorizeCtx *ctx, int dreg, int kind, int etype, int src)
+{
+	if (dreg < 0 || dreg >= ctx->nvregs || get_vreg_to_inst (ctx->cfg, dreg) || ctx->kinds [dreg] != VEC_NONE)
+		return FALSE;
+	ctx->kinds [dreg] = kind;
+	ctx->etypes [dreg] = etype;
+	ctx->srcs [dreg] = src;
+	return TRUE;
+}
+
+static gboolean
+vec_is_int_elem (int etype)
+{
+	return etype == MONO_TYPE_I4 || etype == MONO_TYPE_U4;
+}
+
+static int
+vec_simd_opcode (int opcode)
+{
+	switch (opcode) {
+	case OP_IADD: return OP_PADDD;
+	case OP_ISUB: return OP_PSUBD;
+	case OP_IAND: return OP_PAND;
+	case OP_IOR: return OP_POR;
+	case OP_IXOR: return OP_PXOR;
+	case OP_FADD: return OP_ADDPS;
+	case OP_FSUB: return OP_SUBPS;
+	case OP_FMUL: return OP_MULPS;
+	default: return -1;
+	}
+}
+
+static gboolean
+vec_is_check_compare (VectorizeCtx *ctx, MonoInst *ins)
+{
+	switch (ins->opcode) {
+	case OP_COMPARE_IMM:
+	case OP_ICOMPARE_IMM:
+		/* Explicit null check */
+		return ins->inst_imm == 0 && vec_get_kind (ctx, ins->sreg1) == VEC_ARRAY;
+#ifdef TARGET_AMD64
+	case OP_AMD64_ICOMPARE_MEMBASE_REG:
+#endif
+#ifdef TARGET_X86
+	case OP_X86_COMPARE_MEMBASE_REG:
+#endif
+		/* Bounds check */
+		return ins->inst_offset == G_STRUCT_OFFSET (MonoArray, max_length) &&
+			vec_get_kind (ctx, ins->inst_basereg) == VEC_ARRAY && vec_get_kind (ctx, ins->sreg2) == VEC_INDEX;
+	default:
+		return FALSE;
+	}
+}
+
+/*
+ * vectorize_analyze_header:
+ *
+ *   Check that the loop header only compares the loop counter with a loop invariant
+ * limit, and find the loop counter and the limit.
+ */
+static gboolean
+vectorize_analyze_header (VectorizeCtx *ctx)
+{
+	MonoCompile *cfg = ctx->cfg;
+	MonoBasicBlock *h = ctx->header;
+	MonoInst *ins, *cmp = NULL, *var;
+	int sreg1, sreg2;
+
+	MONO_BB_FOR_EACH_INS (h, ins) {
+		if (ins->opcode == OP_NOP)
+			continue;
+		if (ins->opcode == OP_MOVE || ins->opcode == OP_ICONV_TO_I4) {
+			/* Use srcs as an alias map */
+			if (!vec_set_kind (ctx, ins->dreg, VEC_NONE, 0, -1))
+				return FALSE;
+			ctx->srcs [ins->dreg] = (ins->sreg1 < ctx->nvregs && ctx->srcs [ins->sreg1] != -1) ? ctx->srcs [ins->sreg1] : ins->sreg1;
+			continue;
+		}
+		if ((ins->opcode == OP_ICOMPARE || ins->opcode == OP_ICOMPARE_IMM) && !cmp && ins->next && ins->next == h->last_ins) {
+			cmp = ins;
+			continue;
+		}
+		if (ins == h->last_ins && cmp && ins->opcode == OP_IBLT)
+			continue;
+		return FALSE;
+	}
+	if (!cmp || h->last_ins->inst_true_bb != ctx->body)
+		return FALSE;
+
+	sreg1 = (cmp->sreg1 < ctx->nvregs && ctx->srcs [cmp->sreg1] != -1) ? ctx->srcs [cmp->sreg1] : cmp->sreg1;
+	ctx->ivar = get_vreg_to_inst (cfg, sreg1);
+	if (!ctx->ivar || ctx->ivar->type != STACK_I4 || (ctx->ivar->flags & (MONO_INST_VOLATILE|MONO_INST_INDIRECT)))
+		return FALSE;
+
+	if (cmp->opcode == OP_ICOMPARE_IMM) {
+		/* Too short to be worth it */
+		if (cmp->inst_imm < 4)
+			return FALSE;
+		ctx->limit_imm = cmp->inst_imm;
+	} else {
+		sreg2 = (cmp->sreg2 < ctx->nvregs && ctx->srcs [cmp->sreg2] != -1) ? ctx->srcs [cmp->sreg2] : cmp->sreg2;
+		var = get_vreg_to_inst (cfg, sreg2);
+		if (!var || var == ctx->ivar || var->type != STACK_I4 || (var->flags & (MONO_INST_VOLATILE|MONO_INST_INDIRECT)))
+			return FALSE;
+		ctx->limit_var = var;
+	}
+
+	/* The aliases are local to the header */
+	memset (ctx->srcs, 0xff, sizeof (int) * ctx->nvregs);
+	memset (ctx->kinds, 0, ctx->nvregs);
+	return TRUE;
+}
+
+/*
+ * vectorize_analyze_body:
+ *
+ *   Check that the loop body only consists of elementwise operations on arrays
+ * indexed by the loop counter, followed by the increment of the loop counter.
+ */
+static gboolean
+vectorize_analyze_body (VectorizeCtx *ctx)
+{
+	MonoBasicBlock *b = ctx->body;
+	MonoInst *ins;
+	gboolean in_check = FALSE, seen_inc = FALSE;
+	int i, kind, kind1, kind2, nstores = 0;
+
+	MONO_BB_FOR_EACH_INS (b, ins) {
+		if (ins->opcode == OP_NOP)
+			continue;
+		if (seen_inc && !(ins->opcode == OP_BR && ins == b->last_ins))
+			return FALSE;
+		if (in_check) {
+			if (!MONO_IS_COND_EXC (ins))
+				return FALSE;
+			in_check = FALSE;
+			continue;
+		}
+		if (vec_is_check_compare (ctx, ins)) {
+			in_check = TRUE;
+			continue;
+		}
+
+		switch (ins->opcode) {
+		case OP_NOT_NULL:
+			if (vec_get_kind (ctx, ins->sreg1) != VEC_ARRAY)
+				return FALSE;
+			break;
+		case OP_MOVE:
+		case OP_ICONV_TO_I4:
+		case OP_FMOVE:
+			kind = vec_get_kind (ctx, ins->sreg1);
+			if (ins->dreg == ctx->ivar->dreg) {
+				if (kind != VEC_INC)
+					return FALSE;
+				seen_inc = TRUE;
+				break;
+			}
+			if (kind == VEC_NONE)
+				return FALSE;
+			if (kind == VEC_ARRAY) {
+				if (!vec_set_kind (ctx, ins->dreg, kind, 0, vec_get_array (ctx, ins->sreg1)))
+					return FALSE;
+			} else {
+				if (!vec_set_kind (ctx, ins->dreg, kind, ctx->etypes [ins->sreg1], ctx->srcs [ins->sreg1]))
+					return FALSE;
+			}
+			break;
+		case OP_SEXT_I4:
+			if (vec_get_kind (ctx, ins->sreg1) != VEC_INDEX || !vec_set_kind (ctx, ins->dreg, VEC_INDEX, 0, -1))
+				return FALSE;
+			break;
+		case OP_IADD_IMM:
+			if (vec_get_kind (ctx, ins->sreg1) != VEC_INDEX || ins->inst_imm != 1)
+				return FALSE;
+			if (ins->dreg == ctx->ivar->dreg)
+				seen_inc = TRUE;
+			else if (!vec_set_kind (ctx, ins->dreg, VEC_INC, 0, -1))
+				return FALSE;
+			break;
+		case OP_X86_LEA: {
+			int array, etype;
+
+			if (vec_get_kind (ctx, ins->sreg1) != VEC_ARRAY || vec_get_kind (ctx, ins->sreg2) != VEC_INDEX)
+				return FALSE;
+			if (ins->inst_imm != G_STRUCT_OFFSET (MonoArray, vector) || ins->backend.shift_amount != 2 || !ins->klass)
+				return FALSE;
+			etype = ins->klass->byval_arg.type;
+			if (!vec_is_int_elem (etype) && etype != MONO_TYPE_R4)
+				return FALSE;
+			array = vec_get_array (ctx, ins->sreg1);
+			for (i = 0; i < ctx->narrays; ++i)
+				if (ctx->arrays [i] == array)
+					break;
+			if (i == ctx->narrays) {
+				if (ctx->narrays == VECTORIZE_MAX_ARRAYS)
+					return FALSE;
+				ctx->arrays [ctx->narrays ++] = array;
+			}
+			if (!vec_set_kind (ctx, ins->dreg, VEC_ADDR, etype, array))
+				return FALSE;
+			break;
+		}
+		case OP_LOADI4_MEMBASE:
+		case OP_LOADU4_MEMBASE:
+		case OP_LOADR4_MEMBASE:
+			if (vec_get_kind (ctx, ins->inst_basereg) != VEC_ADDR || ins->inst_offset != 0)
+				return FALSE;
+			if (ins->opcode == OP_LOADR4_MEMBASE) {
+				if (ctx->etypes [ins->inst_basereg] != MONO_TYPE_R4 || !vec_set_kind (ctx, ins->dreg, VEC_FLOAT, MONO_TYPE_R4, -1))
+					return FALSE;
+			} else {
+				if (!vec_is_int_elem (ctx->etypes [ins->inst_basereg]) || !vec_set_kind (ctx, ins->dreg, VEC_INT, MONO_TYPE_I4, -1))
+					return FALSE;
+			}
+			break;
+		case OP_IADD:
+		case OP_ISUB:
+		case OP_IAND:
+		case OP_IOR:
+		case OP_IXOR:
+			kind1 = vec_get_kind (ctx, ins->sreg1);
+			kind2 = vec_get_kind (ctx, ins->sreg2);
+			if (kind1 != VEC_INT || kind2 != VEC_INT || !vec_set_kind (ctx, ins->dreg, VEC_INT, MONO_TYPE_I4, -1))
+				return FALSE;
+			break;
+		case OP_FADD:
+		case OP_FSUB:
+		case OP_FMUL:
+			/*
+			 * Only one operation is allowed, since the result of a single double operation
+			 * rounded to float is the same as the result of the float operation.
+			 */
+			kind1 = vec_get_kind (ctx, ins->sreg1);
+			kind2 = vec_get_kind (ctx, ins->sreg2);
+			if (kind1 != VEC_FLOAT || kind2 != VEC_FLOAT || !vec_set_kind (ctx, ins->dreg, VEC_FLOAT_OP, MONO_TYPE_R4, -1))
+				return FALSE;
+			break;
+		case OP_STOREI4_MEMBASE_REG:
+		case OP_STORER4_MEMBASE_REG:
+			if (vec_get_kind (ctx, ins->inst_destbasereg) != VEC_ADDR || ins->inst_offset != 0)
+				return FALSE;
+			kind = vec_get_kind (ctx, ins->sreg1);
+			if (ins->opcode == OP_STORER4_MEMBASE_REG) {
+				if (ctx->etypes [ins->inst_destbasereg] != MONO_TYPE_R4 || (kind != VEC_FLOAT && kind != VEC_FLOAT_OP))
+					return FALSE;
+			} else {
+				if (!vec_is_int_elem (ctx->etypes [ins->inst_destbasereg]) || kind != VEC_INT)
+					return FALSE;
+			}
+			nstores ++;
+			break;
+		case OP_BR:
+			if (ins != b->last_ins || ins->inst_target_bb != ctx->header)
+				return FALSE;
+			break;
+		default:
+			return FALSE;
+		}
+	}
+
+	return !in_check && seen_inc && nstores == 1 && ctx->narrays > 0;
+}
+
+static MonoBasicBlock*
+vectorize_new_bblock (VectorizeCtx *ctx, MonoBasicBlock *prev)
+{
+	MonoCompile *cfg = ctx->cfg;
+	MonoBasicBlock *bb;
+
+	bb = mono_mempool_alloc0 (cfg->mempool, sizeof (MonoBasicBlock));
+	bb->block_num = cfg->max_block_num ++;
+	bb->region = ctx->header->region;
+	bb->real_offset = ctx->header->real_offset;
+	bb->next_bb = prev->next_bb;
+	prev->next_bb = bb;
+	return bb;
+}
+
+static void
+vectorize_emit_branch (MonoCompile *cfg, MonoBasicBlock *bb, int opcode, MonoBasicBlock *true_bb, MonoBasicBlock *false_bb)
+{
+	MonoInst *ins;
+
+	MONO_INST_NEW (cfg, ins, opcode);
+	if (opcode == OP_BR) {
+		ins->inst_target_bb = true_bb;
+	} else {
+		ins->inst_true_bb = true_bb;
+		ins->inst_false_bb = false_bb;
+		mono_link_bblock (cfg, bb, false_bb);
+	}
+	mono_link_bblock (cfg, bb, true_bb);
+	MONO_ADD_INS (bb, ins);
+}
+
+/*
+ * vectorize_emit_vector_body:
+ *
+ *   Emit the instructions of the loop body into VB, with each array access
+ * replaced by an access to 4 consecutive elements.
+ */
+static void
+vectorize_emit_vector_body (VectorizeCtx *ctx, MonoBasicBlock *vb)
+{
+	MonoCompile *cfg = ctx->cfg;
+	MonoInst *ins, *new_ins;
+	int *map;
+
+	map = mono_mempool_alloc0 (cfg->mempool, sizeof (int) * ctx->nvregs);
+#define MAP_VREG(vreg) (get_vreg_to_inst (cfg, (vreg)) ? (vreg) : map [(vreg)])
+
+	cfg->cbb = vb;
+	MONO_BB_FOR_EACH_INS (ctx->body, ins) {
+		switch (ins->opcode) {
+		case OP_MOVE:
+		case OP_ICONV_TO_I4:
+		case OP_FMOVE:
+			if (ins->dreg != ctx->ivar->dreg)
+				map [ins->dreg] = MAP_VREG (ins->sreg1);
+			break;
+		case OP_SEXT_I4:
+			map [ins->dreg] = alloc_preg (cfg);
+			MONO_EMIT_NEW_UNALU (cfg, OP_SEXT_I4, map [ins->dreg], MAP_VREG (ins->sreg1));
+			break;
+		case OP_X86_LEA:
+			MONO_INST_NEW (cfg, new_ins, OP_X86_LEA);
+			new_ins->dreg = map [ins->dreg] = alloc_ireg_mp (cfg);
+			new_ins->sreg1 = ctx->srcs [ins->dreg];
+			new_ins->sreg2 = MAP_VREG (ins->sreg2);
+			new_ins->inst_imm = ins->inst_imm;
+			new_ins->backend.shift_amount = ins->backend.shift_amount;
+			new_ins->klass = ins->klass;
+			new_ins->type = STACK_MP;
+			MONO_ADD_INS (vb, new_ins);
+			break;
+		case OP_LOADI4_MEMBASE:
+		case OP_LOADU4_MEMBASE:
+		case OP_LOADR4_MEMBASE:
+			MONO_INST_NEW (cfg, new_ins, OP_LOADX_MEMBASE);
+			new_ins->dreg = map [ins->dreg] = alloc_ireg (cfg);
+			new_ins->sreg1 = MAP_VREG (ins->inst_basereg);
+			new_ins->inst_offset = 0;
+			new_ins->type = STACK_VTYPE;
+			MONO_ADD_INS (vb, new_ins);
+			break;
+		case OP_IADD:
+		case OP_ISUB:
+		case OP_IAND:
+		case OP_IOR:
+		case OP_IXOR:
+		case OP_FADD:
+		case OP_FSUB:
+		case OP_FMUL:
+			map [ins->dreg] = alloc_ireg (cfg);
+			MONO_EMIT_NEW_BIALU (cfg, vec_simd_opcode (ins->opcode), map [ins->dreg], MAP_VREG (ins->sreg1), MAP_VREG (ins->sreg2));
+			break;
+		case OP_STOREI4_MEMBASE_REG:
+		case OP_STORER4_MEMBASE_REG:
+			MONO_INST_NEW (cfg, new_ins, OP_STOREX_MEMBASE);
+			new_ins->dreg = MAP_VREG (ins->inst_destbasereg);
+			new_ins->sreg1 = MAP_VREG (ins->sreg1);
+			new_ins->inst_offset = 0;
+			MONO_ADD_INS (vb, new_ins);
+			break;
+		default:
+			/* Checks are done before entering the vector loop, the increment is emitted below */
+			break;
+		}
+	}
+#undef MAP_VREG
+
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_IADD_IMM, ctx->ivar->dreg, ctx->ivar->dreg, 4);
+}
+
+/*
+ * vectorize_loop:
+ *
+ *   Emit the checks and the vector loop in front of the loop, which has already
+ * been analyzed.
+ *
+ *   P -> G0 -> null/length checks -> GL -> VH <-> VB
+ *   VH, and each check -> H (scalar loop)
+ */
+static void
+vectorize_loop (VectorizeCtx *ctx)
+{
+	MonoCompile *cfg = ctx->cfg;
+	MonoBasicBlock *p = ctx->preheader, *h = ctx->header;
+	MonoBasicBlock *prev, *bb, *first, *vh, *vb;
+	MonoInst *vlimit;
+	const unsigned char *ip = cfg->ip;
+	int i, len_reg;
+
+	vlimit = mono_compile_create_var (cfg, &mono_defaults.int32_class->byval_arg, OP_LOCAL);
+
+	cfg->ip = NULL;
+
+	first = bb = vectorize_new_bblock (ctx, p);
+	cfg->cbb = bb;
+	/* The vector loop runs while i + 3 < limit, this is only used if limit >= 4 */
+	if (ctx->limit_var)
+		MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ISUB_IMM, vlimit->dreg, ctx->limit_var->dreg, 3);
+	else
+		MONO_EMIT_NEW_ICONST (cfg, vlimit->dreg, ctx->limit_imm - 3);
+	/* i >= 0 */
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ICOMPARE_IMM, -1, ctx->ivar->dreg, 0);
+	prev = bb;
+
+	if (ctx->limit_var) {
+		/* limit >= 4 */
+		bb = vectorize_new_bblock (ctx, prev);
+		vectorize_emit_branch (cfg, prev, OP_IBLT, h, bb);
+		cfg->cbb = bb;
+		MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ICOMPARE_IMM, -1, ctx->limit_var->dreg, 4);
+		prev = bb;
+	}
+
+	for (i = 0; i < ctx->narrays; ++i) {
+		/* array != null */
+		bb = vectorize_new_bblock (ctx, prev);
+		vectorize_emit_branch (cfg, prev, OP_IBLT, h, bb);
+		cfg->cbb = bb;
+		MONO_EMIT_NEW_BIALU_IMM (cfg, OP_COMPARE_IMM, -1, ctx->arrays [i], 0);
+		prev = bb;
+
+		/* array.Length >= limit */
+		bb = vectorize_new_bblock (ctx, prev);
+		vectorize_emit_branch (cfg, prev, OP_PBEQ, h, bb);
+		cfg->cbb = bb;
+		len_reg = alloc_ireg (cfg);
+		MONO_EMIT_NEW_LOAD_MEMBASE_OP_FLAGS (cfg, OP_LOADI4_MEMBASE, len_reg, ctx->arrays [i], G_STRUCT_OFFSET (MonoArray, max_length), MONO_INST_CONSTANT_LOAD);
+		if (ctx->limit_var)
+			MONO_EMIT_NEW_BIALU (cfg, OP_ICOMPARE, -1, len_reg, ctx->limit_var->dreg);
+		else
+			MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ICOMPARE_IMM, -1, len_reg, ctx->limit_imm);
+		prev = bb;
+	}
+
+	vh = vectorize_new_bblock (ctx, prev);
+	vectorize_emit_branch (cfg, prev, OP_IBLT, h, vh);
+	vb = vectorize_new_bblock (ctx, vh);
+
+	cfg->cbb = vh;
+	MONO_EMIT_NEW_BIALU (cfg, OP_ICOMPARE, -1, ctx->ivar->dreg, vlimit->dreg);
+	vectorize_emit_branch (cfg, vh, OP_IBLT, vb, h);
+
+	vectorize_emit_vector_body (ctx, vb);
+	vectorize_emit_branch (cfg, vb, OP_BR, vh, NULL);
+
+	/* Enter the new code instead of the scalar loop */
+	mono_unlink_bblock (cfg, p, h);
+	mono_link_bblock (cfg, p, first);
+	if (p->last_ins && p->last_ins->opcode == OP_BR)
+		p->last_ins->inst_target_bb = first;
+
+	cfg->ip = ip;
+	cfg->cbb = NULL;
+
+	if (cfg->verbose_level > 2)
+		printf ("VECTORIZE: vectorized loop BB%d with vector loop BB%d\n", h->block_num, vb->block_num);
+}
+
+/*
+ * mono_loop_vectorize:
+ *
+ *   Add a vector loop in front of simple elementwise loops over int32 and float32
+ * arrays, using the packed SIMD opcodes. Return whenever the cfg was changed, in
+ * which case the caller needs to recompute cfg->bblocks and the loop information.
+ * Requires the loop information computed by mono_compute_natural_loops ().
+ */
+gboolean
+mono_loop_vectorize (MonoCompile *cfg)
+{
+	VectorizeCtx ctx;
+	MonoBasicBlock *h, *b, *preheader;
+	MonoBasicBlock **headers;
+	int i, nheaders = 0, nvectorized = 0;
+
+	g_assert (cfg->comp_done & MONO_COMP_LOOPS);
+
+	if (cfg->gen_seq_points || COMPILE_LLVM (cfg))
+		return FALSE;
+
+	/* Collect the candidates first since vectorizing adds bblocks */
+	headers = mono_mempool_alloc0 (cfg->mempool, sizeof (MonoBasicBlock*) * cfg->num_bblocks);
+	for (i = 0; i < cfg->num_bblocks; ++i) {
+		h = cfg->bblocks [i];
+
+		if (!h->loop_blocks || g_list_length (h->loop_blocks) != 2 || h->extended || h->region != -1)
+			continue;
+		if (h->in_count != 2 || h->out_count != 2 || !h->last_ins || h->last_ins->opcode != OP_IBLT)
+			continue;
+		b = h->last_ins->inst_true_bb;
+		if (b == h || !g_list_find (h->loop_blocks, b) || g_list_find (h->loop_blocks, h->last_ins->inst_false_bb))
+			continue;
+		if (b->in_count != 1 || b->out_count != 1 || b->out_bb [0] != h || b->region != h->region || b->extended)
+			continue;
+		/* The body either falls through or branches to the header */
+		if (!(b->last_ins && b->last_ins->opcode == OP_BR) && b->next_bb != h)
+			continue;
+		preheader = get_loop_preheader (h);
+		if (!preheader || preheader->region != h->region)
+			continue;
+		headers [nheaders ++] = h;
+	}
+
+	for (i = 0; i < nheaders; ++i) {
+		memset (&ctx, 0, sizeof (ctx));
+		ctx.cfg = cfg;
+		ctx.header = h = headers [i];
+		ctx.body = h->last_ins->inst_true_bb;
+		ctx.exit = h->last_ins->inst_false_bb;
+		ctx.preheader = get_loop_preheader (h);
+		ctx.nvregs = cfg->next_vreg;
+		ctx.kinds = mono_mempool_alloc0 (cfg->mempool, ctx.nvregs);
+		ctx.etypes = mono_mempool_alloc0 (cfg->mempool, ctx.nvregs);
+		ctx.srcs = mono_mempool_alloc (cfg->mempool, sizeof (int) * ctx.nvregs);
+		memset (ctx.srcs, 0xff, sizeof (int) * ctx.nvregs);
+
+		if (!vectorize_analyze_header (&ctx) || !vectorize_analyze_body (&ctx))
+			continue;
+
+		vectorize_loop (&ctx);
+		nvectorized ++;
+	}
+
+	mono_jit_stats.loops_vectorized += nvectorized;
+
+	return nvectorized > 0;
+}
+
+#endif /* MONO_ARCH_SIMD_INTRINSICS */
+
+#endif /* DISABLE_JIT */
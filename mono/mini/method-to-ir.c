@@ -1770,8 +1770,15 @@ mini_emit_memset (MonoCompile *cfg, int destreg, int offset, int size, int val,
 	}
 }
 
-void 
-mini_emit_memcpy (MonoCompile *cfg, int destreg, int doffset, int srcreg, int soffset, int size, int align)
+/*
+ * emit_memcpy:
+ *
+ *   Emit an inline copy of SIZE bytes. If NO_REFS is TRUE, the copied memory is known
+ * not to contain object references, so it can be copied through xmm registers, which
+ * the GC doesn't scan.
+ */
+static void
+emit_memcpy (MonoCompile *cfg, int destreg, int doffset, int srcreg, int soffset, int size, int align, gboolean no_refs)
 {
 	int cur_reg;
 
@@ -1794,6 +1801,31 @@ mini_emit_memcpy (MonoCompile *cfg, int destreg, int doffset, int srcreg, int so
 	}
 
 #if !NO_UNALIGNED_ACCESS
+#if defined(MONO_ARCH_SIMD_INTRINSICS) && (defined(TARGET_X86) || defined(TARGET_AMD64))
+	/* Copy large blocks 16 bytes at a time using unaligned sse moves */
+	if (no_refs && (cfg->opt & MONO_OPT_SIMD) && !COMPILE_LLVM (cfg) && size >= 32) {
+		MonoInst *ins;
+
+		while (size >= 16) {
+			MONO_INST_NEW (cfg, ins, OP_LOADX_MEMBASE);
+			ins->dreg = cur_reg = alloc_ireg (cfg);
+			ins->sreg1 = srcreg;
+			ins->inst_offset = soffset;
+			ins->type = STACK_VTYPE;
+			MONO_ADD_INS (cfg->cbb, ins);
+
+			MONO_INST_NEW (cfg, ins, OP_STOREX_MEMBASE);
+			ins->dreg = destreg;
+			ins->sreg1 = cur_reg;
+			ins->inst_offset = doffset;
+			MONO_ADD_INS (cfg->cbb, ins);
+			doffset += 16;
+			soffset += 16;
+			size -= 16;
+		}
+	}
+#endif
+
 	if (SIZEOF_REGISTER == 8) {
 		while (size >= 8) {
 			cur_reg = alloc_preg (cfg);
@@ -1832,6 +1864,12 @@ mini_emit_memcpy (MonoCompile *cfg, int destreg, int doffset, int srcreg, int so
 	}
 }
 
+void 
+mini_emit_memcpy (MonoCompile *cfg, int destreg, int doffset, int srcreg, int soffset, int size, int align)
+{
+	emit_memcpy (cfg, destreg, doffset, srcreg, soffset, size, align, FALSE);
+}
+
 static int
 ret_type_to_call_opcode (MonoType *type, int calli, int virt, MonoGenericSharingContext *gsctx)
 {
@@ -2840,7 +2878,7 @@ mini_emit_stobj (MonoCompile *cfg, MonoInst *dest, MonoInst *src, MonoClass *kla
 
 	if ((cfg->opt & MONO_OPT_INTRINS) && n <= sizeof (gpointer) * 5) {
 		/* FIXME: Optimize the case when src/dest is OP_LDADDR */
-		mini_emit_memcpy (cfg, dest->dreg, 0, src->dreg, 0, n, align);
+		emit_memcpy (cfg, dest->dreg, 0, src->dreg, 0, n, align, native || !klass->has_references);
 	} else {
 		iargs [0] = dest;
 		iargs [1] = src;
@@ -3211,6 +3249,20 @@ handle_unbox (MonoCompile *cfg, MonoClass *klass, MonoInst **sp, int context_use
 	return add;
 }
 
+/*
+ * mark_alloc:
+ *
+ *   Mark the call INS as returning a newly allocated object, so the write barriers of
+ * stores into it can be removed by mono_elide_fresh_object_barriers ().
+ */
+static MonoInst*
+mark_alloc (MonoInst *ins)
+{
+	if (ins && MONO_IS_CALL (ins))
+		((MonoCallInst*)ins)->alloc_obj = TRUE;
+	return ins;
+}
+
 /*
  * Returns NULL and set the cfg exception on error.
  */
@@ -3248,7 +3300,7 @@ handle_alloc (MonoCompile *cfg, MonoClass *klass, gboolean for_box, int context_
 			alloc_ftn = mono_object_new_specific;
 		}
 
-		return mono_emit_jit_icall (cfg, alloc_ftn, iargs);
+		return mark_alloc (mono_emit_jit_icall (cfg, alloc_ftn, iargs));
 	}
 
 	if (cfg->opt & MONO_OPT_SHARED) {
@@ -3260,7 +3312,7 @@ handle_alloc (MonoCompile *cfg, MonoClass *klass, gboolean for_box, int context_
 		/* This happens often in argument checking code, eg. throw new FooException... */
 		/* Avoid relocations and save some space by calling a helper function specialized to mscorlib */
 		EMIT_NEW_ICONST (cfg, iargs [0], mono_metadata_token_index (klass->type_token));
-		return mono_emit_jit_icall (cfg, mono_helper_newobj_mscorlib, iargs);
+		return mark_alloc (mono_emit_jit_icall (cfg, mono_helper_newobj_mscorlib, iargs));
 	} else {
 		MonoVTable *vtable = mono_class_vtable (cfg->domain, klass);
 		MonoMethod *managed_alloc = NULL;
@@ -3278,7 +3330,7 @@ handle_alloc (MonoCompile *cfg, MonoClass *klass, gboolean for_box, int context_
 
 		if (managed_alloc) {
 			EMIT_NEW_VTABLECONST (cfg, iargs [0], vtable);
-			return mono_emit_method_call (cfg, managed_alloc, iargs, NULL);
+			return mark_alloc (mono_emit_method_call (cfg, managed_alloc, iargs, NULL));
 		}
 		alloc_ftn = mono_class_get_allocation_ftn (vtable, for_box, &pass_lw);
 		if (pass_lw) {
@@ -3292,7 +3344,7 @@ handle_alloc (MonoCompile *cfg, MonoClass *klass, gboolean for_box, int context_
 		}
 	}
 
-	return mono_emit_jit_icall (cfg, alloc_ftn, iargs);
+	return mark_alloc (mono_emit_jit_icall (cfg, alloc_ftn, iargs));
 }
 	
 /*
@@ -4323,6 +4375,15 @@ mini_emit_inst_for_method (MonoCompile *cfg, MonoMethod *cmethod, MonoMethodSign
 			MONO_EMIT_NEW_BIALU (cfg, OP_PADD, add_reg, mult_reg, args [0]->dreg);
 			MONO_EMIT_NEW_STORE_MEMBASE (cfg, OP_STOREI2_MEMBASE_REG, add_reg, G_STRUCT_OFFSET (MonoString, chars), args [2]->dreg);
 			return cfg->cbb->last_ins;
+		} else if (!mono_string_intrinsics_enabled ()) {
+			return NULL;
+		} else if (strcmp (cmethod->name, "IndexOfUnchecked") == 0 && fsig->param_count == 3 && fsig->params [0]->type == MONO_TYPE_CHAR) {
+			/* The callers already did the range checks */
+			return mono_emit_jit_icall (cfg, mono_string_index_of_char, args);
+		} else if (strcmp (cmethod->name, "Equals") == 0 && !fsig->hasthis && fsig->param_count == 2) {
+			return mono_emit_jit_icall (cfg, mono_string_equal_ordinal, args);
+		} else if (strcmp (cmethod->name, "CompareOrdinalUnchecked") == 0 && fsig->param_count == 6) {
+			return mono_emit_jit_icall (cfg, mono_string_compare_ordinal, args);
 		} else 
 			return NULL;
 	} else if (cmethod->klass == mono_defaults.object_class) {
@@ -4356,6 +4417,25 @@ mini_emit_inst_for_method (MonoCompile *cfg, MonoMethod *cmethod, MonoMethodSign
 		if (strcmp (cmethod->name + 1, "etGenericValueImpl") == 0)
 			return emit_array_generic_access (cfg, fsig, args, *cmethod->name == 'S');
 
+		/* Array.IndexOf<T> (T[], T) for integral T */
+		if (strcmp (cmethod->name, "IndexOf") == 0 && cmethod->is_inflated && fsig->param_count == 2 &&
+			fsig->params [0]->type == MONO_TYPE_SZARRAY && !fsig->params [1]->byref && mono_string_intrinsics_enabled ()) {
+			switch (fsig->params [1]->type) {
+			case MONO_TYPE_I1:
+			case MONO_TYPE_U1:
+				return mono_emit_jit_icall (cfg, mono_array_index_of_1, args);
+			case MONO_TYPE_I2:
+			case MONO_TYPE_U2:
+			case MONO_TYPE_CHAR:
+				return mono_emit_jit_icall (cfg, mono_array_index_of_2, args);
+			case MONO_TYPE_I4:
+			case MONO_TYPE_U4:
+				return mono_emit_jit_icall (cfg, mono_array_index_of_4, args);
+			default:
+				break;
+			}
+		}
+
 #ifndef MONO_BIG_ARRAYS
 		/*
 		 * This is an inline version of GetLength/GetLowerBound(0) used frequently in
@@ -4832,6 +4912,7 @@ inline_method (MonoCompile *cfg, MonoMethod *cmethod, MonoMethodSignature *fsig,
 	MonoMethod *prev_current_method;
 	MonoGenericContext *prev_generic_context;
 	gboolean ret_var_set, prev_ret_var_set, virtual = FALSE;
+	gint64 phase_start;
 
 	g_assert (cfg->exception_type == MONO_EXCEPTION_NONE);
 
@@ -4911,7 +4992,11 @@ inline_method (MonoCompile *cfg, MonoMethod *cmethod, MonoMethodSignature *fsig,
 	if (*ip == CEE_CALLVIRT && !(cmethod->flags & METHOD_ATTRIBUTE_STATIC))
 		virtual = TRUE;
 
+	/* Nested inlining is already accounted for by the outermost one */
+	phase_start = cfg->inline_depth == 1 ? MONO_JIT_PHASE_START (cfg) : 0;
 	costs = mono_method_to_ir (cfg, cmethod, sbblock, ebblock, rvar, dont_inline, sp, real_offset, virtual);
+	if (cfg->inline_depth == 1)
+		MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_INLINE, phase_start);
 
 	ret_var_set = cfg->ret_var_set;
 
@@ -5493,7 +5493,7 @@ mono_arch_output_basic_block (MonoCompile *cfg, MonoBasicBlock *bb)
 		case OP_CARD_TABLE_WBARRIER: {
 			int ptr = ins->sreg1;
 			int value = ins->sreg2;
-			guchar *br;
+			guchar *br, *br2;
 			int nursery_shift, card_table_shift;
 			gpointer card_table_mask;
 			size_t nursery_size;
@@ -5523,10 +5523,16 @@ mono_arch_output_basic_block (MonoCompile *cfg, MonoBasicBlock *bb)
 			 *   cmp edx, (nursery_start >> nursery_shift)
 			 *   jne done
 			 *   edx = ptr
+			 *   edx >>= nursery_shift
+			 *   cmp edx, (nursery_start >> nursery_shift)
+			 *   je done
+			 *   edx = ptr
 			 *   edx >>= card_table_shift
 			 *   edx += cardtable
 			 *   [edx] = 1
 			 * done:
+			 *
+			 * Stores into nursery objects don't need to be recorded.
 			 */
 
 			if (value != AMD64_RDX)
@@ -5535,6 +5541,10 @@ mono_arch_output_basic_block (MonoCompile *cfg, MonoBasicBlock *bb)
 			amd64_alu_reg_imm (code, X86_CMP, AMD64_RDX, nursery_start >> nursery_shift);
 			br = code; x86_branch8 (code, X86_CC_NE, -1, FALSE);
 			amd64_mov_reg_reg (code, AMD64_RDX, ptr, 8);
+			amd64_shift_reg_imm (code, X86_SHR, AMD64_RDX, nursery_shift);
+			amd64_alu_reg_imm (code, X86_CMP, AMD64_RDX, nursery_start >> nursery_shift);
+			br2 = code; x86_branch8 (code, X86_CC_EQ, -1, FALSE);
+			amd64_mov_reg_reg (code, AMD64_RDX, ptr, 8);
 			amd64_shift_reg_imm (code, X86_SHR, AMD64_RDX, card_table_shift);
 			if (card_table_mask)
 				amd64_alu_reg_imm (code, X86_AND, AMD64_RDX, (guint32)(guint64)card_table_mask);
@@ -5544,6 +5554,7 @@ mono_arch_output_basic_block (MonoCompile *cfg, MonoBasicBlock *bb)
 
 			amd64_mov_membase_imm (code, AMD64_RDX, 0, 1, 1);
 			x86_patch (br, code);
+			x86_patch (br2, code);
 			break;
 		}
 #ifdef MONO_ARCH_SIMD_INTRINSICS
@@ -64,6 +64,31 @@ static gpointer restore_stack_protection_tramp = NULL;
 
 static void try_more_restore (void);
 static void restore_stack_protection (void);
+static gboolean find_jit_info_ext_with_ji (MonoDomain *domain, MonoDomain *target_domain, MonoJitInfo *ji,
+										   MonoJitTlsData *jit_tls, MonoContext *ctx,
+										   MonoContext *new_ctx, char **trace, MonoLMF **lmf,
+										   mgreg_t **save_locations, StackFrameInfo *frame);
+
+/*
+ * Per-thread cache used by the exception handling code, mapping the IPs of the
+ * frames seen during unwinding to their jit info and to the clauses protecting
+ * them. Exceptions used for control flow are thrown from and caught at the same
+ * few places, so this saves the jit info table lookups and the clause scanning.
+ * Entries are invalidated by bumping throw_cache_gen when jit info is freed.
+ */
+#define THROW_CACHE_SIZE 64
+
+typedef struct {
+	gpointer ip;
+	MonoDomain *domain;
+	guint32 gen;
+	MonoJitInfo *ji;
+	MonoDomain *target_domain;
+	/* Bit N is set if clause N protects IP, only used for the first 64 clauses */
+	guint64 protected_clauses;
+} ThrowCacheEntry;
+
+static volatile gint32 throw_cache_gen;
 
 void
 mono_exceptions_init (void)
@@ -189,6 +214,84 @@ is_address_protected (MonoJitInfo *ji, MonoJitExceptionInfo *ei, gpointer ip)
 	return TRUE;
 }
 
+/*
+ * mini_invalidate_throw_cache:
+ *
+ *   Invalidate the exception handling caches of all threads. Called when jit info
+ * is freed, since the code addresses could be reused.
+ */
+void
+mini_invalidate_throw_cache (void)
+{
+	InterlockedIncrement (&throw_cache_gen);
+}
+
+static ThrowCacheEntry*
+throw_cache_lookup (MonoDomain *domain, MonoJitTlsData *jit_tls, gpointer ip)
+{
+	ThrowCacheEntry *entry;
+	MonoJitInfo *ji;
+	MonoDomain *target_domain;
+	guint32 gen = throw_cache_gen;
+	int i;
+
+	if (!jit_tls->throw_cache)
+		jit_tls->throw_cache = g_new0 (ThrowCacheEntry, THROW_CACHE_SIZE);
+	entry = &((ThrowCacheEntry*)jit_tls->throw_cache) [((gsize)ip >> 2) & (THROW_CACHE_SIZE - 1)];
+	if (entry->ip == ip && entry->domain == domain && entry->gen == gen)
+		return entry;
+
+	ji = mini_jit_info_table_find (domain, ip, &target_domain);
+	if (!ji)
+		return NULL;
+
+	entry->ip = ip;
+	entry->domain = domain;
+	entry->gen = gen;
+	entry->ji = ji;
+	entry->target_domain = target_domain;
+	entry->protected_clauses = 0;
+	for (i = 0; i < ji->num_clauses && i < 64; ++i) {
+		if (is_address_protected (ji, &ji->clauses [i], ip))
+			entry->protected_clauses |= (guint64)1 << i;
+	}
+	return entry;
+}
+
+/*
+ * find_jit_info_for_exception:
+ *
+ *   Same as mono_find_jit_info_ext (), but use the throw cache to find the jit info.
+ * Return the cache entry for the frame in OUT_ENTRY, or NULL.
+ */
+static gboolean
+find_jit_info_for_exception (MonoDomain *domain, MonoJitTlsData *jit_tls, MonoContext *ctx,
+							 MonoContext *new_ctx, MonoLMF **lmf, StackFrameInfo *frame, ThrowCacheEntry **out_entry)
+{
+	ThrowCacheEntry *entry = throw_cache_lookup (domain, jit_tls, MONO_CONTEXT_GET_IP (ctx));
+
+	*out_entry = entry;
+	if (entry)
+		return find_jit_info_ext_with_ji (domain, entry->target_domain, entry->ji, jit_tls, ctx, new_ctx, NULL, lmf, NULL, frame);
+	else
+		return find_jit_info_ext_with_ji (domain, NULL, NULL, jit_tls, ctx, new_ctx, NULL, lmf, NULL, frame);
+}
+
+/*
+ * is_clause_protecting:
+ *
+ *   Return whenever CLAUSE of JI protects IP, using ENTRY if it still describes IP.
+ * The entry can be reused by an exception thrown and caught while running the
+ * handlers of the frame, so it needs to be checked again.
+ */
+static inline gboolean
+is_clause_protecting (ThrowCacheEntry *entry, MonoJitInfo *ji, int clause, gpointer ip)
+{
+	if (entry && entry->ip == ip && entry->ji == ji && clause < 64)
+		return (entry->protected_clauses & ((guint64)1 << clause)) != 0;
+	return is_address_protected (ji, &ji->clauses [clause], ip);
+}
+
 /*
  * find_jit_info:
  *
@@ -336,13 +439,9 @@ mono_find_jit_info_ext (MonoDomain *domain, MonoJitTlsData *jit_tls,
 						mgreg_t **save_locations,
 						StackFrameInfo *frame)
 {
-	gboolean err;
 	gpointer ip = MONO_CONTEXT_GET_IP (ctx);
 	MonoJitInfo *ji;
-	MonoDomain *target_domain;
-
-	if (trace)
-		*trace = NULL;
+	MonoDomain *target_domain = NULL;
 
 	/* Avoid costly table lookup during stack overflow */
 	if (prev_ji && (ip > prev_ji->code_start && ((guint8*)ip < ((guint8*)prev_ji->code_start) + prev_ji->code_size)))
@@ -350,6 +449,28 @@ mono_find_jit_info_ext (MonoDomain *domain, MonoJitTlsData *jit_tls,
 	else
 		ji = mini_jit_info_table_find (domain, ip, &target_domain);
 
+	return find_jit_info_ext_with_ji (domain, target_domain, ji, jit_tls, ctx, new_ctx, trace, lmf, save_locations, frame);
+}
+
+/*
+ * find_jit_info_ext_with_ji:
+ *
+ *   Same as mono_find_jit_info_ext, but the jit info of the frame has already
+ * been looked up by the caller.
+ */
+static gboolean
+find_jit_info_ext_with_ji (MonoDomain *domain, MonoDomain *target_domain, MonoJitInfo *ji,
+						   MonoJitTlsData *jit_tls, MonoContext *ctx,
+						   MonoContext *new_ctx, char **trace, MonoLMF **lmf,
+						   mgreg_t **save_locations,
+						   StackFrameInfo *frame)
+{
+	gboolean err;
+	gpointer ip = MONO_CONTEXT_GET_IP (ctx);
+
+	if (trace)
+		*trace = NULL;
+
 	if (!target_domain)
 		target_domain = domain;
 
@@ -940,23 +1061,29 @@ callback_get_stack_frames_security_info (StackFrameInfo *frame, MonoContext *ctx
 	return FALSE;
 }
 
-static MonoArray *
-glist_to_array (GList *list, MonoClass *eclass) 
+/*
+ * set_trace_ips:
+ *
+ *   Store the ip/generic info pairs collected during the first pass into EX.
+ * Only the raw addresses are saved, they are resolved to methods by
+ * ves_icall_get_trace () when the stack trace is actually requested.
+ */
+static void
+set_trace_ips (MonoException *ex, GPtrArray *trace_ips, gboolean has_dynamic_methods)
 {
-	MonoDomain *domain = mono_domain_get ();
 	MonoArray *res;
-	int len, i;
-
-	if (!list)
-		return NULL;
-
-	len = g_list_length (list);
-	res = mono_array_new (domain, eclass, len);
+	int i;
 
-	for (i = 0; list; list = list->next, i++)
-		mono_array_set (res, gpointer, i, list->data);
+	if (trace_ips->len) {
+		res = mono_array_new (mono_domain_get (), mono_defaults.int_class, trace_ips->len);
+		for (i = 0; i < trace_ips->len; ++i)
+			mono_array_set (res, gpointer, i, g_ptr_array_index (trace_ips, i));
+		MONO_OBJECT_SETREF (ex, trace_ips, res);
+	}
 
-	return res;
+	if (has_dynamic_methods)
+		/* These methods could go away anytime, so compute the stack trace now */
+		MONO_OBJECT_SETREF (ex, stack_trace, ves_icall_System_Exception_get_trace (ex));
 }
 
 /**
@@ -1152,7 +1279,7 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpoin
 	MonoJitTlsData *jit_tls = TlsGetValue (mono_jit_tls_id);
 	MonoLMF *lmf = mono_get_lmf ();
 	MonoArray *initial_trace_ips = NULL;
-	GList *trace_ips = NULL;
+	GPtrArray *trace_ips = NULL;
 	MonoException *mono_ex;
 	gboolean stack_overflow = FALSE;
 	MonoContext initial_ctx;
@@ -1190,15 +1317,19 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpoin
 	filter_idx = 0;
 	initial_ctx = *ctx;
 
+	if (mono_ex && !initial_trace_ips)
+		trace_ips = g_ptr_array_sized_new (32);
+
 	while (1) {
 		MonoContext new_ctx;
 		guint32 free_stack;
 		int clause_index_start = 0;
 		gboolean unwind_res = TRUE;
+		ThrowCacheEntry *cache_entry;
 		
 		StackFrameInfo frame;
 
-		unwind_res = mono_find_jit_info_ext (domain, jit_tls, NULL, ctx, &new_ctx, NULL, &lmf, NULL, &frame);
+		unwind_res = find_jit_info_for_exception (domain, jit_tls, ctx, &new_ctx, &lmf, &frame, &cache_entry);
 		if (unwind_res) {
 			if (frame.type == FRAME_TYPE_DEBUGGER_INVOKE || frame.type == FRAME_TYPE_MANAGED_TO_NATIVE) {
 				*ctx = new_ctx;
@@ -1209,14 +1340,10 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpoin
 		}
 
 		if (!unwind_res) {
-			if (mono_ex && !initial_trace_ips) {
-				trace_ips = g_list_reverse (trace_ips);
-				MONO_OBJECT_SETREF (mono_ex, trace_ips, glist_to_array (trace_ips, mono_defaults.int_class));
-				if (has_dynamic_methods)
-					/* These methods could go away anytime, so compute the stack trace now */
-					MONO_OBJECT_SETREF (mono_ex, stack_trace, ves_icall_System_Exception_get_trace (mono_ex));
+			if (trace_ips) {
+				set_trace_ips (mono_ex, trace_ips, has_dynamic_methods);
+				g_ptr_array_free (trace_ips, TRUE);
 			}
-			g_list_free (trace_ips);
 			return FALSE;
 		}
 
@@ -1235,10 +1362,9 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpoin
 			 * rethrown. Also avoid giant stack traces during a stack
 			 * overflow.
 			 */
-			if (!initial_trace_ips && (frame_count < 1000)) {
-				trace_ips = g_list_prepend (trace_ips, MONO_CONTEXT_GET_IP (ctx));
-				trace_ips = g_list_prepend (trace_ips,
-											get_generic_info_from_stack_frame (ji, ctx));
+			if (trace_ips && (frame_count < 1000)) {
+				g_ptr_array_add (trace_ips, MONO_CONTEXT_GET_IP (ctx));
+				g_ptr_array_add (trace_ips, get_generic_info_from_stack_frame (ji, ctx));
 			}
 		}
 
@@ -1265,7 +1391,7 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpoin
 			if (free_stack <= (64 * 1024))
 				continue;
 
-			if (is_address_protected (ji, ei, MONO_CONTEXT_GET_IP (ctx))) {
+			if (is_clause_protecting (cache_entry, ji, i, MONO_CONTEXT_GET_IP (ctx))) {
 				/* catch block */
 				MonoClass *catch_class = get_exception_catch_class (ei, ji, ctx);
 
@@ -1281,16 +1407,10 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpoin
 				if (ei->flags == MONO_EXCEPTION_CLAUSE_FILTER) {
 					mono_perfcounters->exceptions_filters++;
 					mono_debugger_call_exception_handler (ei->data.filter, MONO_CONTEXT_GET_SP (ctx), ex_obj);
-					if (mono_ex && !initial_trace_ips) {
-						trace_ips = g_list_reverse (trace_ips);
-						MONO_OBJECT_SETREF (mono_ex, trace_ips, glist_to_array (trace_ips, mono_defaults.int_class));
-
-						if (has_dynamic_methods)
-							/* These methods could go away anytime, so compute the stack trace now */
-							MONO_OBJECT_SETREF (mono_ex, stack_trace, ves_icall_System_Exception_get_trace (mono_ex));
+					if (trace_ips) {
+						set_trace_ips (mono_ex, trace_ips, has_dynamic_methods);
+						g_ptr_array_set_size (trace_ips, 0);
 					}
-					g_list_free (trace_ips);
-					trace_ips = NULL;
 
 					if (ji->from_llvm) {
 #ifdef MONO_CONTEXT_SET_LLVM_EXC_REG
@@ -1320,14 +1440,10 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpoin
 				}
 
 				if (ei->flags == MONO_EXCEPTION_CLAUSE_NONE && mono_object_isinst (ex_obj, catch_class)) {
-					if (mono_ex && !initial_trace_ips) {
-						trace_ips = g_list_reverse (trace_ips);
-						MONO_OBJECT_SETREF (mono_ex, trace_ips, glist_to_array (trace_ips, mono_defaults.int_class));
-						if (has_dynamic_methods)
-							/* These methods could go away anytime, so compute the stack trace now */
-							MONO_OBJECT_SETREF (mono_ex, stack_trace, ves_icall_System_Exception_get_trace (mono_ex));
+					if (trace_ips) {
+						set_trace_ips (mono_ex, trace_ips, has_dynamic_methods);
+						g_ptr_array_free (trace_ips, TRUE);
 					}
-					g_list_free (trace_ips);
 
 					/* mono_debugger_agent_handle_exception () needs this */
 					MONO_CONTEXT_SET_IP (ctx, ei->handler_start);
@@ -1499,6 +1615,7 @@ mono_handle_exception_internal (MonoContext *ctx, gpointer obj, gpointer origina
 		guint32 free_stack;
 		int clause_index_start = 0;
 		gboolean unwind_res = TRUE;
+		ThrowCacheEntry *cache_entry = NULL;
 		
 		if (resume) {
 			resume = FALSE;
@@ -1511,7 +1628,7 @@ mono_handle_exception_internal (MonoContext *ctx, gpointer obj, gpointer origina
 		} else {
 			StackFrameInfo frame;
 
-			unwind_res = mono_find_jit_info_ext (domain, jit_tls, NULL, ctx, &new_ctx, NULL, &lmf, NULL, &frame);
+			unwind_res = find_jit_info_for_exception (domain, jit_tls, ctx, &new_ctx, &lmf, &frame, &cache_entry);
 			if (unwind_res) {
 				if (frame.type == FRAME_TYPE_DEBUGGER_INVOKE || frame.type == FRAME_TYPE_MANAGED_TO_NATIVE) {
 					*ctx = new_ctx;
@@ -1552,7 +1669,7 @@ mono_handle_exception_internal (MonoContext *ctx, gpointer obj, gpointer origina
 			if (free_stack <= (64 * 1024))
 				continue;
 
-			if (is_address_protected (ji, ei, MONO_CONTEXT_GET_IP (ctx))) {
+			if (is_clause_protecting (cache_entry, ji, i, MONO_CONTEXT_GET_IP (ctx))) {
 				/* catch block */
 				MonoClass *catch_class = get_exception_catch_class (ei, ji, ctx);
 
@@ -777,7 +777,7 @@ conservative_pass (TlsData *tls, guint8 *stack_start, guint8 *stack_end)
 		 */
 		g_assert (pc_offset >= 0);
 
-		emap = ji->gc_info;
+		emap = mono_jit_info_get_gc_info (ji);
 
 		if (!emap) {
 			DEBUG (char *fname = mono_method_full_name (ji->method, TRUE); fprintf (logfile, "Mark(0): %s+0x%x (%p)\n", fname, pc_offset, (gpointer)MONO_CONTEXT_GET_IP (&ctx)); g_free (fname));
@@ -2245,7 +2245,7 @@ create_map (MonoCompile *cfg)
 		stats.gc_bitmaps_size += bitmaps_size;
 		stats.gc_map_struct_size += sizeof (GCEncodedMap) + encoded_size;
 
-		cfg->jit_info->gc_info = emap;
+		mono_jit_info_set_gc_info (cfg->jit_info, emap);
 
 		cfg->gc_map = (guint8*)emap;
 		cfg->gc_map_size = alloc_size;
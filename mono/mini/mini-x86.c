@@ -4108,7 +4108,7 @@ mono_arch_output_basic_block (MonoCompile *cfg, MonoBasicBlock *bb)
 		case OP_CARD_TABLE_WBARRIER: {
 			int ptr = ins->sreg1;
 			int value = ins->sreg2;
-			guchar *br;
+			guchar *br, *br2;
 			int nursery_shift, card_table_shift;
 			gpointer card_table_mask;
 			size_t nursery_size;
@@ -4131,9 +4131,15 @@ mono_arch_output_basic_block (MonoCompile *cfg, MonoBasicBlock *bb)
 			 *   cmp edx, (nursery_start >> nursery_shift)
 			 *   jne done
 			 *   edx = ptr
+			 *   edx >>= nursery_shift
+			 *   cmp edx, (nursery_start >> nursery_shift)
+			 *   je done
+			 *   edx = ptr
 			 *   edx >>= card_table_shift
 			 *   card_table[edx] = 1
 			 * done:
+			 *
+			 * Stores into nursery objects don't need to be recorded.
 			 */
 
 			if (value != X86_EDX)
@@ -4142,11 +4148,16 @@ mono_arch_output_basic_block (MonoCompile *cfg, MonoBasicBlock *bb)
 			x86_alu_reg_imm (code, X86_CMP, X86_EDX, nursery_start >> nursery_shift);
 			br = code; x86_branch8 (code, X86_CC_NE, -1, FALSE);
 			x86_mov_reg_reg (code, X86_EDX, ptr, 4);
+			x86_shift_reg_imm (code, X86_SHR, X86_EDX, nursery_shift);
+			x86_alu_reg_imm (code, X86_CMP, X86_EDX, nursery_start >> nursery_shift);
+			br2 = code; x86_branch8 (code, X86_CC_EQ, -1, FALSE);
+			x86_mov_reg_reg (code, X86_EDX, ptr, 4);
 			x86_shift_reg_imm (code, X86_SHR, X86_EDX, card_table_shift);
 			if (card_table_mask)
 				x86_alu_reg_imm (code, X86_AND, X86_EDX, (int)card_table_mask);
 			x86_mov_membase_imm (code, X86_EDX, card_table, 1, 1);
 			x86_patch (br, code);
+			x86_patch (br2, code);
 			break;
 		}
 #ifdef MONO_ARCH_SIMD_INTRINSICS
@@ -51,6 +51,7 @@
 #include <mono/utils/mono-math.h>
 #include <mono/utils/mono-compiler.h>
 #include <mono/utils/mono-counters.h>
+#include <mono/utils/mono-metrics.h>
 #include <mono/utils/mono-logger-internal.h>
 #include <mono/utils/mono-mmap.h>
 #include <mono/utils/dtrace.h>
@@ -138,6 +139,8 @@ static MonoCodeManager *global_codeman = NULL;
 
 static GHashTable *jit_icall_name_hash = NULL;
 
+static MonoMetric *jit_time_metric;
+
 static MonoDebugOptions debug_options;
 
 #ifdef VALGRIND_JIT_REGISTER_MAP
@@ -2670,6 +2673,7 @@ free_jit_tls_data (MonoJitTlsData *jit_tls)
 	mono_free_altstack (jit_tls);
 
 	g_free (jit_tls->first_lmf);
+	g_free (jit_tls->throw_cache);
 	g_free (jit_tls);
 }
 
@@ -3555,6 +3559,7 @@ mono_codegen (MonoCompile *cfg)
 	int max_epilog_size;
 	guint8 *code;
 	MonoDomain *code_domain;
+	gint64 phase_start;
 
 	if (mono_using_xdebug)
 		/*
@@ -3575,6 +3580,8 @@ mono_codegen (MonoCompile *cfg)
 	nacl_allow_target_modification (FALSE);
 #endif
 
+	/* Lowering and peephole time is counted as part of the local regalloc */
+	phase_start = MONO_JIT_PHASE_START (cfg);
 	for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
 		cfg->spill_count = 0;
 		/* we reuse dfn here */
@@ -3591,6 +3598,9 @@ mono_codegen (MonoCompile *cfg)
 		if (cfg->opt & MONO_OPT_PEEPHOLE)
 			mono_arch_peephole_pass_2 (cfg, bb);
 	}
+	MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_REGALLOC, phase_start);
+
+	phase_start = MONO_JIT_PHASE_START (cfg);
 
 	if (cfg->prof_options & MONO_PROFILE_COVERAGE)
 		cfg->coverage_info = mono_profiler_coverage_alloc (cfg->method, cfg->num_bblocks);
@@ -3662,7 +3672,11 @@ mono_codegen (MonoCompile *cfg)
 #ifdef MONO_ARCH_HAVE_UNWIND_TABLE
 		unwindlen = mono_arch_unwindinfo_get_size (cfg->arch.unwindinfo);
 #endif
-		code = mono_domain_code_reserve (code_domain, cfg->code_size + unwindlen);
+		/* static constructors run only once, keep them away from the other methods */
+		if ((cfg->method->flags & METHOD_ATTRIBUTE_SPECIAL_NAME) && (cfg->method->flags & METHOD_ATTRIBUTE_STATIC) && !strcmp (cfg->method->name, ".cctor"))
+			code = mono_domain_code_reserve_cold (code_domain, cfg->code_size + unwindlen, 0);
+		else
+			code = mono_domain_code_reserve (code_domain, cfg->code_size + unwindlen);
 	}
 #if defined(__native_client_codegen__) && defined(__native_client__)
 	nacl_allow_target_modification (TRUE);
@@ -3754,6 +3768,8 @@ if (valgrind_register){
 #ifdef MONO_ARCH_HAVE_UNWIND_TABLE
 	mono_arch_unwindinfo_install_unwind_info (&cfg->arch.unwindinfo, cfg->native_code, cfg->code_len);
 #endif
+
+	MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_CODEGEN, phase_start);
 }
 
 static void
@@ -3789,7 +3805,7 @@ create_jit_info (MonoCompile *cfg, MonoMethod *method_to_compile)
 	MonoMethodHeader *header;
 	MonoJitInfo *jinfo;
 	int num_clauses;
-	int generic_info_size;
+	int generic_info_size, gc_info_size, size;
 	int holes_size = 0, num_holes = 0;
 
 	g_assert (method_to_compile == cfg->method);
@@ -3800,6 +3816,12 @@ create_jit_info (MonoCompile *cfg, MonoMethod *method_to_compile)
 	else
 		generic_info_size = 0;
 
+	/* Only reserve space for the gc map pointer if the method will have one */
+	if (cfg->compute_gc_maps)
+		gc_info_size = sizeof (gpointer);
+	else
+		gc_info_size = 0;
+
 	if (cfg->try_block_holes) {
 		for (tmp = cfg->try_block_holes; tmp; tmp = tmp->next) {
 			TryBlockHole *hole = tmp->data;
@@ -3823,14 +3845,13 @@ create_jit_info (MonoCompile *cfg, MonoMethod *method_to_compile)
 	else
 		num_clauses = header->num_clauses;
 
-	if (cfg->method->dynamic) {
-		jinfo = g_malloc0 (MONO_SIZEOF_JIT_INFO + (num_clauses * sizeof (MonoJitExceptionInfo)) +
-				generic_info_size + holes_size);
-	} else {
-		jinfo = mono_domain_alloc0 (cfg->domain, MONO_SIZEOF_JIT_INFO +
-				(num_clauses * sizeof (MonoJitExceptionInfo)) +
-				generic_info_size + holes_size);
-	}
+	size = MONO_SIZEOF_JIT_INFO + (num_clauses * sizeof (MonoJitExceptionInfo)) +
+		gc_info_size + generic_info_size + holes_size;
+	if (cfg->method->dynamic)
+		jinfo = g_malloc0 (size);
+	else
+		jinfo = mono_domain_alloc0 (cfg->domain, size);
+	mono_jit_stats.jit_info_size += size;
 
 	jinfo->method = cfg->method_to_register;
 	jinfo->code_start = cfg->native_code;
@@ -3839,6 +3860,7 @@ create_jit_info (MonoCompile *cfg, MonoMethod *method_to_compile)
 	jinfo->domain_neutral = (cfg->opt & MONO_OPT_SHARED) != 0;
 	jinfo->cas_inited = FALSE; /* initialization delayed at the first stalk walk using this method */
 	jinfo->num_clauses = num_clauses;
+	jinfo->has_gc_info = gc_info_size != 0;
 	if (COMPILE_LLVM (cfg))
 		jinfo->from_llvm = TRUE;
 
@@ -4112,6 +4134,27 @@ mini_get_shared_method (MonoMethod *method)
 }
 
 #ifndef DISABLE_JIT
+/*
+ * report_jit_phases:
+ *
+ *   Add the per-phase timings of CFG to the JIT statistics and pass them to the
+ * profiler.
+ */
+static void
+report_jit_phases (MonoCompile *cfg, int il_size)
+{
+	int i;
+
+	/* Inlining happens inside method_to_ir () */
+	cfg->phase_time [MONO_PROFILER_JIT_PHASE_METHOD_TO_IR] -= MIN (cfg->phase_time [MONO_PROFILER_JIT_PHASE_INLINE], cfg->phase_time [MONO_PROFILER_JIT_PHASE_METHOD_TO_IR]);
+
+	for (i = 0; i < MONO_PROFILER_JIT_PHASE_LAST; ++i)
+		mono_jit_stats.jit_phase_time [i] += cfg->phase_time [i] / 1000000000.0;
+
+	if (cfg->prof_options & MONO_PROFILE_JIT_COMPILATION)
+		mono_profiler_method_jit_phases (cfg->method, il_size, cfg->phase_time);
+}
+
 /*
  * mini_method_compile:
  * @method: the method to compile
@@ -4136,6 +4179,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	gboolean deadce_has_run = FALSE;
 	gboolean try_generic_shared, try_llvm = FALSE;
 	MonoMethod *method_to_compile, *method_to_register;
+	gint64 phase_start;
 
 	mono_jit_stats.methods_compiled++;
 	if (mono_profiler_get_events () & MONO_PROFILE_JIT_COMPILATION)
@@ -4180,6 +4224,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	cfg->mempool = mono_mempool_new ();
 	cfg->opt = opts;
 	cfg->prof_options = mono_profiler_get_events ();
+	cfg->time_phases = mono_jit_stats.enabled || (cfg->prof_options & MONO_PROFILE_JIT_COMPILATION);
 	cfg->run_cctors = run_cctors;
 	cfg->domain = domain;
 	cfg->verbose_level = mini_verbose;
@@ -4427,7 +4472,9 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	/* SSAPRE is not supported on linear IR */
 	cfg->opt &= ~MONO_OPT_SSAPRE;
 
+	phase_start = MONO_JIT_PHASE_START (cfg);
 	i = mono_method_to_ir (cfg, method_to_compile, NULL, NULL, NULL, NULL, NULL, 0, FALSE);
+	MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_METHOD_TO_IR, phase_start);
 
 	if (i < 0) {
 		if (try_generic_shared && cfg->exception_type == MONO_EXCEPTION_GENERIC_SHARING_FAILED) {
@@ -4495,15 +4542,25 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 
 	/*g_print ("numblocks = %d\n", cfg->num_bblocks);*/
 
+	phase_start = MONO_JIT_PHASE_START (cfg);
 	if (!COMPILE_LLVM (cfg))
 		mono_decompose_long_opts (cfg);
+	MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_DECOMPOSE, phase_start);
 
 	/* Should be done before branch opts */
+	phase_start = MONO_JIT_PHASE_START (cfg);
 	if (cfg->opt & (MONO_OPT_CONSPROP | MONO_OPT_COPYPROP))
 		mono_local_cprop (cfg);
+	MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_LOCAL_OPTS, phase_start);
 
+	phase_start = MONO_JIT_PHASE_START (cfg);
 	if (cfg->opt & MONO_OPT_BRANCH)
 		mono_optimize_branches (cfg);
+	MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_BRANCH_OPTS, phase_start);
+
+	phase_start = MONO_JIT_PHASE_START (cfg);
+	/* After branch opts, so more stores end up in the same bblock as the allocation */
+	mono_elide_fresh_object_barriers (cfg);
 
 	/* This must be done _before_ global reg alloc and _after_ decompose */
 	mono_handle_global_vregs (cfg);
@@ -4512,6 +4569,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	/* Disable this for LLVM to make the IR easier to handle */
 	if (!COMPILE_LLVM (cfg))
 		mono_if_conversion (cfg);
+	MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_LOCAL_OPTS, phase_start);
 
 	if ((cfg->opt & MONO_OPT_SSAPRE) || cfg->globalra)
 		mono_remove_critical_edges (cfg);
@@ -4559,10 +4617,34 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 		cfg->disable_ssa = TRUE;
 	}
 
+	phase_start = MONO_JIT_PHASE_START (cfg);
 	if (cfg->opt & MONO_OPT_LOOP) {
 		mono_compile_dominator_info (cfg, MONO_COMP_DOM | MONO_COMP_IDOM);
 		mono_compute_natural_loops (cfg);
+		mono_loop_invariant_code_motion (cfg);
+#ifdef MONO_ARCH_SIMD_INTRINSICS
+		if ((cfg->opt & MONO_OPT_VECTORIZE) && (cfg->opt & MONO_OPT_SIMD) && mono_loop_vectorize (cfg)) {
+			MonoBasicBlock *bb;
+
+			/* Have to recompute cfg->bblocks, bb->dfn and the loop info */
+			mono_free_loop_info (cfg);
+			cfg->comp_done &= ~MONO_COMP_DOM;
+
+			for (bb = cfg->bb_entry; bb; bb = bb->next_bb)
+				bb->dfn = 0;
+
+			cfg->bblocks = mono_mempool_alloc (cfg->mempool, sizeof (MonoBasicBlock*) * (cfg->max_block_num + 1));
+
+			dfn = 0;
+			df_visit (cfg->bb_entry, &dfn, cfg->bblocks);
+			cfg->num_bblocks = dfn + 1;
+
+			mono_compile_dominator_info (cfg, MONO_COMP_DOM | MONO_COMP_IDOM);
+			mono_compute_natural_loops (cfg);
+		}
+#endif
 	}
+	MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_LOOP_OPTS, phase_start);
 
 	/* after method_to_ir */
 	if (parts == 1) {
@@ -4588,6 +4670,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 #endif
 	}
 #else 
+	phase_start = MONO_JIT_PHASE_START (cfg);
 	if (cfg->opt & MONO_OPT_SSA) {
 		if (!(cfg->comp_done & MONO_COMP_SSA) && !cfg->disable_ssa) {
 #ifndef DISABLE_SSA
@@ -4599,6 +4682,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 			}
 		}
 	}
+	MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_SSA, phase_start);
 #endif
 
 	/* after SSA translation */
@@ -4608,6 +4692,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 		return cfg;
 	}
 
+	phase_start = MONO_JIT_PHASE_START (cfg);
 	if ((cfg->opt & MONO_OPT_CONSPROP) || (cfg->opt & MONO_OPT_COPYPROP)) {
 		if (cfg->comp_done & MONO_COMP_SSA && !COMPILE_LLVM (cfg)) {
 #ifndef DISABLE_SSA
@@ -4667,6 +4752,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 		if (cfg->opt & MONO_OPT_ABCREM)
 			mono_perform_abc_removal (cfg);
 	}
+	MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_SSA, phase_start);
 
 	/* after SSA removal */
 	if (parts == 3) {
@@ -4675,6 +4761,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 		return cfg;
 	}
 
+	phase_start = MONO_JIT_PHASE_START (cfg);
 #ifdef MONO_ARCH_SOFT_FLOAT
 	if (!COMPILE_LLVM (cfg))
 		mono_decompose_soft_float (cfg);
@@ -4683,6 +4770,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 		mono_decompose_vtype_opts (cfg);
 	if (cfg->flags & MONO_CFG_HAS_ARRAY_ACCESS)
 		mono_decompose_array_access_opts (cfg);
+	MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_DECOMPOSE, phase_start);
 
 	if (cfg->got_var) {
 #ifndef MONO_ARCH_GOT_REG
@@ -4717,6 +4805,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	 */
 	mono_liveness_handle_exception_clauses (cfg);
 
+	phase_start = MONO_JIT_PHASE_START (cfg);
 	if (cfg->globalra) {
 		MonoBasicBlock *bb;
 
@@ -4732,8 +4821,15 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 		
 		/* fixme: maybe we can avoid to compute livenesss here if already computed ? */
 		cfg->comp_done &= ~MONO_COMP_LIVENESS;
-		if (!(cfg->comp_done & MONO_COMP_LIVENESS))
+		if (!(cfg->comp_done & MONO_COMP_LIVENESS)) {
+			gint64 liveness_start = MONO_JIT_PHASE_START (cfg);
+
 			mono_analyze_liveness (cfg);
+			MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_LIVENESS, liveness_start);
+			/* Don't count it as regalloc time too */
+			if (cfg->time_phases)
+				phase_start += mono_100ns_ticks () - liveness_start;
+		}
 
 		if ((vars = mono_arch_get_allocatable_int_vars (cfg))) {
 			regs = mono_arch_get_global_int_regs (cfg);
@@ -4775,6 +4871,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 					mono_local_deadce (cfg);
 			}
 		}
+		MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_REGALLOC, phase_start);
 
 		/* Add branches between non-consecutive bblocks */
 		for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
@@ -4859,7 +4956,9 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	else
 		InterlockedIncrement (&mono_jit_stats.methods_without_llvm);
 
+	phase_start = MONO_JIT_PHASE_START (cfg);
 	cfg->jit_info = create_jit_info (cfg, method_to_compile);
+	MONO_JIT_PHASE_END (cfg, MONO_PROFILER_JIT_PHASE_JIT_INFO, phase_start);
 
 #ifdef MONO_ARCH_HAVE_LIVERANGE_OPS
 	if (cfg->extend_live_ranges) {
@@ -4909,6 +5008,9 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	}
 	mono_jit_stats.native_code_size += cfg->code_len;
 
+	if (cfg->time_phases)
+		report_jit_phases (cfg, header->code_size);
+
 	if (MONO_PROBE_METHOD_COMPILE_END_ENABLED ())
 		MONO_PROBE_METHOD_COMPILE_END (method, TRUE);
 
@@ -5030,15 +5132,22 @@ mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, in
 	MonoException *ex = NULL;
 	guint32 prof_options;
 	GTimer *jit_timer;
+	double jit_time;
 	MonoMethod *prof_method;
 
 #ifdef MONO_USE_AOT_COMPILER
 	if (opt & MONO_OPT_AOT) {
 		MonoDomain *domain = mono_domain_get ();
 
+		gint64 aot_start;
+
 		mono_class_init (method->klass);
 
-		if ((code = mono_aot_get_method (domain, method))) {
+		aot_start = mono_jit_stats.enabled ? mono_100ns_ticks () : 0;
+		code = mono_aot_get_method (domain, method);
+		if (mono_jit_stats.enabled)
+			mono_jit_stats.aot_load_time += (mono_100ns_ticks () - aot_start) / 10000000.0;
+		if (code) {
 			vtable = mono_class_vtable (domain, method->klass);
 			g_assert (vtable);
 			mono_runtime_class_init (vtable);
@@ -5137,7 +5246,9 @@ mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, in
 	prof_method = cfg->method;
 
 	g_timer_stop (jit_timer);
-	mono_jit_stats.jit_time += g_timer_elapsed (jit_timer, NULL);
+	jit_time = g_timer_elapsed (jit_timer, NULL);
+	mono_jit_stats.jit_time += jit_time;
+	mono_metric_record (jit_time_metric, (gint64)(jit_time * 1000000));
 	g_timer_destroy (jit_timer);
 
 	switch (cfg->exception_type) {
@@ -5424,6 +5535,7 @@ mono_jit_free_method (MonoDomain *domain, MonoMethod *method)
 	mono_internal_hash_table_remove (&domain->jit_code_hash, method);
 	g_hash_table_remove (domain_jit_info (domain)->jump_trampoline_hash, method);
 	g_hash_table_remove (domain_jit_info (domain)->runtime_invoke_hash, method);
+	mono_conc_cache_remove (domain_jit_info (domain)->runtime_invoke_cache, domain_jit_info (domain)->runtime_invoke_hash, method);
 	mono_domain_unlock (domain);
 
 #ifdef MONO_ARCH_HAVE_INVALIDATE_METHOD
@@ -5447,6 +5559,7 @@ mono_jit_free_method (MonoDomain *domain, MonoMethod *method)
 	 * same code address and replace our entry in the table.
 	 */
 	mono_jit_info_table_remove (domain, ji->ji);
+	mini_invalidate_throw_cache ();
 
 	if (destroy)
 		mono_code_manager_destroy (ji->code_mp);
@@ -5493,6 +5606,11 @@ typedef struct {
 	MonoVTable *vtable;
 	MonoDynCallInfo *dyn_call_info;
 	MonoClass *ret_box_class;
+	/* Used by mono_jit_runtime_invoke_array () */
+	gboolean array_invoke_inited;
+	gpointer runtime_invoke_array;
+	/* Bit I is set if argument I is a valuetype, those can't be null */
+	guint64 array_invoke_vtype_args;
 } RuntimeInvokeInfo;
 
 /**
@@ -5518,9 +5636,14 @@ mono_jit_runtime_invoke (MonoMethod *method, void *obj, void **params, MonoObjec
 
 	domain_info = domain_jit_info (domain);
 
-	mono_domain_lock (domain);
-	info = g_hash_table_lookup (domain_info->runtime_invoke_hash, method);
-	mono_domain_unlock (domain);		
+	info = mono_conc_cache_lookup (domain_info->runtime_invoke_cache, domain_info->runtime_invoke_hash, method);
+	if (!info) {
+		mono_domain_lock (domain);
+		info = g_hash_table_lookup (domain_info->runtime_invoke_hash, method);
+		if (info)
+			mono_conc_cache_insert (domain_info->runtime_invoke_cache, domain_info->runtime_invoke_hash, method, info);
+		mono_domain_unlock (domain);
+	}
 
 	if (!info) {
 		if (mono_security_get_mode () == MONO_SECURITY_MODE_CORE_CLR) {
@@ -5651,6 +5774,7 @@ mono_jit_runtime_invoke (MonoMethod *method, void *obj, void **params, MonoObjec
 			info = info2;
 		} else {
 			g_hash_table_insert (domain_info->runtime_invoke_hash, method, info);
+			mono_conc_cache_insert (domain_info->runtime_invoke_cache, domain_info->runtime_invoke_hash, method, info);
 		}
 		mono_domain_unlock (domain);
 	}
@@ -5722,6 +5846,81 @@ mono_jit_runtime_invoke (MonoMethod *method, void *obj, void **params, MonoObjec
 	return runtime_invoke (obj, params, exc, info->compiled_method);
 }
 
+/*
+ * mono_jit_runtime_invoke_array:
+ *
+ *   Fast path of mono_runtime_invoke_array (), which invokes METHOD through a
+ * wrapper reading the boxed arguments straight from PARAMS. The wrappers are
+ * shared between methods with the same signature shape. Returns FALSE without
+ * invoking METHOD if this can't be done, the first invoke of a method always
+ * goes through mono_jit_runtime_invoke (), which sets up the invoke info.
+ */
+static gboolean
+mono_jit_runtime_invoke_array (MonoMethod *method, void *obj, MonoArray *params, MonoObject **exc, MonoObject **res)
+{
+	MonoDomain *domain = mono_domain_get ();
+	MonoJitDomainInfo *domain_info = domain_jit_info (domain);
+	RuntimeInvokeInfo *info;
+	RuntimeInvokeArrayFunction runtime_invoke_array;
+	guint64 vtype_args;
+	int i;
+
+	if (obj == NULL && !(method->flags & METHOD_ATTRIBUTE_STATIC))
+		return FALSE;
+
+	info = mono_conc_cache_lookup (domain_info->runtime_invoke_cache, domain_info->runtime_invoke_hash, method);
+	if (!info)
+		return FALSE;
+
+	if (!info->array_invoke_inited) {
+		MonoMethodSignature *sig = mono_method_signature (method);
+		MonoMethod *invoke = NULL;
+
+		if (!mono_aot_only && !info->dyn_call_info && info->compiled_method && sig->param_count <= 64)
+			invoke = mono_marshal_get_runtime_invoke_array (method);
+		if (invoke) {
+			vtype_args = 0;
+			for (i = 0; i < sig->param_count; ++i) {
+				if (!MONO_TYPE_IS_REFERENCE (sig->params [i]))
+					vtype_args |= (guint64)1 << i;
+			}
+			info->array_invoke_vtype_args = vtype_args;
+			info->runtime_invoke_array = mono_jit_compile_method (invoke);
+		}
+		/* Racing threads compute the same values */
+		mono_memory_barrier ();
+		info->array_invoke_inited = TRUE;
+	}
+
+	runtime_invoke_array = info->runtime_invoke_array;
+	if (!runtime_invoke_array)
+		return FALSE;
+
+	/* Null valuetype arguments are replaced by default values by the slow path */
+	vtype_args = info->array_invoke_vtype_args;
+	for (i = 0; vtype_args; ++i, vtype_args >>= 1) {
+		if ((vtype_args & 1) && !mono_array_get (params, MonoObject*, i))
+			return FALSE;
+	}
+
+	if (exc) {
+		*exc = (MonoObject*)mono_runtime_class_init_full (info->vtable, FALSE);
+		if (*exc) {
+			*res = NULL;
+			return TRUE;
+		}
+	} else {
+		mono_runtime_class_init (info->vtable);
+	}
+
+	/* The wrappers expect this to be initialized to NULL */
+	if (exc)
+		*exc = NULL;
+
+	*res = runtime_invoke_array (obj, params, exc, info->compiled_method);
+	return TRUE;
+}
+
 void
 SIG_HANDLER_SIGNATURE (mono_sigfpe_signal_handler)
 {
@@ -6033,11 +6232,26 @@ mini_get_addr_from_ftnptr (gpointer descr)
 static void
 register_jit_stats (void)
 {
+	jit_time_metric = mono_metric_new ("JIT time per method (usec)", MONO_METRIC_HISTOGRAM, MONO_COUNTER_JIT);
+
 	mono_counters_register ("Compiled methods", MONO_COUNTER_JIT | MONO_COUNTER_WORD, &mono_jit_stats.methods_compiled);
 	mono_counters_register ("Methods from AOT", MONO_COUNTER_JIT | MONO_COUNTER_WORD, &mono_jit_stats.methods_aot);
+	mono_counters_register ("JIT info size", MONO_COUNTER_JIT | MONO_COUNTER_WORD, &mono_jit_stats.jit_info_size);
 	mono_counters_register ("Methods JITted using LLVM", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.methods_with_llvm);	
 	mono_counters_register ("Methods JITted using mono JIT", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.methods_without_llvm);
 	mono_counters_register ("Total time spent JITting (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_time);
+	mono_counters_register ("JIT/method-to-ir (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_phase_time [MONO_PROFILER_JIT_PHASE_METHOD_TO_IR]);
+	mono_counters_register ("JIT/inlining (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_phase_time [MONO_PROFILER_JIT_PHASE_INLINE]);
+	mono_counters_register ("JIT/decompose (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_phase_time [MONO_PROFILER_JIT_PHASE_DECOMPOSE]);
+	mono_counters_register ("JIT/local opts (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_phase_time [MONO_PROFILER_JIT_PHASE_LOCAL_OPTS]);
+	mono_counters_register ("JIT/branch opts (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_phase_time [MONO_PROFILER_JIT_PHASE_BRANCH_OPTS]);
+	mono_counters_register ("JIT/loop opts (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_phase_time [MONO_PROFILER_JIT_PHASE_LOOP_OPTS]);
+	mono_counters_register ("JIT/ssa (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_phase_time [MONO_PROFILER_JIT_PHASE_SSA]);
+	mono_counters_register ("JIT/liveness (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_phase_time [MONO_PROFILER_JIT_PHASE_LIVENESS]);
+	mono_counters_register ("JIT/regalloc (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_phase_time [MONO_PROFILER_JIT_PHASE_REGALLOC]);
+	mono_counters_register ("JIT/codegen (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_phase_time [MONO_PROFILER_JIT_PHASE_CODEGEN]);
+	mono_counters_register ("JIT/jit info (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_phase_time [MONO_PROFILER_JIT_PHASE_JIT_INFO]);
+	mono_counters_register ("Total time spent loading AOT code (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.aot_load_time);
 }
 
 static void runtime_invoke_info_free (gpointer value);
@@ -6053,6 +6267,7 @@ mini_create_jit_domain_info (MonoDomain *domain)
 	info->delegate_trampoline_hash = g_hash_table_new (mono_aligned_addr_hash, NULL);
 	info->llvm_vcall_trampoline_hash = g_hash_table_new (mono_aligned_addr_hash, NULL);
 	info->runtime_invoke_hash = g_hash_table_new_full (mono_aligned_addr_hash, NULL, NULL, runtime_invoke_info_free);
+	info->runtime_invoke_cache = mono_conc_cache_new (256);
 	info->seq_points = g_hash_table_new_full (mono_aligned_addr_hash, NULL, NULL, g_free);
 	info->arch_seq_points = g_hash_table_new (mono_aligned_addr_hash, NULL);
 
@@ -6112,6 +6327,9 @@ mini_free_jit_domain_info (MonoDomain *domain)
 		g_hash_table_destroy (info->static_rgctx_trampoline_hash);
 	g_hash_table_destroy (info->llvm_vcall_trampoline_hash);
 	g_hash_table_destroy (info->runtime_invoke_hash);
+	mono_conc_cache_free (info->runtime_invoke_cache);
+	/* The jit info of the domain is going away */
+	mini_invalidate_throw_cache ();
 	g_hash_table_destroy (info->seq_points);
 	g_hash_table_destroy (info->arch_seq_points);
 
@@ -6171,6 +6389,7 @@ mini_init (const char *filename, const char *runtime_version)
 	callbacks.get_addr_from_ftnptr = mini_get_addr_from_ftnptr;
 	callbacks.get_runtime_build_info = mono_get_runtime_build_info;
 	callbacks.set_cast_details = mono_set_cast_details;
+	callbacks.runtime_invoke_array = mono_jit_runtime_invoke_array;
 
 #ifdef MONO_ARCH_HAVE_IMT
 	if (mono_use_imt) {
@@ -6507,6 +6726,13 @@ mini_init (const char *filename, const char *runtime_version)
 	register_icall (mono_object_castclass_with_cache, "mono_object_castclass_with_cache", "object object ptr ptr", FALSE);
 	register_icall (mono_object_isinst_with_cache, "mono_object_isinst_with_cache", "object object ptr ptr", FALSE);
 
+	register_icall (mono_string_index_of_char, "mono_string_index_of_char", "int32 object int32 int32 int32", FALSE);
+	register_icall (mono_string_equal_ordinal, "mono_string_equal_ordinal", "int32 object object", FALSE);
+	register_icall (mono_string_compare_ordinal, "mono_string_compare_ordinal", "int32 object int32 int32 object int32 int32", FALSE);
+	register_icall (mono_array_index_of_1, "mono_array_index_of_1", "int32 object int32", FALSE);
+	register_icall (mono_array_index_of_2, "mono_array_index_of_2", "int32 object int32", FALSE);
+	register_icall (mono_array_index_of_4, "mono_array_index_of_4", "int32 object int32", FALSE);
+
 #endif
 
 	mono_generic_sharing_init ();
@@ -6514,6 +6740,7 @@ mini_init (const char *filename, const char *runtime_version)
 #ifdef MONO_ARCH_SIMD_INTRINSICS
 	mono_simd_intrinsics_init ();
 #endif
+	mono_string_intrinsics_init ();
 
 #if MONO_SUPPORT_TASKLETS
 	mono_tasklets_init ();
@@ -6559,9 +6786,14 @@ print_jit_stats (void)
 				 mono_jit_stats.biggest_method);
 		g_print ("Code reallocs:          %ld\n", mono_jit_stats.code_reallocs);
 		g_print ("Allocated code size:    %ld\n", mono_jit_stats.allocated_code_size);
+		g_print ("JIT info size:          %ld (%ld bytes/method)\n", mono_jit_stats.jit_info_size,
+				 mono_jit_stats.methods_compiled ? mono_jit_stats.jit_info_size / mono_jit_stats.methods_compiled : 0);
 		g_print ("Inlineable methods:     %ld\n", mono_jit_stats.inlineable_methods);
 		g_print ("Inlined methods:        %ld\n", mono_jit_stats.inlined_methods);
 		g_print ("Regvars:                %ld\n", mono_jit_stats.regvars);
+		g_print ("Invariants hoisted:     %ld\n", mono_jit_stats.loop_invariants_hoisted);
+		g_print ("Loops vectorized:       %ld\n", mono_jit_stats.loops_vectorized);
+		g_print ("Write barriers elided:  %ld\n", mono_jit_stats.write_barriers_elided);
 		g_print ("Locals stack size:      %ld\n", mono_jit_stats.locals_stack_size);
 
 		g_print ("\nCreated object count:   %ld\n", mono_stats.new_object_count);
@@ -6598,6 +6830,7 @@ print_jit_stats (void)
 		g_print ("JIT info table inserts: %ld\n", mono_stats.jit_info_table_insert_count);
 		g_print ("JIT info table removes: %ld\n", mono_stats.jit_info_table_remove_count);
 		g_print ("JIT info table lookups: %ld\n", mono_stats.jit_info_table_lookup_count);
+		g_print ("JIT info cache hits:    %ld\n", mono_stats.jit_info_table_lookup_cache_hits);
 
 		g_print ("Hazardous pointers:     %ld\n", mono_stats.hazardous_pointer_count);
 		g_print ("Minor GC collections:   %ld\n", mono_stats.minor_gc_count);
@@ -6686,6 +6919,8 @@ mini_cleanup (MonoDomain *domain)
 	mono_trace_cleanup ();
 
 	mono_counters_dump (-1, stdout);
+	if (mono_jit_stats.enabled)
+		mono_metrics_dump (stdout);
 
 	if (mono_inject_async_exc_method)
 		mono_method_desc_free (mono_inject_async_exc_method);
@@ -20,6 +20,8 @@
 #include <mono/metadata/profiler-private.h>
 #include <mono/metadata/debug-helpers.h>
 #include <mono/utils/mono-compiler.h>
+#include <mono/utils/mono-conc-cache.h>
+#include <mono/utils/mono-time.h>
 
 #define MONO_BREAKPOINT_ARRAY_SIZE 64
 
@@ -119,7 +121,7 @@ typedef gint64 mgreg_t;
 #endif
 
 /* Version number of the AOT file format */
-#define MONO_AOT_FILE_VERSION 75
+#define MONO_AOT_FILE_VERSION 76
 
 //TODO: This is x86/amd64 specific.
 #define mono_simd_shuffle_mask(a,b,c,d) ((a) | ((b) << 2) | ((c) << 4) | ((d) << 6))
@@ -177,6 +179,11 @@ typedef struct MonoAotFileInfo
 	gpointer method_info_offsets;
 	gpointer ex_info_offsets;
 	gpointer code_offsets;
+	/*
+	 * <code offset, method index> pairs sorted by code offset, preceded by the number
+	 * of pairs. Empty if the order is only known at link time (LLVM).
+	 */
+	gpointer sorted_code_offsets;
 	gpointer extra_method_info_offsets;
 	gpointer extra_method_table;
 	gpointer got_info_offsets;
@@ -252,6 +259,8 @@ typedef struct
 	GHashTable *method_code_hash;
 	/* Maps methods to a RuntimeInvokeInfo structure */
 	GHashTable *runtime_invoke_hash;
+	/* Lock-free front end of runtime_invoke_hash, updated while holding the domain lock */
+	MonoConcCache *runtime_invoke_cache;
 	/* Maps MonoMethod to a GPtrArray containing sequence point locations */
 	GHashTable *seq_points;
 	/* Debugger agent data */
@@ -798,6 +807,8 @@ struct MonoCallInst {
 	guint dynamic_imt_arg : 1;
 	/* Whenever there is an RGCTX argument */
 	guint32 rgctx_reg : 1;
+	/* Whenever the call returns a newly allocated object */
+	guint alloc_obj : 1;
 	regmask_t used_iregs;
 	regmask_t used_fregs;
 	GSList *out_ireg_args;
@@ -1002,6 +1013,9 @@ typedef struct {
 	 */
 	MonoContext orig_ex_ctx;
 	gboolean orig_ex_ctx_set;
+
+	/* Maps IPs to jit info/protecting clauses during exception handling, see mini-exceptions.c */
+	gpointer throw_cache;
 } MonoJitTlsData;
 
 /*
@@ -1273,6 +1287,7 @@ typedef struct {
 	guint            gen_seq_points : 1;
 	guint            explicit_null_checks : 1;
 	guint            compute_gc_maps : 1;
+	guint            time_phases : 1;
 	gpointer         debug_info;
 	guint32          lmf_offset;
     guint16          *intvars;
@@ -1280,6 +1295,8 @@ typedef struct {
 	GHashTable       *token_info_hash;
 	MonoCompileArch  arch;
 	guint32          inline_depth;
+	/* Time spent in each JIT phase in nanoseconds, only if time_phases is set */
+	guint64          phase_time [MONO_PROFILER_JIT_PHASE_LAST];
 	guint32          exception_type;	/* MONO_EXCEPTION_* */
 	guint32          exception_data;
 	char*            exception_message;
@@ -1412,6 +1429,7 @@ typedef struct {
 	gulong max_code_size_ratio;
 	gulong biggest_method_size;
 	gulong allocated_code_size;
+	gulong jit_info_size;
 	gulong inlineable_methods;
 	gulong inlined_methods;
 	gulong basic_blocks;
@@ -1425,16 +1443,31 @@ typedef struct {
 	gulong cas_linkdemand;
 	gulong cas_demand_generation;
 	gulong generic_virtual_invocations;
+	gulong loop_invariants_hoisted;
+	gulong loops_vectorized;
+	gulong write_barriers_elided;
     int methods_with_llvm;
 	int methods_without_llvm;
 	char *max_ratio_method;
 	char *biggest_method;
 	double jit_time;
+	double jit_phase_time [MONO_PROFILER_JIT_PHASE_LAST];
+	double aot_load_time;
 	gboolean enabled;
 } MonoJitStats;
 
 extern MonoJitStats mono_jit_stats;
 
+/*
+ * Per-phase JIT timers. They are only active when JIT statistics are enabled or
+ * a profiler listens for JIT events, since they read the clock.
+ */
+#define MONO_JIT_PHASE_START(cfg) ((cfg)->time_phases ? mono_100ns_ticks () : 0)
+#define MONO_JIT_PHASE_END(cfg,phase,start) do { \
+		if ((cfg)->time_phases) \
+			(cfg)->phase_time [(phase)] += (mono_100ns_ticks () - (start)) * 100; \
+	} while (0)
+
 /* opcodes: value assigned after all the CIL opcodes */
 #ifdef MINI_OP
 #undef MINI_OP
@@ -2117,6 +2150,7 @@ void     mono_setup_altstack                    (MonoJitTlsData *tls) MONO_INTER
 void     mono_free_altstack                     (MonoJitTlsData *tls) MONO_INTERNAL;
 gpointer mono_altstack_restore_prot             (mgreg_t *regs, guint8 *code, gpointer *tramp_data, guint8* tramp) MONO_INTERNAL;
 MonoJitInfo* mini_jit_info_table_find           (MonoDomain *domain, char *addr, MonoDomain **out_domain) MONO_INTERNAL;
+void     mini_invalidate_throw_cache            (void) MONO_INTERNAL;
 void     mono_resume_unwind                     (MonoContext *ctx) MONO_LLVM_INTERNAL;
 
 MonoJitInfo * mono_find_jit_info                (MonoDomain *domain, MonoJitTlsData *jit_tls, MonoJitInfo *res, MonoJitInfo *prev_ji, MonoContext *ctx, MonoContext *new_ctx, char **trace, MonoLMF **lmf, int *native_offset, gboolean *managed) MONO_INTERNAL;
@@ -2153,6 +2187,8 @@ void        mono_ssa_cprop                      (MonoCompile *cfg) MONO_INTERNAL
 void        mono_ssa_deadce                     (MonoCompile *cfg) MONO_INTERNAL;
 void        mono_ssa_strength_reduction         (MonoCompile *cfg) MONO_INTERNAL;
 void        mono_free_loop_info                 (MonoCompile *cfg) MONO_INTERNAL;
+void        mono_loop_invariant_code_motion     (MonoCompile *cfg) MONO_INTERNAL;
+gboolean    mono_loop_vectorize                 (MonoCompile *cfg) MONO_INTERNAL;
 
 void        mono_ssa_compute2                   (MonoCompile *cfg);
 void        mono_ssa_remove2                    (MonoCompile *cfg);
@@ -2206,6 +2242,8 @@ extern void
 mono_local_cprop (MonoCompile *cfg);
 extern void
 mono_local_deadce (MonoCompile *cfg);
+extern void
+mono_elide_fresh_object_barriers (MonoCompile *cfg) MONO_INTERNAL;
 
 /* CAS - stack walk */
 MonoSecurityFrame* ves_icall_System_Security_SecurityFrame_GetSecurityFrame (gint32 skip) MONO_INTERNAL;
@@ -1500,5 +1500,66 @@ ncells ) {
 		return 0;
 	}
 
-}
+	public static int test_0_string_index_of_char () {
+		string s = "abcdefghijklmnopqrstuvwxyz0123456789";
+
+		if (s.IndexOf ('a') != 0)
+			return 1;
+		if (s.IndexOf ('9') != 35)
+			return 2;
+		if (s.IndexOf ('z') != 25)
+			return 3;
+		if (s.IndexOf ('A') != -1)
+			return 4;
+		if (s.IndexOf ('a', 1) != -1)
+			return 5;
+		if (s.IndexOf ('q', 10, 7) != 16)
+			return 6;
+		if (s.IndexOf ('q', 10, 6) != -1)
+			return 7;
+		if ("".IndexOf ('a') != -1)
+			return 8;
+		if ("\uffffx".IndexOf ('\uffff') != 0)
+			return 9;
+		return 0;
+	}
+
+	public static int test_0_string_equals_ordinal () {
+		string a = "0123456789abcdefghij";
+		string b = new StringBuilder ("0123456789").Append ("abcdefghij").ToString ();
+
+		if (!String.Equals (a, b) || !(a == b))
+			return 1;
+		if (String.Equals (a, b.Substring (1)))
+			return 2;
+		if (String.Equals (a, "0123456789abcdefghiJ"))
+			return 3;
+		if (String.Equals (a, "x123456789abcdefghij"))
+			return 4;
+		if (String.Equals (a, null) || String.Equals (null, b))
+			return 5;
+		if (!String.Equals (null, null) || !String.Equals ("", String.Empty))
+			return 6;
+		return 0;
+	}
+
+	public static int test_0_string_compare_ordinal () {
+		string a = "0123456789abcdefghij";
 
+		if (String.CompareOrdinal (a, "0123456789abcdefghij") != 0)
+			return 1;
+		if (String.CompareOrdinal (a, "0123456789abcdefghiJ") <= 0)
+			return 2;
+		if (String.CompareOrdinal (a, "0123456789abcdefghijk") >= 0)
+			return 3;
+		if (String.CompareOrdinal (a, "0123456789abcdefghi") <= 0)
+			return 4;
+		if (String.CompareOrdinal (a, 10, "xxabcdefghij", 2, 10) != 0)
+			return 5;
+		if (String.CompareOrdinal (a, null) != 1 || String.CompareOrdinal (null, a) != -1 || String.CompareOrdinal (null, null) != 0)
+			return 6;
+		if (String.CompareOrdinal ("a\uffff", "a\u0001") != 0xfffe)
+			return 7;
+		return 0;
+	}
+}
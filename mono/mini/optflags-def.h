@@ -24,3 +24,4 @@ OPTFLAG(SSE2     ,23, "sse2",       "SSE2 instructions on x86")
 OPTFLAG(GSHARED  ,24, "gshared",    "Share generics")
 OPTFLAG(SIMD	 ,25, "simd",	    "Simd intrinsics")
 OPTFLAG(UNSAFE	 ,26, "unsafe",	    "Remove bound checks and perform other dangerous changes")
+OPTFLAG(VECTORIZE,27, "vectorize",  "Vectorize simple array loops")
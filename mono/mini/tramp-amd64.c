@@ -716,7 +716,8 @@ mono_arch_create_specific_trampoline (gpointer arg1, MonoTrampolineType tramp_ty
 	else
 		size = 5 + 1 + 8;
 
-	code = buf = mono_domain_code_reserve_align (domain, size, 1);
+	/* specific trampolines are usually only executed until the call site is patched */
+	code = buf = mono_domain_code_reserve_cold (domain, size, 1);
 #elif defined(__native_client_codegen__)
 	size = 5 + 1 + 4;
 	/* Aligning the call site below could */
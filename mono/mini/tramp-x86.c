@@ -571,7 +571,8 @@ mono_arch_create_specific_trampoline (gpointer arg1, MonoTrampolineType tramp_ty
 	
 	tramp = mono_get_trampoline_code (tramp_type);
 
-	code = buf = mono_domain_code_reserve_align (domain, TRAMPOLINE_SIZE, NACL_SIZE (4, kNaClAlignment));
+	/* specific trampolines are usually only executed until the call site is patched */
+	code = buf = mono_domain_code_reserve_cold (domain, TRAMPOLINE_SIZE, NACL_SIZE (4, kNaClAlignment));
 
 	x86_push_imm (buf, arg1);
 	x86_jump_code (buf, tramp);
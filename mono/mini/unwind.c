@@ -32,10 +32,24 @@ typedef struct {
 
 static CRITICAL_SECTION unwind_mutex;
 
+/*
+ * Open addressing hash table mapping the contents of the cached unwind infos to
+ * their index in CACHED_INFO, so duplicates can be found without a linear scan.
+ * Slots contain the index + 1, 0 means empty. Slots are only written while
+ * holding the unwind lock, the table is replaced when it becomes half full, and
+ * readers access it using hazard pointers, so lookups don't need the lock.
+ */
+typedef struct {
+	guint32 size;
+	volatile guint32 slots [MONO_ZERO_LEN_ARRAY];
+} MonoUnwindInfoHash;
+
 static MonoUnwindInfo **cached_info;
 static int cached_info_next, cached_info_size;
+static MonoUnwindInfoHash *cached_info_hash;
 /* Statistics */
 static int unwind_info_size;
+static int unwind_info_lookups, unwind_info_lock_free_hits;
 
 #define unwind_lock() EnterCriticalSection (&unwind_mutex)
 #define unwind_unlock() LeaveCriticalSection (&unwind_mutex)
@@ -413,6 +427,9 @@ mono_unwind_init (void)
 	InitializeCriticalSection (&unwind_mutex);
 
 	mono_counters_register ("Unwind info size", MONO_COUNTER_JIT | MONO_COUNTER_INT, &unwind_info_size);
+	mono_counters_register ("Unwind info entries", MONO_COUNTER_JIT | MONO_COUNTER_INT, &cached_info_next);
+	mono_counters_register ("Unwind info lookups", MONO_COUNTER_JIT | MONO_COUNTER_INT, &unwind_info_lookups);
+	mono_counters_register ("Unwind info lock-free hits", MONO_COUNTER_JIT | MONO_COUNTER_INT, &unwind_info_lock_free_hits);
 }
 
 void
@@ -432,6 +449,124 @@ mono_unwind_cleanup (void)
 	}
 
 	g_free (cached_info);
+	g_free (cached_info_hash);
+}
+
+static gpointer
+get_hazardous_pointer (gpointer volatile *pp, MonoThreadHazardPointers *hp, int hazard_index)
+{
+	gpointer p;
+
+	for (;;) {
+		/* Get the pointer */
+		p = *pp;
+		/* If we don't have hazard pointers just return the
+		   pointer. */
+		if (!hp)
+			return p;
+		/* Make it hazardous */
+		mono_hazard_pointer_set (hp, hazard_index, p);
+		/* Check that it's still the same.  If not, try
+		   again. */
+		if (*pp != p) {
+			mono_hazard_pointer_clear (hp, hazard_index);
+			continue;
+		}
+		break;
+	}
+
+	return p;
+}
+
+static guint32
+unwind_info_hash (guint8 *unwind_info, guint32 unwind_info_len)
+{
+	guint32 i, h = unwind_info_len;
+
+	for (i = 0; i < unwind_info_len; ++i)
+		h = (h << 5) - h + unwind_info [i];
+	return h;
+}
+
+/*
+ * unwind_info_hash_find:
+ *
+ *   Return the index of the cached copy of UNWIND_INFO, or -1. If HP is not NULL,
+ * the lookup is done without holding the unwind lock.
+ */
+static int
+unwind_info_hash_find (MonoUnwindInfoHash *hash, MonoThreadHazardPointers *hp, guint32 h, guint8 *unwind_info, guint32 unwind_info_len)
+{
+	guint32 i, slot;
+	MonoUnwindInfo **table;
+	MonoUnwindInfo *cached;
+
+	for (i = h & (hash->size - 1);; i = (i + 1) & (hash->size - 1)) {
+		slot = hash->slots [i];
+		if (!slot)
+			return -1;
+		/*
+		 * The entry is stored into cached_info before its slot is set, so the table
+		 * has to be loaded after the slot.
+		 */
+		mono_memory_read_barrier ();
+		if (hp)
+			table = get_hazardous_pointer ((gpointer volatile*)&cached_info, hp, 1);
+		else
+			table = cached_info;
+		cached = table [slot - 1];
+		if (hp)
+			mono_hazard_pointer_clear (hp, 1);
+		if (cached->len == unwind_info_len && memcmp (cached->info, unwind_info, unwind_info_len) == 0)
+			return slot - 1;
+	}
+}
+
+static void
+unwind_info_hash_insert (MonoUnwindInfoHash *hash, guint32 h, int index)
+{
+	guint32 i;
+
+	for (i = h & (hash->size - 1); hash->slots [i]; i = (i + 1) & (hash->size - 1))
+		;
+	hash->slots [i] = index + 1;
+}
+
+/*
+ * unwind_info_hash_add:
+ *
+ *   Add the entry at INDEX in cached_info to the hash, growing it if needed.
+ * Called with the unwind lock held, after the entry has been published.
+ */
+static void
+unwind_info_hash_add (guint32 h, int index)
+{
+	MonoUnwindInfoHash *hash = cached_info_hash;
+
+	if (!hash || (index + 1) * 2 > hash->size) {
+		MonoUnwindInfoHash *new_hash;
+		guint32 size = hash ? hash->size * 2 : 64;
+		int i;
+
+		new_hash = g_malloc0 (sizeof (MonoUnwindInfoHash) + size * sizeof (guint32));
+		new_hash->size = size;
+		for (i = 0; i < index; ++i)
+			unwind_info_hash_insert (new_hash, unwind_info_hash (cached_info [i]->info, cached_info [i]->len), i);
+		unwind_info_hash_insert (new_hash, h, index);
+
+		mono_memory_barrier ();
+
+		cached_info_hash = new_hash;
+
+		if (hash) {
+			mono_memory_barrier ();
+			mono_thread_hazardous_free_or_queue (hash, g_free);
+		}
+		return;
+	}
+
+	mono_memory_write_barrier ();
+	unwind_info_hash_insert (hash, h, index);
 }
 
 /*
@@ -443,12 +578,29 @@ mono_unwind_cleanup (void)
  * This function is useful for two reasons:
  * - many methods have the same unwind info
  * - MonoJitInfo->used_regs is an int so it can't store the pointer to the unwind info
+ * Since most methods share their unwind info with an already compiled method,
+ * the lookup is done first without taking the unwind lock.
  */
 guint32
 mono_cache_unwind_info (guint8 *unwind_info, guint32 unwind_info_len)
 {
 	int i;
 	MonoUnwindInfo *info;
+	MonoUnwindInfoHash *hash;
+	MonoThreadHazardPointers *hp = mono_hazard_pointer_get ();
+	guint32 h = unwind_info_hash (unwind_info, unwind_info_len);
+
+	unwind_info_lookups ++;
+
+	if (hp) {
+		hash = get_hazardous_pointer ((gpointer volatile*)&cached_info_hash, hp, 0);
+		i = hash ? unwind_info_hash_find (hash, hp, h, unwind_info, unwind_info_len) : -1;
+		mono_hazard_pointer_clear (hp, 0);
+		if (i != -1) {
+			unwind_info_lock_free_hits ++;
+			return i;
+		}
+	}
 
 	unwind_lock ();
 
@@ -457,10 +609,9 @@ mono_cache_unwind_info (guint8 *unwind_info, guint32 unwind_info_len)
 		cached_info = g_new0 (MonoUnwindInfo*, cached_info_size);
 	}
 
-	for (i = 0; i < cached_info_next; ++i) {
-		MonoUnwindInfo *cached = cached_info [i];
-
-		if (cached->len == unwind_info_len && memcmp (cached->info, unwind_info, unwind_info_len) == 0) {
+	if (cached_info_hash) {
+		i = unwind_info_hash_find (cached_info_hash, NULL, h, unwind_info, unwind_info_len);
+		if (i != -1) {
 			unwind_unlock ();
 			return i;
 		}
@@ -498,38 +649,14 @@ mono_cache_unwind_info (guint8 *unwind_info, guint32 unwind_info_len)
 
 	cached_info [cached_info_next ++] = info;
 
+	unwind_info_hash_add (h, i);
+
 	unwind_info_size += sizeof (MonoUnwindInfo) + unwind_info_len;
 
 	unwind_unlock ();
 	return i;
 }
 
-static gpointer
-get_hazardous_pointer (gpointer volatile *pp, MonoThreadHazardPointers *hp, int hazard_index)
-{
-	gpointer p;
-
-	for (;;) {
-		/* Get the pointer */
-		p = *pp;
-		/* If we don't have hazard pointers just return the
-		   pointer. */
-		if (!hp)
-			return p;
-		/* Make it hazardous */
-		mono_hazard_pointer_set (hp, hazard_index, p);
-		/* Check that it's still the same.  If not, try
-		   again. */
-		if (*pp != p) {
-			mono_hazard_pointer_clear (hp, hazard_index);
-			continue;
-		}
-		break;
-	}
-
-	return p;
-}
-
 /*
  * This function is signal safe.
  */
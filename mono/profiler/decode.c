@@ -17,6 +17,12 @@
 #endif
 #include <unistd.h>
 #include <stdlib.h>
+#include <signal.h>
+#include <errno.h>
+#ifndef HOST_WIN32
+#include <pthread.h>
+#define USE_READER_THREAD 1
+#endif
 #if defined (HAVE_SYS_ZLIB)
 #include <zlib.h>
 #endif
@@ -41,6 +47,9 @@ static uint64_t time_from = 0;
 static uint64_t time_to = 0xffffffffffffffffULL;
 static uint64_t startup_time = 0;
 static FILE* outfile = NULL;
+static int follow = 0;
+static volatile int stop_following = 0;
+static const char *index_name = NULL;
 
 static int32_t
 read_int16 (unsigned char *p)
@@ -183,10 +192,15 @@ struct _MethodDesc {
 	int len;
 	int recurse_count;
 	int sample_hits;
+	/* samples with the method anywhere in the call chain */
+	int inclusive_hits;
+	int last_sample;
 	uint64_t calls;
 	uint64_t total_time;
 	uint64_t callee_time;
 	uint64_t self_time;
+	uint64_t jit_time;
+	int il_size;
 	TraceDesc traces;
 };
 
@@ -245,6 +259,11 @@ static int num_stat_samples = 0;
 static int size_stat_samples = 0;
 uintptr_t *stat_samples = NULL;
 int *stat_sample_desc = NULL;
+/* the callers of stat_samples [i] are stored in sample_callers starting at stat_sample_callers [i] */
+int *stat_sample_callers = NULL;
+static int num_sample_callers = 0;
+static int size_sample_callers = 0;
+uintptr_t *sample_callers = NULL;
 
 static void
 add_stat_sample (int type, uintptr_t ip) {
@@ -254,11 +273,25 @@ add_stat_sample (int type, uintptr_t ip) {
 		size_stat_samples = 32;
 		stat_samples = realloc (stat_samples, size_stat_samples * sizeof (uintptr_t));
 		stat_sample_desc = realloc (stat_sample_desc, size_stat_samples * sizeof (int));
+		stat_sample_callers = realloc (stat_sample_callers, size_stat_samples * sizeof (int));
 	}
 	stat_samples [num_stat_samples] = ip;
+	stat_sample_callers [num_stat_samples] = num_sample_callers;
 	stat_sample_desc [num_stat_samples++] = type;
 }
 
+/* adds a caller to the last sample added with add_stat_sample () */
+static void
+add_stat_sample_caller (uintptr_t ip) {
+	if (num_sample_callers == size_sample_callers) {
+		size_sample_callers *= 2;
+		if (!size_sample_callers)
+			size_sample_callers = 32;
+		sample_callers = realloc (sample_callers, size_sample_callers * sizeof (uintptr_t));
+	}
+	sample_callers [num_sample_callers++] = ip;
+}
+
 static MethodDesc*
 lookup_method_by_ip (uintptr_t ip)
 {
@@ -278,6 +311,37 @@ lookup_method_by_ip (uintptr_t ip)
 	return NULL;
 }
 
+/* These match the order of MonoProfilerJitPhase in profiler.h */
+static const char *jit_phase_names [] = {
+	"method-to-ir",
+	"inlining",
+	"decompose",
+	"local opts",
+	"branch opts",
+	"loop opts",
+	"ssa",
+	"liveness",
+	"regalloc",
+	"codegen",
+	"jit info"
+};
+#define NUM_JIT_PHASES (sizeof (jit_phase_names) / sizeof (jit_phase_names [0]))
+static uint64_t jit_phase_time [NUM_JIT_PHASES];
+static uint64_t jit_time = 0;
+static int jit_phase_methods = 0;
+
+static int
+compare_method_jit_time (const void *a, const void *b)
+{
+	MethodDesc *const*A = a;
+	MethodDesc *const*B = b;
+	if ((*A)->jit_time == (*B)->jit_time)
+		return 0;
+	if ((*B)->jit_time < (*A)->jit_time)
+		return -1;
+	return 1;
+}
+
 static int
 compare_method_samples (const void *a, const void *b)
 {
@@ -290,6 +354,18 @@ compare_method_samples (const void *a, const void *b)
 	return 1;
 }
 
+static int
+compare_method_inclusive_samples (const void *a, const void *b)
+{
+	MethodDesc *const*A = a;
+	MethodDesc *const*B = b;
+	if ((*A)->inclusive_hits == (*B)->inclusive_hits)
+		return 0;
+	if ((*B)->inclusive_hits < (*A)->inclusive_hits)
+		return -1;
+	return 1;
+}
+
 typedef struct _UnmanagedSymbol UnmanagedSymbol;
 struct _UnmanagedSymbol {
 	UnmanagedSymbol *parent;
@@ -453,6 +529,50 @@ sym_percent (uintptr_t sample_hits)
 	return pc >= 0.1;
 }
 
+/*
+ * When the samples include the managed call chain, count for each method
+ * the samples it appears in, either as the sampled method or as a caller.
+ */
+static void
+dump_inclusive_samples (void)
+{
+	int i, j;
+	int count = 0, msize = 0;
+	MethodDesc** cachedm = NULL;
+	if (!num_sample_callers)
+		return;
+	for (i = 0; i < num_stat_samples; ++i) {
+		int end = i + 1 < num_stat_samples? stat_sample_callers [i + 1]: num_sample_callers;
+		for (j = stat_sample_callers [i] - 1; j < end; ++j) {
+			MethodDesc *m = lookup_method_by_ip (j < stat_sample_callers [i]? stat_samples [i]: sample_callers [j]);
+			/* recursive methods are counted once per sample */
+			if (!m || m->last_sample == i + 1)
+				continue;
+			m->last_sample = i + 1;
+			if (!m->inclusive_hits) {
+				if (count == msize) {
+					msize *= 2;
+					if (!msize)
+						msize = 4;
+					cachedm = realloc (cachedm, sizeof (void*) * msize);
+				}
+				cachedm [count++] = m;
+			}
+			m->inclusive_hits++;
+		}
+	}
+	qsort (cachedm, count, sizeof (MethodDesc*), compare_method_inclusive_samples);
+	fprintf (outfile, "\n\tInclusive managed hits (the method or its callees were executing)\n");
+	fprintf (outfile, "\t%6s %6s %s\n", "Hits", "%", "Method name");
+	for (i = 0; i < count; ++i) {
+		MethodDesc *m = cachedm [i];
+		if (!sym_percent (m->inclusive_hits))
+			break;
+		fprintf (outfile, "\t%6d %6.2f %s\n", m->inclusive_hits, m->inclusive_hits*100.0/num_stat_samples, m->name);
+	}
+	free (cachedm);
+}
+
 static void
 dump_samples (void)
 {
@@ -540,6 +660,7 @@ dump_samples (void)
 			continue;
 		}
 	}
+	dump_inclusive_samples ();
 }
 
 typedef struct _HeapClassDesc HeapClassDesc;
@@ -615,6 +736,8 @@ add_heap_class_rev (HeapClassDesc *from, HeapClassDesc *to)
 typedef struct {
 	uintptr_t objaddr;
 	HeapClassDesc *hklass;
+	/* only set for incremental heap shots, 0 when the object died */
+	uint64_t size;
 	uintptr_t num_refs;
 	uintptr_t refs [0];
 } HeapObjectDesc;
@@ -634,10 +757,13 @@ struct _HeapShot {
 	uintptr_t *roots;
 	uintptr_t *roots_extra;
 	int *roots_types;
+	int incremental;
 };
 
 static HeapShot *heap_shots = NULL;
 static int num_heap_shots = 0;
+/* the last heap shot, with the objects incremental heap shots are based on */
+static HeapShot *heap_shot_base = NULL;
 
 static HeapShot*
 new_heap_shot (uint64_t timestamp)
@@ -750,6 +876,8 @@ heap_shot_find_obj_slot (HeapShot *hs, uintptr_t objaddr)
 	uintptr_t i;
 	uintptr_t start_pos;
 	HeapObjectDesc **hash = hs->objects_hash;
+	if (!hs->objects_hash_size)
+		return -1;
 	start_pos = ((uintptr_t)objaddr >> 3) % hs->objects_hash_size;
 	i = start_pos;
 	do {
@@ -832,6 +960,32 @@ add_heap_shot_obj (HeapShot *hs, HeapObjectDesc *obj)
 	hs->objects_count += add_heap_hashed_obj (hs->objects_hash, hs->objects_hash_size, obj);
 }
 
+static void
+heap_shot_mark_dead (HeapShot *hs, uintptr_t objaddr)
+{
+	uintptr_t i = heap_shot_find_obj_slot (hs, objaddr);
+	if (i != -1)
+		hs->objects_hash [i]->size = 0;
+}
+
+/*
+ * Complete an incremental heap shot with the objects from BASE which
+ * didn't die or change: they are moved from BASE to HS.
+ */
+static void
+heap_shot_add_base_objects (HeapShot *hs, HeapShot *base)
+{
+	uintptr_t i;
+	for (i = 0; i < base->objects_hash_size; ++i) {
+		HeapObjectDesc *ho = base->objects_hash [i];
+		if (!ho || !ho->size || heap_shot_find_obj_slot (hs, ho->objaddr) != -1)
+			continue;
+		ho->hklass = add_heap_shot_class (hs, ho->hklass->klass, ho->size);
+		add_heap_shot_obj (hs, ho);
+		base->objects_hash [i] = NULL;
+	}
+}
+
 static void
 heap_shot_resolve_reverse_refs (HeapShot *hs)
 {
@@ -1009,13 +1163,65 @@ add_backtrace (int count, MethodDesc **methods)
 typedef struct _MonitorDesc MonitorDesc;
 typedef struct _ThreadContext ThreadContext;
 
+/*
+ * The index written with --index: a header followed by a record for each
+ * buffer in the data file. It lets us skip the buffers that don't matter
+ * for the --thread and --time filters without decoding them.
+ */
+#define INDEX_ID 0x4D505249
+#define INDEX_VERSION 2
+
+enum {
+	/* the buffer has metadata, GC, heap or sample events, which are needed regardless of filters */
+	INDEX_BUF_GLOBAL = 1,
+	/* the buffer has method enter/leave, monitor or exception events, which the time filter doesn't apply to */
+	INDEX_BUF_UNTIMED = 2
+};
+
+typedef struct {
+	uint64_t file_offset;
+	uint64_t thread_id;
+	uint64_t time_start;
+	uint64_t time_end;
+	uint32_t len;
+	uint32_t flags;
+} IndexRecord;
+
+/* a buffer read from the data file, the data doesn't include the 48 bytes header */
+typedef struct _BufferData BufferData;
+struct _BufferData {
+	BufferData *next;
+	uint64_t file_offset;
+	unsigned char header [48];
+	unsigned char *data;
+	int size;
+};
+
 typedef struct {
 	FILE *file;
 #if defined (HAVE_SYS_ZLIB)
-	gzFile *gzfile;
+	gzFile gzfile;
 #endif
 	unsigned char *buf;
 	int size;
+	/* buffers read ahead by the reader thread, see next_buffer () */
+	BufferData *queue_head;
+	BufferData *queue_tail;
+	BufferData *free_buffers;
+	int queued;
+	int queued_bytes;
+	int reader_done;
+#ifdef USE_READER_THREAD
+	pthread_t reader;
+	pthread_mutex_t queue_mutex;
+	pthread_cond_t queue_cond;
+#endif
+	/* the index used to skip buffers, with the filters as absolute times */
+	IndexRecord *index;
+	int index_size;
+	uint64_t index_time_from;
+	uint64_t index_time_to;
+	FILE *index_out;
 	int data_version;
 	int version_major;
 	int version_minor;
@@ -1059,25 +1265,314 @@ ensure_buffer (ProfContext *ctx, int size)
 }
 
 static int
-load_data (ProfContext *ctx, int size)
+read_data (ProfContext *ctx, unsigned char *buf, int size)
 {
-	ensure_buffer (ctx, size);
 #if defined (HAVE_SYS_ZLIB)
 	if (ctx->gzfile) {
-		int r = gzread (ctx->gzfile, ctx->buf, size);
+		int r = gzread (ctx->gzfile, buf, size);
 		if (r == 0)
 			return size == 0? 1: 0;
 		return r == size;
 	} else 
 #endif
 	{
-		int r = fread (ctx->buf, size, 1, ctx->file);
+		int r = fread (buf, size, 1, ctx->file);
 		if (r == 0)
 			return size == 0? 1: 0;
 		return r;
 	}
 }
 
+static int
+load_data (ProfContext *ctx, int size)
+{
+	ensure_buffer (ctx, size);
+	return read_data (ctx, ctx->buf, size);
+}
+
+static uint64_t
+data_offset (ProfContext *ctx)
+{
+#ifdef HAVE_SYS_ZLIB
+	if (ctx->gzfile)
+		return gztell (ctx->gzfile);
+#endif
+	return ftello (ctx->file);
+}
+
+static int
+seek_data (ProfContext *ctx, uint64_t offset)
+{
+#ifdef HAVE_SYS_ZLIB
+	/* forward seeks just skip the uncompressed data */
+	if (ctx->gzfile)
+		return gzseek (ctx->gzfile, offset, SEEK_SET) >= 0;
+#endif
+	clearerr (ctx->file);
+	return fseeko (ctx->file, offset, SEEK_SET) == 0;
+}
+
+/*
+ * With --follow we wait at the end of the file for the profiler to write
+ * more data until we are interrupted or the profiled process is gone.
+ */
+static int
+wait_for_data (ProfContext *ctx)
+{
+	if (!follow || stop_following)
+		return 0;
+#ifndef HOST_WIN32
+	if (ctx->pid && kill (ctx->pid, 0) < 0 && errno == ESRCH)
+		return 0;
+#endif
+	sleep (1);
+	return !stop_following;
+}
+
+static int
+read_buffer_data (ProfContext *ctx, BufferData *bd)
+{
+	int len;
+	while (1) {
+		bd->file_offset = data_offset (ctx);
+		if (read_data (ctx, bd->header, 48)) {
+			/* decode_buffer () complains about the bad id */
+			len = read_int32 (bd->header) == BUF_ID? read_int32 (bd->header + 4): 0;
+			if (bd->size < len) {
+				bd->data = realloc (bd->data, len);
+				bd->size = len;
+			}
+			if (read_data (ctx, bd->data, len))
+				return 1;
+		}
+		/* a partial buffer at the end of a file still being written: retry it later */
+		if (!wait_for_data (ctx) || !seek_data (ctx, bd->file_offset))
+			return 0;
+	}
+}
+
+/*
+ * Whether the buffer described by the index record can be skipped when
+ * filtering by thread or time: the output must be the same as when all
+ * the buffers are decoded.
+ */
+static int
+index_skip_buffer (ProfContext *ctx, IndexRecord *rec)
+{
+	int out_of_range;
+	/* the first buffer gives the startup time */
+	if (rec == ctx->index || (rec->flags & INDEX_BUF_GLOBAL))
+		return 0;
+	out_of_range = rec->time_end < ctx->index_time_from || rec->time_start >= ctx->index_time_to;
+	/* the allocations of the other threads are still counted in the time range */
+	if (thread_filter)
+		return rec->thread_id != thread_filter && out_of_range;
+	return !(rec->flags & INDEX_BUF_UNTIMED) && out_of_range;
+}
+
+/*
+ * Reads the next buffer that needs to be decoded. When an index is used,
+ * the buffers it allows to skip aren't even read.
+ */
+static int
+read_next_buffer (ProfContext *ctx, BufferData *bd, int *index_pos)
+{
+	while (*index_pos < ctx->index_size) {
+		IndexRecord *rec = &ctx->index [(*index_pos)++];
+		if (index_skip_buffer (ctx, rec))
+			continue;
+		if (!seek_data (ctx, rec->file_offset))
+			return 0;
+		return read_buffer_data (ctx, bd);
+	}
+	/* past the indexed buffers the file is read sequentially */
+	if (ctx->index_size && *index_pos == ctx->index_size) {
+		IndexRecord *last = &ctx->index [ctx->index_size - 1];
+		(*index_pos)++;
+		if (!seek_data (ctx, last->file_offset + 48 + last->len))
+			return 0;
+	}
+	return read_buffer_data (ctx, bd);
+}
+
+#ifdef USE_READER_THREAD
+/*
+ * The reader thread stays at most this many buffers and bytes ahead of the
+ * decoder: a few buffers are enough to overlap the reading with the decoding
+ * and the peak memory use stays close to the one of the serial decoder.
+ */
+#define MAX_QUEUED_BUFFERS 8
+#define MAX_QUEUED_BYTES (4 * 1024 * 1024)
+
+/*
+ * The reader thread does the file reading and, for compressed files, the
+ * inflating, while the main thread decodes the buffers already read.
+ */
+static void*
+reader_thread (void *arg)
+{
+	ProfContext *ctx = arg;
+	BufferData *bd;
+	int index_pos = 0;
+	while (1) {
+		pthread_mutex_lock (&ctx->queue_mutex);
+		while (ctx->queued >= MAX_QUEUED_BUFFERS || (ctx->queued && ctx->queued_bytes >= MAX_QUEUED_BYTES))
+			pthread_cond_wait (&ctx->queue_cond, &ctx->queue_mutex);
+		bd = ctx->free_buffers;
+		if (bd)
+			ctx->free_buffers = bd->next;
+		pthread_mutex_unlock (&ctx->queue_mutex);
+		if (!bd)
+			bd = calloc (sizeof (BufferData), 1);
+		if (!read_next_buffer (ctx, bd, &index_pos)) {
+			free (bd->data);
+			free (bd);
+			break;
+		}
+		bd->next = NULL;
+		pthread_mutex_lock (&ctx->queue_mutex);
+		if (ctx->queue_tail)
+			ctx->queue_tail->next = bd;
+		else
+			ctx->queue_head = bd;
+		ctx->queue_tail = bd;
+		ctx->queued++;
+		ctx->queued_bytes += bd->size;
+		pthread_cond_broadcast (&ctx->queue_cond);
+		pthread_mutex_unlock (&ctx->queue_mutex);
+	}
+	pthread_mutex_lock (&ctx->queue_mutex);
+	ctx->reader_done = 1;
+	pthread_cond_broadcast (&ctx->queue_cond);
+	pthread_mutex_unlock (&ctx->queue_mutex);
+	return NULL;
+}
+
+static void
+start_reader (ProfContext *ctx)
+{
+	pthread_mutex_init (&ctx->queue_mutex, NULL);
+	pthread_cond_init (&ctx->queue_cond, NULL);
+	if (pthread_create (&ctx->reader, NULL, reader_thread, ctx)) {
+		fprintf (stderr, "Cannot create the reader thread\n");
+		exit (1);
+	}
+}
+
+static BufferData*
+next_buffer (ProfContext *ctx)
+{
+	BufferData *bd;
+	pthread_mutex_lock (&ctx->queue_mutex);
+	while (!ctx->queue_head && !ctx->reader_done)
+		pthread_cond_wait (&ctx->queue_cond, &ctx->queue_mutex);
+	bd = ctx->queue_head;
+	if (bd) {
+		ctx->queue_head = bd->next;
+		if (!ctx->queue_head)
+			ctx->queue_tail = NULL;
+		ctx->queued--;
+		ctx->queued_bytes -= bd->size;
+		pthread_cond_broadcast (&ctx->queue_cond);
+	}
+	pthread_mutex_unlock (&ctx->queue_mutex);
+	return bd;
+}
+
+static void
+release_buffer (ProfContext *ctx, BufferData *bd)
+{
+	pthread_mutex_lock (&ctx->queue_mutex);
+	bd->next = ctx->free_buffers;
+	ctx->free_buffers = bd;
+	pthread_mutex_unlock (&ctx->queue_mutex);
+}
+#else
+static int sync_index_pos;
+
+static void
+start_reader (ProfContext *ctx)
+{
+	ctx->free_buffers = calloc (sizeof (BufferData), 1);
+}
+
+static BufferData*
+next_buffer (ProfContext *ctx)
+{
+	if (ctx->reader_done || !read_next_buffer (ctx, ctx->free_buffers, &sync_index_pos)) {
+		ctx->reader_done = 1;
+		return NULL;
+	}
+	return ctx->free_buffers;
+}
+
+static void
+release_buffer (ProfContext *ctx, BufferData *bd)
+{
+}
+#endif
+
+static int
+load_index (ProfContext *ctx, const char *name)
+{
+	FILE *f = fopen (name, "rb");
+	int32_t header [3];
+	long size;
+	if (!f)
+		return 0;
+	if (fread (header, sizeof (header), 1, f) != 1 || header [0] != INDEX_ID) {
+		fprintf (stderr, "Invalid index file: %s\n", name);
+		exit (1);
+	}
+	/* an index written by another version is created again */
+	if (header [1] != INDEX_VERSION || header [2] != sizeof (IndexRecord)) {
+		fclose (f);
+		return 0;
+	}
+	fseek (f, 0, SEEK_END);
+	size = ftell (f) - sizeof (header);
+	fseek (f, sizeof (header), SEEK_SET);
+	ctx->index_size = size / sizeof (IndexRecord);
+	ctx->index = malloc (ctx->index_size * sizeof (IndexRecord));
+	ctx->index_size = fread (ctx->index, sizeof (IndexRecord), ctx->index_size, f);
+	fclose (f);
+	return 1;
+}
+
+static void
+create_index (ProfContext *ctx, const char *name)
+{
+	int32_t header [3];
+	ctx->index_out = fopen (name, "wb");
+	if (!ctx->index_out) {
+		fprintf (stderr, "Cannot create index file: %s\n", name);
+		exit (1);
+	}
+	header [0] = INDEX_ID;
+	header [1] = INDEX_VERSION;
+	header [2] = sizeof (IndexRecord);
+	fwrite (header, sizeof (header), 1, ctx->index_out);
+}
+
+/*
+ * Uses the index file if it exists and there are filters to apply,
+ * otherwise it is created while decoding.
+ */
+static void
+setup_index (ProfContext *ctx, const char *name)
+{
+	if (!load_index (ctx, name)) {
+		create_index (ctx, name);
+		return;
+	}
+	if (!ctx->index_size || (!thread_filter && !time_from && time_to == 0xffffffffffffffffULL)) {
+		ctx->index_size = 0;
+		return;
+	}
+	ctx->index_time_from = ctx->index [0].time_start + time_from;
+	ctx->index_time_to = time_to == 0xffffffffffffffffULL? time_to: ctx->index [0].time_start + time_to;
+}
+
 static ThreadContext*
 get_thread (ProfContext *ctx, intptr_t thread_id)
 {
@@ -1475,7 +1970,7 @@ found_object (uintptr_t obj)
 }
 
 #define OBJ_ADDR(diff) ((obj_base + diff) << 3)
-#define LOG_TIME(base,diff) /*fprintf("outfile, time %llu + %llu near offset %d\n", base, diff, p - ctx->buf)*/
+#define LOG_TIME(base,diff) /*fprintf("outfile, time %llu + %llu near offset %d\n", base, diff, p - buf)*/
 
 static int
 decode_buffer (ProfContext *ctx)
@@ -1490,21 +1985,21 @@ decode_buffer (ProfContext *ctx)
 	uint64_t file_offset;
 	int len, i;
 	ThreadContext *thread;
+	BufferData *bd;
+	unsigned char *buf;
+	IndexRecord rec;
 
-#ifdef HAVE_SYS_ZLIB
-	if (ctx->gzfile)
-		file_offset = gztell (ctx->gzfile);
-	else
-#endif
-		file_offset = ftell (ctx->file);
-	if (!load_data (ctx, 48))
+	bd = next_buffer (ctx);
+	if (!bd)
 		return 0;
-	p = ctx->buf;
+	file_offset = bd->file_offset;
+	p = bd->header;
 	if (read_int32 (p) != BUF_ID) {
 		fprintf (outfile, "Incorrect buffer id: 0x%x\n", read_int32 (p));
 		for (i = 0; i < 48; ++i) {
 			fprintf (outfile, "0x%x%s", p [i], i % 8?" ":"\n");
 		}
+		release_buffer (ctx, bd);
 		return 0;
 	}
 	len = read_int32 (p + 4);
@@ -1516,8 +2011,11 @@ decode_buffer (ProfContext *ctx)
 	if (debug)
 		fprintf (outfile, "buf: thread:%x, len: %d, time: %llu, file offset: %llu\n", thread_id, len, time_base, file_offset);
 	thread = load_thread (ctx, thread_id);
-	if (!load_data (ctx, len))
-		return 0;
+	rec.file_offset = file_offset;
+	rec.thread_id = thread_id;
+	rec.time_start = time_base;
+	rec.len = len;
+	rec.flags = 0;
 	if (!startup_time) {
 		startup_time = time_base;
 		if (time_from) {
@@ -1529,9 +2027,27 @@ decode_buffer (ProfContext *ctx)
 	}
 	for (i = 0; i < thread->stack_id; ++i)
 		thread->stack [i]->recurse_count++;
-	p = ctx->buf;
+	buf = p = bd->data;
 	end = p + len;
 	while (p < end) {
+		switch (*p & 0xf) {
+		case TYPE_GC:
+		case TYPE_METADATA:
+		case TYPE_HEAP:
+		case TYPE_SAMPLE:
+			rec.flags |= INDEX_BUF_GLOBAL;
+			break;
+		case TYPE_METHOD:
+			if ((*p & 0xf0) == TYPE_JIT)
+				rec.flags |= INDEX_BUF_GLOBAL;
+			else
+				rec.flags |= INDEX_BUF_UNTIMED;
+			break;
+		case TYPE_MONITOR:
+		case TYPE_EXCEPTION:
+			rec.flags |= INDEX_BUF_UNTIMED;
+			break;
+		}
 		switch (*p & 0xf) {
 		case TYPE_GC: {
 			int subtype = *p & 0xf0;
@@ -1708,6 +2224,21 @@ decode_buffer (ProfContext *ctx)
 				add_method (method_base, (char*)p, ptr_base + codediff, codelen);
 				while (*p) p++;
 				p++;
+			} else if (subtype == TYPE_JIT_PHASES) {
+				MethodDesc *method = lookup_method (method_base);
+				int il_size = decode_uleb128 (p, &p);
+				int i, num_phases = decode_uleb128 (p, &p);
+				method->il_size = il_size;
+				for (i = 0; i < num_phases; ++i) {
+					uint64_t t = decode_uleb128 (p, &p);
+					if (i < NUM_JIT_PHASES)
+						jit_phase_time [i] += t;
+					method->jit_time += t;
+					jit_time += t;
+				}
+				jit_phase_methods++;
+				if (debug)
+					fprintf (outfile, "jit phases for method %p, il size: %d\n", (void*)(method_base), il_size);
 			} else {
 				MethodDesc *method;
 				if ((thread_filter && thread_filter != thread->thread_id))
@@ -1738,8 +2269,9 @@ decode_buffer (ProfContext *ctx)
 				ClassDesc *cd = lookup_class (ptr_base + ptrdiff);
 				if (size) {
 					HeapClassDesc *hcd = add_heap_shot_class (thread->current_heap_shot, cd, size);
-					if (collect_traces) {
-						ho = alloc_heap_obj (OBJ_ADDR (objdiff), hcd, num);
+					if (collect_traces || thread->current_heap_shot->incremental) {
+						ho = alloc_heap_obj (OBJ_ADDR (objdiff), hcd, collect_traces? num: 0);
+						ho->size = size;
 						add_heap_shot_obj (thread->current_heap_shot, ho);
 						ref_offset = 0;
 					}
@@ -1775,14 +2307,32 @@ decode_buffer (ProfContext *ctx)
 					if (collect_traces)
 						thread_add_root (thread, OBJ_ADDR (objdiff), root_type, extra_info);
 				}
+			} else if (subtype == TYPE_HEAP_DEAD) {
+				uintptr_t num = decode_uleb128 (p + 1, &p);
+				int i;
+				for (i = 0; i < num; ++i) {
+					intptr_t objdiff = decode_sleb128 (p, &p);
+					if (debug)
+						fprintf (outfile, "object %p died since the last heap shot\n", (void*)OBJ_ADDR (objdiff));
+					if (heap_shot_base)
+						heap_shot_mark_dead (heap_shot_base, OBJ_ADDR (objdiff));
+				}
 			} else if (subtype == TYPE_HEAP_END) {
 				uint64_t tdiff = decode_uleb128 (p + 1, &p);
+				HeapShot *hs = thread->current_heap_shot;
 				LOG_TIME (time_base, tdiff);
 				time_base += tdiff;
 				if (debug)
 					fprintf (outfile, "heap shot end\n");
+				if (hs && hs->incremental) {
+					if (heap_shot_base)
+						heap_shot_add_base_objects (hs, heap_shot_base);
+				}
+				if (heap_shot_base) {
+					heap_shot_free_objects (heap_shot_base);
+					heap_shot_base = NULL;
+				}
 				if (collect_traces) {
-					HeapShot *hs = thread->current_heap_shot;
 					if (hs && thread->num_roots) {
 						/* transfer the root ownershipt to the heapshot */
 						hs->num_roots = thread->num_roots;
@@ -1801,16 +2351,22 @@ decode_buffer (ProfContext *ctx)
 					thread->roots_types = NULL;
 					heap_shot_resolve_reverse_refs (hs);
 					heap_shot_mark_objects (hs);
-					heap_shot_free_objects (hs);
 				}
+				/* the objects are kept to complete the next heap shot */
+				if (hs && hs->incremental)
+					heap_shot_base = hs;
+				else if (hs)
+					heap_shot_free_objects (hs);
 				thread->current_heap_shot = NULL;
 			} else if (subtype == TYPE_HEAP_START) {
 				uint64_t tdiff = decode_uleb128 (p + 1, &p);
+				int flags = ctx->data_version > 5? decode_uleb128 (p, &p): 0;
 				LOG_TIME (time_base, tdiff);
 				time_base += tdiff;
 				if (debug)
-					fprintf (outfile, "heap shot start\n");
+					fprintf (outfile, "heap shot start%s\n", flags & HEAP_SHOT_INCREMENTAL? " (incremental)": "");
 				thread->current_heap_shot = new_heap_shot (time_base);
+				thread->current_heap_shot->incremental = flags & HEAP_SHOT_INCREMENTAL;
 			}
 			break;
 		}
@@ -1928,11 +2484,15 @@ decode_buffer (ProfContext *ctx)
 				int sample_type = decode_uleb128 (p + 1, &p);
 				uint64_t tstamp = decode_uleb128 (p, &p);
 				int count = decode_uleb128 (p, &p);
+				/* the first address is the sampled one, the others its managed callers */
 				for (i = 0; i < count; ++i) {
 					uintptr_t ip = ptr_base + decode_sleb128 (p, &p);
-					add_stat_sample (sample_type, ip);
+					if (i == 0)
+						add_stat_sample (sample_type, ip);
+					else
+						add_stat_sample_caller (ip);
 					if (debug)
-						fprintf (outfile, "sample hit, type: %d at %p\n", sample_type, (void*)ip);
+						fprintf (outfile, "sample %s, type: %d at %p\n", i? "caller": "hit", sample_type, (void*)ip);
 				}
 			} else if (subtype == TYPE_SAMPLE_USYM) {
 				/* un unmanaged symbol description */
@@ -1966,13 +2526,18 @@ decode_buffer (ProfContext *ctx)
 			break;
 		}
 		default:
-			fprintf (outfile, "unhandled profiler event: 0x%x at file offset: %llu + %d (len: %d\n)\n", *p, file_offset, p - ctx->buf, len);
+			fprintf (outfile, "unhandled profiler event: 0x%x at file offset: %llu + %ld (len: %d\n)\n", *p, file_offset, (long)(p - buf), len);
 			exit (1);
 		}
 	}
 	thread->last_time = time_base;
 	for (i = 0; i < thread->stack_id; ++i)
 		thread->stack [i]->recurse_count = 0;
+	if (ctx->index_out) {
+		rec.time_end = time_base;
+		fwrite (&rec, sizeof (rec), 1, ctx->index_out);
+	}
+	release_buffer (ctx, bd);
 	return 1;
 }
 
@@ -1981,16 +2546,22 @@ load_file (char *name)
 {
 	unsigned char *p;
 	ProfContext *ctx = calloc (sizeof (ProfContext), 1);
-	if (strcmp (name, "-") == 0)
+	if (strcmp (name, "-") == 0) {
+		if (follow) {
+			printf ("Cannot follow the standard input.\n");
+			exit (1);
+		}
 		ctx->file = stdin;
-	else
+	} else {
 		ctx->file = fopen (name, "rb");
+	}
 	if (!ctx->file) {
 		printf ("Cannot open file: %s\n", name);
 		exit (1);
 	}
 #if defined (HAVE_SYS_ZLIB)
-	if (ctx->file != stdin)
+	/* a compressed file can't be followed while being written */
+	if (ctx->file != stdin && !follow)
 		ctx->gzfile = gzdopen (fileno (ctx->file), "rb");
 #endif
 	if (!load_data (ctx, 32))
@@ -2184,6 +2755,25 @@ dump_jit (void)
 	}
 	fprintf (outfile, "\tCompiled methods: %d\n", compiled_methods);
 	fprintf (outfile, "\tGenerated code size: %d\n", code_size);
+	if (jit_phase_methods) {
+		MethodDesc **methods;
+		int c = 0;
+		fprintf (outfile, "\tJIT time: %.3f ms\n", jit_time/1000000.0);
+		for (i = 0; i < NUM_JIT_PHASES; ++i)
+			fprintf (outfile, "\t\t%-14s %10.3f ms (%5.2f%%)\n", jit_phase_names [i], jit_phase_time [i]/1000000.0, jit_time? jit_phase_time [i] * 100.0 / jit_time: 0.0);
+		methods = malloc (num_methods * sizeof (void*));
+		for (i = 0; i < HASH_SIZE; ++i) {
+			for (m = method_hash [i]; m; m = m->next) {
+				if (m->jit_time)
+					methods [c++] = m;
+			}
+		}
+		qsort (methods, c, sizeof (void*), compare_method_jit_time);
+		fprintf (outfile, "\t%10s %8s Slowest methods to compile\n", "JIT(ms)", "IL size");
+		for (i = 0; i < c && (verbose || i < 10); ++i)
+			fprintf (outfile, "\t%10.3f %8d %s\n", methods [i]->jit_time/1000000.0, methods [i]->il_size, methods [i]->name);
+		free (methods);
+	}
 }
 
 static void
@@ -2577,10 +3167,20 @@ usage (void)
 	printf ("\t                     S:minimum_size or T:partial_name\n");
 	printf ("\t--thread=THREADID    consider just the data for thread THREADID\n");
 	printf ("\t--time=FROM-TO       consider data FROM seconds from startup up to TO seconds\n");
+	printf ("\t--index=FILE        use the buffer index in FILE to skip data not matching --thread\n");
+	printf ("\t                     and --time, the index is created if FILE doesn't exist\n");
+	printf ("\t--follow             keep reading data as it is written by the profiled program,\n");
+	printf ("\t                     reporting when it exits or on SIGINT\n");
 	printf ("\t--verbose            increase verbosity level\n");
 	printf ("\t--debug              display decoding debug info for mprof-report devs\n");
 }
 
+static void
+stop_follow (int sig)
+{
+	stop_following = 1;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -2674,6 +3274,10 @@ main (int argc, char *argv[])
 			}
 			time_from = from_secs * 1000000000;
 			time_to = to_secs * 1000000000;
+		} else if (strncmp ("--index=", argv [i], 8) == 0) {
+			index_name = argv [i] + 8;
+		} else if (strcmp ("--follow", argv [i]) == 0) {
+			follow = 1;
 		} else if (strcmp ("--verbose", argv [i]) == 0) {
 			verbose++;
 		} else if (strcmp ("--traces", argv [i]) == 0) {
@@ -2692,7 +3296,14 @@ main (int argc, char *argv[])
 		printf ("Not a log profiler data file (or unsupported version).\n");
 		return 1;
 	}
+	if (index_name)
+		setup_index (ctx, index_name);
+	if (follow)
+		signal (SIGINT, stop_follow);
+	start_reader (ctx);
 	while (decode_buffer (ctx));
+	if (ctx->index_out)
+		fclose (ctx->index_out);
 	flush_context (ctx);
 	if (num_tracked_objects)
 		return 0;
@@ -7,8 +7,30 @@
  * This profiler collects profiling information usable by the Mono AOT compiler
  * to generate better code. It saves the information into files under ~/.mono. 
  * The AOT compiler can load these files during compilation.
- * Currently, only the order in which methods were compiled is saved, 
- * allowing more efficient function ordering in the AOT files.
+ * The order in which methods were compiled is saved, allowing more efficient
+ * function ordering in the AOT files, together with the generic instances and
+ * wrappers which were compiled, so 'mono --aot=profile-only' can restrict
+ * compilation to the code which actually runs.
+ *
+ * File format (version 4):
+ * "#VER:4\n" followed by a sequence of records, all integers are little endian:
+ * [kind: byte]
+ *   METHOD:  [methoddef token: int32]
+ *   GINST:   [image name: string] [methoddef token: int32] [class inst] [method inst]
+ *   WRAPPER: [wrapper type: byte] [methoddef token: int32]
+ * An inst is [type argc: byte] followed by type_argc types, an empty inst means
+ * no instantiation. A type is [MONO_TYPE_: byte] followed by:
+ *   CLASS/VALUETYPE: [image name: string] [typedef token: int32]
+ *   GENERICINST: [container image name: string] [typedef token: int32] [inst]
+ *   SZARRAY/PTR: [element type]
+ *   ARRAY: [rank: byte] [element type]
+ * Strings are [length: int32] followed by the bytes, without a terminating 0.
+ * The wrapper token refers to the wrapped method, or for delegate wrappers to
+ * the Invoke/BeginInvoke/EndInvoke method of the delegate.
+ * A generic instance is saved in the profile of the image of its declaring method
+ * and in the profiles of the images of its type arguments, so instances like
+ * List<T> over an application type end up in the profile of the application.
+ * The AOT compiler in mini/aot-compiler.c must be kept in sync with this.
  */
 
 #include <config.h>
@@ -17,12 +39,21 @@
 #include <mono/metadata/tabledefs.h>
 #include <mono/metadata/debug-helpers.h>
 #include <mono/metadata/assembly.h>
+#include <mono/metadata/class-internals.h>
 #include <string.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <glib.h>
 #include <sys/stat.h>
 
+#define PROFILE_VERSION 4
+
+enum {
+	PROFILE_RECORD_METHOD = 1,
+	PROFILE_RECORD_GINST = 2,
+	PROFILE_RECORD_WRAPPER = 3
+};
+
 struct _MonoProfiler {
 	GHashTable *images;
 };
@@ -38,19 +69,223 @@ typedef struct ForeachData {
 	MonoMethod *method;
 } ForeachData;
 
+static void
+emit_byte (FILE *outfile, int val)
+{
+	fputc (val, outfile);
+}
+
+static void
+emit_int32 (FILE *outfile, guint32 val)
+{
+	fputc (val & 0xff, outfile);
+	fputc ((val >> 8) & 0xff, outfile);
+	fputc ((val >> 16) & 0xff, outfile);
+	fputc ((val >> 24) & 0xff, outfile);
+}
+
+static void
+emit_string (FILE *outfile, const char *s)
+{
+	int len = strlen (s);
+
+	emit_int32 (outfile, len);
+	fwrite (s, 1, len, outfile);
+}
+
+static gboolean inst_is_encodable (MonoGenericInst *inst);
+
+/*
+ * type_is_encodable:
+ *
+ *   Return whenever T can be written to the profile. Open types and types
+ * which can't be looked up by token are not saved.
+ */
+static gboolean
+type_is_encodable (MonoType *t)
+{
+	if (t->byref)
+		return FALSE;
+
+	switch (t->type) {
+	case MONO_TYPE_BOOLEAN:
+	case MONO_TYPE_CHAR:
+	case MONO_TYPE_I1:
+	case MONO_TYPE_U1:
+	case MONO_TYPE_I2:
+	case MONO_TYPE_U2:
+	case MONO_TYPE_I4:
+	case MONO_TYPE_U4:
+	case MONO_TYPE_I8:
+	case MONO_TYPE_U8:
+	case MONO_TYPE_R4:
+	case MONO_TYPE_R8:
+	case MONO_TYPE_I:
+	case MONO_TYPE_U:
+	case MONO_TYPE_STRING:
+	case MONO_TYPE_OBJECT:
+		return TRUE;
+	case MONO_TYPE_CLASS:
+	case MONO_TYPE_VALUETYPE:
+		return t->data.klass->type_token && !t->data.klass->image->dynamic;
+	case MONO_TYPE_GENERICINST: {
+		MonoClass *container = t->data.generic_class->container_class;
+
+		return container->type_token && !container->image->dynamic && inst_is_encodable (t->data.generic_class->context.class_inst);
+	}
+	case MONO_TYPE_SZARRAY:
+		return type_is_encodable (&t->data.klass->byval_arg);
+	case MONO_TYPE_ARRAY:
+		return type_is_encodable (&t->data.array->eklass->byval_arg);
+	case MONO_TYPE_PTR:
+		return type_is_encodable (t->data.type);
+	default:
+		return FALSE;
+	}
+}
+
+static gboolean
+inst_is_encodable (MonoGenericInst *inst)
+{
+	int i;
+
+	if (!inst)
+		return TRUE;
+	if (inst->type_argc > 255)
+		return FALSE;
+	for (i = 0; i < inst->type_argc; ++i)
+		if (!type_is_encodable (inst->type_argv [i]))
+			return FALSE;
+	return TRUE;
+}
+
+static void emit_inst (FILE *outfile, MonoGenericInst *inst);
+
+static void
+emit_type (FILE *outfile, MonoType *t)
+{
+	emit_byte (outfile, t->type);
+
+	switch (t->type) {
+	case MONO_TYPE_CLASS:
+	case MONO_TYPE_VALUETYPE:
+		emit_string (outfile, mono_image_get_name (t->data.klass->image));
+		emit_int32 (outfile, t->data.klass->type_token);
+		break;
+	case MONO_TYPE_GENERICINST: {
+		MonoClass *container = t->data.generic_class->container_class;
+
+		emit_string (outfile, mono_image_get_name (container->image));
+		emit_int32 (outfile, container->type_token);
+		emit_inst (outfile, t->data.generic_class->context.class_inst);
+		break;
+	}
+	case MONO_TYPE_SZARRAY:
+		emit_type (outfile, &t->data.klass->byval_arg);
+		break;
+	case MONO_TYPE_ARRAY:
+		emit_byte (outfile, t->data.array->rank);
+		emit_type (outfile, &t->data.array->eklass->byval_arg);
+		break;
+	case MONO_TYPE_PTR:
+		emit_type (outfile, t->data.type);
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+emit_inst (FILE *outfile, MonoGenericInst *inst)
+{
+	int i;
+
+	if (!inst) {
+		emit_byte (outfile, 0);
+		return;
+	}
+	emit_byte (outfile, inst->type_argc);
+	for (i = 0; i < inst->type_argc; ++i)
+		emit_type (outfile, inst->type_argv [i]);
+}
+
+/*
+ * get_wrapped_method:
+ *
+ *   Return the methoddef a wrapper can be recreated from by the AOT compiler,
+ * or NULL. This mirrors mono_marshal_method_from_wrapper (), which is not
+ * exported from the runtime.
+ */
+static MonoMethod*
+get_wrapped_method (MonoMethod *method)
+{
+	MonoClass *klass = mono_method_get_class (method);
+	void **data;
+
+	switch (method->wrapper_type) {
+	case MONO_WRAPPER_SYNCHRONIZED:
+	case MONO_WRAPPER_MANAGED_TO_NATIVE:
+		if (method->is_inflated)
+			return NULL;
+		data = ((MonoMethodWrapper *)method)->method_data;
+		if (!data || GPOINTER_TO_UINT (data [0]) < 1)
+			return NULL;
+		return data [1];
+	case MONO_WRAPPER_DELEGATE_INVOKE:
+		return klass->delegate ? mono_get_delegate_invoke (klass) : NULL;
+	case MONO_WRAPPER_DELEGATE_BEGIN_INVOKE:
+		return klass->delegate ? mono_class_get_method_from_name (klass, "BeginInvoke", -1) : NULL;
+	case MONO_WRAPPER_DELEGATE_END_INVOKE:
+		return klass->delegate ? mono_class_get_method_from_name (klass, "EndInvoke", -1) : NULL;
+	default:
+		return NULL;
+	}
+}
+
 static void
 foreach_method (gpointer data, gpointer user_data)
 {
 	ForeachData *udata = (ForeachData*)user_data;
 	MonoMethod *method = (MonoMethod*)data;
-	char *name;
+	MonoMethod *declaring;
+	MonoGenericContext *ctx;
+
+	if (method->wrapper_type) {
+		MonoMethod *wrapped = get_wrapped_method (method);
+
+		if (!wrapped || !mono_method_get_token (wrapped) || mono_class_get_image (mono_method_get_class (wrapped)) != udata->image)
+			return;
+		if (wrapped->is_inflated || wrapped->is_generic || mono_method_get_class (wrapped)->generic_container)
+			return;
+
+		emit_byte (udata->outfile, PROFILE_RECORD_WRAPPER);
+		emit_byte (udata->outfile, method->wrapper_type);
+		emit_int32 (udata->outfile, mono_method_get_token (wrapped));
+		return;
+	}
+
+	if (method->is_inflated) {
+		declaring = ((MonoMethodInflated*)method)->declaring;
+		ctx = &((MonoMethodInflated*)method)->context;
+
+		if (!mono_method_get_token (declaring) || mono_class_get_image (mono_method_get_class (declaring))->dynamic)
+			return;
+		if (!inst_is_encodable (ctx->class_inst) || !inst_is_encodable (ctx->method_inst))
+			return;
+
+		emit_byte (udata->outfile, PROFILE_RECORD_GINST);
+		emit_string (udata->outfile, mono_image_get_name (mono_class_get_image (mono_method_get_class (declaring))));
+		emit_int32 (udata->outfile, mono_method_get_token (declaring));
+		emit_inst (udata->outfile, ctx->class_inst);
+		emit_inst (udata->outfile, ctx->method_inst);
+		return;
+	}
 
 	if (!mono_method_get_token (method) || mono_class_get_image (mono_method_get_class (method)) != udata->image)
 		return;
 
-	name = mono_method_full_name (method, TRUE);
-	fprintf (udata->outfile, "%s\n", name);
-	g_free (name);
+	emit_byte (udata->outfile, PROFILE_RECORD_METHOD);
+	emit_int32 (udata->outfile, mono_method_get_token (method));
 }
 
 static void
@@ -90,16 +325,22 @@ output_image (gpointer key, gpointer value, gpointer user_data)
 
 	printf ("Creating output file: %s\n", outfile_name);
 
-	outfile = fopen (outfile_name, "w+");
+	outfile = fopen (outfile_name, "wb+");
 	g_assert (outfile);
 
-	fprintf (outfile, "#VER:%d\n", 2);
+	fprintf (outfile, "#VER:%d\n", PROFILE_VERSION);
 
 	data.prof = prof;
 	data.outfile = outfile;
 	data.image = image;
 
+	/* The list is built in reverse to keep prof_jit_leave () O(1) */
+	image_data->methods = g_list_reverse (image_data->methods);
 	g_list_foreach (image_data->methods, foreach_method, &data);
+
+	fclose (outfile);
+	g_free (outfile_name);
+	g_free (tmp);
 }
 
 /* called at the end of the program */
@@ -115,9 +356,8 @@ prof_jit_enter (MonoProfiler *prof, MonoMethod *method)
 }
 
 static void
-prof_jit_leave (MonoProfiler *prof, MonoMethod *method, int result)
+add_image_method (MonoProfiler *prof, MonoImage *image, MonoMethod *method)
 {
-	MonoImage *image = mono_class_get_image (mono_method_get_class (method));
 	PerImageData *data;
 
 	data = g_hash_table_lookup (prof->images, image);
@@ -126,7 +366,82 @@ prof_jit_leave (MonoProfiler *prof, MonoMethod *method, int result)
 		g_hash_table_insert (prof->images, image, data);
 	}
 
-	data->methods = g_list_append (data->methods, method);
+	data->methods = g_list_prepend (data->methods, method);
+}
+
+static void collect_inst_images (MonoGenericInst *inst, GSList **images);
+
+/*
+ * collect_type_images:
+ *
+ *   Add the images of the classes T refers to to IMAGES.
+ */
+static void
+collect_type_images (MonoType *t, GSList **images)
+{
+	MonoImage *image;
+
+	switch (t->type) {
+	case MONO_TYPE_CLASS:
+	case MONO_TYPE_VALUETYPE:
+		image = t->data.klass->image;
+		break;
+	case MONO_TYPE_GENERICINST:
+		image = t->data.generic_class->container_class->image;
+		collect_inst_images (t->data.generic_class->context.class_inst, images);
+		break;
+	case MONO_TYPE_SZARRAY:
+		collect_type_images (&t->data.klass->byval_arg, images);
+		return;
+	case MONO_TYPE_ARRAY:
+		collect_type_images (&t->data.array->eklass->byval_arg, images);
+		return;
+	case MONO_TYPE_PTR:
+		collect_type_images (t->data.type, images);
+		return;
+	default:
+		return;
+	}
+
+	if (!image->dynamic && !g_slist_find (*images, image))
+		*images = g_slist_prepend (*images, image);
+}
+
+static void
+collect_inst_images (MonoGenericInst *inst, GSList **images)
+{
+	int i;
+
+	if (!inst)
+		return;
+	for (i = 0; i < inst->type_argc; ++i)
+		collect_type_images (inst->type_argv [i], images);
+}
+
+static void
+prof_jit_leave (MonoProfiler *prof, MonoMethod *method, int result)
+{
+	MonoImage *image = mono_class_get_image (mono_method_get_class (method));
+	MonoGenericContext *ctx;
+	GSList *images, *l;
+
+	if (!method->is_inflated || method->wrapper_type) {
+		add_image_method (prof, image, method);
+		return;
+	}
+
+	/*
+	 * The AOT compiler can only add an instance to the images it compiles, and in
+	 * profile-only mode it only adds the ones in their profile, so an instance is
+	 * saved for every image its instantiation refers to.
+	 */
+	ctx = &((MonoMethodInflated*)method)->context;
+	images = g_slist_prepend (NULL, image);
+	collect_inst_images (ctx->class_inst, &images);
+	collect_inst_images (ctx->method_inst, &images);
+	for (l = images; l; l = l->next)
+		add_image_method (prof, l->data, method);
+	g_slist_free (images);
 }
 
 void
@@ -23,6 +23,9 @@
 #if defined(HOST_WIN32) || defined(DISABLE_SOCKETS)
 #define DISABLE_HELPER_THREAD 1
 #endif
+#ifdef HOST_WIN32
+#define DISABLE_WRITER_THREAD 1
+#endif
 
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
@@ -61,6 +64,11 @@
 #include <zlib.h>
 #endif
 
+#ifndef HOST_WIN32
+#include "mono/io-layer/atomic.h"
+#endif
+#define cmp_exchange InterlockedCompareExchangePointer
+
 /* the architecture needs a memory fence */
 #if defined(__linux__) && (defined(__i386__) || defined(__x86_64__))
 #include "perf_event.h"
@@ -74,6 +82,7 @@ static int notraces = 0;
 static int use_zip = 0;
 static int do_report = 0;
 static int do_heap_shot = 0;
+static int heap_shot_incremental = 0;
 static int max_call_depth = 100;
 static int runtime_inited = 0;
 static int command_port = 0;
@@ -83,6 +92,19 @@ static int sample_freq = 0;
 static int do_mono_sample = 0;
 static int in_shutdown = 0;
 static int do_debug = 0;
+/* buffers the writer thread may lag behind before mutators write them themselves */
+static int max_queued_buffers = 256;
+static volatile int queued_buffers = 0;
+static volatile int writer_stalls = 0;
+/* mutators which may still write to writer_pipes, see stop_writer_thread () */
+static volatile int writer_notifiers = 0;
+static volatile int lost_sample_hits = 0;
+/* managed frames recorded with each statistical sample */
+static int sample_frames = 0;
+static int alloc_sample_bytes = 0;
+/* start a new output file after this many bytes, keeping at most max_files */
+static uint64_t max_file_size = 0;
+static int max_files = 4;
 
 /* For linux compile with:
  * gcc -fPIC -shared -o libmono-profiler-log.so proflog.c utils.c -Wall -g -lz `pkg-config --cflags --libs mono-2`
@@ -222,7 +244,7 @@ typedef struct _LogBuffer LogBuffer;
  *
  * type method format:
  * type: TYPE_METHOD
- * exinfo: one of: TYPE_LEAVE, TYPE_ENTER, TYPE_EXC_LEAVE, TYPE_JIT
+ * exinfo: one of: TYPE_LEAVE, TYPE_ENTER, TYPE_EXC_LEAVE, TYPE_JIT, TYPE_JIT_PHASES
  * [time diff: uleb128] nanoseconds since last timing
  * [method: sleb128] MonoMethod* as a pointer difference from the last such
  * pointer or the buffer method_base
@@ -230,6 +252,11 @@ typedef struct _LogBuffer LogBuffer;
  *	[code address: sleb128] pointer to the native code as a diff from ptr_base
  *	[code size: uleb128] size of the generated code
  *	[name: string] full method name
+ * if exinfo == TYPE_JIT_PHASES
+ *	[il size: uleb128] size of the IL code of the method
+ *	[num_phases: uleb128] number of phase timings that follow
+ *	[phase time: uleb128]* nanoseconds spent in each phase, in the order of
+ *	MonoProfilerJitPhase in profiler.h
  *
  * type exception format:
  * type: TYPE_EXCEPTION
@@ -257,6 +284,8 @@ typedef struct _LogBuffer LogBuffer;
  * exinfo: one of TYPE_HEAP_START, TYPE_HEAP_END, TYPE_HEAP_OBJECT, TYPE_HEAP_ROOT
  * if exinfo == TYPE_HEAP_START
  * 	[time diff: uleb128] nanoseconds since last timing
+ * 	if (format version > 5) [flags: uleb128] HEAP_SHOT_INCREMENTAL if only
+ * 	the objects that changed since the previous heap shot are recorded
  * if exinfo == TYPE_HEAP_END
  * 	[time diff: uleb128] nanoseconds since last timing
  * if exinfo == TYPE_HEAP_OBJECT
@@ -278,6 +307,13 @@ typedef struct _LogBuffer LogBuffer;
  * 	[root_type: uleb128] the root_type: MonoProfileGCRootType (profiler.h)
  * 	[extra_info: uleb128] the extra_info value
  * 	object, root_type_extra_info are repeated num_roots times
+ * if exinfo == TYPE_HEAP_DEAD
+ * 	[num_objects: uleb128] number of objects
+ * 	[object: sleb128]* the objects as a difference from obj_base
+ * 	In an incremental heap shot, the objects from the previous heap shot
+ * 	which are not alive anymore (or were moved). The objects from the
+ * 	previous heap shot which are neither listed here nor recorded again
+ * 	with TYPE_HEAP_OBJECT are unchanged.
  *
  * type sample format
  * type: TYPE_SAMPLE
@@ -301,6 +337,8 @@ typedef struct _LogBuffer LogBuffer;
  */
 struct _LogBuffer {
 	LogBuffer *next;
+	/* link in the writer thread queue, valid only for the first buffer of a chain */
+	LogBuffer *queue_next;
 	uint64_t time_base;
 	uint64_t last_time;
 	uintptr_t ptr_base;
@@ -341,16 +379,25 @@ struct _MonoProfiler {
 	StatBuffer *stat_buffers;
 	FILE* file;
 #if defined (HAVE_SYS_ZLIB)
-	gzFile *gzfile;
+	gzFile gzfile;
 #endif
 	uint64_t startup_time;
 	int pipe_output;
+	/* rolling output state, see rotate_output () */
+	char *file_name;
+	int file_index;
+	uint64_t file_written;
 	int last_gc_gen_started;
 	int command_port;
 	int server_socket;
 	int pipes [2];
 #ifndef HOST_WIN32
 	pthread_t helper_thread;
+#endif
+#ifndef DISABLE_WRITER_THREAD
+	int writer_pipes [2];
+	int writer_running;
+	pthread_t writer_thread;
 #endif
 	BinaryObject *binary_objects;
 };
@@ -539,6 +586,21 @@ write_int64 (char *buf, int64_t value)
 	return buf + 8;
 }
 
+static void
+write_output (MonoProfiler *profiler, const void *data, int size)
+{
+#if defined (HAVE_SYS_ZLIB)
+	if (profiler->gzfile) {
+		gzwrite (profiler->gzfile, data, size);
+	} else {
+		fwrite (data, size, 1, profiler->file);
+	}
+#else
+	fwrite (data, size, 1, profiler->file);
+#endif
+	profiler->file_written += size;
+}
+
 static void
 dump_header (MonoProfiler *profiler)
 {
@@ -555,24 +617,14 @@ dump_header (MonoProfiler *profiler)
 	p = write_int32 (p, process_id ()); /* pid */
 	p = write_int16 (p, profiler->command_port); /* port */
 	p = write_int16 (p, 0); /* opsystem */
-#if defined (HAVE_SYS_ZLIB)
-	if (profiler->gzfile) {
-		gzwrite (profiler->gzfile, hbuf, p - hbuf);
-	} else {
-		fwrite (hbuf, p - hbuf, 1, profiler->file);
-	}
-#else
-	fwrite (hbuf, p - hbuf, 1, profiler->file);
-#endif
+	write_output (profiler, hbuf, p - hbuf);
 }
 
 static void
-dump_buffer (MonoProfiler *profiler, LogBuffer *buf)
+write_buffer (MonoProfiler *profiler, LogBuffer *buf)
 {
 	char hbuf [128];
 	char *p = hbuf;
-	if (buf->next)
-		dump_buffer (profiler, buf->next);
 	p = write_int32 (p, BUF_ID);
 	p = write_int32 (p, buf->data - buf->buf);
 	p = write_int64 (p, buf->time_base);
@@ -580,18 +632,132 @@ dump_buffer (MonoProfiler *profiler, LogBuffer *buf)
 	p = write_int64 (p, buf->obj_base);
 	p = write_int64 (p, buf->thread_id);
 	p = write_int64 (p, buf->method_base);
-#if defined (HAVE_SYS_ZLIB)
-	if (profiler->gzfile) {
-		gzwrite (profiler->gzfile, hbuf, p - hbuf);
-		gzwrite (profiler->gzfile, buf->buf, buf->data - buf->buf);
-	} else {
+	write_output (profiler, hbuf, p - hbuf);
+	write_output (profiler, buf->buf, buf->data - buf->buf);
+}
+
+static void
+dump_buffer (MonoProfiler *profiler, LogBuffer *buf)
+{
+	if (buf->next)
+		dump_buffer (profiler, buf->next);
+	write_buffer (profiler, buf);
+	free_buffer (buf, buf->size);
+}
+
+/*
+ * With a rolling output each file must be decodable on its own, so the
+ * image, class, method and thread descriptions are also kept in this
+ * chain, which is written after the header of every new file.
+ * Accessed with metadata_lock held: it is separate from the output lock
+ * so the mutators don't wait for the file writes. The chain is limited
+ * to max_file_size bytes, the descriptions past that are only written to
+ * the current file.
+ */
+static LogBuffer *metadata_buffer = NULL;
+static uint64_t metadata_size = 0;
+
+#ifndef HOST_WIN32
+static pthread_mutex_t metadata_lock = PTHREAD_MUTEX_INITIALIZER;
+#define take_metadata_lock() pthread_mutex_lock (&metadata_lock)
+#define release_metadata_lock() pthread_mutex_unlock (&metadata_lock)
+#else
+/* without the writer thread the mutators take the output lock anyway */
+#define take_metadata_lock() take_lock ()
+#define release_metadata_lock() release_lock ()
 #endif
-		fwrite (hbuf, p - hbuf, 1, profiler->file);
-		fwrite (buf->buf, buf->data - buf->buf, 1, profiler->file);
+
+/*
+ * Return a metadata buffer with room for BYTES, or NULL if the chain
+ * reached its size limit.
+ */
+static LogBuffer*
+ensure_metadata_buffer (int bytes)
+{
+	LogBuffer *old = metadata_buffer;
+	if (old && old->data + bytes + 100 < old->data_end)
+		return old;
+	if (metadata_size + BUFFER_SIZE > max_file_size) {
+		if (metadata_size <= max_file_size) {
+			fprintf (stderr, "Log profiler: the metadata is larger than maxsize, rotated files will miss some descriptions\n");
+			/* warn once */
+			metadata_size = max_file_size + 1;
+		}
+		return NULL;
+	}
+	metadata_size += BUFFER_SIZE;
+	metadata_buffer = create_buffer ();
+	metadata_buffer->thread_id = thread_id ();
+	metadata_buffer->next = old;
+	return metadata_buffer;
+}
+
+static void
+write_metadata_buffers (MonoProfiler *profiler, LogBuffer *buf)
+{
+	if (!buf)
+		return;
+	write_metadata_buffers (profiler, buf->next);
+	write_buffer (profiler, buf);
+}
+
+static char*
+rolling_file_name (MonoProfiler *profiler, int index)
+{
+	int len = strlen (profiler->file_name) + 16;
+	char *name = malloc (len);
+	if (index)
+		snprintf (name, len, "%s.%d", profiler->file_name, index);
+	else
+		snprintf (name, len, "%s", profiler->file_name);
+	return name;
+}
+
+/* set when the output is rotated: the next heap shot can't refer to the previous file, see heap_walk () */
+static volatile int hs_objects_reset = 0;
+
+/*
+ * Called with the output lock held after a buffer chain has been written:
+ * once the current file reached max_file_size, switch to the next one of
+ * the max_files names, overwriting the data it held before.
+ */
+static void
+rotate_output (MonoProfiler *profiler)
+{
+	FILE *f;
+	char *name;
+	int index;
+	if (!profiler->file_name || profiler->file_written < max_file_size)
+		return;
+	index = (profiler->file_index + 1) % max_files;
+	name = rolling_file_name (profiler, index);
+	unlink (name);
+	f = fopen (name, "wb");
+	if (!f) {
+		fprintf (stderr, "Cannot create profiler output: %s, the output won't be rotated anymore\n", name);
+		free (name);
+		free (profiler->file_name);
+		profiler->file_name = NULL;
+		return;
+	}
+	free (name);
 #if defined (HAVE_SYS_ZLIB)
+	if (profiler->gzfile) {
+		gzclose (profiler->gzfile);
+		profiler->gzfile = gzdopen (dup (fileno (f)), "wb");
 	}
 #endif
-	free_buffer (buf, buf->size);
+	fclose (profiler->file);
+	profiler->file = f;
+	profiler->file_index = index;
+	profiler->file_written = 0;
+	dump_header (profiler);
+	take_metadata_lock ();
+	write_metadata_buffers (profiler, metadata_buffer);
+	release_metadata_lock ();
+	/* the replayed metadata doesn't count, or a large one would rotate the output after every write */
+	profiler->file_written = 0;
+	hs_objects_reset = 1;
 }
 
 static void
@@ -607,6 +773,147 @@ runtime_initialized (MonoProfiler *profiler)
 	runtime_inited = 1;
 }
 
+#ifndef DISABLE_WRITER_THREAD
+/*
+ * Full buffer chains are handed to the writer thread through a lock-free
+ * list: mutators push at the head with a CAS and whoever writes them out
+ * detaches the whole list and reverses it, so the chains hit the file in
+ * the order they were queued. The detach happens with the output lock held
+ * so batches taken by the writer thread and by a stalled mutator can't be
+ * reordered either.
+ */
+static LogBuffer * volatile writer_queue = NULL;
+
+static void
+write_queued_buffers (MonoProfiler *profiler)
+{
+	LogBuffer *head, *prev, *next;
+	int count = 0;
+	take_lock ();
+	do {
+		head = writer_queue;
+	} while (cmp_exchange ((gpointer volatile*)&writer_queue, NULL, head) != head);
+	for (prev = NULL; head; head = next) {
+		next = head->queue_next;
+		head->queue_next = prev;
+		prev = head;
+	}
+	for (head = prev; head; head = next) {
+		LogBuffer *buf;
+		next = head->queue_next;
+		for (buf = head; buf; buf = buf->next)
+			count++;
+		dump_buffer (profiler, head);
+		if (max_file_size)
+			rotate_output (profiler);
+	}
+	release_lock ();
+	if (count)
+		InterlockedExchangeAdd (&queued_buffers, -count);
+}
+
+static void
+enqueue_buffer (MonoProfiler *profiler, LogBuffer *logbuffer)
+{
+	LogBuffer *head, *buf;
+	int count = 0;
+	for (buf = logbuffer; buf; buf = buf->next)
+		count++;
+	do {
+		head = writer_queue;
+		logbuffer->queue_next = head;
+	} while (cmp_exchange ((gpointer volatile*)&writer_queue, logbuffer, head) != head);
+	InterlockedIncrement (&writer_notifiers);
+	if (!profiler->writer_running || in_shutdown) {
+		InterlockedDecrement (&writer_notifiers);
+		InterlockedExchangeAdd (&queued_buffers, count);
+		write_queued_buffers (profiler);
+		return;
+	}
+	if (InterlockedExchangeAdd (&queued_buffers, count) + count > max_queued_buffers) {
+		/* the writer thread fell behind: pay for the write here instead of growing the queue */
+		InterlockedDecrement (&writer_notifiers);
+		InterlockedIncrement (&writer_stalls);
+		write_queued_buffers (profiler);
+		return;
+	}
+	/* the writer drains the whole list, so it needs a wakeup only when the list was empty */
+	if (!head) {
+		char c = 0;
+		write (profiler->writer_pipes [1], &c, 1);
+	}
+	InterlockedDecrement (&writer_notifiers);
+}
+
+static void*
+writer_thread (void *arg)
+{
+	MonoProfiler *prof = arg;
+	char c;
+	int r;
+	while (1) {
+		r = read (prof->writer_pipes [0], &c, 1);
+		if (r < 0 && errno == EINTR)
+			continue;
+		write_queued_buffers (prof);
+		/* time to shut down */
+		if (r != 1 || c)
+			break;
+	}
+	if (do_debug)
+		fprintf (stderr, "writer shutdown\n");
+	return NULL;
+}
+
+static void
+start_writer_thread (MonoProfiler* prof)
+{
+	if (pipe (prof->writer_pipes) < 0) {
+		fprintf (stderr, "Cannot create writer pipe, buffers will be written synchronously\n");
+		return;
+	}
+	if (pthread_create (&prof->writer_thread, NULL, writer_thread, prof)) {
+		close (prof->writer_pipes [0]);
+		close (prof->writer_pipes [1]);
+		return;
+	}
+	prof->writer_running = 1;
+}
+
+static void
+stop_writer_thread (MonoProfiler* prof)
+{
+	char c = 1;
+	void *res;
+	if (!prof->writer_running)
+		return;
+	/*
+	 * From now on mutators write their buffers themselves, but the ones which
+	 * saw the writer running can still be about to notify it: wait for them
+	 * before closing the pipe.
+	 */
+	InterlockedExchange (&prof->writer_running, 0);
+	write (prof->writer_pipes [1], &c, 1);
+	pthread_join (prof->writer_thread, &res);
+	while (writer_notifiers)
+		usleep (1000);
+	close (prof->writer_pipes [0]);
+	close (prof->writer_pipes [1]);
+	/* pick up anything queued while the writer was exiting */
+	write_queued_buffers (prof);
+}
+#else
+static void
+enqueue_buffer (MonoProfiler *profiler, LogBuffer *logbuffer)
+{
+	take_lock ();
+	dump_buffer (profiler, logbuffer);
+	if (max_file_size)
+		rotate_output (profiler);
+	release_lock ();
+}
+#endif
+
 /*
  * Can be called only at safe callback locations.
  */
@@ -614,16 +921,14 @@ static void
 safe_dump (MonoProfiler *profiler, LogBuffer *logbuffer)
 {
 	int cd = logbuffer->call_depth;
-	take_lock ();
-	dump_buffer (profiler, TLS_GET (tlsbuffer));
-	release_lock ();
+	enqueue_buffer (profiler, TLS_GET (tlsbuffer));
 	TLS_SET (tlsbuffer, NULL);
 	init_thread ();
 	TLS_GET (tlsbuffer)->call_depth = cd;
 }
 
-static int
-gc_reference (MonoObject *obj, MonoClass *klass, uintptr_t size, uintptr_t num, MonoObject **refs, uintptr_t *offsets, void *data)
+static void
+emit_heap_object (MonoObject *obj, MonoClass *klass, uintptr_t size, uintptr_t num, MonoObject **refs, uintptr_t *offsets)
 {
 	int i;
 	uintptr_t last_offset = 0;
@@ -644,6 +949,176 @@ gc_reference (MonoObject *obj, MonoClass *klass, uintptr_t size, uintptr_t num,
 	}
 	//if (num)
 	//	printf ("obj: %p, klass: %s, refs: %d, size: %d\n", obj, name, (int)num, (int)size);
+}
+
+/*
+ * For incremental heap shots we keep, for each object recorded in the
+ * previous heap shot, a hash of its class, size and references: objects
+ * which didn't change are not recorded again.
+ */
+typedef struct {
+	uintptr_t obj;
+	uint64_t hash;
+	uint32_t shot;
+} HeapShotObject;
+
+static HeapShotObject *hs_objects = NULL;
+static uintptr_t num_hs_objects = 0;
+static uintptr_t size_hs_objects = 0;
+static uint32_t hs_shot_id = 0;
+
+/* the references of the object being walked, the GC reports them in chunks */
+static MonoObject *hs_obj = NULL;
+static MonoClass *hs_obj_class;
+static uintptr_t hs_obj_size;
+static uintptr_t hs_obj_num_refs;
+static uintptr_t hs_obj_refs_size = 0;
+static MonoObject **hs_obj_refs = NULL;
+static uintptr_t *hs_obj_offsets = NULL;
+
+/* the same chunk size used by the GC heap walk */
+#define HS_REFS_CHUNK 128
+
+static HeapShotObject*
+find_hs_object (HeapShotObject *hash, uintptr_t hsize, uintptr_t obj)
+{
+	uintptr_t i;
+	uintptr_t start_pos;
+	start_pos = (obj >> 3) % hsize;
+	i = start_pos;
+	do {
+		if (!hash [i].obj || hash [i].obj == obj)
+			return &hash [i];
+		/* wrap around */
+		if (++i == hsize)
+			i = 0;
+	} while (i != start_pos);
+	/* should not happen */
+	printf ("failed heap shot object lookup\n");
+	return NULL;
+}
+
+/*
+ * Resize the table to hold at least COUNT objects, dropping the objects
+ * which were not seen in the current heap shot if DROP_DEAD is set.
+ */
+static void
+resize_hs_objects (uintptr_t count, int drop_dead)
+{
+	uintptr_t i;
+	HeapShotObject *n;
+	uintptr_t new_size = 16;
+	while (new_size < count * 2)
+		new_size *= 2;
+	n = calloc (sizeof (HeapShotObject) * new_size, 1);
+	num_hs_objects = 0;
+	for (i = 0; i < size_hs_objects; ++i) {
+		if (hs_objects [i].obj && (!drop_dead || hs_objects [i].shot == hs_shot_id)) {
+			*find_hs_object (n, new_size, hs_objects [i].obj) = hs_objects [i];
+			num_hs_objects++;
+		}
+	}
+	free (hs_objects);
+	hs_objects = n;
+	size_hs_objects = new_size;
+}
+
+static uint64_t
+hash_heap_object (void)
+{
+	uintptr_t i;
+	uint64_t h = (uintptr_t)hs_obj_class;
+	h = h * 31 + hs_obj_size;
+	h = h * 31 + hs_obj_num_refs;
+	for (i = 0; i < hs_obj_num_refs; ++i) {
+		h = h * 31 + (uintptr_t)hs_obj_refs [i];
+		h = h * 31 + hs_obj_offsets [i];
+	}
+	return h;
+}
+
+static void
+flush_heap_object (void)
+{
+	uintptr_t i, num;
+	uint64_t h;
+	HeapShotObject *hso;
+	if (!hs_obj)
+		return;
+	h = hash_heap_object ();
+	if (num_hs_objects * 2 >= size_hs_objects)
+		resize_hs_objects (num_hs_objects * 2, 0);
+	hso = find_hs_object (hs_objects, size_hs_objects, (uintptr_t)hs_obj);
+	if (hso->obj && hso->hash == h) {
+		hso->shot = hs_shot_id;
+		hs_obj = NULL;
+		return;
+	}
+	if (!hso->obj)
+		num_hs_objects++;
+	hso->obj = (uintptr_t)hs_obj;
+	hso->hash = h;
+	hso->shot = hs_shot_id;
+	for (i = 0; i == 0 || i < hs_obj_num_refs; i += num) {
+		num = MIN (hs_obj_num_refs - i, HS_REFS_CHUNK);
+		emit_heap_object (hs_obj, hs_obj_class, i? 0: hs_obj_size, num, hs_obj_refs + i, hs_obj_offsets + i);
+	}
+	hs_obj = NULL;
+}
+
+/*
+ * Emit the objects from the previous heap shot which weren't found by
+ * the heap walk and drop them from the table.
+ */
+static void
+emit_dead_objects (void)
+{
+	uintptr_t i, j, num_dead = 0;
+	LogBuffer *logbuffer;
+	for (i = 0; i < size_hs_objects; ++i) {
+		if (hs_objects [i].obj && hs_objects [i].shot != hs_shot_id)
+			num_dead++;
+	}
+	for (i = 0; num_dead;) {
+		uintptr_t num = MIN (num_dead, HS_REFS_CHUNK);
+		logbuffer = ensure_logbuf (10 + num * 10);
+		emit_byte (logbuffer, TYPE_HEAP_DEAD | TYPE_HEAP);
+		emit_value (logbuffer, num);
+		for (j = 0; j < num; ++i) {
+			if (hs_objects [i].obj && hs_objects [i].shot != hs_shot_id) {
+				emit_obj (logbuffer, (void*)hs_objects [i].obj);
+				j++;
+			}
+		}
+		num_dead -= num;
+	}
+	if (size_hs_objects)
+		resize_hs_objects (num_hs_objects, 1);
+}
+
+static int
+gc_reference (MonoObject *obj, MonoClass *klass, uintptr_t size, uintptr_t num, MonoObject **refs, uintptr_t *offsets, void *data)
+{
+	if (!heap_shot_incremental) {
+		emit_heap_object (obj, klass, size, num, refs, offsets);
+		return 0;
+	}
+	/* more references for the current object come with size == 0 */
+	if (size) {
+		flush_heap_object ();
+		hs_obj = obj;
+		hs_obj_class = klass;
+		hs_obj_size = size;
+		hs_obj_num_refs = 0;
+	}
+	if (hs_obj_num_refs + num > hs_obj_refs_size) {
+		hs_obj_refs_size = MAX (hs_obj_refs_size * 2, hs_obj_num_refs + num);
+		hs_obj_refs = realloc (hs_obj_refs, hs_obj_refs_size * sizeof (MonoObject*));
+		hs_obj_offsets = realloc (hs_obj_offsets, hs_obj_refs_size * sizeof (uintptr_t));
+	}
+	memcpy (hs_obj_refs + hs_obj_num_refs, refs, num * sizeof (MonoObject*));
+	memcpy (hs_obj_offsets + hs_obj_num_refs, offsets, num * sizeof (uintptr_t));
+	hs_obj_num_refs += num;
 	return 0;
 }
 
@@ -657,6 +1132,7 @@ static void
 heap_walk (MonoProfiler *profiler)
 {
 	int do_walk = 0;
+	int incremental;
 	uint64_t now;
 	LogBuffer *logbuffer;
 	if (!do_heap_shot)
@@ -675,9 +1151,25 @@ heap_walk (MonoProfiler *profiler)
 	if (!do_walk)
 		return;
 	heapshot_requested = 0;
+	incremental = heap_shot_incremental;
+	if (incremental && hs_objects_reset) {
+		/* with an empty table all the objects are emitted, making this a full heap shot */
+		hs_objects_reset = 0;
+		free (hs_objects);
+		hs_objects = NULL;
+		num_hs_objects = 0;
+		size_hs_objects = 0;
+		incremental = 0;
+	}
 	emit_byte (logbuffer, TYPE_HEAP_START | TYPE_HEAP);
 	emit_time (logbuffer, now);
+	emit_value (logbuffer, incremental? HEAP_SHOT_INCREMENTAL: 0);
+	hs_shot_id++;
 	mono_gc_walk_heap (0, gc_reference, NULL);
+	if (heap_shot_incremental) {
+		flush_heap_object ();
+		emit_dead_objects ();
+	}
 	logbuffer = ensure_logbuf (10);
 	now = current_time ();
 	emit_byte (logbuffer, TYPE_HEAP_END | TYPE_HEAP);
@@ -770,11 +1262,10 @@ emit_bt (LogBuffer *logbuffer, FrameData *data)
 }
 
 static void
-gc_alloc (MonoProfiler *prof, MonoObject *obj, MonoClass *klass)
+log_alloc (MonoProfiler *prof, MonoObject *obj, MonoClass *klass, int do_bt)
 {
 	uint64_t now;
 	uintptr_t len;
-	int do_bt = (nocalls && runtime_inited && !notraces)? TYPE_ALLOC_BT: 0;
 	FrameData data;
 	LogBuffer *logbuffer;
 	len = mono_object_get_size (obj);
@@ -796,10 +1287,28 @@ gc_alloc (MonoProfiler *prof, MonoObject *obj, MonoClass *klass)
 	EXIT_LOG (logbuffer);
 	if (logbuffer->next)
 		safe_dump (prof, logbuffer);
+}
+
+static void
+gc_alloc (MonoProfiler *prof, MonoObject *obj, MonoClass *klass)
+{
+	log_alloc (prof, obj, klass, (nocalls && runtime_inited && !notraces)? TYPE_ALLOC_BT: 0);
 	process_requests (prof);
 	//printf ("gc alloc %s at %p\n", mono_class_get_name (klass), obj);
 }
 
+/*
+ * Called by the GC for an object every alloc_sample_bytes allocated by a
+ * thread: these events have the same format as the ones emitted by
+ * gc_alloc (), but with the backtrace collected even when method calls are
+ * recorded, since the sampled mode doesn't usually record them.
+ */
+static void
+gc_alloc_sample (MonoProfiler *prof, MonoObject *obj, MonoClass *klass)
+{
+	log_alloc (prof, obj, klass, (runtime_inited && !notraces)? TYPE_ALLOC_BT: 0);
+}
+
 static void
 gc_moves (MonoProfiler *prof, void **objects, int num)
 {
@@ -892,6 +1401,18 @@ type_name (MonoClass *klass)
 	return p;
 }
 
+static void
+emit_image (LogBuffer *logbuffer, uint64_t now, MonoImage *image, const char *name, int nlen)
+{
+	emit_byte (logbuffer, TYPE_END_LOAD | TYPE_METADATA);
+	emit_time (logbuffer, now);
+	emit_byte (logbuffer, TYPE_IMAGE);
+	emit_ptr (logbuffer, image);
+	emit_value (logbuffer, 0); /* flags */
+	memcpy (logbuffer->data, name, nlen);
+	logbuffer->data += nlen;
+}
+
 static void
 image_loaded (MonoProfiler *prof, MonoImage *image, int result)
 {
@@ -906,18 +1427,32 @@ image_loaded (MonoProfiler *prof, MonoImage *image, int result)
 	logbuffer = ensure_logbuf (16 + nlen);
 	now = current_time ();
 	ENTER_LOG (logbuffer, "image");
+	emit_image (logbuffer, now, image, name, nlen);
+	//printf ("loaded image %p (%s)\n", image, name);
+	EXIT_LOG (logbuffer);
+	if (max_file_size) {
+		LogBuffer *mbuffer;
+		take_metadata_lock ();
+		if ((mbuffer = ensure_metadata_buffer (16 + nlen)))
+			emit_image (mbuffer, current_time (), image, name, nlen);
+		release_metadata_lock ();
+	}
+	if (logbuffer->next)
+		safe_dump (prof, logbuffer);
+	process_requests (prof);
+}
+
+static void
+emit_class (LogBuffer *logbuffer, uint64_t now, MonoClass *klass, MonoImage *image, const char *name, int nlen)
+{
 	emit_byte (logbuffer, TYPE_END_LOAD | TYPE_METADATA);
 	emit_time (logbuffer, now);
-	emit_byte (logbuffer, TYPE_IMAGE);
+	emit_byte (logbuffer, TYPE_CLASS);
+	emit_ptr (logbuffer, klass);
 	emit_ptr (logbuffer, image);
 	emit_value (logbuffer, 0); /* flags */
 	memcpy (logbuffer->data, name, nlen);
 	logbuffer->data += nlen;
-	//printf ("loaded image %p (%s)\n", image, name);
-	EXIT_LOG (logbuffer);
-	if (logbuffer->next)
-		safe_dump (prof, logbuffer);
-	process_requests (prof);
 }
 
 static void
@@ -939,15 +1474,15 @@ class_loaded (MonoProfiler *prof, MonoClass *klass, int result)
 	logbuffer = ensure_logbuf (24 + nlen);
 	now = current_time ();
 	ENTER_LOG (logbuffer, "class");
-	emit_byte (logbuffer, TYPE_END_LOAD | TYPE_METADATA);
-	emit_time (logbuffer, now);
-	emit_byte (logbuffer, TYPE_CLASS);
-	emit_ptr (logbuffer, klass);
-	emit_ptr (logbuffer, image);
-	emit_value (logbuffer, 0); /* flags */
-	memcpy (logbuffer->data, name, nlen);
-	logbuffer->data += nlen;
+	emit_class (logbuffer, now, klass, image, name, nlen);
 	//printf ("loaded class %p (%s)\n", klass, name);
+	if (max_file_size) {
+		LogBuffer *mbuffer;
+		take_metadata_lock ();
+		if ((mbuffer = ensure_metadata_buffer (24 + nlen)))
+			emit_class (mbuffer, current_time (), klass, image, name, nlen);
+		release_metadata_lock ();
+	}
 	if (runtime_inited)
 		mono_free (name);
 	else
@@ -1011,6 +1546,18 @@ method_exc_leave (MonoProfiler *prof, MonoMethod *method)
 	process_requests (prof);
 }
 
+static void
+emit_jitted_method (LogBuffer *logbuffer, uint64_t now, MonoMethod *method, MonoJitInfo* jinfo, const char *name, int nlen)
+{
+	emit_byte (logbuffer, TYPE_JIT | TYPE_METHOD);
+	emit_time (logbuffer, now);
+	emit_method (logbuffer, method);
+	emit_ptr (logbuffer, mono_jit_info_get_code_start (jinfo));
+	emit_value (logbuffer, mono_jit_info_get_code_size (jinfo));
+	memcpy (logbuffer->data, name, nlen);
+	logbuffer->data += nlen;
+}
+
 static void
 method_jitted (MonoProfiler *prof, MonoMethod *method, MonoJitInfo* jinfo, int result)
 {
@@ -1025,20 +1572,39 @@ method_jitted (MonoProfiler *prof, MonoMethod *method, MonoJitInfo* jinfo, int r
 	logbuffer = ensure_logbuf (32 + nlen);
 	now = current_time ();
 	ENTER_LOG (logbuffer, "jit");
-	emit_byte (logbuffer, TYPE_JIT | TYPE_METHOD);
-	emit_time (logbuffer, now);
-	emit_method (logbuffer, method);
-	emit_ptr (logbuffer, mono_jit_info_get_code_start (jinfo));
-	emit_value (logbuffer, mono_jit_info_get_code_size (jinfo));
-	memcpy (logbuffer->data, name, nlen);
-	logbuffer->data += nlen;
-	mono_free (name);
+	emit_jitted_method (logbuffer, now, method, jinfo, name, nlen);
 	EXIT_LOG (logbuffer);
+	if (max_file_size) {
+		LogBuffer *mbuffer;
+		take_metadata_lock ();
+		if ((mbuffer = ensure_metadata_buffer (32 + nlen)))
+			emit_jitted_method (mbuffer, current_time (), method, jinfo, name, nlen);
+		release_metadata_lock ();
+	}
+	mono_free (name);
 	if (logbuffer->next)
 		safe_dump (prof, logbuffer);
 	process_requests (prof);
 }
 
+static void
+method_jit_phases (MonoProfiler *prof, MonoMethod *method, int il_size, const uint64_t *phase_times)
+{
+	uint64_t now;
+	int i;
+	LogBuffer *logbuffer = ensure_logbuf (32 + MONO_PROFILER_JIT_PHASE_LAST * 10);
+	now = current_time ();
+	ENTER_LOG (logbuffer, "jitphases");
+	emit_byte (logbuffer, TYPE_JIT_PHASES | TYPE_METHOD);
+	emit_time (logbuffer, now);
+	emit_method (logbuffer, method);
+	emit_value (logbuffer, il_size);
+	emit_value (logbuffer, MONO_PROFILER_JIT_PHASE_LAST);
+	for (i = 0; i < MONO_PROFILER_JIT_PHASE_LAST; ++i)
+		emit_uvalue (logbuffer, phase_times [i]);
+	EXIT_LOG (logbuffer);
+}
+
 static void
 throw_exc (MonoProfiler *prof, MonoObject *object)
 {
@@ -1106,22 +1672,14 @@ thread_start (MonoProfiler *prof, uintptr_t tid)
 static void
 thread_end (MonoProfiler *prof, uintptr_t tid)
 {
-	take_lock ();
 	if (TLS_GET (tlsbuffer))
-		dump_buffer (prof, TLS_GET (tlsbuffer));
-	release_lock ();
+		enqueue_buffer (prof, TLS_GET (tlsbuffer));
 	TLS_SET (tlsbuffer, NULL);
 }
 
 static void
-thread_name (MonoProfiler *prof, uintptr_t tid, const char *name)
+emit_thread_name (LogBuffer *logbuffer, uint64_t now, uintptr_t tid, const char *name, int len)
 {
-	int len = strlen (name) + 1;
-	uint64_t now;
-	LogBuffer *logbuffer;
-	logbuffer = ensure_logbuf (10 + len);
-	now = current_time ();
-	ENTER_LOG (logbuffer, "tname");
 	emit_byte (logbuffer, TYPE_METADATA);
 	emit_time (logbuffer, now);
 	emit_byte (logbuffer, TYPE_THREAD);
@@ -1129,13 +1687,28 @@ thread_name (MonoProfiler *prof, uintptr_t tid, const char *name)
 	emit_value (logbuffer, 0); /* flags */
 	memcpy (logbuffer->data, name, len);
 	logbuffer->data += len;
+}
+
+static void
+thread_name (MonoProfiler *prof, uintptr_t tid, const char *name)
+{
+	int len = strlen (name) + 1;
+	uint64_t now;
+	LogBuffer *logbuffer;
+	logbuffer = ensure_logbuf (10 + len);
+	now = current_time ();
+	ENTER_LOG (logbuffer, "tname");
+	emit_thread_name (logbuffer, now, tid, name, len);
 	EXIT_LOG (logbuffer);
+	if (max_file_size) {
+		LogBuffer *mbuffer;
+		take_metadata_lock ();
+		if ((mbuffer = ensure_metadata_buffer (10 + len)))
+			emit_thread_name (mbuffer, current_time (), tid, name, len);
+		release_metadata_lock ();
+	}
 }
 
-#ifndef HOST_WIN32
-#include "mono/io-layer/atomic.h"
-#endif
-#define cmp_exchange InterlockedCompareExchangePointer
 /*#else
 static void*
 cmp_exchange (volatile void **dest, void *exch, void *comp)
@@ -1155,19 +1728,25 @@ cmp_exchange (volatile void **dest, void *exch, void *comp)
 #endif
 */
 
+/*
+ * Stores a sample in the stat buffers: ips [0] is the address where the
+ * thread was interrupted, the following ones its managed callers.
+ * Called from the signal handler.
+ */
 static void
-mono_sample_hit (MonoProfiler *profiler, unsigned char *ip, void *context)
+record_sample (MonoProfiler *profiler, unsigned char **ips, int count)
 {
 	StatBuffer *sbuf;
 	uint64_t now;
 	uintptr_t *data, *new_data, *old_data;
+	int i;
 	if (in_shutdown)
 		return;
 	now = current_time ();
 	if (do_debug) {
 		int len;
 		char buf [256];
-		snprintf (buf, sizeof (buf), "hit at %p in thread %p at %llu\n", ip, (void*)thread_id (), (unsigned long long int)now);
+		snprintf (buf, sizeof (buf), "hit at %p in thread %p at %llu (%d frames)\n", ips [0], (void*)thread_id (), (unsigned long long int)now, count);
 		len = strlen (buf);
 		write (2, buf, len);
 	}
@@ -1191,15 +1770,31 @@ mono_sample_hit (MonoProfiler *profiler, unsigned char *ip, void *context)
 	}
 	do {
 		old_data = sbuf->data;
-		new_data = old_data + 4;
+		new_data = old_data + count + 3;
 		data = cmp_exchange ((volatile void**)&sbuf->data, new_data, old_data);
 	} while (data != old_data);
-	if (old_data >= sbuf->data_end)
-		return; /* lost event */
-	old_data [0] = 1 | (sample_type << 16);
+	if (new_data > sbuf->data_end) {
+		/* lost event */
+		InterlockedIncrement (&lost_sample_hits);
+		return;
+	}
+	old_data [0] = count | (sample_type << 16);
 	old_data [1] = thread_id ();
 	old_data [2] = (now - profiler->startup_time) / 10000;
-	old_data [3] = (uintptr_t)ip;
+	for (i = 0; i < count; ++i)
+		old_data [i + 3] = (uintptr_t)ips [i];
+}
+
+static void
+mono_sample_hit (MonoProfiler *profiler, unsigned char *ip, void *context)
+{
+	record_sample (profiler, &ip, 1);
+}
+
+static void
+mono_sample_hit_chain (MonoProfiler *profiler, int call_chain_depth, unsigned char **ips, void *context)
+{
+	record_sample (profiler, ips, call_chain_depth);
 }
 
 static uintptr_t *code_pages = 0;
@@ -1520,7 +2115,7 @@ dump_unmanaged_coderefs (MonoProfiler *prof)
 static void
 dump_sample_hits (MonoProfiler *prof, StatBuffer *sbuf, int recurse)
 {
-	uintptr_t *sample;
+	uintptr_t *sample, *data_end;
 	LogBuffer *logbuffer;
 	if (!sbuf)
 		return;
@@ -1529,11 +2124,13 @@ dump_sample_hits (MonoProfiler *prof, StatBuffer *sbuf, int recurse)
 		free_buffer (sbuf->next, sbuf->next->size);
 		sbuf->next = NULL;
 	}
-	for (sample = sbuf->buf; sample < sbuf->data;) {
+	/* data goes past data_end when samples were lost */
+	data_end = sbuf->data < sbuf->data_end? sbuf->data: sbuf->data_end;
+	for (sample = sbuf->buf; sample < data_end;) {
 		int i;
 		int count = sample [0] & 0xffff;
 		int type = sample [0] >> 16;
-		if (sample + count + 3 > sbuf->data)
+		if (sample + count + 3 > data_end)
 			break;
 		logbuffer = ensure_logbuf (20 + count * 8);
 		emit_byte (logbuffer, TYPE_SAMPLE | TYPE_SAMPLE_HIT);
@@ -1743,11 +2340,16 @@ log_shutdown (MonoProfiler *prof)
 		read_perf_mmap (prof);
 #endif
 	dump_sample_hits (prof, prof->stat_buffers, 1);
+#ifndef DISABLE_WRITER_THREAD
+	stop_writer_thread (prof);
+#endif
 	take_lock ();
 	if (TLS_GET (tlsbuffer))
 		dump_buffer (prof, TLS_GET (tlsbuffer));
 	TLS_SET (tlsbuffer, NULL);
 	release_lock ();
+	if (writer_stalls || lost_sample_hits || do_debug)
+		fprintf (stderr, "Log profiler: the writer thread fell behind %d times, %d sample hits were lost\n", writer_stalls, lost_sample_hits);
 #if defined (HAVE_SYS_ZLIB)
 	if (prof->gzfile)
 		gzclose (prof->gzfile);
@@ -1756,6 +2358,12 @@ log_shutdown (MonoProfiler *prof)
 		pclose (prof->file);
 	else
 		fclose (prof->file);
+	while (metadata_buffer) {
+		LogBuffer *next = metadata_buffer->next;
+		free_buffer (metadata_buffer, metadata_buffer->size);
+		metadata_buffer = next;
+	}
+	free (prof->file_name);
 	free (prof);
 }
 
@@ -2014,9 +2622,18 @@ create_profiler (const char *filename)
 		fprintf (stderr, "Cannot create profiler output: %s\n", nf);
 		exit (1);
 	}
+	if (max_file_size) {
+		if (prof->pipe_output) {
+			fprintf (stderr, "The maxsize profiler option is ignored when writing to a program.\n");
+			max_file_size = 0;
+		} else {
+			prof->file_name = pstrdup (nf);
+		}
+	}
 #if defined (HAVE_SYS_ZLIB)
+	/* gzclose () closes the descriptor it was given, the FILE is closed separately */
 	if (use_zip)
-		prof->gzfile = gzdopen (fileno (prof->file), "wb");
+		prof->gzfile = gzdopen (dup (fileno (prof->file)), "wb");
 #endif
 #if USE_PERF_EVENTS
 	if (sample_type && !do_mono_sample)
@@ -2041,6 +2658,9 @@ create_profiler (const char *filename)
 #endif
 	prof->startup_time = current_time ();
 	dump_header (prof);
+#ifndef DISABLE_WRITER_THREAD
+	start_writer_thread (prof);
+#endif
 	return prof;
 }
 
@@ -2055,15 +2675,25 @@ usage (int do_exit)
 	printf ("\t[no]calls        enable/disable recording enter/leave method events\n");
 	printf ("\theapshot[=MODE]  record heap shot info (by default at each major collection)\n");
 	printf ("\t                 MODE: every XXms milliseconds, every YYgc collections, ondemand\n");
+	printf ("\theapshot-delta[=MODE] like heapshot, but record only the objects which\n");
+	printf ("\t                 changed since the previous heap shot\n");
 	printf ("\tsample[=TYPE]    use statistical sampling mode (by default cycles/1000)\n");
 	printf ("\t                 TYPE: cycles,instr,cacherefs,cachemiss,branches,branchmiss\n");
 	printf ("\t                 TYPE can be followed by /FREQUENCY\n");
+	printf ("\tsampleframes=NUM record up to NUM managed callers with each sample (cycles only)\n");
+	printf ("\tallocsample[=BYTES] record an allocation with its backtrace every BYTES\n");
+	printf ("\t                 allocated by a thread (by default 524288, sgen only)\n");
+	printf ("\tcontinuous       low overhead mode for long running processes, same as:\n");
+	printf ("\t                 sample,sampleframes=16,allocsample,maxsize=64\n");
 	printf ("\ttime=fast        use a faster (but more inaccurate) timer\n");
 	printf ("\tmaxframes=NUM    collect up to NUM stack frames\n");
 	printf ("\tcalldepth=NUM    ignore method events for call chain depth bigger than NUM\n");
 	printf ("\toutput=FILENAME  write the data to file FILENAME (-FILENAME to overwrite)\n");
 	printf ("\toutput=|PROGRAM  write the data to the stdin of PROGRAM\n");
 	printf ("\t                 %%t is subtituted with date and time, %%p with the pid\n");
+	printf ("\tmaxsize=MB       start a new output file each MB megabytes, the files are\n");
+	printf ("\t                 FILENAME, FILENAME.1 ... and older ones are overwritten\n");
+	printf ("\tmaxfiles=NUM     keep at most NUM output files with maxsize (default 4)\n");
 	printf ("\treport           create a report instead of writing the raw data to a file\n");
 	printf ("\tzip              compress the output data\n");
 	printf ("\tport=PORTNUM     use PORTNUM for the listening command server\n");
@@ -2264,6 +2894,16 @@ mono_profiler_startup (const char *desc)
 			do_debug = 1;
 			continue;
 		}
+		/* must come before "heapshot", which is a prefix */
+		if ((opt = match_option (p, "heapshot-delta", &val)) != p) {
+			events &= ~MONO_PROFILE_ALLOCATIONS;
+			events &= ~MONO_PROFILE_ENTER_LEAVE;
+			nocalls = 1;
+			do_heap_shot = 1;
+			heap_shot_incremental = 1;
+			set_hsmode (val, 1);
+			continue;
+		}
 		if ((opt = match_option (p, "heapshot", &val)) != p) {
 			events &= ~MONO_PROFILE_ALLOCATIONS;
 			events &= ~MONO_PROFILE_ENTER_LEAVE;
@@ -2272,6 +2912,15 @@ mono_profiler_startup (const char *desc)
 			set_hsmode (val, 1);
 			continue;
 		}
+		/* must come before "sample", which is a prefix */
+		if ((opt = match_option (p, "sampleframes", &val)) != p) {
+			char *end;
+			sample_frames = strtoul (val, &end, 10);
+			if (sample_frames > MONO_PROFILER_MAX_STAT_CALL_CHAIN_DEPTH)
+				sample_frames = MONO_PROFILER_MAX_STAT_CALL_CHAIN_DEPTH;
+			free (val);
+			continue;
+		}
 		if ((opt = match_option (p, "sample", &val)) != p) {
 			events &= ~MONO_PROFILE_ALLOCATIONS;
 			events &= ~MONO_PROFILE_ENTER_LEAVE;
@@ -2279,6 +2928,39 @@ mono_profiler_startup (const char *desc)
 			set_sample_mode (val, 1);
 			continue;
 		}
+		if ((opt = match_option (p, "allocsample", &val)) != p) {
+			char *end;
+			alloc_sample_bytes = 512 * 1024;
+			if (val) {
+				alloc_sample_bytes = strtoul (val, &end, 10);
+				free (val);
+			}
+			continue;
+		}
+		if ((opt = match_option (p, "continuous", NULL)) != p) {
+			events &= ~MONO_PROFILE_ALLOCATIONS;
+			events &= ~MONO_PROFILE_ENTER_LEAVE;
+			nocalls = 1;
+			set_sample_mode (NULL, 1);
+			sample_frames = 16;
+			alloc_sample_bytes = 512 * 1024;
+			max_file_size = 64 * 1024 * 1024;
+			continue;
+		}
+		if ((opt = match_option (p, "maxsize", &val)) != p) {
+			char *end;
+			max_file_size = (uint64_t)strtoul (val, &end, 10) * 1024 * 1024;
+			free (val);
+			continue;
+		}
+		if ((opt = match_option (p, "maxfiles", &val)) != p) {
+			char *end;
+			max_files = strtoul (val, &end, 10);
+			if (max_files < 1)
+				max_files = 1;
+			free (val);
+			continue;
+		}
 		if ((opt = match_option (p, "hsmode", &val)) != p) {
 			fprintf (stderr, "The hsmode profiler option is obsolete, use heapshot=MODE.\n");
 			set_hsmode (val, 0);
@@ -2324,6 +3006,9 @@ mono_profiler_startup (const char *desc)
 	}
 	if (allocs_enabled)
 		events |= MONO_PROFILE_ALLOCATIONS;
+	/* perf events can't walk the managed stack */
+	if (sample_frames && sample_type == SAMPLE_CYCLES)
+		do_mono_sample = 1;
 	utils_init (fast_time);
 
 	prof = create_profiler (filename);
@@ -2342,6 +3027,7 @@ mono_profiler_startup (const char *desc)
 	mono_profiler_install_thread_name (thread_name);
 	mono_profiler_install_enter_leave (method_enter, method_leave);
 	mono_profiler_install_jit_end (method_jitted);
+	mono_profiler_install_jit_phases (method_jit_phases);
 	mono_profiler_install_exception (throw_exc, method_exc_leave, clause_exc);
 	mono_profiler_install_monitor (monitor_event);
 	mono_profiler_install_runtime_initialized (runtime_initialized);
@@ -2350,6 +3036,12 @@ mono_profiler_startup (const char *desc)
 	if (do_mono_sample && sample_type == SAMPLE_CYCLES) {
 		events |= MONO_PROFILE_STATISTICAL;
 		mono_profiler_install_statistical (mono_sample_hit);
+		if (sample_frames)
+			mono_profiler_install_statistical_call_chain (mono_sample_hit_chain, sample_frames, MONO_PROFILER_CALL_CHAIN_MANAGED);
+	}
+	if (alloc_sample_bytes) {
+		events |= MONO_PROFILE_ALLOCATION_SAMPLES;
+		mono_profiler_install_allocation_sample (gc_alloc_sample, alloc_sample_bytes);
 	}
 
 	mono_profiler_set_events (events);
@@ -5,12 +5,14 @@
 #define LOG_HEADER_ID 0x4D505A01
 #define LOG_VERSION_MAJOR 0
 #define LOG_VERSION_MINOR 4
-#define LOG_DATA_VERSION 4
+#define LOG_DATA_VERSION 6
 /*
  * Changes in data versions:
  * version 2: added offsets in heap walk
  * version 3: added GC roots
  * version 4: added sample/statistical profiling
+ * version 5: added JIT phase timings
+ * version 6: added incremental heap shots
  */
 
 enum {
@@ -27,6 +29,7 @@ enum {
 	TYPE_HEAP_END    = 1 << 4,
 	TYPE_HEAP_OBJECT = 2 << 4,
 	TYPE_HEAP_ROOT   = 3 << 4,
+	TYPE_HEAP_DEAD   = 4 << 4,
 	/* extended type for TYPE_METADATA */
 	TYPE_START_LOAD   = 1 << 4,
 	TYPE_END_LOAD     = 2 << 4,
@@ -49,6 +52,7 @@ enum {
 	TYPE_ENTER     = 2 << 4,
 	TYPE_EXC_LEAVE = 3 << 4,
 	TYPE_JIT       = 4 << 4,
+	TYPE_JIT_PHASES = 5 << 4,
 	/* extended type for TYPE_EXCEPTION */
 	TYPE_THROW        = 0 << 4,
 	TYPE_CLAUSE       = 1 << 4,
@@ -74,5 +78,10 @@ enum {
 	SAMPLE_LAST
 };
 
+/* flags for TYPE_HEAP_START */
+enum {
+	HEAP_SHOT_INCREMENTAL = 1
+};
+
 #endif /* __MONO_PROFLOG_H__ */
 
@@ -101,6 +101,10 @@ check_alloc_traces ($report,
 	T => [1010, "T:Main (string[])", "T:level3 (int)", "T:level2 (int)", "T:level1 (int)", "T:level0 (int)"]
 );
 report_errors ();
+# test the AOT profile round trip: the instances of corlib generic types
+# over types of the test are saved in its profile and AOT compiled
+check_aot_profile ("test-aotprofile.exe", "System_Collections_Generic_List_1_S_Add_S");
+report_errors ();
 
 exit ($total_errors? 1: 0);
 
@@ -147,6 +151,39 @@ sub run_test_bin
 	return $report;
 }
 
+sub check_aot_profile
+{
+	my $test_name = shift;
+	my $symbol = shift;
+	my $bin = "$minibuilddir/mono";
+	my $image_name = $test_name;
+	$image_name =~ s/\.exe$//;
+	#clear the errors
+	@errors = ();
+	$total_errors = 0;
+	print "Checking $test_name with the AOT profiler ...";
+	my $output = `$bin --profile=aot $test_name`;
+	print "\n";
+	my @profiles = $output =~ /^Creating output file: (.*)$/mg;
+	my ($profile) = grep {/\/\Q$image_name\E-\d+$/} @profiles;
+	if (defined $profile && open (my $fh, "<", $profile)) {
+		local $/;
+		my $data = <$fh>;
+		close ($fh);
+		push @errors, "No corlib generic instances in the profile of $test_name." unless $data =~ /mscorlib/;
+		`$bin --aot=profile-only,profile=$profile $test_name`;
+		if ($?) {
+			push @errors, "AOT compilation of $test_name with its profile failed.";
+		} else {
+			my $symbols = `nm $test_name.so`;
+			push @errors, "Profiled instance $symbol not AOT compiled." unless $symbols =~ /\b\Q$symbol\E\b/;
+		}
+	} else {
+		push @errors, "No AOT profile for $test_name.";
+	}
+	unlink (@profiles, "$test_name.so");
+}
+
 sub report_errors
 {
 	foreach my $e (@errors) {
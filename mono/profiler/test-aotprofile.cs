@@ -0,0 +1,23 @@
+using System;
+using System.Collections.Generic;
+
+struct S {
+	public int v;
+}
+
+class T {
+
+	static void Main (string[] args) {
+		List<S> l = new List<S> ();
+		for (int i = 0; i < 10; ++i) {
+			S s;
+			s.v = i;
+			l.Add (s);
+		}
+		int sum = 0;
+		foreach (S s in l)
+			sum += s.v;
+		if (sum != 45)
+			Environment.Exit (1);
+	}
+}
@@ -174,6 +174,51 @@ class Tests
 		return f;
 	}
 
+	public struct Pair {
+		public int a;
+		public long b;
+	}
+
+	public static long sum_args (bool b, byte u1, sbyte i1, char c, short i2, ushort u2, int i4, uint u4, long i8, float r4, double r8, Enum1 e, Pair p, string s) {
+		return (b ? 1 : 0) + u1 + i1 + c + i2 + u2 + i4 + u4 + i8 + (long)r4 + (long)r8 + (int)e + p.a + p.b + s.Length;
+	}
+
+	public static int add_int (int a, int b) {
+		return a + b;
+	}
+
+	public static int sub_int (int a, int b) {
+		return a - b;
+	}
+
+	public static int test_0_repeated_invoke_args () {
+		MethodInfo sum = typeof (Tests).GetMethod ("sum_args");
+		Pair p = new Pair { a = 11, b = 12 };
+
+		/* The first invoke takes the slow path, the later ones the array invoke fast path */
+		for (int i = 0; i < 3; ++i) {
+			object o = sum.Invoke (null, new object [] { true, (byte)2, (sbyte)-3, 'A', (short)-5, (ushort)6, -7, (uint)8, 9L, 10.5f, 11.5, Enum1.B, p, "ABC" });
+			if ((long)o != 1 + 2 - 3 + 65 - 5 + 6 - 7 + 8 + 9 + 10 + 11 + 1 + 11 + 12 + 3)
+				return i + 1;
+		}
+
+		/* Null valuetype arguments are passed as default values */
+		for (int i = 0; i < 3; ++i) {
+			if ((long)sum.Invoke (null, new object [] { false, (byte)0, (sbyte)0, '\0', (short)0, (ushort)0, 0, (uint)0, 0L, 0.0f, 0.0, Enum1.A, null, "" }) != 0)
+				return 10 + i;
+		}
+
+		/* Methods with the same signature shape share their wrapper */
+		for (int i = 0; i < 3; ++i) {
+			if ((int)typeof (Tests).GetMethod ("add_int").Invoke (null, new object [] { 5, 3 }) != 8)
+				return 20;
+			if ((int)typeof (Tests).GetMethod ("sub_int").Invoke (null, new object [] { 5, 3 }) != 2)
+				return 21;
+		}
+
+		return 0;
+	}
+
     public static unsafe int* data_types_ptr (int *val) {
 		//Console.WriteLine (new IntPtr (val));
         return val;
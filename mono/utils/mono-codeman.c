@@ -13,6 +13,7 @@
 
 #include "mono-codeman.h"
 #include "mono-mmap.h"
+#include "mono-counters.h"
 #include "dlmalloc.h"
 #include <mono/metadata/class-internals.h>
 #include <mono/metadata/profiler-private.h>
@@ -82,10 +83,17 @@ struct _CodeChunck {
 	unsigned int bsize: 24;
 };
 
+/*
+ * Code which is rarely or only once executed is allocated in separate
+ * chunks (the cold list), so it doesn't end up between the methods and
+ * the pages and cache lines holding those stay dense.
+ * Filled chunks of both kinds are moved to the full list.
+ */
 struct _MonoCodeManager {
 	int dynamic;
 	int read_only;
 	CodeChunk *current;
+	CodeChunk *cold;
 	CodeChunk *full;
 #if defined(__native_client_codegen__) && defined(__native_client__)
 	MonoGHashTable *hash;
@@ -94,6 +102,13 @@ struct _MonoCodeManager {
 
 #define ALIGN_INT(val,alignment) (((val) + (alignment - 1)) & ~(alignment - 1))
 
+/* the size of the chunks which can be backed by huge pages, 0 if they are not used */
+static int hugepage_chunk_size;
+static int hugepage_code_bytes;
+/* statistics */
+static int cold_code_bytes;
+static int wasted_code_bytes;
+
 #if defined(__native_client_codegen__) && defined(__native_client__)
 /* End of text segment, set by linker. 
  * Dynamic text starts on the next allocated page.
@@ -200,6 +215,58 @@ nacl_inverse_modify_patch_target (unsigned char *target)
 
 #endif /* __native_client_codegen && __native_client__ */
 
+/**
+ * mono_code_manager_set_hugepages:
+ * @enable: whenever to use huge pages
+ *
+ * Make the code managers allocate chunks whose size is a multiple of the
+ * huge page size, aligned to it, and ask the OS to back them with huge
+ * pages. This reduces the iTLB misses when running a lot of JITted code,
+ * at the cost of a bigger minimum chunk size. It only affects the chunks
+ * allocated after it is called.
+ */
+void
+mono_code_manager_set_hugepages (int enable)
+{
+	hugepage_chunk_size = enable ? mono_hugepage_size () : 0;
+}
+
+/**
+ * mono_code_manager_init:
+ *
+ * Register the code manager statistics.
+ */
+void
+mono_code_manager_init (void)
+{
+	mono_counters_register ("Code space allocated in huge page chunks", MONO_COUNTER_INT|MONO_COUNTER_JIT, &hugepage_code_bytes);
+	mono_counters_register ("Cold code space reserved", MONO_COUNTER_INT|MONO_COUNTER_JIT, &cold_code_bytes);
+	mono_counters_register ("Code space wasted in full chunks", MONO_COUNTER_INT|MONO_COUNTER_JIT, &wasted_code_bytes);
+}
+
+/*
+ * Allocate SIZE bytes aligned to the huge page size, trimming the extra
+ * space needed for the alignment.
+ */
+static void*
+valloc_hugepage_chunk (int size)
+{
+	char *mem, *aligned;
+	int extra = hugepage_chunk_size;
+
+	mem = mono_valloc (NULL, size + extra, MONO_PROT_RWX | ARCH_MAP_FLAGS);
+	if (!mem)
+		return NULL;
+	aligned = (char*)ALIGN_INT ((gsize)mem, (gsize)hugepage_chunk_size);
+	if (aligned > mem)
+		mono_vfree (mem, aligned - mem);
+	if (aligned + size < mem + size + extra)
+		mono_vfree (aligned + size, (mem + size + extra) - (aligned + size));
+	mono_mprotect (aligned, size, MONO_PROT_RWX | MONO_MMAP_HUGEPAGES);
+	hugepage_code_bytes += size;
+	return aligned;
+}
+
 /**
  * mono_code_manager_new:
  *
@@ -218,6 +285,7 @@ mono_code_manager_new (void)
 	if (!cman)
 		return NULL;
 	cman->current = NULL;
+	cman->cold = NULL;
 	cman->full = NULL;
 	cman->dynamic = 0;
 	cman->read_only = 0;
@@ -299,6 +367,7 @@ mono_code_manager_destroy (MonoCodeManager *cman)
 {
 	free_chunklist (cman->full);
 	free_chunklist (cman->current);
+	free_chunklist (cman->cold);
 	free (cman);
 }
 
@@ -323,6 +392,8 @@ mono_code_manager_invalidate (MonoCodeManager *cman)
 
 	for (chunk = cman->current; chunk; chunk = chunk->next)
 		memset (chunk->data, fill_value, chunk->size);
+	for (chunk = cman->cold; chunk; chunk = chunk->next)
+		memset (chunk->data, fill_value, chunk->size);
 	for (chunk = cman->full; chunk; chunk = chunk->next)
 		memset (chunk->data, fill_value, chunk->size);
 }
@@ -356,6 +427,10 @@ mono_code_manager_foreach (MonoCodeManager *cman, MonoCodeManagerFunc func, void
 		if (func (chunk->data, chunk->size, chunk->bsize, user_data))
 			return;
 	}
+	for (chunk = cman->cold; chunk; chunk = chunk->next) {
+		if (func (chunk->data, chunk->size, chunk->bsize, user_data))
+			return;
+	}
 	for (chunk = cman->full; chunk; chunk = chunk->next) {
 		if (func (chunk->data, chunk->size, chunk->bsize, user_data))
 			return;
@@ -375,7 +450,7 @@ mono_code_manager_foreach (MonoCodeManager *cman, MonoCodeManagerFunc func, void
 #endif
 
 static CodeChunk*
-new_codechunk (int dynamic, int size)
+new_codechunk (int dynamic, int cold, int size)
 {
 	int minsize, flags = CODE_FLAG_MMAP;
 	int chunk_size, bsize = 0;
@@ -394,8 +469,13 @@ new_codechunk (int dynamic, int size)
 		flags = CODE_FLAG_MALLOC;
 	} else {
 		minsize = pagesize * MIN_PAGES;
+		/* cold code doesn't benefit from huge pages */
+		if (hugepage_chunk_size > minsize && !cold)
+			minsize = hugepage_chunk_size;
 		if (size < minsize)
 			chunk_size = minsize;
+		else if (hugepage_chunk_size && !cold)
+			chunk_size = ALIGN_INT (size, hugepage_chunk_size);
 		else {
 			chunk_size = size;
 			chunk_size += pagesize - 1;
@@ -423,7 +503,11 @@ new_codechunk (int dynamic, int size)
 		/* Allocate MIN_ALIGN-1 more than we need so we can still */
 		/* guarantee MIN_ALIGN alignment for individual allocs    */
 		/* from mono_code_manager_reserve_align.                  */
-		ptr = mono_valloc (NULL, chunk_size + MIN_ALIGN - 1, MONO_PROT_RWX | ARCH_MAP_FLAGS);
+		/* Huge page chunks are aligned to the huge page size.    */
+		if (hugepage_chunk_size && !cold && chunk_size % hugepage_chunk_size == 0)
+			ptr = valloc_hugepage_chunk (chunk_size);
+		else
+			ptr = mono_valloc (NULL, chunk_size + MIN_ALIGN - 1, MONO_PROT_RWX | ARCH_MAP_FLAGS);
 		if (!ptr)
 			return NULL;
 	}
@@ -455,43 +539,25 @@ new_codechunk (int dynamic, int size)
 	return chunk;
 }
 
-/**
- * mono_code_manager_reserve:
- * @cman: a code manager
- * @size: size of memory to allocate
- * @alignment: power of two alignment value
- *
- * Allocates at least @size bytes of memory inside the code manager @cman.
- *
- * Returns: the pointer to the allocated memory or #NULL on failure
+#if !defined(__native_client__) || !defined(__native_client_codegen__)
+/*
+ * Allocate SIZE bytes from the chunks in *CURRENT, which is either the
+ * list of the hot or of the cold chunks of CMAN.
  */
-void*
-mono_code_manager_reserve_align (MonoCodeManager *cman, int size, int alignment)
+static void*
+reserve_in_chunks (MonoCodeManager *cman, CodeChunk **current, int size, int alignment, int cold)
 {
-#if !defined(__native_client__) || !defined(__native_client_codegen__)
 	CodeChunk *chunk, *prev;
 	void *ptr;
 	guint32 align_mask = alignment - 1;
 
-	g_assert (!cman->read_only);
-
-	/* eventually allow bigger alignments, but we need to fix the dynamic alloc code to
-	 * handle this before
-	 */
-	g_assert (alignment <= MIN_ALIGN);
-
-	if (cman->dynamic) {
-		++mono_stats.dynamic_code_alloc_count;
-		mono_stats.dynamic_code_bytes_count += size;
-	}
-
-	if (!cman->current) {
-		cman->current = new_codechunk (cman->dynamic, size);
-		if (!cman->current)
+	if (!*current) {
+		*current = new_codechunk (cman->dynamic, cold, size);
+		if (!*current)
 			return NULL;
 	}
 
-	for (chunk = cman->current; chunk; chunk = chunk->next) {
+	for (chunk = *current; chunk; chunk = chunk->next) {
 		if (ALIGN_INT (chunk->pos, alignment) + size <= chunk->size) {
 			chunk->pos = ALIGN_INT (chunk->pos, alignment);
 			/* Align the chunk->data we add to chunk->pos */
@@ -506,29 +572,60 @@ mono_code_manager_reserve_align (MonoCodeManager *cman, int size, int alignment)
 	 * to keep cman->current from growing too much
 	 */
 	prev = NULL;
-	for (chunk = cman->current; chunk; prev = chunk, chunk = chunk->next) {
+	for (chunk = *current; chunk; prev = chunk, chunk = chunk->next) {
 		if (chunk->pos + MIN_ALIGN * 4 <= chunk->size)
 			continue;
 		if (prev) {
 			prev->next = chunk->next;
 		} else {
-			cman->current = chunk->next;
+			*current = chunk->next;
 		}
 		chunk->next = cman->full;
 		cman->full = chunk;
+		wasted_code_bytes += chunk->size - chunk->pos;
 		break;
 	}
-	chunk = new_codechunk (cman->dynamic, size);
+	chunk = new_codechunk (cman->dynamic, cold, size);
 	if (!chunk)
 		return NULL;
-	chunk->next = cman->current;
-	cman->current = chunk;
+	chunk->next = *current;
+	*current = chunk;
 	chunk->pos = ALIGN_INT (chunk->pos, alignment);
 	/* Align the chunk->data we add to chunk->pos */
 	/* or we can't guarantee proper alignment     */
 	ptr = (void*)((((uintptr_t)chunk->data + align_mask) & ~(uintptr_t)align_mask) + chunk->pos);
 	chunk->pos = ((char*)ptr - chunk->data) + size;
 	return ptr;
+}
+#endif
+
+/**
+ * mono_code_manager_reserve:
+ * @cman: a code manager
+ * @size: size of memory to allocate
+ * @alignment: power of two alignment value
+ *
+ * Allocates at least @size bytes of memory inside the code manager @cman.
+ *
+ * Returns: the pointer to the allocated memory or #NULL on failure
+ */
+void*
+mono_code_manager_reserve_align (MonoCodeManager *cman, int size, int alignment)
+{
+#if !defined(__native_client__) || !defined(__native_client_codegen__)
+	g_assert (!cman->read_only);
+
+	/* eventually allow bigger alignments, but we need to fix the dynamic alloc code to
+	 * handle this before
+	 */
+	g_assert (alignment <= MIN_ALIGN);
+
+	if (cman->dynamic) {
+		++mono_stats.dynamic_code_alloc_count;
+		mono_stats.dynamic_code_bytes_count += size;
+	}
+
+	return reserve_in_chunks (cman, &cman->current, size, alignment, FALSE);
 #else
 	unsigned char *temp_ptr, *code_ptr;
 	/* Round up size to next bundle */
@@ -568,6 +665,38 @@ mono_code_manager_reserve (MonoCodeManager *cman, int size)
 	return mono_code_manager_reserve_align (cman, size, MIN_ALIGN);
 }
 
+/**
+ * mono_code_manager_reserve_cold:
+ * @cman: a code manager
+ * @size: size of memory to allocate
+ * @alignment: power of two alignment value, or 0 for the default alignment
+ *
+ * Same as mono_code_manager_reserve_align (), but the memory is allocated
+ * away from the other code, for code which is executed rarely or only once,
+ * like trampolines and static constructors. Dynamic code managers don't
+ * keep cold code separately.
+ *
+ * Returns: the pointer to the allocated memory or #NULL on failure
+ */
+void*
+mono_code_manager_reserve_cold (MonoCodeManager *cman, int size, int alignment)
+{
+	if (!alignment)
+		alignment = MIN_ALIGN;
+#if !defined(__native_client__) || !defined(__native_client_codegen__)
+	if (cman->dynamic)
+		return mono_code_manager_reserve_align (cman, size, alignment);
+
+	g_assert (!cman->read_only);
+	g_assert (alignment <= MIN_ALIGN);
+
+	cold_code_bytes += size;
+	return reserve_in_chunks (cman, &cman->cold, size, alignment, TRUE);
+#else
+	return mono_code_manager_reserve_align (cman, size, alignment);
+#endif
+}
+
 /**
  * mono_code_manager_commit:
  * @cman: a code manager
@@ -587,6 +716,9 @@ mono_code_manager_commit (MonoCodeManager *cman, void *data, int size, int newsi
 
 	if (cman->current && (size != newsize) && (data == cman->current->data + cman->current->pos - size)) {
 		cman->current->pos -= size - newsize;
+	} else if (cman->cold && (size != newsize) && (data == cman->cold->data + cman->cold->pos - size)) {
+		cold_code_bytes -= size - newsize;
+		cman->cold->pos -= size - newsize;
 	}
 #else
 	unsigned char *code;
@@ -642,6 +774,10 @@ mono_code_manager_size (MonoCodeManager *cman, int *used_size)
 		size += chunk->size;
 		used += chunk->pos;
 	}
+	for (chunk = cman->cold; chunk; chunk = chunk->next) {
+		size += chunk->size;
+		used += chunk->pos;
+	}
 	for (chunk = cman->full; chunk; chunk = chunk->next) {
 		size += chunk->size;
 		used += chunk->pos;
@@ -8,10 +8,13 @@ MonoCodeManager* mono_code_manager_new_dynamic (void);
 void             mono_code_manager_destroy (MonoCodeManager *cman);
 void             mono_code_manager_invalidate (MonoCodeManager *cman);
 void             mono_code_manager_set_read_only (MonoCodeManager *cman);
+void             mono_code_manager_set_hugepages (int enable);
+void             mono_code_manager_init (void);
 
 void*            mono_code_manager_reserve_align (MonoCodeManager *cman, int size, int alignment);
 
 void*            mono_code_manager_reserve (MonoCodeManager *cman, int size);
+void*            mono_code_manager_reserve_cold (MonoCodeManager *cman, int size, int alignment);
 void             mono_code_manager_commit  (MonoCodeManager *cman, void *data, int size, int newsize);
 int              mono_code_manager_size    (MonoCodeManager *cman, int *used_size);
 
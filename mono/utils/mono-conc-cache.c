@@ -0,0 +1,126 @@
+/*
+ * mono-conc-cache.c: A lock-free lookup cache for read-mostly hash tables
+ */
+
+#include "mono-conc-cache.h"
+#include "mono-membar.h"
+
+/*
+ * Each entry is protected by a sequence number which is odd while the entry is
+ * being written. Readers read the sequence number, the entry, then the sequence
+ * number again, and treat the lookup as a miss if they don't match.
+ */
+typedef struct {
+	volatile guint32 seq;
+	gpointer table;
+	gpointer key;
+	gpointer value;
+} MonoConcCacheEntry;
+
+struct _MonoConcCache {
+	guint32 mask;
+	MonoConcCacheEntry *entries;
+};
+
+static inline guint32
+conc_cache_hash (MonoConcCache *cache, gconstpointer table, gconstpointer key)
+{
+	gsize h = ((gsize)key >> 3) ^ ((gsize)table >> 4);
+
+	return (guint32)(h ^ (h >> 11)) & cache->mask;
+}
+
+/*
+ * mono_conc_cache_new:
+ *
+ *   Create a new cache with SIZE entries, which is rounded up to a power of two.
+ */
+MonoConcCache*
+mono_conc_cache_new (int size)
+{
+	MonoConcCache *cache = g_new0 (MonoConcCache, 1);
+	int n = 1;
+
+	while (n < size)
+		n <<= 1;
+	cache->mask = n - 1;
+	cache->entries = g_new0 (MonoConcCacheEntry, n);
+	return cache;
+}
+
+void
+mono_conc_cache_free (MonoConcCache *cache)
+{
+	g_free (cache->entries);
+	g_free (cache);
+}
+
+gpointer
+mono_conc_cache_lookup (MonoConcCache *cache, gpointer table, gconstpointer key)
+{
+	MonoConcCacheEntry *entry = &cache->entries [conc_cache_hash (cache, table, key)];
+	guint32 seq;
+	gpointer value;
+
+	seq = entry->seq;
+	if (seq & 1)
+		return NULL;
+	mono_memory_read_barrier ();
+	if (entry->table != table || entry->key != key)
+		return NULL;
+	value = entry->value;
+	mono_memory_read_barrier ();
+	if (entry->seq != seq)
+		return NULL;
+	return value;
+}
+
+static inline void
+conc_cache_set (MonoConcCacheEntry *entry, gpointer table, gpointer key, gpointer value)
+{
+	entry->seq ++;
+	mono_memory_write_barrier ();
+	entry->table = table;
+	entry->key = key;
+	entry->value = value;
+	mono_memory_write_barrier ();
+	entry->seq ++;
+}
+
+/*
+ * mono_conc_cache_insert:
+ *
+ *   Add the KEY->VALUE mapping of TABLE to the cache, evicting the entry which
+ * occupies its slot. The caller should hold the lock protecting TABLE.
+ */
+void
+mono_conc_cache_insert (MonoConcCache *cache, gpointer table, gpointer key, gpointer value)
+{
+	conc_cache_set (&cache->entries [conc_cache_hash (cache, table, key)], table, key, value);
+}
+
+void
+mono_conc_cache_remove (MonoConcCache *cache, gpointer table, gconstpointer key)
+{
+	MonoConcCacheEntry *entry = &cache->entries [conc_cache_hash (cache, table, key)];
+
+	if (entry->table == table && entry->key == key)
+		conc_cache_set (entry, NULL, NULL, NULL);
+}
+
+/*
+ * mono_conc_cache_clear:
+ *
+ *   Remove all entries. This has to be called when entries are removed from the
+ * underlying tables by equality instead of identity, or when they are freed.
+ */
+void
+mono_conc_cache_clear (MonoConcCache *cache)
+{
+	int i;
+
+	for (i = 0; i <= cache->mask; ++i) {
+		if (cache->entries [i].table)
+			conc_cache_set (&cache->entries [i], NULL, NULL, NULL);
+	}
+}
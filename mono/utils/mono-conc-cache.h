@@ -0,0 +1,42 @@
+/*
+ * mono-conc-cache.h: A lock-free lookup cache for read-mostly hash tables
+ */
+#ifndef __MONO_UTILS_MONO_CONC_CACHE_H__
+#define __MONO_UTILS_MONO_CONC_CACHE_H__
+
+#include <glib.h>
+#include "mono-compiler.h"
+
+G_BEGIN_DECLS
+
+/*
+ * This is a direct mapped cache of <table, key> -> value mappings which sits in
+ * front of a lock protected hash table:
+ * - Lookups don't take any locks, they can run concurrently with updates, in
+ *   which case they might miss.
+ * - Updates (insert/remove/clear) must be serialized by the caller, usually by
+ *   holding the lock protecting the underlying table.
+ * - Keys are compared by identity, so this can be used for tables with custom
+ *   equality functions too, as long as every removal from the underlying table
+ *   is followed by a clear of the entries of that table.
+ * - Entries are overwritten on collisions, so it only holds the hot subset of
+ *   the underlying tables.
+ */
+
+typedef struct _MonoConcCache MonoConcCache;
+
+MonoConcCache* mono_conc_cache_new (int size) MONO_INTERNAL;
+
+void mono_conc_cache_free (MonoConcCache *cache) MONO_INTERNAL;
+
+gpointer mono_conc_cache_lookup (MonoConcCache *cache, gpointer table, gconstpointer key) MONO_INTERNAL;
+
+void mono_conc_cache_insert (MonoConcCache *cache, gpointer table, gpointer key, gpointer value) MONO_INTERNAL;
+
+void mono_conc_cache_remove (MonoConcCache *cache, gpointer table, gconstpointer key) MONO_INTERNAL;
+
+void mono_conc_cache_clear (MonoConcCache *cache) MONO_INTERNAL;
+
+G_END_DECLS
+
+#endif
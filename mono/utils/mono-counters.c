@@ -148,9 +148,27 @@ section_names [][10] = {
 	"GC",
 	"Metadata",
 	"Generics",
-	"Security"
+	"Security",
+	"Runtime"
 };
 
+/**
+ * mono_counters_section_name:
+ * @section: One of the MONO_COUNTER section values
+ *
+ * Returns the name used for @section in the dumps.
+ */
+const char*
+mono_counters_section_name (int section)
+{
+	int i, j;
+	for (j = 0, i = MONO_COUNTER_JIT; i < MONO_COUNTER_LAST_SECTION; j++, i <<= 1) {
+		if (section & i)
+			return section_names [j];
+	}
+	return NULL;
+}
+
 static void
 mono_counters_dump_section (int section, FILE *outfile)
 {
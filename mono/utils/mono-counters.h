@@ -20,6 +20,7 @@ enum {
 	MONO_COUNTER_METADATA = 1 << 10,
 	MONO_COUNTER_GENERICS = 1 << 11,
 	MONO_COUNTER_SECURITY = 1 << 12,
+	MONO_COUNTER_RUNTIME  = 1 << 13,
 	MONO_COUNTER_LAST_SECTION
 };
 
@@ -37,6 +38,8 @@ void mono_counters_register (const char* descr, int type, void *addr);
  */
 void mono_counters_dump (int section_mask, FILE *outfile);
 
+const char* mono_counters_section_name (int section);
+
 void mono_counters_cleanup (void);
 
 #endif /* __MONO_COUNTERS_H__ */
@@ -0,0 +1,613 @@
+/*
+ * mono-metrics.c: Typed runtime metrics which can be read while the runtime is running
+ */
+
+#include <config.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "mono-metrics.h"
+#include "mono-membar.h"
+#include "mono/io-layer/io-layer.h"
+
+#if defined(HAVE_SYS_UN_H) && !defined(HOST_WIN32)
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#define ENABLE_METRICS_EXPORT 1
+#endif
+
+/*
+ * The values are stored in per-thread shards, each metric owns one slot in
+ * every shard, histograms own the slots for their count, sum and buckets.
+ * Shards are never freed: when a thread exits its shard is put on a free list
+ * and reused by the next thread which needs one, keeping the values the exiting
+ * thread recorded. This means readers can walk the shards without locking, the
+ * lock only serializes the creation of metrics and the attaching and detaching
+ * of shards.
+ * The updates done by a thread after it detached its shard, while it finishes
+ * exiting, go to the shared detached_shard instead of attaching a new shard
+ * which would never be returned to the free list. Unlike the other shards it
+ * can be updated by more than one thread at a time, and since the updates are
+ * not atomic, some of the updates done by concurrently exiting threads
+ * can be lost.
+ * The values are written with plain stores, so a reader can miss the most recent
+ * updates, and on 32 bit platforms it can see a torn value while it is being
+ * updated.
+ */
+#define SHARD_SLOTS 512
+
+#define HISTOGRAM_SLOTS (MONO_METRIC_HISTOGRAM_BUCKETS + 2)
+
+struct _MonoMetric {
+	MonoMetric *next;
+	const char *name;
+	MonoMetricKind kind;
+	int section;
+	int slot;
+	MonoMetricCallback callback;
+};
+
+typedef struct _MetricShard MetricShard;
+
+struct _MetricShard {
+	MetricShard *next;
+	MetricShard *next_free;
+	gint64 slots [SHARD_SLOTS];
+};
+
+static MonoMetric *metrics, *last_metric;
+static MetricShard *shards, *free_shards;
+static MetricShard detached_shard;
+static int next_slot;
+static CRITICAL_SECTION metrics_lock;
+static gboolean metrics_inited;
+
+#ifdef HAVE_KW_THREAD
+static __thread MetricShard *tls_shard MONO_TLS_FAST;
+#define GET_SHARD() (tls_shard)
+#define SET_SHARD(shard) do { tls_shard = (shard); } while (0)
+#else
+static guint32 shard_tls_id;
+#define GET_SHARD() ((MetricShard*)TlsGetValue (shard_tls_id))
+#define SET_SHARD(shard) TlsSetValue (shard_tls_id, (shard))
+#endif
+
+#ifdef ENABLE_METRICS_EXPORT
+static void metrics_export_start (const char *path, int interval);
+#endif
+
+/**
+ * mono_metrics_init:
+ *
+ * Initialize the metrics subsystem. If the MONO_METRICS_SOCKET environment
+ * variable is set, start serving snapshots of the metrics on the unix socket
+ * it names, every MONO_METRICS_INTERVAL milliseconds if that is set too.
+ * This is also called by the creation of the first metric, which can happen
+ * during the GC initialization, before the runtime is initialized: this is
+ * still done by the main thread alone, so it doesn't need locking.
+ */
+void
+mono_metrics_init (void)
+{
+	const char *path;
+
+	if (metrics_inited)
+		return;
+
+	InitializeCriticalSection (&metrics_lock);
+#ifndef HAVE_KW_THREAD
+	shard_tls_id = TlsAlloc ();
+#endif
+	shards = &detached_shard;
+	metrics_inited = TRUE;
+
+	path = g_getenv ("MONO_METRICS_SOCKET");
+	if (path && *path) {
+#ifdef ENABLE_METRICS_EXPORT
+		const char *interval = g_getenv ("MONO_METRICS_INTERVAL");
+
+		metrics_export_start (path, interval ? atoi (interval) : 0);
+#else
+		g_warning ("Exporting metrics is not supported on this platform.");
+#endif
+	}
+}
+
+static MetricShard*
+shard_attach (void)
+{
+	MetricShard *shard;
+
+	EnterCriticalSection (&metrics_lock);
+	if (free_shards) {
+		shard = free_shards;
+		free_shards = shard->next_free;
+		shard->next_free = NULL;
+	} else {
+		shard = g_new0 (MetricShard, 1);
+		shard->next = shards;
+		/* Readers walk the list without locking */
+		mono_memory_barrier ();
+		shards = shard;
+	}
+	LeaveCriticalSection (&metrics_lock);
+
+	SET_SHARD (shard);
+	return shard;
+}
+
+static inline gint64*
+shard_slots (void)
+{
+	MetricShard *shard = GET_SHARD ();
+
+	if (G_UNLIKELY (!shard))
+		shard = shard_attach ();
+	return shard->slots;
+}
+
+/**
+ * mono_metrics_thread_cleanup:
+ *
+ * Return the shard of the current thread to the free list. Called when a
+ * thread exits, the updates it does afterwards go to the detached shard.
+ */
+void
+mono_metrics_thread_cleanup (void)
+{
+	MetricShard *shard;
+
+	if (!metrics_inited)
+		return;
+	shard = GET_SHARD ();
+	if (!shard || shard == &detached_shard)
+		return;
+	SET_SHARD (&detached_shard);
+
+	EnterCriticalSection (&metrics_lock);
+	shard->next_free = free_shards;
+	free_shards = shard;
+	LeaveCriticalSection (&metrics_lock);
+}
+
+static MonoMetric*
+metric_new (const char *name, MonoMetricKind kind, int section, MonoMetricCallback callback)
+{
+	MonoMetric *metric;
+	int nslots;
+
+	mono_metrics_init ();
+	g_assert (section & MONO_COUNTER_SECTION_MASK);
+
+	if (callback)
+		nslots = 0;
+	else if (kind == MONO_METRIC_HISTOGRAM)
+		nslots = HISTOGRAM_SLOTS;
+	else
+		nslots = 1;
+
+	EnterCriticalSection (&metrics_lock);
+	if (next_slot + nslots > SHARD_SLOTS) {
+		LeaveCriticalSection (&metrics_lock);
+		g_warning ("Too many metrics, ignoring '%s'.", name);
+		return NULL;
+	}
+
+	metric = g_new0 (MonoMetric, 1);
+	metric->name = name;
+	metric->kind = kind;
+	metric->section = section & MONO_COUNTER_SECTION_MASK;
+	metric->slot = next_slot;
+	metric->callback = callback;
+	next_slot += nslots;
+
+	/* Readers walk the list without locking */
+	mono_memory_barrier ();
+	if (last_metric)
+		last_metric->next = metric;
+	else
+		metrics = metric;
+	last_metric = metric;
+	LeaveCriticalSection (&metrics_lock);
+
+	return metric;
+}
+
+/**
+ * mono_metric_new:
+ * @name: The name of the metric, it must stay valid for the lifetime of the runtime.
+ * @kind: The kind of the metric.
+ * @section: One of the MONO_COUNTER section values.
+ *
+ * Create a new metric. Returns NULL if there is no space left for it, which
+ * the update functions accept.
+ */
+MonoMetric*
+mono_metric_new (const char *name, MonoMetricKind kind, int section)
+{
+	return metric_new (name, kind, section, NULL);
+}
+
+/**
+ * mono_metric_new_callback:
+ * @name: The name of the metric, it must stay valid for the lifetime of the runtime.
+ * @section: One of the MONO_COUNTER section values.
+ * @callback: The function computing the value of the metric.
+ *
+ * Create a gauge whose value is computed by @callback when it is read. The
+ * callback can be called from any thread, so it should only read some state
+ * which is safe to access without locking.
+ */
+MonoMetric*
+mono_metric_new_callback (const char *name, int section, MonoMetricCallback callback)
+{
+	g_assert (callback);
+
+	return metric_new (name, MONO_METRIC_GAUGE, section, callback);
+}
+
+/**
+ * mono_metric_add:
+ * @metric: A counter or a gauge.
+ * @value: The amount to add, it can only be negative for gauges.
+ */
+void
+mono_metric_add (MonoMetric *metric, gint64 value)
+{
+	if (!metric)
+		return;
+	g_assert (metric->kind != MONO_METRIC_HISTOGRAM && !metric->callback);
+
+	shard_slots () [metric->slot] += value;
+}
+
+static inline int
+histogram_bucket (gint64 value)
+{
+	int bucket = 0;
+
+	if (value <= 0)
+		return 0;
+	while (value && bucket < MONO_METRIC_HISTOGRAM_BUCKETS - 1) {
+		value >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+/**
+ * mono_metric_record:
+ * @metric: A histogram.
+ * @value: The value to record.
+ */
+void
+mono_metric_record (MonoMetric *metric, gint64 value)
+{
+	gint64 *slots;
+
+	if (!metric)
+		return;
+	g_assert (metric->kind == MONO_METRIC_HISTOGRAM);
+
+	slots = shard_slots () + metric->slot;
+	slots [0]++;
+	slots [1] += value;
+	slots [2 + histogram_bucket (value)]++;
+}
+
+const char*
+mono_metric_get_name (MonoMetric *metric)
+{
+	return metric->name;
+}
+
+MonoMetricKind
+mono_metric_get_kind (MonoMetric *metric)
+{
+	return metric->kind;
+}
+
+int
+mono_metric_get_section (MonoMetric *metric)
+{
+	return metric->section;
+}
+
+static gint64
+sum_slot (int slot)
+{
+	MetricShard *shard;
+	gint64 res = 0;
+
+	for (shard = shards; shard; shard = shard->next)
+		res += shard->slots [slot];
+	return res;
+}
+
+/**
+ * mono_metric_get_value:
+ * @metric: The metric to read.
+ *
+ * Returns the current value of @metric, the number of recorded values
+ * for histograms.
+ */
+gint64
+mono_metric_get_value (MonoMetric *metric)
+{
+	if (metric->callback)
+		return metric->callback ();
+	return sum_slot (metric->slot);
+}
+
+/**
+ * mono_metric_get_histogram:
+ * @metric: A histogram.
+ * @count: Where to store the number of recorded values, or NULL.
+ * @sum: Where to store the sum of the recorded values, or NULL.
+ * @buckets: An array of MONO_METRIC_HISTOGRAM_BUCKETS elements where to
+ * store the bucket counts, or NULL.
+ */
+void
+mono_metric_get_histogram (MonoMetric *metric, gint64 *count, gint64 *sum, gint64 *buckets)
+{
+	int i;
+
+	g_assert (metric->kind == MONO_METRIC_HISTOGRAM);
+
+	if (count)
+		*count = sum_slot (metric->slot);
+	if (sum)
+		*sum = sum_slot (metric->slot + 1);
+	if (buckets) {
+		for (i = 0; i < MONO_METRIC_HISTOGRAM_BUCKETS; ++i)
+			buckets [i] = sum_slot (metric->slot + 2 + i);
+	}
+}
+
+/**
+ * mono_metrics_foreach:
+ * @func: The function to call.
+ * @user_data: Passed to @func.
+ *
+ * Call @func for every metric, in the order they were created. This doesn't
+ * take any locks, so it can be called from any thread at any time.
+ */
+void
+mono_metrics_foreach (MonoMetricFunc func, gpointer user_data)
+{
+	MonoMetric *metric;
+
+	for (metric = metrics; metric; metric = metric->next)
+		func (metric, user_data);
+}
+
+#define ENTRY_FMT "%-36s: "
+
+static void
+dump_metric (MonoMetric *metric, gpointer user_data)
+{
+	FILE *outfile = user_data;
+	gint64 count, sum, buckets [MONO_METRIC_HISTOGRAM_BUCKETS];
+	char range [32];
+	int i;
+
+	if (metric->kind != MONO_METRIC_HISTOGRAM) {
+		fprintf (outfile, ENTRY_FMT "%lld\n", metric->name, (long long)mono_metric_get_value (metric));
+		return;
+	}
+
+	mono_metric_get_histogram (metric, &count, &sum, buckets);
+	fprintf (outfile, ENTRY_FMT "%lld (sum: %lld, avg: %lld)\n", metric->name, (long long)count, (long long)sum, count ? (long long)(sum / count) : 0LL);
+	for (i = 0; i < MONO_METRIC_HISTOGRAM_BUCKETS; ++i) {
+		if (!buckets [i])
+			continue;
+		if (i == 0)
+			g_snprintf (range, sizeof (range), "<= 0");
+		else if (i == MONO_METRIC_HISTOGRAM_BUCKETS - 1)
+			g_snprintf (range, sizeof (range), ">= %lld", 1LL << (i - 1));
+		else
+			g_snprintf (range, sizeof (range), "%lld-%lld", 1LL << (i - 1), (1LL << i) - 1);
+		fprintf (outfile, "%36s: %lld\n", range, (long long)buckets [i]);
+	}
+}
+
+/**
+ * mono_metrics_dump:
+ * @outfile: a FILE to dump the metrics to
+ *
+ * Displays the current values of the metrics.
+ */
+void
+mono_metrics_dump (FILE *outfile)
+{
+	MonoMetric *metric;
+	int i;
+
+	if (!metrics)
+		return;
+	for (i = MONO_COUNTER_JIT; i < MONO_COUNTER_LAST_SECTION; i <<= 1) {
+		gboolean header = FALSE;
+
+		for (metric = metrics; metric; metric = metric->next) {
+			if (!(metric->section & i))
+				continue;
+			if (!header) {
+				fprintf (outfile, "\n%s metrics\n", mono_counters_section_name (i));
+				header = TRUE;
+			}
+			dump_metric (metric, outfile);
+		}
+	}
+}
+
+#ifdef ENABLE_METRICS_EXPORT
+
+/*
+ * Every snapshot has one line per metric, with tab separated fields:
+ *   section kind name value
+ * where value is the count, sum and comma separated bucket counts for
+ * histograms. Snapshots are terminated by an empty line.
+ */
+static const char*
+kind_name (MonoMetricKind kind)
+{
+	switch (kind) {
+	case MONO_METRIC_COUNTER:
+		return "counter";
+	case MONO_METRIC_GAUGE:
+		return "gauge";
+	case MONO_METRIC_HISTOGRAM:
+		return "histogram";
+	}
+	return NULL;
+}
+
+static void
+append_metric (MonoMetric *metric, gpointer user_data)
+{
+	GString *str = user_data;
+	gint64 count, sum, buckets [MONO_METRIC_HISTOGRAM_BUCKETS];
+	int i;
+
+	g_string_append_printf (str, "%s\t%s\t%s\t", mono_counters_section_name (metric->section), kind_name (metric->kind), metric->name);
+	if (metric->kind != MONO_METRIC_HISTOGRAM) {
+		g_string_append_printf (str, "%lld\n", (long long)mono_metric_get_value (metric));
+		return;
+	}
+
+	mono_metric_get_histogram (metric, &count, &sum, buckets);
+	g_string_append_printf (str, "%lld\t%lld\t", (long long)count, (long long)sum);
+	for (i = 0; i < MONO_METRIC_HISTOGRAM_BUCKETS; ++i)
+		g_string_append_printf (str, i ? ",%lld" : "%lld", (long long)buckets [i]);
+	g_string_append_c (str, '\n');
+}
+
+static gboolean
+send_all (int fd, const char *buf, size_t len)
+{
+	int flags = 0;
+
+#ifdef MSG_NOSIGNAL
+	flags = MSG_NOSIGNAL;
+#endif
+	while (len > 0) {
+		ssize_t res = send (fd, buf, len, flags);
+
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		buf += res;
+		len -= res;
+	}
+	return TRUE;
+}
+
+typedef struct {
+	int fd;
+	int interval;
+} ExportData;
+
+static void*
+metrics_export_thread (void *arg)
+{
+	ExportData *data = arg;
+	GString *str = g_string_new ("");
+
+	while (TRUE) {
+		int client = accept (data->fd, NULL, NULL);
+		gboolean ok;
+
+		if (client < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			g_warning ("Stopping the metrics export: %s", strerror (errno));
+			break;
+		}
+#ifdef SO_NOSIGPIPE
+		{
+			int one = 1;
+			setsockopt (client, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof (one));
+		}
+#endif
+
+		do {
+			g_string_truncate (str, 0);
+			mono_metrics_foreach (append_metric, str);
+			g_string_append_c (str, '\n');
+			ok = send_all (client, str->str, str->len);
+			if (ok && data->interval > 0)
+				g_usleep (data->interval * 1000);
+		} while (ok && data->interval > 0);
+
+		close (client);
+	}
+
+	g_string_free (str, TRUE);
+	close (data->fd);
+	g_free (data);
+	return NULL;
+}
+
+/*
+ * Serve snapshots of the metrics on the unix socket PATH from a separate
+ * thread. Clients receive one snapshot and the socket is closed, or if
+ * INTERVAL is positive, a new snapshot every INTERVAL milliseconds until they
+ * disconnect.
+ * The thread is not registered with the runtime, it only touches the metrics.
+ */
+static void
+metrics_export_start (const char *path, int interval)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	pthread_attr_t attr;
+	pthread_t tid;
+	ExportData *data;
+	int fd, res;
+
+	if (strlen (path) >= sizeof (addr.sun_path)) {
+		g_warning ("The metrics socket path '%s' is too long.", path);
+		return;
+	}
+
+	/* Remove the socket left by a previous run, but nothing else */
+	if (stat (path, &st) == 0 && S_ISSOCK (st.st_mode))
+		unlink (path);
+
+	fd = socket (AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		g_warning ("Could not create the metrics socket: %s", strerror (errno));
+		return;
+	}
+	memset (&addr, 0, sizeof (addr));
+	addr.sun_family = AF_UNIX;
+	strcpy (addr.sun_path, path);
+	if (bind (fd, (struct sockaddr*)&addr, sizeof (addr)) < 0 || listen (fd, 4) < 0) {
+		g_warning ("Could not listen on the metrics socket '%s': %s", path, strerror (errno));
+		close (fd);
+		return;
+	}
+
+	data = g_new0 (ExportData, 1);
+	data->fd = fd;
+	data->interval = interval;
+
+	pthread_attr_init (&attr);
+	pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+	res = pthread_create (&tid, &attr, metrics_export_thread, data);
+	pthread_attr_destroy (&attr);
+	if (res != 0) {
+		g_warning ("Could not start the metrics export thread: %s", strerror (res));
+		close (fd);
+		g_free (data);
+	}
+}
+
+#endif /* ENABLE_METRICS_EXPORT */
@@ -0,0 +1,74 @@
+/*
+ * mono-metrics.h: Typed runtime metrics which can be read while the runtime is running
+ */
+#ifndef __MONO_UTILS_MONO_METRICS_H__
+#define __MONO_UTILS_MONO_METRICS_H__
+
+#include <stdio.h>
+#include <glib.h>
+#include "mono-compiler.h"
+#include "mono-counters.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Unlike the counters in mono-counters.h, metrics are always enabled and are
+ * meant to be read while the runtime is running, either with
+ * mono_metrics_foreach () or through the socket named by the
+ * MONO_METRICS_SOCKET environment variable.
+ * - Every thread updates its own copy of the values, so updates don't need
+ *   locks or atomic operations. Readers sum the copies of all the threads.
+ * - Counters only increase, gauges are increased and decreased, or computed
+ *   by a callback when they are read.
+ * - Histograms count the recorded values in power of two buckets: bucket 0
+ *   counts the values <= 0, bucket N the values in [2^(N-1), 2^N), the last
+ *   bucket also counts all the larger values.
+ * - Metrics are grouped using the MONO_COUNTER_ section values.
+ * - The update functions accept a NULL metric, so subsystems don't need to
+ *   check whenever they were initialized.
+ */
+
+typedef enum {
+	MONO_METRIC_COUNTER,
+	MONO_METRIC_GAUGE,
+	MONO_METRIC_HISTOGRAM
+} MonoMetricKind;
+
+#define MONO_METRIC_HISTOGRAM_BUCKETS 32
+
+typedef struct _MonoMetric MonoMetric;
+
+/* Gauge callbacks can be called from any thread, including non-runtime ones */
+typedef gint64 (*MonoMetricCallback) (void);
+
+typedef void (*MonoMetricFunc) (MonoMetric *metric, gpointer user_data);
+
+void mono_metrics_init (void) MONO_INTERNAL;
+
+void mono_metrics_thread_cleanup (void) MONO_INTERNAL;
+
+MonoMetric* mono_metric_new (const char *name, MonoMetricKind kind, int section) MONO_INTERNAL;
+
+MonoMetric* mono_metric_new_callback (const char *name, int section, MonoMetricCallback callback) MONO_INTERNAL;
+
+void mono_metric_add (MonoMetric *metric, gint64 value) MONO_INTERNAL;
+
+void mono_metric_record (MonoMetric *metric, gint64 value) MONO_INTERNAL;
+
+const char* mono_metric_get_name (MonoMetric *metric) MONO_INTERNAL;
+
+MonoMetricKind mono_metric_get_kind (MonoMetric *metric) MONO_INTERNAL;
+
+int mono_metric_get_section (MonoMetric *metric) MONO_INTERNAL;
+
+gint64 mono_metric_get_value (MonoMetric *metric) MONO_INTERNAL;
+
+void mono_metric_get_histogram (MonoMetric *metric, gint64 *count, gint64 *sum, gint64 *buckets) MONO_INTERNAL;
+
+void mono_metrics_foreach (MonoMetricFunc func, gpointer user_data) MONO_INTERNAL;
+
+void mono_metrics_dump (FILE *outfile) MONO_INTERNAL;
+
+G_END_DECLS
+
+#endif
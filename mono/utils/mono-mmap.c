@@ -26,6 +26,10 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <errno.h>
+#ifdef __linux__
+#include <stdio.h>
+#include <sys/syscall.h>
+#endif
 #endif
 
 #include "mono-mmap.h"
@@ -175,6 +179,24 @@ mono_mprotect (void *addr, size_t length, int flags)
 	return VirtualProtect (addr, length, prot, &oldprot) == 0;
 }
 
+int
+mono_mresident (void *addr, size_t length)
+{
+	return -1;
+}
+
+int
+mono_hugepage_size (void)
+{
+	return 0;
+}
+
+int
+mono_mbind (void *addr, size_t length, int policy)
+{
+	return -1;
+}
+
 void*
 mono_shared_area (void)
 {
@@ -280,6 +302,10 @@ mono_valloc (void *addr, size_t length, int flags)
 		if (ptr == (void*)-1)
 			return NULL;
 	}
+#ifdef MADV_HUGEPAGE
+	if (flags & MONO_MMAP_HUGEPAGES)
+		madvise (ptr, length, MADV_HUGEPAGE);
+#endif
 	return ptr;
 }
 
@@ -363,6 +389,9 @@ mono_file_unmap (void *addr, void *handle)
  * to matche the supplied @flags.
  * If @flags includes MON_MMAP_DISCARD the pages are discarded from memory
  * and the area is cleared to zero.
+ * If @flags includes MONO_MMAP_HUGEPAGES the OS is asked to back the area
+ * with huge pages: only the parts of it which are aligned to the huge page
+ * size can use them.
  * @addr must be aligned to the page size.
  * @length must be a multiple of the page size.
  *
@@ -388,9 +417,171 @@ mono_mprotect (void *addr, size_t length, int flags)
 #endif
 #endif
 	}
+#ifdef MADV_HUGEPAGE
+	if (flags & MONO_MMAP_HUGEPAGES)
+		madvise (addr, length, MADV_HUGEPAGE);
+#endif
 	return mprotect (addr, length, prot);
 }
 
+/**
+ * mono_mresident:
+ * @addr: memory address
+ * @length: memory area size
+ *
+ * Query how much of the memory area starting at @addr is currently
+ * resident in physical memory. This is mostly useful to find out how
+ * many pages of a file mapping were actually touched.
+ * @addr must be aligned to the page size.
+ *
+ * Returns: the number of resident pages, or -1 if this can't be determined.
+ */
+int
+mono_mresident (void *addr, size_t length)
+{
+#ifdef HAVE_MINCORE
+	unsigned char vec [256];
+	size_t pagesize = mono_pagesize ();
+	size_t npages = (length + pagesize - 1) / pagesize;
+	char *p = addr;
+	int i, count, resident = 0;
+
+	while (npages) {
+		count = npages > sizeof (vec) ? sizeof (vec) : npages;
+		/* the vector is unsigned char* on linux and char* on the BSDs */
+		if (mincore ((void*)p, count * pagesize, (void*)vec) != 0)
+			return -1;
+		for (i = 0; i < count; ++i)
+			resident += vec [i] & 1;
+		p += count * pagesize;
+		npages -= count;
+	}
+	return resident;
+#else
+	return -1;
+#endif
+}
+
+/**
+ * mono_hugepage_size:
+ *
+ * Returns: the size of the huge pages the OS can use to back anonymous
+ * memory, or 0 if it doesn't support them.
+ */
+int
+mono_hugepage_size (void)
+{
+	static int saved_hugepage_size = -1;
+#ifdef __linux__
+	FILE *file;
+	char buf [128];
+	int size = 0;
+
+	if (saved_hugepage_size >= 0)
+		return saved_hugepage_size;
+
+	if ((file = fopen ("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r"))) {
+		if (fgets (buf, sizeof (buf), file))
+			size = atoi (buf);
+		fclose (file);
+	}
+	if (!size && (file = fopen ("/proc/meminfo", "r"))) {
+		while (fgets (buf, sizeof (buf), file)) {
+			if (strncmp (buf, "Hugepagesize:", 13) == 0) {
+				/* the value is in kB */
+				size = atoi (buf + 13) * 1024;
+				break;
+			}
+		}
+		fclose (file);
+	}
+	saved_hugepage_size = size;
+#else
+	saved_hugepage_size = 0;
+#endif
+	return saved_hugepage_size;
+}
+
+#if defined(__linux__) && defined(SYS_mbind)
+#define MPOL_DEFAULT 0
+#define MPOL_PREFERRED 1
+#define MPOL_INTERLEAVE 3
+#define MAX_NUMA_NODES 256
+
+/*
+ * Set the bits of the nodes with memory in NODES, by parsing the
+ * range list in sysfs, like "0-1,3".
+ */
+static int
+get_memory_nodes (unsigned long *nodes)
+{
+	FILE *file;
+	char buf [256], *p;
+	int res = 0;
+
+	memset (nodes, 0, MAX_NUMA_NODES / 8);
+	file = fopen ("/sys/devices/system/node/has_memory", "r");
+	if (!file)
+		file = fopen ("/sys/devices/system/node/online", "r");
+	if (!file)
+		return 0;
+	if (fgets (buf, sizeof (buf), file)) {
+		p = buf;
+		while (*p >= '0' && *p <= '9') {
+			int first, last, i;
+
+			first = last = strtol (p, &p, 10);
+			if (*p == '-')
+				last = strtol (p + 1, &p, 10);
+			for (i = first; i <= last && i < MAX_NUMA_NODES; ++i)
+				nodes [i / (sizeof (unsigned long) * 8)] |= 1UL << (i % (sizeof (unsigned long) * 8));
+			if (last >= first)
+				res += last - first + 1;
+			if (*p == ',')
+				p++;
+		}
+	}
+	fclose (file);
+	return res;
+}
+#endif
+
+/**
+ * mono_mbind:
+ * @addr: memory address
+ * @length: memory area size
+ * @policy: one of the MONO_NUMA_ values
+ *
+ * Set the NUMA placement policy for the pages of the memory area at
+ * @addr which are not yet allocated.
+ * @addr must be aligned to the page size.
+ *
+ * Returns: 0 on success, -1 on failure or if NUMA is not supported.
+ */
+int
+mono_mbind (void *addr, size_t length, int policy)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+	unsigned long nodes [MAX_NUMA_NODES / (sizeof (unsigned long) * 8)];
+
+	switch (policy) {
+	case MONO_NUMA_DEFAULT:
+		return syscall (SYS_mbind, addr, length, MPOL_DEFAULT, NULL, 0, 0) ? -1 : 0;
+	case MONO_NUMA_LOCAL:
+		/* an empty node mask means the node of the faulting thread */
+		return syscall (SYS_mbind, addr, length, MPOL_PREFERRED, NULL, 0, 0) ? -1 : 0;
+	case MONO_NUMA_INTERLEAVE:
+		if (get_memory_nodes (nodes) < 2)
+			return -1;
+		return syscall (SYS_mbind, addr, length, MPOL_INTERLEAVE, nodes, MAX_NUMA_NODES + 1, 0) ? -1 : 0;
+	default:
+		return -1;
+	}
+#else
+	return -1;
+#endif
+}
+
 #else
 
 /* dummy malloc-based implementation */
@@ -421,6 +612,24 @@ mono_mprotect (void *addr, size_t length, int flags)
 	}
 	return 0;
 }
+
+int
+mono_mresident (void *addr, size_t length)
+{
+	return -1;
+}
+
+int
+mono_hugepage_size (void)
+{
+	return 0;
+}
+
+int
+mono_mbind (void *addr, size_t length, int policy)
+{
+	return -1;
+}
 #endif // HAVE_MMAP
 
 #if defined(HAVE_SHM_OPEN)
@@ -16,7 +16,19 @@ enum {
 	MONO_MMAP_SHARED  = 1 << 5,
 	MONO_MMAP_ANON    = 1 << 6,
 	MONO_MMAP_FIXED   = 1 << 7,
-	MONO_MMAP_32BIT   = 1 << 8
+	MONO_MMAP_32BIT   = 1 << 8,
+	/* ask the OS to back the memory with huge pages when possible */
+	MONO_MMAP_HUGEPAGES = 1 << 9
+};
+
+/* NUMA placement policies for mono_mbind () */
+enum {
+	/* use the policy of the process */
+	MONO_NUMA_DEFAULT,
+	/* allocate pages on the node of the thread which first touches them */
+	MONO_NUMA_LOCAL,
+	/* spread the pages over all the nodes */
+	MONO_NUMA_INTERLEAVE
 };
 
 /*
@@ -35,6 +47,9 @@ int   mono_vfree      (void *addr, size_t length);
 void* mono_file_map   (size_t length, int flags, int fd, guint64 offset, void **ret_handle);
 int   mono_file_unmap (void *addr, void *handle);
 int   mono_mprotect   (void *addr, size_t length, int flags);
+int   mono_mresident  (void *addr, size_t length);
+int   mono_hugepage_size (void);
+int   mono_mbind      (void *addr, size_t length, int policy);
 
 void* mono_shared_area         (void);
 void  mono_shared_area_remove  (void);